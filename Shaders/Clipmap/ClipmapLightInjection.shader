@@ -0,0 +1,48 @@
+// Injects the direct light of a directional light into the radiance of the clipmap cascades,
+// one thread per shadow map texel. Like LightInjection.shader for the SVO, the radiance is the
+// voxel color times the light color; every cascade that holds the lit surface gets it.
+
+#version 430
+
+#include "Clipmap/_clipmap.shader"
+
+uniform sampler2D smPosition;
+uniform sampler3D clipmapAlbedo[MAX_CLIPMAP_CASCADES];
+layout(rgba8) uniform writeonly image3D clipmapRadiance[MAX_CLIPMAP_CASCADES];
+
+uniform mat4 lightViewProj; // the shadow map was rendered with it
+
+struct DirectionalLight {
+	vec3 position;
+	vec3 direction;
+	vec3 up;
+	vec2 size;
+	vec3 color;
+};
+
+uniform DirectionalLight directionalLights[1];
+uniform int numberOfDirLights;
+
+void main() {
+  ivec2 smTexSize = textureSize(smPosition, 0);
+  ivec2 smTexel = ivec2(gl_VertexID % smTexSize.x, gl_VertexID / smTexSize.x);
+  vec3 posWS = texelFetch(smPosition, smTexel, 0).xyz;
+
+  // Texels without a surface hold the clear value, which does not project back onto them
+  vec4 posLight = lightViewProj * vec4(posWS, 1.0);
+  vec2 smPos = (posLight.xy / posLight.w * 0.5 + 0.5) * vec2(smTexSize);
+  if (any(greaterThan(abs(smPos - (vec2(smTexel) + 0.5)), vec2(1.0)))) {
+    return;
+  }
+
+  for (int i = 0; i < numCascades; ++i) {
+    ivec3 cell = ivec3(floor(posWS / getCascadeVoxelSize(i)));
+    if (!isCellInCascade(i, cell)) {
+      continue;
+    }
+
+    ivec3 texel = cellToTexel(cell);
+    vec4 albedo = texelFetch(clipmapAlbedo[i], texel, 0);
+    imageStore(clipmapRadiance[i], texel, vec4(directionalLights[0].color * albedo.rgb * albedo.a, albedo.a));
+  }
+}
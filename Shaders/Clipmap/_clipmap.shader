@@ -0,0 +1,23 @@
+// Camera centred voxel clipmap, see VoxelClipmap.h. Every cascade has clipmapResolution voxels along
+// one edge and twice the voxel size of the one before it. Cell c of a cascade, counted in its voxels
+// from the world origin, is stored in texel c mod clipmapResolution.
+
+#define MAX_CLIPMAP_CASCADES 6
+
+uniform int clipmapResolution;
+uniform int numCascades;
+uniform float clipmapVoxelSize; // voxel size of the finest cascade
+uniform ivec3 clipmapOrigin[MAX_CLIPMAP_CASCADES]; // first cell of each cascade
+
+float getCascadeVoxelSize(in int cascade) {
+  return clipmapVoxelSize * float(1 << cascade);
+}
+
+ivec3 cellToTexel(in ivec3 cell) {
+  return cell & ivec3(clipmapResolution - 1);
+}
+
+bool isCellInCascade(in int cascade, in ivec3 cell) {
+  return all(greaterThanEqual(cell, clipmapOrigin[cascade])) &&
+         all(lessThan(cell, clipmapOrigin[cascade] + ivec3(clipmapResolution)));
+}
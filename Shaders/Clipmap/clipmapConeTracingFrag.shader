@@ -0,0 +1,335 @@
+// Voxel cone tracing through the cascades of a voxel clipmap (see _clipmap.shader), the counterpart of
+// voxelConeTracingFrag.shader for the SVO. A cone samples the cascade whose voxels match its diameter
+// and blends it with the next coarser one, with hardware filtered lookups instead of octree traversals.
+#version 450 core
+// --------------------------------------
+// Light (voxel) cone tracing settings.
+// --------------------------------------
+#define MAX_CONE_STEPS 128
+#define CONE_STEP 0.5 /* Distance between the samples of a cone, in voxels of the sampled size. */
+// --------------------------------------
+// Other lighting settings.
+// --------------------------------------
+#define SPECULAR_MODE 1 /* 0 == Blinn-Phong (halfway vector), 1 == reflection model. */
+#define SPECULAR_FACTOR 4.0f /* Specular intensity tweaking factor. */
+#define SPECULAR_POWER 65.0f /* Specular power in Blinn-Phong. */
+#define MAX_LIGHTS 1 /* Maximum number of lights supported. */
+
+// Lighting attenuation factors. See the function "attenuate" (below) for more information.
+#define DIST_FACTOR 1.1f /* Distance is multiplied by this when calculating attenuation. */
+#define CONSTANT 1
+#define LINEAR 0 /* Looks meh when using gamma correction. */
+#define QUADRATIC 1
+
+#include "Clipmap/_clipmap.shader"
+
+uniform sampler3D clipmapAlbedo[MAX_CLIPMAP_CASCADES]; // the opacity is in alpha
+uniform sampler3D clipmapRadiance[MAX_CLIPMAP_CASCADES];
+
+uniform sampler2D smPosition;
+
+// Basic point light.
+struct PointLight {
+	vec3 position;
+	vec3 color;
+};
+struct DirectionalLight {
+	vec3 position;
+	vec3 direction;
+	vec3 up;
+	vec2 size;
+	vec3 color;
+};
+
+// Basic material.
+struct Material {
+	vec3 diffuseColor;
+	float diffuseReflectivity;
+	vec3 specularColor;
+	float specularDiffusion; // "Reflective and refractive" specular diffusion.
+	float specularReflectivity;
+	float emissivity; // Emissive materials uses diffuse color as emissive color.
+	float refractiveIndex;
+	float transparency;
+};
+
+struct Settings {
+	bool indirectSpecularLight; // Whether indirect specular light should be rendered or not.
+	bool indirectDiffuseLight; // Whether indirect diffuse light should be rendered or not.
+	bool directLight; // Whether direct light should be rendered or not.
+	bool shadows; // Whether shadows should be rendered or not.
+};
+
+uniform float directLightMultiplier;
+uniform float indirectLightMultiplier;
+uniform Material material;
+uniform Settings settings;
+uniform PointLight pointLights[MAX_LIGHTS];
+uniform int numberOfLights; // Number of lights currently uploaded.
+
+uniform DirectionalLight directionalLights[1];
+uniform int numberOfDirLights;
+
+uniform vec3 cameraPosition; // World campera position.
+
+in vec3 worldPositionFrag;
+in vec3 normalFrag;
+
+out vec4 color;
+
+vec3 normal = normalize(normalFrag);
+
+// The cascade differs between the fragments, so the samplers are indexed with constants.
+void sampleCascade(in int cascade, in vec3 posTex, out vec4 albedo, out vec4 radiance) {
+	switch (cascade) {
+	case 0: albedo = textureLod(clipmapAlbedo[0], posTex, 0); radiance = textureLod(clipmapRadiance[0], posTex, 0); break;
+	case 1: albedo = textureLod(clipmapAlbedo[1], posTex, 0); radiance = textureLod(clipmapRadiance[1], posTex, 0); break;
+	case 2: albedo = textureLod(clipmapAlbedo[2], posTex, 0); radiance = textureLod(clipmapRadiance[2], posTex, 0); break;
+	case 3: albedo = textureLod(clipmapAlbedo[3], posTex, 0); radiance = textureLod(clipmapRadiance[3], posTex, 0); break;
+	case 4: albedo = textureLod(clipmapAlbedo[4], posTex, 0); radiance = textureLod(clipmapRadiance[4], posTex, 0); break;
+	default: albedo = textureLod(clipmapAlbedo[5], posTex, 0); radiance = textureLod(clipmapRadiance[5], posTex, 0); break;
+	}
+}
+
+// True if the filter footprint around posWorld lies inside the cascade.
+bool isInCascade(in int cascade, in vec3 posWorld) {
+	vec3 posCell = posWorld / getCascadeVoxelSize(cascade);
+	return all(greaterThanEqual(posCell, vec3(clipmapOrigin[cascade]) + 0.5)) &&
+		all(lessThanEqual(posCell, vec3(clipmapOrigin[cascade] + ivec3(clipmapResolution)) - 0.5));
+}
+
+// Opacity and radiance (premultiplied by the opacity) of the voxels of size diameter at posWorld.
+// Returns false outside of the coarsest cascade.
+bool sampleClipmap(in vec3 posWorld, in float diameter, out float opacity, out vec3 radiance) {
+	float lod = clamp(log2(diameter / clipmapVoxelSize), 0.0, float(numCascades - 1));
+	int cascade = int(lod);
+
+	// The finer cascades end before the coarser ones
+	while (cascade < numCascades && !isInCascade(cascade, posWorld)) {
+		++cascade;
+		lod = float(cascade);
+	}
+	if (cascade >= numCascades) {
+		return false;
+	}
+
+	vec4 albedo, rad;
+	sampleCascade(cascade, posWorld / (getCascadeVoxelSize(cascade) * float(clipmapResolution)), albedo, rad);
+
+	float blend = lod - float(cascade);
+	if (blend > 0.0 && isInCascade(cascade + 1, posWorld)) {
+		vec4 coarserAlbedo, coarserRad;
+		sampleCascade(cascade + 1, posWorld / (getCascadeVoxelSize(cascade + 1) * float(clipmapResolution)), coarserAlbedo, coarserRad);
+		albedo = mix(albedo, coarserAlbedo, blend);
+		rad = mix(rad, coarserRad, blend);
+	}
+
+	opacity = albedo.a;
+	radiance = rad.rgb;
+	return true;
+}
+
+// Returns an attenuation factor given a distance.
+float attenuate(float dist){ dist *= DIST_FACTOR; return 1.0f / (CONSTANT + LINEAR * dist + QUADRATIC * dist * dist); }
+
+// Returns a vector that is orthogonal to u.
+vec3 orthogonal(vec3 u){
+	u = normalize(u);
+	vec3 v = vec3(0.99146, 0.11664, 0.05832); // Pick any normalized vector.
+	return abs(dot(u, v)) > 0.99999f ? cross(u, vec3(0, 1, 0)) : cross(u, v);
+}
+
+// Traces a voxel cone, front to back until it is opaque or leaves the clipmap.
+vec3 traceVoxelCone(const vec3 from, vec3 direction, float coneHalfAngle){
+	direction = normalize(direction);
+	const float coneTangent = tan(coneHalfAngle);
+
+	vec4 acc = vec4(0, 0, 0, 1); // radiance and transmittance
+	float dist = clipmapVoxelSize;
+	for (int i = 0; i < MAX_CONE_STEPS && acc.a > 0.05; i++)
+	{
+		float diameter = max(clipmapVoxelSize, 2.0 * coneTangent * dist);
+		float opacity;
+		vec3 radiance;
+		if (!sampleClipmap(from + dist * direction, diameter, opacity, radiance)) {
+			break;
+		}
+
+		// The opacity of a voxel is for its whole size, a step covers CONE_STEP of it
+		float stepOpacity = 1.0 - pow(clamp(1.0 - opacity, 0.0, 1.0), CONE_STEP);
+		acc.rgb += acc.a * radiance * (opacity > 0.0 ? stepOpacity / opacity : 0.0);
+		acc.a *= 1.0 - stepOpacity;
+		dist += CONE_STEP * diameter;
+	}
+	return acc.rgb;
+}
+
+// Calculates indirect diffuse light using voxel cone tracing, with the cones of voxelConeTracingFrag.shader.
+vec3 indirectDiffuseLight() {
+	const vec3 directionCoef[6] = {
+		normalize(vec3(0, 0, 1)),       normalize(vec3(1,0,0.83)),
+		normalize(vec3(0.31,0.95,0.83)),  normalize(vec3(0.31,-0.95,0.83)),
+		normalize(vec3(-0.81,0.58,0.83)), normalize(vec3(-0.81,-0.58,0.83)),
+	};
+
+	const float coneAngle[6] = {
+		60,40,40,40,40,40,
+	};
+
+	const vec3 xAxis = normalize(orthogonal(normal));
+	const vec3 yAxis = normalize(cross(xAxis, normal));
+	const vec3 zAxis = normal;
+
+	const vec3 origin = worldPositionFrag + normal * clipmapVoxelSize * 1.732;
+	vec3 acc = vec3(0);
+
+	for (int i = 0; i < 6; i++)
+	{
+		vec3 coef = directionCoef[i];
+		const float coneHalfAngle = coneAngle[i] / 180 * 3.1415;
+		vec3 direction = xAxis * coef.x + yAxis * coef.y + zAxis * coef.z;
+		float solidAngle = 2 * 3.14 * (1 - cos(coneHalfAngle));
+		acc += traceVoxelCone(origin, direction, coneHalfAngle) * coef.z * solidAngle;
+	}
+	return material.diffuseReflectivity * acc * material.diffuseColor;
+}
+
+// Calculates indirect specular light using voxel cone tracing.
+vec3 indirectSpecularLight(vec3 viewDirection){
+	const float cosVal = clamp(dot(-viewDirection, normal), 0.0, 1.0);
+	const vec3 reflection = normalize(reflect(viewDirection, normal));
+	const float coneHalfAngle = material.specularDiffusion * 0.5;
+
+	const vec3 origin = worldPositionFrag + normal * clipmapVoxelSize * 1.732;
+	vec3 incomeSpecular = traceVoxelCone(origin, reflection, coneHalfAngle);
+	return material.specularReflectivity * material.specularColor * incomeSpecular * cosVal;
+}
+
+// Calculates diffuse and specular direct light for a given point light.
+vec3 calculateDirectLight(const PointLight light, const vec3 viewDirection){
+	vec3 lightDirection = light.position - worldPositionFrag;
+	const float distanceToLight = length(lightDirection);
+	lightDirection = lightDirection / distanceToLight;
+	const float lightAngle = dot(normal, lightDirection);
+
+	// Diffuse lighting.
+	float diffuseAngle = max(lightAngle, 0.0f); // Lambertian.
+
+	// Specular lighting.
+#if (SPECULAR_MODE == 0) /* Blinn-Phong. */
+	const vec3 halfwayVector = normalize(lightDirection + viewDirection);
+	float specularAngle = max(dot(normal, halfwayVector), 0.0f);
+#endif
+
+#if (SPECULAR_MODE == 1) /* Perfect reflection. */
+	const vec3 reflection = normalize(reflect(viewDirection, normal));
+	float specularAngle = max(0, dot(reflection, lightDirection));
+#endif
+
+	float refractiveAngle = 0;
+	if(material.transparency > 0.01){
+		vec3 refraction = refract(viewDirection, normal, 1.0 / material.refractiveIndex);
+		refractiveAngle = max(0, material.transparency * dot(refraction, lightDirection));
+	}
+
+	// Add it all together.
+	specularAngle = max(specularAngle, refractiveAngle);
+	const float df = 1.0f / (1.0f + 0.25f * material.specularDiffusion); // Diffusion factor.
+	const float specular = SPECULAR_FACTOR * pow(specularAngle, df * SPECULAR_POWER);
+	const float diffuse = diffuseAngle * (1.0f - material.transparency);
+
+	const vec3 diff = material.diffuseReflectivity * material.diffuseColor * diffuse;
+	const vec3 spec = material.specularReflectivity * material.specularColor * specular;
+	const vec3 total = light.color * (diff + spec);
+	return attenuate(distanceToLight) * total;
+};
+
+// Direct light of a directional light, shadowed with its shadow map.
+vec3 calculateDirectDirLight(const DirectionalLight light, const vec3 viewDirection) {
+	vec3 pointPosToLight = worldPositionFrag - light.position;
+	if (dot(pointPosToLight, light.direction) < 0)
+		return vec3(0);
+	if (dot(normal, light.direction * -1.0) < 0)
+		return vec3(0);
+
+	vec3 xAxis = normalize(cross(light.direction, light.up));
+	vec3 yAxis = normalize(cross(xAxis, light.direction));
+	float xProj = dot(pointPosToLight, xAxis);
+	float yProj = dot(pointPosToLight, yAxis);
+	float zProj = dot(pointPosToLight, light.direction);
+	float halfWidth = light.size.x*0.5;
+	float halfHeight = light.size.y*0.5;
+	if (xProj < -halfWidth || xProj > halfWidth)
+		return vec3(0);
+	if (yProj < -halfHeight || yProj > halfHeight)
+		return vec3(0);
+
+	vec2 uv = vec2(xProj / halfWidth, yProj / halfHeight) * 0.5 + 0.5;
+	vec3 shadowPosWS =texture(smPosition, uv).xyz;
+	float shadowZ = dot(shadowPosWS - light.position, light.direction);
+	if (settings.shadows && shadowZ > 0.0 && shadowZ < zProj - 0.04)
+		return vec3(0);
+
+	vec3 lightDirection = light.direction;
+	const float distanceToLight = zProj;
+	const float lightAngle = dot(normal, light.direction * -1.0);
+
+	// Diffuse lighting.
+	float diffuseAngle = max(lightAngle, 0.0f); // Lambertian.
+
+	// Specular lighting.
+#if (SPECULAR_MODE == 0) /* Blinn-Phong. */
+	const vec3 halfwayVector = normalize(lightDirection + viewDirection);
+	float specularAngle = max(dot(normal, halfwayVector), 0.0f);
+#endif
+
+#if (SPECULAR_MODE == 1) /* Perfect reflection. */
+	const vec3 reflection = normalize(reflect(viewDirection, normal));
+	float specularAngle = max(0, dot(reflection, lightDirection));
+#endif
+
+	float refractiveAngle = 0;
+	if (material.transparency > 0.01) {
+		vec3 refraction = refract(viewDirection, normal, 1.0 / material.refractiveIndex);
+		refractiveAngle = max(0, material.transparency * dot(refraction, lightDirection));
+	}
+
+	// Add it all together.
+	specularAngle = max(specularAngle, refractiveAngle);
+	const float df = 1.0f / (1.0f + 0.25f * material.specularDiffusion); // Diffusion factor.
+	const float specular = SPECULAR_FACTOR * pow(specularAngle, df * SPECULAR_POWER);
+	const float diffuse = diffuseAngle * (1.0f - material.transparency);
+
+	const vec3 diff = material.diffuseReflectivity * material.diffuseColor * diffuse;
+	const vec3 spec = material.specularReflectivity * material.specularColor * specular;
+	const vec3 total = light.color * (diff + spec);
+	return attenuate(distanceToLight) * total;
+};
+
+// Sums up all direct light from point lights and directional lights (both diffuse and specular).
+vec3 directLight(vec3 viewDirection){
+	vec3 direct = vec3(0.0f);
+	const uint maxLights = min(numberOfLights, MAX_LIGHTS);
+	for(uint i = 0; i < maxLights; ++i)
+		direct += calculateDirectLight(pointLights[i], viewDirection);
+	for (uint i = 0; i < numberOfDirLights; ++i)
+		direct += calculateDirectDirLight(directionalLights[i], viewDirection);
+	return direct;
+}
+
+void main(){
+	color = vec4(0, 0, 0, 1);
+	vec3 viewDir = normalize(worldPositionFrag - cameraPosition);
+
+	// Indirect diffuse light.
+	if(settings.indirectDiffuseLight && material.diffuseReflectivity * (1.0f - material.transparency) > 0.01f)
+		color.rgb += indirectLightMultiplier * indirectDiffuseLight();
+
+	// Indirect specular light (glossy reflections).
+	if(settings.indirectSpecularLight && material.specularReflectivity * (1.0f - material.transparency) > 0.01f)
+		color.rgb += indirectLightMultiplier * indirectSpecularLight(viewDir);
+
+	// Direct light.
+	if(settings.directLight)
+		color.rgb += directLightMultiplier * directLight(viewDir);
+}
@@ -0,0 +1,31 @@
+#version 430
+
+layout(rgba8) uniform writeonly image3D clipmapAlbedo;
+
+uniform int clipmapResolution;
+uniform ivec3 regionMin; // only cells inside the region are written
+uniform ivec3 regionMax;
+
+struct Material {
+	vec3 diffuseColor;
+	vec3 specularColor;
+	float diffuseReflectivity;
+	float specularReflectivity;
+	float emissivity;
+	float transparency;
+};
+uniform Material material;
+
+in VoxelData{
+	vec3 posCell;
+} In;
+
+void main() {
+	ivec3 cell = regionMin + ivec3(floor(In.posCell));
+	if (any(lessThan(cell, regionMin)) || any(greaterThan(cell, regionMax))) {
+		discard;
+	}
+
+	// The last fragment in a voxel wins, the cones filter the cascades in hardware anyway
+	imageStore(clipmapAlbedo, cell & ivec3(clipmapResolution - 1), vec4(material.diffuseColor, 1.0));
+}
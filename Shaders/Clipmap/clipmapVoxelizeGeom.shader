@@ -0,0 +1,41 @@
+#version 430
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+in VertexData{
+	vec3 pos;
+	vec3 normal;
+	vec2 uv;
+} In[3];
+
+out VoxelData{
+	vec3 posCell; // position in cells of the cascade, relative to regionMin
+} Out;
+
+uniform float voxelSize; // of the cascade that is voxelized
+uniform ivec3 regionMin;
+uniform int clipmapResolution;
+
+void main()
+{
+	// Project along the axis the triangle faces most. The viewport covers clipmapResolution
+	// cells from regionMin, which is at least the size of the region.
+	vec3 faceNormal = abs(cross(In[1].pos - In[0].pos, In[2].pos - In[0].pos));
+	for (int i = 0; i < gl_in.length(); i++) {
+		Out.posCell = In[i].pos / voxelSize - vec3(regionMin);
+
+		vec2 projPos;
+		if (faceNormal.z >= faceNormal.x && faceNormal.z >= faceNormal.y) {
+			projPos = Out.posCell.xy;
+		} else if (faceNormal.x >= faceNormal.y) {
+			projPos = Out.posCell.yz;
+		} else {
+			projPos = Out.posCell.xz;
+		}
+		gl_Position = vec4(projPos / float(clipmapResolution) * 2.0 - 1.0, 0.5, 1.0);
+
+		EmitVertex();
+	}
+	EndPrimitive();
+}
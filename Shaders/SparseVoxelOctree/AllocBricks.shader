@@ -1,28 +1,28 @@
-#version 420 core
+#version 430 core
 
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform uimageBuffer nodePool_next;
 layout(r32ui) uniform uimageBuffer nodePool_color;
-layout(binding = 0) uniform atomic_uint nextFreeBrick;
-
-uniform uint brickPoolResolution;
+#endif
 
 #include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_brickAllocator.shader"
 
 
-// Allocate brick-texture, store pointer in color
-void alloc3x3x3TextureBrick(in int nodeAddress) {
-  uint nextFreeTexBrick = atomicCounterIncrement(nextFreeBrick);
-  memoryBarrier();
-  uvec3 texAddress = uvec3(0);
-  uint brickPoolResBricks = brickPoolResolution / 3;
-  texAddress.x = nextFreeTexBrick % brickPoolResBricks;
-  texAddress.y = (nextFreeTexBrick / brickPoolResBricks) % brickPoolResBricks;
-  texAddress.z = nextFreeTexBrick / (brickPoolResBricks * brickPoolResBricks);
-  texAddress *= 3;
+// Allocate brick-texture, store pointer in color.
+// Nodes which find the brick pool full are left empty, like nodes past the node pool.
+void alloc3x3x3TextureBrick(in int nodeAddress, in uint staticTag) {
+  uint brickIndex = takeBrick();
+  if (brickIndex == 0U) {
+    storeNode(NODE_NEXT, nodeAddress, loadNode(NODE_NEXT, nodeAddress) & ~uint(NODE_MASK_BRICK));
+    return;
+  }
+  uvec3 texAddress = brickIndexToAddress(brickIndex);
 
   // Store brick-pointer
-  imageStore(nodePool_color, nodeAddress,
-      uvec4(vec3ToUintXYZ10(texAddress), 0, 0, 0));
+  storeNode(NODE_COLOR, nodeAddress, vec3ToUintXYZ10(texAddress) | staticTag);
 }
 
 void main() {
@@ -30,17 +30,20 @@ void main() {
 
   for (uint i = 0; i < 8; ++i) {
     int address = int(tileAddress + i);
-	uint nodeNextU = imageLoad(nodePool_next, address).x;
-	if ((nodeNextU & NODE_MASK_BRICK) != 0)
+	uint nodeNextU = loadNode(NODE_NEXT, address);
+	uint nodeColorU = loadNode(NODE_COLOR, address);
+	// Nodes from an earlier build already have a brick (brick 0 is never handed out),
+	// the static tag above the brick pointer is kept
+	if ((nodeNextU & NODE_MASK_BRICK) != 0 && (nodeColorU & NODE_MASK_VALUE) == 0U)
 	{
 		// allocate new brick
-		alloc3x3x3TextureBrick(address);
+		alloc3x3x3TextureBrick(address, nodeColorU & uint(NODE_MASK_TAG_STATIC));
 	}
   }
 
   // root brick
-  if (gl_VertexID == 0)
+  if (gl_VertexID == 0 && (loadNode(NODE_COLOR, 0) & NODE_MASK_VALUE) == 0U)
   {
-	  alloc3x3x3TextureBrick(0);
+	  alloc3x3x3TextureBrick(0, loadNode(NODE_COLOR, 0) & uint(NODE_MASK_TAG_STATIC));
   }
 }
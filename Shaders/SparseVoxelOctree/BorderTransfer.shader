@@ -26,8 +26,17 @@
 //#version 430 core
 //#define THREAD_MODE 0
 
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 uniform usamplerBuffer nodePool_color;
-uniform usamplerBuffer nodePool_Neighbour;
+uniform usamplerBuffer nodePool_Neighbour; // neighbours along axis
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+#define NODE_NEIGHBOUR nodePool_Neighbour
+#else
+#define NODE_NEIGHBOUR neighbours[2U * axis]
+#endif
 
 uniform usamplerBuffer levelAddressBuffer;
 layout(rgba8) uniform volatile image3D brickPool_value;
@@ -37,8 +46,11 @@ uniform uint numLevels;
 uniform uint axis;
 
 uniform usampler2D nodeMap;
-uniform ivec2 nodeMapOffset[8];
-uniform ivec2 nodeMapSize[8];
+
+// THREAD_MODE_REGION: cells on the current level whose bricks were rebuilt. The threads also cover
+// one cell more on the negative side, so every pair with one node inside the region is visited.
+uniform ivec3 updateRegionMin;
+uniform ivec3 updateRegionMax;
 
 #define NODE_MASK_VALUE 0x3FFFFFFF
 #define NODE_NOT_FOUND 0xFFFFFFFF
@@ -52,12 +64,27 @@ uniform ivec2 nodeMapSize[8];
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 #include "SparseVoxelOctree/_threadNodeUtil.shader"
 
+bool nodeRebuilt = true;
+bool neighbourRebuilt = true;
+
 vec4 getFinalVal(in vec4 borderVal, in vec4 neighbourBorderVal) {
+  // Bricks outside of the update region already hold the averaged border, which is copied over
+  if (!nodeRebuilt) {
+    return borderVal;
+  }
+  if (!neighbourRebuilt) {
+    return neighbourBorderVal;
+  }
+
   vec4 col = 0.5 * (borderVal + neighbourBorderVal);
   
   return col;
 }
 
+bool insideUpdateRegion(in ivec3 cell) {
+  return all(greaterThanEqual(cell, updateRegionMin)) && all(lessThanEqual(cell, updateRegionMax));
+}
+
 ///*
 //This shader is launched for every node up to a specific level, so that gl_VertexID 
 //exactly matches all node-addresses in a dense octree. */
@@ -67,15 +94,25 @@ void main() {
     return;  // The requested threadID-node does not belong to the current level
   }
 
-  uint brickAddrU = texelFetch(nodePool_color, int(nodeAddress)).x;
+  uint brickAddrU = fetchNode(NODE_COLOR, int(nodeAddress));
   ivec3 brickAddr = ivec3(uintXYZ10ToVec3(brickAddrU));
 
-  uint neighbourAddress = texelFetch(nodePool_Neighbour, int(nodeAddress)).x;  
+  uint neighbourAddress = fetchNode(NODE_NEIGHBOUR, int(nodeAddress));
   if (neighbourAddress == 0) {
     return;
   }
 
-  uint nBrickAddrU = texelFetch(nodePool_color, int(neighbourAddress)).x;
+#if THREAD_MODE == THREAD_MODE_REGION
+  ivec3 neighbourCell = threadCell;
+  neighbourCell[axis] += 1;
+  nodeRebuilt = insideUpdateRegion(threadCell);
+  neighbourRebuilt = insideUpdateRegion(neighbourCell);
+  if (!nodeRebuilt && !neighbourRebuilt) {
+    return;
+  }
+#endif
+
+  uint nBrickAddrU = fetchNode(NODE_COLOR, int(neighbourAddress));
   ivec3 nBrickAddr = ivec3(uintXYZ10ToVec3(nBrickAddrU));
   //if (brickAddr == nBrickAddr)
   //{
@@ -0,0 +1,180 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+//#version 430 core
+//#define THREAD_MODE 0
+
+// Averages the borders of neighbouring bricks along all three axes in one pass, with the same
+// result as the three passes of BorderTransfer.shader. Those average the X faces, then the Y faces
+// of the new values, then the Z faces, so the edge and corner voxels shared by up to 8 bricks
+// mix in that order, and empty neighbours leave gaps in the mixing.
+// Every border voxel belongs to the group of copies at the same place in the bricks around it.
+// The node with the lowest corner among the connected nodes of a group replays the three passes
+// for the group, and is the only thread reading and writing its voxels, so no pass races with another.
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+uniform usamplerBuffer nodePool_color;
+uniform usamplerBuffer nodePool_X;
+uniform usamplerBuffer nodePool_X_neg;
+uniform usamplerBuffer nodePool_Y;
+uniform usamplerBuffer nodePool_Y_neg;
+uniform usamplerBuffer nodePool_Z;
+uniform usamplerBuffer nodePool_Z_neg;
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+#endif
+
+uniform usamplerBuffer levelAddressBuffer;
+
+#define BORDER_POOLS 3
+layout(rgba8) uniform image3D brickPools[BORDER_POOLS];
+uniform int numBrickPools;
+
+uniform uint level;
+uniform uint numLevels;
+
+uniform usampler2D nodeMap;
+
+// THREAD_MODE_REGION: cells on the current level whose bricks were rebuilt. The threads also cover
+// one cell more on both sides, so every group with one node inside the region has its owner.
+uniform ivec3 updateRegionMin;
+uniform ivec3 updateRegionMax;
+
+#define NODE_MASK_VALUE 0x3FFFFFFF
+#define NODE_NOT_FOUND 0xFFFFFFFF
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
+#include "SparseVoxelOctree/_brickNeighbourUtil.shader"
+
+bool insideUpdateRegion(in ivec3 cell) {
+  return all(greaterThanEqual(cell, updateRegionMin)) && all(lessThanEqual(cell, updateRegionMax));
+}
+
+// The value an RGBA8 image returns after storing v
+vec4 storedValue(in vec4 v) {
+  return unpackUnorm4x8(packUnorm4x8(v));
+}
+
+void main() {
+  uint nodeAddress = getThreadNode();
+  if(nodeAddress == NODE_NOT_FOUND) {
+    return;  // The requested threadID-node does not belong to the current level
+  }
+
+  findBrickNeighbours(nodeAddress);
+
+  // One group per border voxel of the node. Its nodes are the corners of a cube of up to 2x2x2 cells,
+  // indexed by their corner bits, on the axes where the voxel lies on the border.
+  for (int v = 0; v < 27; ++v) {
+    ivec3 border = ivec3(v % 3, (v / 3) % 3, v / 9) - 1;
+    if (border == ivec3(0)) {
+      continue;
+    }
+    ivec3 cubeMin = min(border, ivec3(0));
+    int ownCorner = (border.x < 0 ? 1 : 0) + (border.y < 0 ? 2 : 0) + (border.z < 0 ? 4 : 0);
+    int cornerMask = (border.x != 0 ? 1 : 0) + (border.y != 0 ? 2 : 0) + (border.z != 0 ? 4 : 0);
+
+    // The corners connected to the node by links inside the cube
+    int group = 1 << ownCorner;
+    for (int step = 0; step < 3; ++step) {
+      for (int c = 0; c < 8; ++c) {
+        if ((group & (1 << c)) == 0) {
+          continue;
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+          int n = c ^ (1 << axis);
+          if ((cornerMask & (1 << axis)) != 0 && neighbours[cellIndex(cubeMin + ivec3(n & 1, (n >> 1) & 1, n >> 2))] > 0) {
+            group |= 1 << n;
+          }
+        }
+      }
+    }
+    int owners = group;
+#if THREAD_MODE == THREAD_MODE_LIGHT
+    // Only the lit nodes have threads, the lowest lit one owns the group. The unlit bricks are empty,
+    // so a group without lit nodes keeps its values.
+    owners = 0;
+    for (int c = 0; c < 8; ++c) {
+      int neighbour = neighbours[cellIndex(cubeMin + ivec3(c & 1, (c >> 1) & 1, c >> 2))];
+      if ((group & (1 << c)) != 0 && isLitNode(neighbour)) {
+        owners |= 1 << c;
+      }
+    }
+#endif
+    if (group == (1 << ownCorner) || findLSB(owners) != ownCorner) {
+      continue;  // Not shared, or another node of the group owns it
+    }
+
+    for (int pool = 0; pool < numBrickPools; ++pool) {
+      vec4 values[8];
+      for (int c = 0; c < 8; ++c) {
+        if ((group & (1 << c)) != 0) {
+          ivec3 corner = ivec3(c & 1, (c >> 1) & 1, c >> 2);
+          ivec3 voxel = ivec3(1) + (ivec3(1) - 2 * corner) * abs(border);
+          values[c] = imageLoad(brickPools[pool], neighbourBricks[cellIndex(cubeMin + corner)] + voxel);
+        }
+      }
+
+      // The X, Y and Z passes of BorderTransfer.shader, each averaging a pair of neighbours
+      for (int axis = 0; axis < 3; ++axis) {
+        if ((cornerMask & (1 << axis)) == 0) {
+          continue;
+        }
+        for (int c = 0; c < 8; ++c) {
+          int n = c | (1 << axis);
+          if (n == c || (group & (1 << c)) == 0 || (group & (1 << n)) == 0) {
+            continue;
+          }
+          vec4 finalVal = storedValue(0.5 * (values[c] + values[n]));
+#if THREAD_MODE == THREAD_MODE_REGION
+          // Bricks outside of the update region already hold the averaged border, which is copied over
+          ivec3 cell = threadCell + cubeMin + ivec3(c & 1, (c >> 1) & 1, c >> 2);
+          ivec3 neighbourCell = cell;
+          neighbourCell[axis] += 1;
+          bool nodeRebuilt = insideUpdateRegion(cell);
+          bool neighbourRebuilt = insideUpdateRegion(neighbourCell);
+          if (!nodeRebuilt && !neighbourRebuilt) {
+            continue;
+          }
+          finalVal = !nodeRebuilt ? values[c] : (!neighbourRebuilt ? values[n] : finalVal);
+#endif
+          values[c] = finalVal;
+          values[n] = finalVal;
+        }
+      }
+
+      for (int c = 0; c < 8; ++c) {
+        if ((group & (1 << c)) != 0) {
+          ivec3 corner = ivec3(c & 1, (c >> 1) & 1, c >> 2);
+          ivec3 voxel = ivec3(1) + (ivec3(1) - 2 * corner) * abs(border);
+          imageStore(brickPools[pool], neighbourBricks[cellIndex(cubeMin + corner)] + voxel, values[c]);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,56 @@
+// Clears the bricks the previous light update wrote, before the next one injects the lights again,
+// one thread per node of the level in last frame's lit node list (see _threadNodeUtil.shader).
+// The border transfer also wrote the borders of the neighbour bricks, these are cleared with them.
+//#version 430 core
+//#define THREAD_MODE 1
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+uniform usamplerBuffer nodePool_color;
+uniform usamplerBuffer nodePool_X;
+uniform usamplerBuffer nodePool_X_neg;
+uniform usamplerBuffer nodePool_Y;
+uniform usamplerBuffer nodePool_Y_neg;
+uniform usamplerBuffer nodePool_Z;
+uniform usamplerBuffer nodePool_Z_neg;
+#endif
+
+uniform usamplerBuffer levelAddressBuffer;
+
+#define CLEAR_POOLS 7 // the irradiance and the six directional pools
+layout(rgba8) uniform writeonly image3D brickPools[CLEAR_POOLS];
+uniform int numBrickPools;
+
+uniform uint level;
+uniform uint numLevels;
+
+uniform usampler2D nodeMap;
+
+#define NODE_MASK_VALUE 0x3FFFFFFF
+#define NODE_NOT_FOUND 0xFFFFFFFF
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
+#include "SparseVoxelOctree/_brickNeighbourUtil.shader"
+
+void main() {
+  uint nodeAddress = getThreadNode();
+  if(nodeAddress == NODE_NOT_FOUND) {
+    return;  // The requested threadID-node does not belong to the current level
+  }
+
+  findBrickNeighbours(nodeAddress);
+
+  for (int i = 0; i < 27; ++i) {
+    if (neighbours[i] <= 0) {
+      continue;
+    }
+    for (int pool = 0; pool < numBrickPools; ++pool) {
+      for (int v = 0; v < 27; ++v) {
+        imageStore(brickPools[pool], neighbourBricks[i] + ivec3(v % 3, (v / 3) % 3, v / 9), vec4(0.0));
+      }
+    }
+  }
+}
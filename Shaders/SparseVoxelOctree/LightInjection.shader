@@ -25,56 +25,57 @@
 
 #version 430
 
-// Note: Size has to be manually adjusted depending on the number of levels
+// Every level has its region in the node map, it lists the nodes of the level that light reached
 layout(r32ui) uniform uimage2D nodeMap;
-uniform sampler2D smPosition;
+layout(r32ui) uniform uimageBuffer litNodeCounts; // listed nodes per level, may exceed the region
+layout(r32ui) uniform uimageBuffer litNodeFlags;  // one bit per node of the pool, set once a node is listed
+uniform sampler2DArray smPosition; // one layer per light
 //layout(rgba8) uniform image2D nodeMap;
 
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform uimageBuffer nodePool_next;
 layout(r32ui) uniform uimageBuffer nodePool_color;
-layout(rgba8) uniform image3D brickPool_irradiance;
-layout(rgba8) uniform image3D brickPool_color;
+#endif
+// Bound as r32ui, the lights only set their bit in the brick corners. ResolveLightInjection.shader writes the colors.
+layout(r32ui) uniform uimage3D brickPool_irradiance;
 //layout(rgba8) uniform image3D brickPool_normal;
 
 uniform mat4 voxelGridTransformI;
 uniform uint numLevels;
 
-//uniform vec3 lightColor;
-//uniform vec3 lightDir;
-struct DirectionalLight {
-	vec3 position;
-	vec3 direction;
-	vec3 up;
-	vec2 size;
-	vec3 color;
-};
-
-uniform DirectionalLight directionalLights[1];
-uniform int numberOfDirLights;
-
-uniform ivec2 nodeMapOffset[10];
-uniform ivec2 nodeMapSize[10];
-
 #include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
 #include "SparseVoxelOctree/_traverseUtil.shader"
+#include "SparseVoxelOctree/_topLevelIndex.shader"
 
-void storeNodeInNodemap(in vec2 uv, in uint level, in int nodeAddress) {
-  ivec2 storePos = nodeMapOffset[level] + ivec2(uv * nodeMapSize[level]);
-  imageStore(nodeMap, storePos, uvec4(nodeAddress));
+void storeNodeInNodemap(in uint level, in int nodeAddress) {
+  // Only the first thread reaching a node lists it
+  uint bit = 1U << uint(nodeAddress & 31);
+  if ((imageAtomicOr(litNodeFlags, nodeAddress >> 5, bit) & bit) != 0U) {
+    return;
+  }
 
-  //DEBUG:
-  //imageStore(nodeMap, storePos, vec4(0.143 * level + 0.1));
+  uint index = imageAtomicAdd(litNodeCounts, int(level), 1U);
+  ivec2 size = nodeMapSize[level];
+  if (index < uint(size.x * size.y)) {
+    ivec2 storePos = nodeMapOffset[level] + ivec2(index % uint(size.x), index / uint(size.x));
+    imageStore(nodeMap, storePos, uvec4(nodeAddress));
+  }
 }
 
 void main() {
   
-  ivec2 smTexSize = textureSize(smPosition, 0);
-  vec2 uv = vec2(0);
-  uv.x = (gl_VertexID % smTexSize.x) / float(smTexSize.x);
-  uv.y = (gl_VertexID / smTexSize.x) / float(smTexSize.y);
+  // One thread per texel of every layer
+  ivec3 smTexSize = textureSize(smPosition, 0);
+  int layer = gl_VertexID / (smTexSize.x * smTexSize.y);
+  int texel = gl_VertexID % (smTexSize.x * smTexSize.y);
+  ivec2 smTexel = ivec2(texel % smTexSize.x, texel / smTexSize.x);
 
   // Calculate voxel position
-  vec4 posWS = vec4(texture(smPosition, uv).xyz, 1.0);
+  vec4 posWS = vec4(texelFetch(smPosition, ivec3(smTexel, layer), 0).xyz, 1.0);
   vec3 posTex = (voxelGridTransformI * posWS).xyz;// *0.5 + 0.5;
 
   if (posTex.x < 0 || posTex.y < 0 || posTex.z < 0 ||
@@ -82,40 +83,42 @@ void main() {
        return;
   }
     
-  int nodeAddress = 0;            // Address in node pool
-  vec3 nodePosTex = vec3(0.0);
-  vec3 nodePosMaxTex = vec3(1.0);
-  float sideLength = 0.5;
+  // The nodes above the start of the traversal are in the index, they are not dependent on each other
+  vec3 posIndex = posTex;
+  vec3 nodePosTex;
+  float sideLength;
+  uint startLevel;
+  int nodeAddress = startTraversal(posTex, numLevels, startLevel, nodePosTex, sideLength); // Address in node pool
+  vec3 nodePosMaxTex = nodePosTex + vec3(2.0 * sideLength);
+  for (uint iLevel = 0U; iLevel < startLevel; ++iLevel) {
+    uint foundOnLevel;
+    storeNodeInNodemap(iLevel, lookupTopLevelIndex(posIndex, iLevel, foundOnLevel));
+  }
 
-  for (uint iLevel = 0U; iLevel < numLevels; ++iLevel) {
+  for (uint iLevel = startLevel; iLevel < numLevels; ++iLevel) {
     // Store nodes during traversal in the nodeMap
-    storeNodeInNodemap(uv, iLevel, nodeAddress);
+    storeNodeInNodemap(iLevel, nodeAddress);
 
-    uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+    uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
     
     uint childStartAddress = nodeNext & NODE_MASK_VALUE;
     if (childStartAddress == 0U) 
 	{
+       if (iLevel + 1U < numLevels) {
+         return;  // Empty space above the leaves, the node has no brick of its own
+       }
+
        // Find brick pool 3D address
-       uint nodeColorU = imageLoad(nodePool_color, nodeAddress).x;
+       uint nodeColorU = loadNode(NODE_COLOR, nodeAddress);
        
        ivec3 brickCoords = ivec3(uintXYZ10ToVec3(nodeColorU));
        uvec3 offVec = uvec3(2.0 * posTex);
        uint offIdx = offVec.x + 2U * offVec.y + 4U * offVec.z;
 
 	   ivec3 injectionPos = brickCoords  +2 * ivec3(childOffsets[offIdx]);
-        //vec3 voxelNormal = normalize(imageLoad(brickPool_normal, injectionPos).xyz * 2.0 - 1.0);
-        vec4 voxelColor = imageLoad(brickPool_color, injectionPos);
-       
-		vec4 reflectedRadiance = vec4(directionalLights[0].color, 1) *voxelColor;
-        //reflectedRadiance.xyz *= clamp(abs(dot(-lightDir, voxelNormal)) + 0.3, 0.0, 1.0);
-
-        // Store irradiance into brickPool irradiance
-        imageStore(brickPool_irradiance, injectionPos, reflectedRadiance);
-         //store Radiance in brick corners
-        /*imageStore(brickPool_irradiance,
-               injectionPos,
-               vec4(lightColor, 1)); */
+
+        // Mark the brick corner as lit by this light, the lights are summed by the resolve
+        imageAtomicOr(brickPool_irradiance, injectionPos, 1U << uint(layer));
 
         return;
     }
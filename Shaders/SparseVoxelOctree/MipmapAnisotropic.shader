@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+//#version 430 core
+//#define THREAD_MODE 0
+
+// Filters the directional bricks of a node for the cones along +X, +Y and +Z, or along -X, -Y
+// and -Z with directionSign -1. Every voxel is the average of the lines through its 3x3x3 child
+// voxels along the direction. A line shows its voxels weighted by how much of them is visible
+// from its front, and lets through the light its voxels let through, so a thin wall seen
+// edge-on stays half transparent while the isotropic mip turns it into a fog.
+// The children of the level above the leaves are read from the isotropic pool, the other
+// children from the directional pool being filtered.
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+#endif
+uniform usampler2D nodeMap;
+uniform usamplerBuffer levelAddressBuffer;
+uniform uint numLevels;
+
+#define MIPMAP_POOLS 3
+layout(rgba8) uniform image3D brickPools[MIPMAP_POOLS]; // the directional pools along X, Y and Z
+layout(rgba8) uniform readonly image3D brickPool_value; // the isotropic pool
+uniform int directionSign;
+
+uniform uint level;
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
+#include "SparseVoxelOctree/_mipmapUtil.shader"
+
+ivec3 childVoxels[125];  // brick pool voxel of the 5x5x5 positions, x fastest
+bool childVoxelValid[125];
+vec4 childColors[125];
+
+void main() {
+  uint nodeAddress = getThreadNode();
+  if(nodeAddress == NODE_NOT_FOUND) {
+    return;  // The requested threadID-node does not belong to the current level
+  }
+
+  uint nodeNextU = loadNode(NODE_NEXT, int(nodeAddress));
+  if ((NODE_MASK_VALUE & nodeNextU) == 0) { 
+    return;  // No child-pointer set - mipmapping is not possible anyway
+  }
+
+  ivec3 brickAddress = ivec3(uintXYZ10ToVec3(
+                       loadNode(NODE_COLOR, int(nodeAddress))));
+  
+  uint childAddress = NODE_MASK_VALUE & nodeNextU;
+  loadChildTile(int(childAddress));  // Loads the child-values into the global arrays
+
+  for (int i = 0; i < 125; ++i) {
+    childVoxelValid[i] = getChildVoxel(ivec3(i % 5, (i / 5) % 5, i / 25), childVoxels[i]);
+  }
+
+  const float axisWeight[2] = {1.0, 0.5};
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int i = 0; i < 125; ++i) {
+      if (!childVoxelValid[i]) {
+        childColors[i] = vec4(0);
+      } else if (level == numLevels - 2) {
+        childColors[i] = imageLoad(brickPool_value, childVoxels[i]);
+      } else {
+        childColors[i] = imageLoad(brickPools[axis], childVoxels[i]);
+      }
+    }
+
+    for (int v = 0; v < 27; ++v) {
+      ivec3 voxel = ivec3(v % 3, (v / 3) % 3, v / 9);
+      ivec3 pos = 2 * voxel;
+      ivec3 lookupMin = max(pos - 1, ivec3(0));
+      ivec3 lookupMax = min(pos + 1, ivec3(4));
+
+      // The lines along the axis, with the same separable gaussian as mipmapIsotropic
+      vec4 col = vec4(0);
+      float weightSum = 0.0;
+      ivec3 across = lookupMin;
+      for (across[(axis + 1) % 3] = lookupMin[(axis + 1) % 3]; across[(axis + 1) % 3] <= lookupMax[(axis + 1) % 3]; ++across[(axis + 1) % 3]) {
+        for (across[(axis + 2) % 3] = lookupMin[(axis + 2) % 3]; across[(axis + 2) % 3] <= lookupMax[(axis + 2) % 3]; ++across[(axis + 2) % 3]) {
+          vec3 lineColor = vec3(0);
+          float visibleSum = 0.0;
+          float transmittance = 1.0;
+          float lengthSum = 0.0;
+          for (int step = -1; step <= 1; ++step) {
+            ivec3 lookupPos = across;
+            lookupPos[axis] = pos[axis] + directionSign * step;  // front to back
+            if (lookupPos[axis] < 0 || lookupPos[axis] > 4) {
+              continue;
+            }
+            const float lengthWeight = axisWeight[abs(step)];
+            const vec4 lookupColor = childColors[lookupPos.x + 5 * lookupPos.y + 25 * lookupPos.z];
+            lineColor += transmittance * lengthWeight * lookupColor.rgb;
+            visibleSum += transmittance * lengthWeight;
+            transmittance *= pow(clamp(1.0 - lookupColor.a, 0.0, 1.0), lengthWeight);
+            lengthSum += lengthWeight;
+          }
+
+          // The opacity per child voxel length, as in the isotropic bricks
+          const float weight = axisWeight[abs(across[(axis + 1) % 3] - pos[(axis + 1) % 3])] *
+                               axisWeight[abs(across[(axis + 2) % 3] - pos[(axis + 2) % 3])];
+          col += weight * vec4(lineColor / visibleSum, 1.0 - pow(transmittance, 1.0 / lengthSum));
+          weightSum += weight;
+        }
+      }
+
+      imageStore(brickPools[axis], brickAddress + voxel, col / weightSum);
+    }
+  }
+}
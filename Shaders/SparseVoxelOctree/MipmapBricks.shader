@@ -0,0 +1,108 @@
+/*
+ Copyright (c) 2012 The VCT Project
+
+  This file is part of VoxelConeTracing and is an implementation of
+  "Interactive Indirect Illumination Using Voxel Cone Tracing" by Crassin et al
+
+  VoxelConeTracing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  VoxelConeTracing is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with VoxelConeTracing.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*!
+* \author Dominik Lazarek (dominik.lazarek@gmail.com)
+* \author Andreas Weinmann (andy.weinmann@gmail.com)
+*/
+
+//#version 430 core
+//#define THREAD_MODE 0
+
+// Filters all 27 voxels of a node's brick from the bricks of its children in one thread,
+// for up to 3 brick pools at once. Replaces the MipmapCenter/Faces/Corners/Edges passes,
+// which each loaded the child tile and the shared child voxels again.
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+#endif
+uniform usampler2D nodeMap;
+uniform usamplerBuffer levelAddressBuffer;
+uniform uint numLevels;
+
+#define MIPMAP_POOLS 3
+layout(rgba8) uniform image3D brickPools[MIPMAP_POOLS];
+uniform vec4 emptyColors[MIPMAP_POOLS];
+uniform int numBrickPools;
+
+uniform uint level;
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
+#include "SparseVoxelOctree/_mipmapUtil.shader"
+
+ivec3 childVoxels[125];  // brick pool voxel of the 5x5x5 positions, x fastest
+bool childVoxelValid[125];
+vec4 childColors[125];
+
+void main() {
+  uint nodeAddress = getThreadNode();
+  if(nodeAddress == NODE_NOT_FOUND) {
+    return;  // The requested threadID-node does not belong to the current level
+  }
+
+  uint nodeNextU = loadNode(NODE_NEXT, int(nodeAddress));
+  if ((NODE_MASK_VALUE & nodeNextU) == 0) { 
+    return;  // No child-pointer set - mipmapping is not possible anyway
+  }
+
+  ivec3 brickAddress = ivec3(uintXYZ10ToVec3(
+                       loadNode(NODE_COLOR, int(nodeAddress))));
+  
+  uint childAddress = NODE_MASK_VALUE & nodeNextU;
+  loadChildTile(int(childAddress));  // Loads the child-values into the global arrays
+
+  for (int i = 0; i < 125; ++i) {
+    childVoxelValid[i] = getChildVoxel(ivec3(i % 5, (i / 5) % 5, i / 25), childVoxels[i]);
+  }
+
+  for (int pool = 0; pool < numBrickPools; ++pool) {
+    for (int i = 0; i < 125; ++i) {
+      childColors[i] = childVoxelValid[i] ? imageLoad(brickPools[pool], childVoxels[i]) : emptyColors[pool];
+    }
+
+    // Same 3x3x3 gaussian as mipmapIsotropic, around the child voxel at 2 * voxel
+    for (int v = 0; v < 27; ++v) {
+      ivec3 voxel = ivec3(v % 3, (v / 3) % 3, v / 9);
+      ivec3 pos = 2 * voxel;
+      ivec3 lookupMin = max(pos - 1, ivec3(0));
+      ivec3 lookupMax = min(pos + 1, ivec3(4));
+
+      vec4 col = vec4(0);
+      float weightSum = 0.0;
+      for (int z = lookupMin.z; z <= lookupMax.z; ++z) {
+        for (int y = lookupMin.y; y <= lookupMax.y; ++y) {
+          for (int x = lookupMin.x; x <= lookupMax.x; ++x) {
+            const ivec3 d = abs(ivec3(x, y, z) - pos);
+            const float weight = gaussianWeight[d.x + d.y + d.z];
+            col += weight * childColors[x + 5 * y + 25 * z];
+            weightSum += weight;
+          }
+        }
+      }
+
+      imageStore(brickPools[pool], brickAddress + voxel, col / weightSum);
+    }
+  }
+}
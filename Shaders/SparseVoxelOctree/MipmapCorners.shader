@@ -27,8 +27,13 @@
 //#version 430 core
 //#define THREAD_MODE 0
 
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform readonly uimageBuffer nodePool_next;
 layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+#endif
 uniform usampler2D nodeMap;
 uniform usamplerBuffer levelAddressBuffer;
 uniform uint mipmapMode;
@@ -38,8 +43,6 @@ uniform vec4 emptyColor = vec4(0);
 layout(rgba8) uniform image3D brickPool_value;
 
 uniform uint level;
-uniform ivec2 nodeMapOffset[8];
-uniform ivec2 nodeMapSize[8];
 
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 #include "SparseVoxelOctree/_threadNodeUtil.shader"
@@ -52,13 +55,13 @@ void main() {
     return;  // The requested threadID-node does not belong to the current level
   }
 
-  uint nodeNextU = imageLoad(nodePool_next, int(nodeAddress)).x;
+  uint nodeNextU = loadNode(NODE_NEXT, int(nodeAddress));
   if ((NODE_MASK_VALUE & nodeNextU) == 0) { 
     return;  // No child-pointer set - mipmapping is not possible anyway
   }
 
   ivec3 brickAddress = ivec3(uintXYZ10ToVec3(
-                       imageLoad(nodePool_color, int(nodeAddress)).x));
+                       loadNode(NODE_COLOR, int(nodeAddress))));
   
   uint childAddress = NODE_MASK_VALUE & nodeNextU;
   loadChildTile(int(childAddress));  // Loads the child-values into the global arrays
@@ -0,0 +1,73 @@
+// Turns the light bits that LightInjection.shader left in the leaf brick corners into the reflected radiance of all
+// lights, one thread per leaf node (see _threadNodeUtil.shader).
+//#version 430 core
+//#define THREAD_MODE 0
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+#endif
+layout(r32ui) uniform uimage3D brickPool_irradiance; // the rgba8 pool, read as light bits and written packed
+layout(rgba8) uniform readonly image3D brickPool_color;
+
+uniform usampler2D nodeMap;
+uniform usamplerBuffer levelAddressBuffer;
+
+uniform uint numLevels;  // Number of levels in the octree
+
+struct DirectionalLight {
+	vec3 position;
+	vec3 direction;
+	vec3 up;
+	vec2 size;
+	vec3 color;
+};
+
+uniform DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS]; // MAX_DIRECTIONAL_LIGHTS comes from Shader::setGlobalDefines
+uniform int numberOfDirLights;
+
+const uvec3 childOffsets[8] = {
+  uvec3(0, 0, 0),
+  uvec3(1, 0, 0),
+  uvec3(0, 1, 0),
+  uvec3(1, 1, 0),
+  uvec3(0, 0, 1),
+  uvec3(1, 0, 1),
+  uvec3(0, 1, 1),
+  uvec3(1, 1, 1)};
+
+const uint level = numLevels - 1;
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
+
+void main() {
+  uint nodeAddress = getThreadNode();
+  if(nodeAddress == NODE_NOT_FOUND) {
+    return;  // The requested threadID-node does not belong to the current level
+  }
+
+  ivec3 brickAddress = ivec3(uintXYZ10ToVec3(
+                       loadNode(NODE_COLOR, int(nodeAddress))));
+
+  for (int i = 0; i < 8; ++i) {
+    ivec3 cornerAddress = brickAddress + 2 * ivec3(childOffsets[i]);
+    uint lightBits = imageLoad(brickPool_irradiance, cornerAddress).x;
+    if (lightBits == 0U) {
+      continue;
+    }
+
+    vec3 lightColor = vec3(0);
+    for (int iLight = 0; iLight < numberOfDirLights; ++iLight) {
+      if ((lightBits & (1U << uint(iLight))) != 0U) {
+        lightColor += directionalLights[iLight].color;
+      }
+    }
+
+    vec4 reflectedRadiance = vec4(lightColor, 1) * imageLoad(brickPool_color, cornerAddress);
+    imageStore(brickPool_irradiance, cornerAddress, uvec4(packUnorm4x8(reflectedRadiance)));
+  }
+}
@@ -0,0 +1,10 @@
+// Stores the world space position into the layer of the light, like ShadowMapFrag.shader.
+#version 430 core
+
+out vec4 color;
+
+in vec4 posWSLayer;
+
+void main() {
+	color = posWSLayer;
+}
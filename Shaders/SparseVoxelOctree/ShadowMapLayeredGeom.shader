@@ -0,0 +1,27 @@
+// Renders the shadow maps of all directional lights in one pass, one layer per light (see Graphics::shadowMapLayered).
+#version 430 core
+
+layout(triangles, invocations = MAX_DIRECTIONAL_LIGHTS) in; // MAX_DIRECTIONAL_LIGHTS comes from Shader::setGlobalDefines
+layout(triangle_strip, max_vertices = 3) out;
+
+uniform mat4 lightViewProj[MAX_DIRECTIONAL_LIGHTS];
+uniform int numberOfDirLights;
+
+in vec4 posWS[];
+in vec3 normalGeom[];
+
+out vec4 posWSLayer;
+
+void main() {
+	if (gl_InvocationID >= numberOfDirLights) {
+		return;
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		gl_Layer = gl_InvocationID;
+		posWSLayer = posWS[i];
+		gl_Position = lightViewProj[gl_InvocationID] * vec4(posWS[i].xyz, 1);
+		EmitVertex();
+	}
+	EndPrimitive();
+}
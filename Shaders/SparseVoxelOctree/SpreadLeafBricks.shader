@@ -30,17 +30,21 @@ the voxel fragment list.
 Every voxel is read from the voxel fragment list and its position is used
 to traverse the octree and find the leaf-node.
 */
-//#version 420 core
-//#version 420 core
+//#version 430 core
+//#version 430 core
 //#define THREAD_MODE 0
 
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
 layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+#endif
 layout(rgba8) uniform volatile image3D brickPool_value;
 
 uniform usampler2D nodeMap;
 uniform usamplerBuffer levelAddressBuffer;
-uniform ivec2 nodeMapOffset[8];
-uniform ivec2 nodeMapSize[8];
 
 uniform uint numLevels;  // Number of levels in the octree
 
@@ -89,7 +93,7 @@ void main() {
   }
 
   ivec3 brickAddress = ivec3(uintXYZ10ToVec3(
-                       imageLoad(nodePool_color, int(nodeAddress)).x));
+                       loadNode(NODE_COLOR, int(nodeAddress))));
 
   loadVoxelValues(brickAddress);
 
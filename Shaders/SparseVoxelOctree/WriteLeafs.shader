@@ -8,14 +8,19 @@ Every voxel is read from the voxel fragment list and its position is used
 to traverse the octree and find the leaf-node.
 */
 
-#version 420 core
+#version 430 core
 
-layout(r32ui) uniform uimageBuffer voxelFragList_position;
+layout(rg32ui) uniform uimageBuffer voxelFragList_position;
 layout(r32ui) uniform uimage3D voxelFragTex_color;
 layout(r32ui) uniform uimage3D voxelFragTex_normal;
 
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform uimageBuffer nodePool_next;
 layout(r32ui) uniform uimageBuffer nodePool_color;
+#endif
 layout(rgba8) uniform image3D brickPool_color;
 layout(rgba8) uniform image3D brickPool_normal;
 layout(rgba8) uniform image3D brickPool_irradiance;
@@ -25,11 +30,12 @@ uniform uint voxelGridResolution;
 
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 #include "SparseVoxelOctree/_traverseUtil.shader"
+#include "SparseVoxelOctree/_topLevelIndex.shader"
 #include "SparseVoxelOctree/_octreeTraverse.shader"
 
 void storeInLeaf(in vec3 posTex, in int nodeAddress, in uint voxelColorU, in uint voxelNormalU) {
 	// get brick address
-       uint nodeColorU = imageLoad(nodePool_color, nodeAddress).x;
+       uint nodeColorU = loadNode(NODE_COLOR, nodeAddress);
        memoryBarrier();
        
        ivec3 brickCoords = ivec3(uintXYZ10ToVec3(nodeColorU));
@@ -53,8 +59,8 @@ void storeInLeaf(in vec3 posTex, in int nodeAddress, in uint voxelColorU, in uin
 
 void main() {
   // Get the voxel's position and color from the voxel frag list.
-  uint voxelPosU = imageLoad(voxelFragList_position, gl_VertexID).x;
-  uvec3 voxelPos = uintXYZ10ToVec3(voxelPosU);
+  uvec2 voxelPosU = imageLoad(voxelFragList_position, gl_VertexID).xy;
+  uvec3 voxelPos = uintXYZ16ToVec3(voxelPosU);
     
   uint voxelColorU = imageLoad(voxelFragTex_color, ivec3(voxelPos)).x;
   uint voxelNormalU = imageLoad(voxelFragTex_normal, ivec3(voxelPos)).x;
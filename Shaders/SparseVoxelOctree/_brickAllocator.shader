@@ -0,0 +1,49 @@
+// Brick pool allocation. Bricks given back by releaseBrick are handed out again first,
+// then new bricks from the counter nextFreeBrick. freeBricks holds the number of free bricks
+// in entry 0 and their indices after it. A pass either takes or releases bricks, never both,
+// so the free list is a plain stack.
+// Brick 0 is never handed out, it is returned when the pool is full. The counter keeps
+// counting past the pool, Graphics reads it back to report the overflow.
+
+layout(binding = 0) uniform atomic_uint nextFreeBrick;
+layout(r32ui) uniform coherent volatile uimageBuffer freeBricks;
+
+uniform uint brickPoolResolution;
+
+uvec3 brickIndexToAddress(in uint brickIndex) {
+  uint brickPoolResBricks = brickPoolResolution / 3U;
+  uvec3 brickAddress;
+  brickAddress.x = brickIndex % brickPoolResBricks;
+  brickAddress.y = (brickIndex / brickPoolResBricks) % brickPoolResBricks;
+  brickAddress.z = brickIndex / (brickPoolResBricks * brickPoolResBricks);
+  return brickAddress * 3U;
+}
+
+uint brickAddressToIndex(in uvec3 brickAddress) {
+  uint brickPoolResBricks = brickPoolResolution / 3U;
+  uvec3 brick = brickAddress / 3U;
+  return brick.x + brickPoolResBricks * (brick.y + brickPoolResBricks * brick.z);
+}
+
+uint takeBrick() {
+  uint numFree = imageLoad(freeBricks, 0).x;
+  while (numFree > 0U) {
+    uint prevNumFree = imageAtomicCompSwap(freeBricks, 0, numFree, numFree - 1U);
+    if (prevNumFree == numFree) {
+      return imageLoad(freeBricks, int(numFree)).x;
+    }
+    numFree = prevNumFree;
+  }
+
+  uint brickPoolResBricks = brickPoolResolution / 3U;
+  uint brickIndex = atomicCounterIncrement(nextFreeBrick);
+  return brickIndex < brickPoolResBricks * brickPoolResBricks * brickPoolResBricks ? brickIndex : 0U;
+}
+
+void releaseBrick(in uint brickIndex) {
+  if (brickIndex == 0U) {
+    return;
+  }
+  uint slot = imageAtomicAdd(freeBricks, 0, 1U) + 1U;
+  imageStore(freeBricks, int(slot), uvec4(brickIndex));
+}
@@ -0,0 +1,55 @@
+// Nodes of the 3x3x3 cells around a node and their bricks, found over the neighbour links.
+// Needs NODE_COLOR and the NODE_X..NODE_Z_NEG fields readable with fetchNode.
+
+// Nodes of the 3x3x3 cells around the thread's node, 0 where none was found yet, -1 where there is none
+int neighbours[27];
+ivec3 neighbourBricks[27];
+
+int cellIndex(in ivec3 offset) {
+  return (offset.x + 1) + 3 * (offset.y + 1) + 9 * (offset.z + 1);
+}
+
+uint fetchNeighbour(in int nodeAddress, in int axis, in int direction) {
+  if (axis == 0) {
+    return direction > 0 ? fetchNode(NODE_X, nodeAddress) : fetchNode(NODE_X_NEG, nodeAddress);
+  }
+  if (axis == 1) {
+    return direction > 0 ? fetchNode(NODE_Y, nodeAddress) : fetchNode(NODE_Y_NEG, nodeAddress);
+  }
+  return direction > 0 ? fetchNode(NODE_Z, nodeAddress) : fetchNode(NODE_Z_NEG, nodeAddress);
+}
+
+// Follow the links from the node to the nodes around it. The links are symmetric (findNeighbours
+// links back). The nodes of a group can be connected over up to 7 links inside its cube.
+void findBrickNeighbours(in uint nodeAddress) {
+  for (int i = 0; i < 27; ++i) {
+    neighbours[i] = 0;
+  }
+  neighbours[13] = int(nodeAddress);
+  bool found = true;
+  for (int step = 0; step < 7 && found; ++step) {
+    found = false;
+    for (int i = 0; i < 27; ++i) {
+      if (neighbours[i] != 0) {
+        continue;
+      }
+      ivec3 offset = ivec3(i % 3, (i / 3) % 3, i / 9) - 1;
+      for (int link = 0; link < 6 && neighbours[i] == 0; ++link) {
+        int axis = link >> 1;
+        int direction = (link & 1) == 0 ? 1 : -1;
+        ivec3 fromOffset = offset;
+        fromOffset[axis] -= direction;
+        if (abs(fromOffset[axis]) <= 1 && neighbours[cellIndex(fromOffset)] > 0) {
+          uint neighbourAddress = fetchNeighbour(neighbours[cellIndex(fromOffset)], axis, direction);
+          neighbours[i] = neighbourAddress != 0U ? int(neighbourAddress) : -1;
+          found = found || neighbourAddress != 0U;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < 27; ++i) {
+    if (neighbours[i] > 0) {
+      neighbourBricks[i] = ivec3(uintXYZ10ToVec3(fetchNode(NODE_COLOR, neighbours[i])));
+    }
+  }
+}
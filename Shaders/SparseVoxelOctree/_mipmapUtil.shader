@@ -14,8 +14,8 @@ const float gaussianWeight[4] = {0.25, 0.125, 0.0625, 0.03125};
 
 void loadChildTile(in int tileAddress) {
   for (int i = 0; i < 8; ++i) {
-    childNextU[i] = imageLoad(nodePool_next, tileAddress + i).x;
-    childColorU[i] = imageLoad(nodePool_color, tileAddress + i).x;
+    childNextU[i] = loadNode(NODE_NEXT, tileAddress + i);
+    childColorU[i] = loadNode(NODE_COLOR, tileAddress + i);
   }
   memoryBarrier();
 }
@@ -25,15 +25,24 @@ uvec3 uintXYZ10ToVec3_(uint val) {
 		uint((val & 0x3FF00000) >> 20U));
 }
 
-vec4 getColor(in ivec3 pos) {
+// Brick pool voxel of a position in the 5x5x5 voxels covered by the child bricks.
+// Returns false for the children without a brick.
+bool getChildVoxel(in ivec3 pos, out ivec3 voxel) {
   ivec3 childPos = ivec3(round(vec3(pos) / 4.0));
   int childIndex = childPos.x + 2 * childPos.y + 4 * childPos.z;
   ivec3 localPos = pos - 2 * childPos;
-  if ((NODE_MASK_VALUE & childNextU[childIndex]) == 0 && level != numLevels-2)
+  voxel = ivec3(uintXYZ10ToVec3_(childColorU[childIndex])) + localPos;
+  return (NODE_MASK_VALUE & childNextU[childIndex]) != 0 || level == numLevels-2;
+}
+
+// The functions below filter brickPool_value, MipmapBricks.shader filters several pools and defines MIPMAP_POOLS
+#ifndef MIPMAP_POOLS
+vec4 getColor(in ivec3 pos) {
+  ivec3 voxel;
+  if (!getChildVoxel(pos, voxel))
 	  return emptyColor;
 
-  ivec3 childBrickAddress = ivec3(uintXYZ10ToVec3_(childColorU[childIndex]));
-  return imageLoad(brickPool_value, childBrickAddress + localPos);
+  return imageLoad(brickPool_value, voxel);
 }
 
 // Get the child brickcolor
@@ -87,4 +96,5 @@ vec4 mipmapIsotropic(in ivec3 pos) {
 
   return col / weightSum;
 }
+#endif
 
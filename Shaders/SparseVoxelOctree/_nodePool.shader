@@ -0,0 +1,63 @@
+// Access to the node pool. Every shader reading or writing nodes goes through the macros below,
+// so it runs with both layouts. NODE_POOL_LAYOUT selects the layout, Graphics::nodePoolLayout
+// sets the default for all shaders:
+// NODE_POOL_TEXTURES - one R32UI texture buffer per field (nodePool_next, nodePool_color, nodePool_X, ...).
+//                      The shaders declare the fields they use, within #if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES.
+// NODE_POOL_RECORDS  - one 32 byte record per node in the storage buffer NodePool, the fields of a
+//                      node share a cache line. Define NODE_POOL_ACCESS before the include to
+//                      declare it readonly or writeonly.
+#define NODE_POOL_TEXTURES 0
+#define NODE_POOL_RECORDS 1
+
+#ifndef NODE_POOL_DEFAULT_LAYOUT
+#define NODE_POOL_DEFAULT_LAYOUT NODE_POOL_TEXTURES
+#endif
+#ifndef NODE_POOL_LAYOUT
+#define NODE_POOL_LAYOUT NODE_POOL_DEFAULT_LAYOUT
+#endif
+
+#if NODE_POOL_LAYOUT == NODE_POOL_RECORDS
+#ifndef NODE_POOL_ACCESS
+#define NODE_POOL_ACCESS coherent
+#endif
+
+// Same order as the node pool textures in Graphics
+struct NodeRecord {
+  uint next;          // child tile and NODE_MASK_BRICK
+  uint color;         // brick address and static tag
+  uint neighbours[6]; // X, X_neg, Y, Y_neg, Z, Z_neg
+};
+
+layout(std430, binding = 0) NODE_POOL_ACCESS buffer NodePool {
+  NodeRecord nodePool[];
+};
+
+#define NODE_NEXT  next
+#define NODE_COLOR color
+#define NODE_X     neighbours[0]
+#define NODE_X_NEG neighbours[1]
+#define NODE_Y     neighbours[2]
+#define NODE_Y_NEG neighbours[3]
+#define NODE_Z     neighbours[4]
+#define NODE_Z_NEG neighbours[5]
+
+#define loadNode(field, address) nodePool[int(address)].field
+#define fetchNode(field, address) nodePool[int(address)].field
+#define storeNode(field, address, value) nodePool[int(address)].field = uint(value)
+#define compSwapNode(field, address, compare, value) atomicCompSwap(nodePool[int(address)].field, compare, value)
+#else
+#define NODE_NEXT  nodePool_next
+#define NODE_COLOR nodePool_color
+#define NODE_X     nodePool_X
+#define NODE_X_NEG nodePool_X_neg
+#define NODE_Y     nodePool_Y
+#define NODE_Y_NEG nodePool_Y_neg
+#define NODE_Z     nodePool_Z
+#define NODE_Z_NEG nodePool_Z_neg
+
+// loadNode reads fields declared as images, fetchNode fields declared as samplers
+#define loadNode(field, address) imageLoad(field, int(address)).x
+#define fetchNode(field, address) texelFetch(field, int(address)).x
+#define storeNode(field, address, value) imageStore(field, int(address), uvec4(value))
+#define compSwapNode(field, address, compare, value) imageAtomicCompSwap(field, int(address), compare, value)
+#endif
@@ -1,6 +1,8 @@
 // DEPENDENCIES:
+// _nodePool.shader
 // _utilityFunctions.shader
 // _traverseUtil.shader
+// _topLevelIndex.shader
 
 
  int traverseOctree_voxelSize(in vec3 posTex, in float d, in float targetVoxelSize,
@@ -14,10 +16,17 @@
   outLevel = 0;
   outSideLength = 1.0;
 
-  float sideLength = 0.5;
-  int nodeAddress = 0;
-
-  for (uint iLevel = 0; iLevel < numLevels; ++iLevel) {
+  // The index is looked up no deeper than the level of targetVoxelSize
+  uint targetLevel = 0;
+  while (targetLevel < numLevels && 0.5 / float(pow2(targetLevel)) > targetVoxelSize) {
+    ++targetLevel;
+  }
+  uint startLevel;
+  float sideLength;
+  int nodeAddress = startTraversal(posTex, targetLevel, startLevel, nodePosTex, sideLength);
+  nodePosMaxTex = nodePosTex + vec3(2.0 * sideLength);
+
+  for (uint iLevel = startLevel; iLevel < numLevels; ++iLevel) {
     
     if (sideLength <= targetVoxelSize) {
       valid = true;
@@ -25,7 +34,7 @@
       break;
     }
 
-    uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+    uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 
     uint childStartAddress = nodeNext & NODE_MASK_VALUE;
       if (childStartAddress == 0U) {
@@ -54,14 +63,15 @@
 
 
 int traverseOctree_simple(in vec3 posTex, out uint foundOnLevel) {
-  vec3 nodePosTex = vec3(0.0);
-  vec3 nodePosMaxTex = vec3(1.0);
-  int nodeAddress = 0;
-  foundOnLevel = 0;
-  float sideLength = 0.5;
+  vec3 nodePosTex;
+  float sideLength;
+  uint startLevel;
+  int nodeAddress = startTraversal(posTex, numLevels, startLevel, nodePosTex, sideLength);
+  vec3 nodePosMaxTex = nodePosTex + vec3(2.0 * sideLength);
+  foundOnLevel = startLevel;
   
-  for (uint iLevel = 0; iLevel < numLevels; ++iLevel) {
-    uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+  for (uint iLevel = startLevel; iLevel < numLevels; ++iLevel) {
+    uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 
     uint childStartAddress = nodeNext & NODE_MASK_VALUE;
       if (childStartAddress == 0U) {
@@ -84,6 +94,7 @@ int traverseOctree_simple(in vec3 posTex, out uint foundOnLevel) {
   return nodeAddress;
 }
 
+// Runs while the octree is built, when the index is not written yet, so it starts at the root
 int traverseToLevel(in vec3 posTex, out uint foundOnLevel, in uint maxLevel) {
 	vec3 nodePosTex = vec3(0.0);
 	vec3 nodePosMaxTex = vec3(1.0);
@@ -92,7 +103,7 @@ int traverseToLevel(in vec3 posTex, out uint foundOnLevel, in uint maxLevel) {
 	float sideLength = 0.5;
 
 	for (foundOnLevel = 0; foundOnLevel < maxLevel; ++foundOnLevel) {
-		uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+		uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 		uint childStartAddress = nodeNext & NODE_MASK_VALUE;
 		if ((nodeNext & NODE_MASK_BRICK) == 0U || foundOnLevel == maxLevel - 1) {
 			break;
@@ -115,14 +126,15 @@ int traverseToLevel(in vec3 posTex, out uint foundOnLevel, in uint maxLevel) {
 
 // find the leaf node containing the given position, return the node's address and its level
 int traverseOctree_posOut(inout vec3 posTex, out uint foundOnLevel) {
-  vec3 nodePosTex = vec3(0.0);
-  vec3 nodePosMaxTex = vec3(1.0);
-  int nodeAddress = 0;
-  foundOnLevel = 0;
-  float sideLength = 0.5;
+  vec3 nodePosTex;
+  float sideLength;
+  uint startLevel;
+  int nodeAddress = startTraversal(posTex, numLevels, startLevel, nodePosTex, sideLength);
+  vec3 nodePosMaxTex = nodePosTex + vec3(2.0 * sideLength);
+  foundOnLevel = startLevel;
   
-  for (uint iLevel = 0; iLevel < numLevels; ++iLevel) {
-    uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+  for (uint iLevel = startLevel; iLevel < numLevels; ++iLevel) {
+    uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 
     // find child start address
     // No next address, so it's a leaf
@@ -1,8 +1,34 @@
 #define THREAD_MODE_COMPLETE 0
 #define THREAD_MODE_LIGHT 1
+#define THREAD_MODE_REGION 2
+
+// Region of each level in the node map, MAX_NODE_POOL_LEVELS comes from Shader::setGlobalDefines
+uniform ivec2 nodeMapOffset[MAX_NODE_POOL_LEVELS];
+uniform ivec2 nodeMapSize[MAX_NODE_POOL_LEVELS];
+
+// Without THREAD_MODE only the node map declarations are included (LightInjection.shader, writeLightCommandsVert.shader)
+#ifdef THREAD_MODE
 
 // THREAD_MODE_COMPLETE: Each thread represents a node in the given level
-// THREAD_MODE_LIGHT: Each thread represents a pixel in the shadow map's given mip map level
+// THREAD_MODE_LIGHT: Each thread represents a node of the given level that light reached, from the list
+//                    LightInjection.shader wrote into the level's region of the node map (see Graphics::drawLevelThreads)
+// THREAD_MODE_REGION: Each thread represents a cell of the given level inside the update region
+//                     (needs NODE_NEXT readable with loadNode)
+#if THREAD_MODE == THREAD_MODE_LIGHT
+uniform usamplerBuffer litNodeCounts; // listed nodes per level, a level with more than its region holds runs over all its nodes
+uniform usamplerBuffer litNodeFlags;  // one bit per node of the pool, set for the listed nodes
+
+bool isLitNode(in int nodeAddress) {
+  return (texelFetch(litNodeFlags, nodeAddress >> 5).x & (1U << uint(nodeAddress & 31))) != 0U;
+}
+#endif
+#if THREAD_MODE == THREAD_MODE_REGION
+uniform ivec3 threadRegionMin;  // first cell of the region on the current level
+uniform ivec3 threadRegionSize; // cells of the region on the current level
+
+ivec3 threadCell = ivec3(0);    // cell of the current thread, set by getThreadNode
+#endif
+
 uint getThreadNode() {
   // Complete octree
   uint index;
@@ -18,16 +44,39 @@ uint getThreadNode() {
         return NODE_NOT_FOUND;
       }
 #elif THREAD_MODE == THREAD_MODE_LIGHT
-      // Only lightMap-Node
-  
+      // Only lit nodes, or all nodes of the level if its list overflowed
       ivec2 nmSize = nodeMapSize[level];
-  
+      if (texelFetch(litNodeCounts, int(level)).x > uint(nmSize.x * nmSize.y)) {
+        index = texelFetch(levelAddressBuffer, int(level)).x + uint(gl_VertexID);
+        return index;
+      }
+
       ivec2 uv = ivec2(0);
       uv.x = (gl_VertexID % nmSize.x);
       uv.y = (gl_VertexID / nmSize.x);
 
       index = texelFetch(nodeMap, nodeMapOffset[level] + uv, 0).x;
+#elif THREAD_MODE == THREAD_MODE_REGION
+      // Only nodes of the update region, found by walking down from the root
+      threadCell = threadRegionMin + ivec3(gl_VertexID % threadRegionSize.x,
+                                           (gl_VertexID / threadRegionSize.x) % threadRegionSize.y,
+                                           gl_VertexID / (threadRegionSize.x * threadRegionSize.y));
+
+      index = 0U;
+      for (uint iLevel = 0U; iLevel < uint(level); ++iLevel) {
+        uint childAddress = loadNode(NODE_NEXT, int(index)) & NODE_MASK_VALUE;
+        if (childAddress == 0U) {
+          return NODE_NOT_FOUND;
+        }
+        uvec3 offVec = uvec3(threadCell >> int(uint(level) - iLevel - 1U)) & 1U;
+        index = childAddress + offVec.x + 2U * offVec.y + 4U * offVec.z;
+      }
+
+      if (!hasBrick(loadNode(NODE_NEXT, int(index)))) {
+        return NODE_NOT_FOUND;
+      }
 #else
 #endif
     return index;
-}
\ No newline at end of file
+}
+#endif
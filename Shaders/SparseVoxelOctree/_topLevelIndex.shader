@@ -0,0 +1,36 @@
+// DEPENDENCIES:
+// _utilityFunctions.shader
+
+// Dense index of the top levels of the octree, written by writeTopLevelIndexVert.shader after every
+// build. Mip (topLevelIndexLevel - level) of topLevelIndex has a texel per cell of the level with the
+// address of the node of the cell and its level. Where the octree ends above the level, the texel
+// holds the deepest node above. The traversals start at the index instead of walking down from the root.
+
+uniform usampler3D topLevelIndex;
+uniform uint topLevelIndexLevel; // 0 if the index is not bound, then the traversals start at the root
+
+// The node on level min(maxLevel, topLevelIndexLevel) containing posTex, or the deepest node above.
+int lookupTopLevelIndex(in vec3 posTex, in uint maxLevel, out uint foundOnLevel) {
+  uint level = min(maxLevel, topLevelIndexLevel);
+  foundOnLevel = 0U;
+  if (level == 0U) {
+    return 0;
+  }
+
+  ivec3 cell = min(ivec3(posTex * float(pow2(level))), ivec3(pow2(level) - 1U));
+  uvec2 entry = texelFetch(topLevelIndex, cell, int(topLevelIndexLevel - level)).xy;
+  foundOnLevel = entry.y;
+  return int(entry.x);
+}
+
+// Starts a traversal of posTex down to maxLevel at the index. Like the traversals keep them, posTex
+// becomes the position in the returned node, nodePosTex its corner and sideLength half its size.
+int startTraversal(inout vec3 posTex, in uint maxLevel, out uint startLevel, out vec3 nodePosTex, out float sideLength) {
+  int nodeAddress = lookupTopLevelIndex(posTex, maxLevel, startLevel);
+  float cellsOnLevel = float(pow2(startLevel));
+  vec3 cell = min(floor(posTex * cellsOnLevel), vec3(cellsOnLevel - 1.0));
+  nodePosTex = cell / cellsOnLevel;
+  sideLength = 0.5 / cellsOnLevel;
+  posTex = posTex * cellsOnLevel - cell;
+  return nodeAddress;
+}
@@ -7,8 +7,15 @@
 #define NODE_MASK_TAG_STATIC (0x00000003 << 30)
 #define NODE_NOT_FOUND 0xFFFFFFFF
 
-const uint pow2[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
-const float nodeSizes[] = {1, 0.5, 0.25, 0.125, 0.0625, 0.03125, 0.015625, 0.0078125, 0.00390625, 0.001953125, 0.0009765625};
+// Nodes along one edge of a level, and their side length in texture space.
+// Computed, so the octree may have as many levels as the voxel grid resolution needs.
+uint pow2(in uint level) {
+  return 1U << level;
+}
+
+float nodeSize(in uint level) {
+  return 1.0 / float(1U << level);
+}
 
 vec4 convRGBA8ToVec4(uint val) {
     return vec4( float((val & 0x000000FF)), 
@@ -36,6 +43,17 @@ uvec3 uintXYZ10ToVec3(uint val) {
                  uint((val & 0x3FF00000) >> 20U));
 }
 
+// Voxel positions in the fragment list, 16 bits per axis in two words (XY, Z).
+// XYZ10 only holds voxel grids up to 1024, it is kept for brick addresses.
+uvec2 vec3ToUintXYZ16(uvec3 val) {
+    return uvec2((val.x & 0x0000FFFF) | (val.y & 0x0000FFFF) << 16U,
+                 val.z & 0x0000FFFF);
+}
+
+uvec3 uintXYZ16ToVec3(uvec2 val) {
+    return uvec3(val.x & 0x0000FFFF, val.x >> 16U, val.y & 0x0000FFFF);
+}
+
 bool isFlagged(in uint nodeNext) {
   return (nodeNext & NODE_MASK_TAG) != 0U;
 }
@@ -44,6 +62,16 @@ bool hasBrick(in uint nextU) {
   return (nextU & NODE_MASK_BRICK) != 0;
 }
 
+// A streamed octree (BrickStreamer) has all nodes, the nodes whose brick is not uploaded have a brick pointer of 0
+bool isResident(in uint nodeNext, in uint nodeColor) {
+  return !hasBrick(nodeNext) || (nodeColor & NODE_MASK_VALUE) != 0U;
+}
+
 bool nextEmpty(in uint nodeNext) {
   return (nodeNext & NODE_MASK_VALUE) == 0U;
 }
+
+// nodePool_color keeps the brick pointer in the lower 30 bits, the bits above mark nodes of the static octree
+bool isStaticNode(in uint nodeColor) {
+  return (nodeColor & uint(NODE_MASK_TAG_STATIC)) == uint(NODE_MASK_TAG_STATIC);
+}
@@ -1,26 +1,35 @@
 
-#version 420 core
+#version 430 core
 
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform volatile uimageBuffer nodePool_next;
+#endif
 layout(r32ui) uniform volatile uimageBuffer levelAddressBuffer;
-layout(binding = 0) uniform atomic_uint nextFreeNode;
+layout(binding = 0) uniform atomic_uint nextFreeNode; // tiles allocated for the children of this level
 
 uniform uint level; // current working level
 
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 
+// Newly flagged nodes still carry the tag (root) or have no child yet. Nodes that already got
+// their tile in an earlier build keep it.
 bool isMarked(in uint nodeNext) {
-	return (nodeNext & NODE_MASK_BRICK) != 0U;
+	return (nodeNext & NODE_MASK_BRICK) != 0U && ((nodeNext & NODE_MASK_TAG) != 0U || (nodeNext & NODE_MASK_VALUE) == 0U);
 }
 
 uint allocChildTile(in int nodeAddress) {
-	uint nextFreeTile = atomicCounterIncrement(nextFreeNode);
-	// root node is not in a 2x2x2 tile
+	// Every level owns a fixed range of the node pool, the children of this level fill the next one.
+	// The root node is not in a 2x2x2 tile, so the node range of level+1 starts at tile (levelAddress[level+1] - 1) / 8.
+	uint levelFirstTile = (imageLoad(levelAddressBuffer, int(level + 1U)).x - 1U) / 8U;
+	uint levelEndTile = (imageLoad(levelAddressBuffer, int(level + 2U)).x - 1U) / 8U;
+	uint nextFreeTile = levelFirstTile + atomicCounterIncrement(nextFreeNode);
+	if (nextFreeTile >= levelEndTile) {
+		// The range is full. The counter still counts the tile, so the pool grows before the next build
+		return 0U;
+	}
 	uint nextFreeAddress = (1U + 8U * nextFreeTile);
-
-	// Create levelAddress indirection buffer by storing the start-addresses on each level
-	// The beginning address of next layer
-	imageAtomicMax(levelAddressBuffer, int(level + 2), nextFreeAddress+8);
 	return nextFreeAddress;
 }
 
@@ -28,14 +37,13 @@ void main() {
 	int levelBeginAddress = int(imageLoad(levelAddressBuffer, int(level)).x);
 	int curNodeAddress = levelBeginAddress + gl_VertexID;
 
-	uint nodeNextU = imageLoad(nodePool_next, curNodeAddress).x;
+	uint nodeNextU = loadNode(NODE_NEXT, curNodeAddress);
 
 	if (isMarked(nodeNextU)) {
 		//alloc child and unflag
-		nodeNextU &= (~NODE_MASK_VALUE);
-		nodeNextU |= NODE_MASK_VALUE & allocChildTile(curNodeAddress);
+		nodeNextU = NODE_MASK_BRICK | (NODE_MASK_VALUE & allocChildTile(curNodeAddress));
 
 		// Store the unflagged nodeNextU
-		imageStore(nodePool_next, curNodeAddress, uvec4(nodeNextU, 0, 0, 0));
+		storeNode(NODE_NEXT, curNodeAddress, nodeNextU);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+layout(r32ui) uniform readonly uimageBuffer nodePool_X;
+layout(r32ui) uniform readonly uimageBuffer nodePool_Y;
+layout(r32ui) uniform readonly uimageBuffer nodePool_Z;
+#endif
+layout(rg32ui) uniform readonly uimageBuffer voxelFragList_position;
+layout(r32ui) uniform writeonly uimageBuffer traversalResult;
+
+uniform uint numLevels;
+uniform uint numFragments;
+uniform uint seed;
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+// Scatters the threads over the fragments, neighbouring threads walk down different paths
+uint hashIndex(in uint v) {
+  v = (v ^ 61U) ^ (v >> 16U);
+  v *= 9U;
+  v = v ^ (v >> 4U);
+  v *= 0x27d4eb2dU;
+  return v ^ (v >> 15U);
+}
+
+// Walks from the root down to the leaf of a random voxel fragment, like a cone tracing sample,
+// then reads the bricks of the leaf and of its positive neighbours, like the border transfer.
+// Compiled for both node pool layouts to compare them. One thread per traversal.
+void main() {
+  uint fragment = hashIndex(uint(gl_VertexID) + seed) % numFragments;
+  uvec3 voxel = uintXYZ16ToVec3(imageLoad(voxelFragList_position, int(fragment)).xy);
+
+  uint nodeAddress = 0U;
+  for (uint iLevel = 0U; iLevel < numLevels - 1U; ++iLevel) {
+    uint childAddress = loadNode(NODE_NEXT, nodeAddress) & NODE_MASK_VALUE;
+    if (childAddress == 0U) {
+      break;
+    }
+    uvec3 offVec = (voxel >> (numLevels - 1U - iLevel)) & 1U;
+    nodeAddress = childAddress + offVec.x + 2U * offVec.y + 4U * offVec.z;
+  }
+
+  uint brickAddresses = loadNode(NODE_COLOR, nodeAddress);
+  uint neighbours[3] = { loadNode(NODE_X, nodeAddress), loadNode(NODE_Y, nodeAddress), loadNode(NODE_Z, nodeAddress) };
+  for (int i = 0; i < 3; ++i) {
+    if (neighbours[i] != 0U) {
+      brickAddresses ^= loadNode(NODE_COLOR, neighbours[i]);
+    }
+  }
+
+  // Keeps the loads, the result is never read
+  if (brickAddresses == NODE_NOT_FOUND) {
+    imageStore(traversalResult, 0, uvec4(nodeAddress));
+  }
+}
@@ -0,0 +1,191 @@
+#define BUILD_PASS_FLAG 0  // flags the cells of every level and hands out their child tiles
+#define BUILD_PASS_WRITE 1 // writes the nodes of the flagged cells and their neighbour links
+
+layout(rg32ui) uniform readonly uimageBuffer voxelFragmentListPosition;
+layout(r32ui) uniform readonly uimageBuffer levelAddressBuffer;
+layout(r32ui) uniform coherent uimageBuffer cellTable; // hash tables of the occupied cells, one per level
+
+#if BUILD_PASS == BUILD_PASS_FLAG
+layout(r32ui) uniform coherent uimageBuffer nextFreeTile; // tile counters of all levels
+#else
+#define NODE_POOL_ACCESS writeonly
+#include "SparseVoxelOctree/_nodePool.shader"
+#endif
+
+#if BUILD_PASS == BUILD_PASS_WRITE && NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform writeonly uimageBuffer nodePool_next;
+layout(r32ui) uniform writeonly uimageBuffer nodePool_X;
+layout(r32ui) uniform writeonly uimageBuffer nodePool_Y;
+layout(r32ui) uniform writeonly uimageBuffer nodePool_Z;
+layout(r32ui) uniform writeonly uimageBuffer nodePool_X_neg;
+layout(r32ui) uniform writeonly uimageBuffer nodePool_Y_neg;
+layout(r32ui) uniform writeonly uimageBuffer nodePool_Z_neg;
+#endif
+
+uniform uint numLevels;
+uniform uint tableOffset[MAX_NODE_POOL_LEVELS]; // first slot of the hash table of each level
+uniform uint tableSlots[MAX_NODE_POOL_LEVELS]; // slots of the hash table of each level
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+#define CELL_FLAGGED   0x80000000U // the cell is within one cell of a fragment and gets a node
+#define CELL_VISITED   0x40000000U // the neighbourhood of the cell was flagged
+#define CELL_WRITTEN   0x20000000U // the neighbourhood of the cell was written
+#define CELL_TILE_MASK 0x1FFFFFFFU // child tile of the node of the cell
+#define CELL_NO_TILE   CELL_TILE_MASK // the level ran out of tiles, the node has no children
+
+#define SLOT_WORDS 9 // the key and the 8 sibling cells
+
+// Spreads the lower 10 bits of v to every third bit, the parents of the leaf cells of 4096^3 voxels have 10
+uint expandBits(in uint v) {
+  v = (v * 0x00010001U) & 0xFF0000FFU;
+  v = (v * 0x00000101U) & 0x0F00F00FU;
+  v = (v * 0x00000011U) & 0xC30C30C3U;
+  v = (v * 0x00000005U) & 0x49249249U;
+  return v;
+}
+
+// x is the lowest bit, the same order as the children of a tile
+uint mortonCode(in uvec3 cell) {
+  return expandBits(cell.x) | (expandBits(cell.y) << 1U) | (expandBits(cell.z) << 2U);
+}
+
+uint hashKey(in uint key) {
+  key ^= key >> 16U;
+  key *= 0x85EBCA6BU;
+  key ^= key >> 13U;
+  key *= 0xC2B2AE35U;
+  key ^= key >> 16U;
+  return key;
+}
+
+// The siblings share a slot of the hash table of their level, keyed by the Morton code of their parent + 1.
+// The flag pass inserts the slots, a cell without a slot was not flagged. Returns the entry of the cell,
+// -1 if it has none or the table is full, which only happens when the level above ran out of tiles.
+int cellIndex(in uvec3 cell, in uint level, in bool insert) {
+  uint key = (level > 0U ? mortonCode(cell >> 1U) : 0U) + 1U;
+  uint slots = tableSlots[level];
+  uint slot = hashKey(key) % slots;
+  for (uint probe = 0U; probe < slots; ++probe) {
+    int keyIndex = int(tableOffset[level] + slot) * SLOT_WORDS;
+    uint slotKey = insert ? imageAtomicCompSwap(cellTable, keyIndex, 0U, key) : imageLoad(cellTable, keyIndex).x;
+    if (slotKey == key || (insert && slotKey == 0U)) {
+      uvec3 offVec = cell & 1U;
+      return keyIndex + 1 + int(offVec.x + 2U * offVec.y + 4U * offVec.z);
+    }
+    if (slotKey == 0U) {
+      return -1;
+    }
+    slot = slot + 1U < slots ? slot + 1U : 0U;
+  }
+  return -1;
+}
+
+#if BUILD_PASS == BUILD_PASS_FLAG
+void flagCell(in uvec3 cell, in uint level) {
+  int index = cellIndex(cell, level, true);
+  if (index < 0) {
+    return;
+  }
+  uint cellU = imageAtomicOr(cellTable, index, CELL_FLAGGED);
+  if ((cellU & CELL_FLAGGED) == 0U && level < numLevels - 1U) {
+    // The children of the level fill the node range of the next level, like in allocateNode
+    uint levelFirstTile = (imageLoad(levelAddressBuffer, int(level + 1U)).x - 1U) / 8U;
+    uint levelEndTile = (imageLoad(levelAddressBuffer, int(level + 2U)).x - 1U) / 8U;
+    uint tile = levelFirstTile + imageAtomicAdd(nextFreeTile, int(level), 1U);
+    imageAtomicOr(cellTable, index, tile < levelEndTile ? tile : CELL_NO_TILE);
+  }
+}
+#else
+// The parent of a flagged cell is flagged as well, its tile holds the node of the cell.
+// Returns NODE_NOT_FOUND if the parent did not get a tile.
+uint nodeAddress(in uvec3 cell, in uint level) {
+  if (level == 0U) {
+    return 0U;
+  }
+  int parentIndex = cellIndex(cell >> 1U, level - 1U, false);
+  uint parentTile = parentIndex >= 0 ? imageLoad(cellTable, parentIndex).x & CELL_TILE_MASK : CELL_NO_TILE;
+  if (parentTile == CELL_NO_TILE) {
+    return NODE_NOT_FOUND;
+  }
+  uvec3 offVec = cell & 1U;
+  return 1U + 8U * parentTile + offVec.x + 2U * offVec.y + 4U * offVec.z;
+}
+
+uint neighbourAddress(in uvec3 cell, in ivec3 direction, in uint level) {
+  ivec3 neighbour = ivec3(cell) + direction;
+  if (any(lessThan(neighbour, ivec3(0))) || any(greaterThanEqual(neighbour, ivec3(1 << level)))) {
+    return 0U;
+  }
+  int index = cellIndex(uvec3(neighbour), level, false);
+  if (index < 0 || (imageLoad(cellTable, index).x & CELL_FLAGGED) == 0U) {
+    return 0U;
+  }
+  uint address = nodeAddress(uvec3(neighbour), level);
+  return address != NODE_NOT_FOUND ? address : 0U;
+}
+
+// Same values as flagNode, allocateNode and findNeighbours store for the node
+void writeNode(in uvec3 cell, in uint level) {
+  uint addressU = nodeAddress(cell, level);
+  if (addressU == NODE_NOT_FOUND) {
+    return;
+  }
+  int address = int(addressU);
+  uint nodeNextU = NODE_MASK_BRICK;
+  if (level < numLevels - 1U) {
+    int index = cellIndex(cell, level, false);
+    uint tile = index >= 0 ? imageLoad(cellTable, index).x & CELL_TILE_MASK : CELL_NO_TILE;
+    if (tile != CELL_NO_TILE) {
+      nodeNextU |= 1U + 8U * tile;
+    }
+  }
+  storeNode(NODE_NEXT, address, nodeNextU);
+
+  if (level > 0U) {
+    storeNode(NODE_X, address, neighbourAddress(cell, ivec3(1, 0, 0), level));
+    storeNode(NODE_Y, address, neighbourAddress(cell, ivec3(0, 1, 0), level));
+    storeNode(NODE_Z, address, neighbourAddress(cell, ivec3(0, 0, 1), level));
+    storeNode(NODE_X_NEG, address, neighbourAddress(cell, ivec3(-1, 0, 0), level));
+    storeNode(NODE_Y_NEG, address, neighbourAddress(cell, ivec3(0, -1, 0), level));
+    storeNode(NODE_Z_NEG, address, neighbourAddress(cell, ivec3(0, 0, -1), level));
+  }
+}
+#endif
+
+// Builds the nodes of all levels bottom-up from the voxel fragments. The nodes of a level are the
+// cells within one cell of a fragment, like the neighbours flagNode flags. Only these cells have an
+// entry in cellTable, the first fragment reaching a cell flags (or writes) its neighbourhood and
+// carries on to the parent, the others stop there.
+// One thread per voxel fragment.
+void main() {
+  uvec3 voxel = uintXYZ16ToVec3(imageLoad(voxelFragmentListPosition, gl_VertexID).xy);
+
+#if BUILD_PASS == BUILD_PASS_FLAG
+  uint passBit = CELL_VISITED;
+#else
+  uint passBit = CELL_WRITTEN;
+#endif
+
+  for (int level = int(numLevels) - 1; level >= 0; --level) {
+    uvec3 cell = voxel >> (numLevels - uint(level));
+    int index = cellIndex(cell, uint(level), BUILD_PASS == BUILD_PASS_FLAG);
+    if (index < 0 || (imageAtomicOr(cellTable, index, passBit) & passBit) != 0U) {
+      return;
+    }
+
+    uvec3 minCell = uvec3(max(ivec3(cell) - 1, ivec3(0)));
+    uvec3 maxCell = min(cell + 1U, uvec3((1U << uint(level)) - 1U));
+    for (uint z = minCell.z; z <= maxCell.z; ++z) {
+      for (uint y = minCell.y; y <= maxCell.y; ++y) {
+        for (uint x = minCell.x; x <= maxCell.x; ++x) {
+#if BUILD_PASS == BUILD_PASS_FLAG
+          flagCell(uvec3(x, y, z), uint(level));
+#else
+          writeNode(uvec3(x, y, z), uint(level));
+#endif
+        }
+      }
+    }
+  }
+}
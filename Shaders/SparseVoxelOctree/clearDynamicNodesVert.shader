@@ -0,0 +1,80 @@
+#version 430 core
+
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform uimageBuffer nodePool_next;
+layout(r32ui) uniform uimageBuffer nodePool_color;
+layout(r32ui) uniform uimageBuffer nodePool_X;
+layout(r32ui) uniform uimageBuffer nodePool_Y;
+layout(r32ui) uniform uimageBuffer nodePool_Z;
+layout(r32ui) uniform uimageBuffer nodePool_X_neg;
+layout(r32ui) uniform uimageBuffer nodePool_Y_neg;
+layout(r32ui) uniform uimageBuffer nodePool_Z_neg;
+#endif
+
+uniform uint numStaticBricks; // bricks handed out while the static octree was built
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+#include "SparseVoxelOctree/_brickAllocator.shader"
+
+// Static nodes which had no brick in the static octree were empty there
+bool hasStaticBrick(in uint nodeColorU) {
+  uint brickIndex = brickAddressToIndex(uintXYZ10ToVec3(nodeColorU));
+  return brickIndex != 0U && brickIndex < numStaticBricks;
+}
+
+// Links between static nodes are kept, links to dynamic nodes are removed.
+// The static tag of a node never changes in this pass, so other threads can read it.
+uint keptNeighbour(in uint neighbourAddress, in bool isStatic) {
+  if (isStatic && neighbourAddress != 0U && isStaticNode(loadNode(NODE_COLOR, int(neighbourAddress)))) {
+    return neighbourAddress;
+  }
+  return 0U;
+}
+
+void clearNode(in int address) {
+  uint nodeColorU = loadNode(NODE_COLOR, address);
+  bool isStatic = isStaticNode(nodeColorU);
+  // The bricks of the dynamic renderers go to the free list
+  if (!isStatic) {
+    releaseBrick(brickAddressToIndex(uintXYZ10ToVec3(nodeColorU)));
+    storeNode(NODE_NEXT, address, 0);
+    storeNode(NODE_COLOR, address, 0);
+  } else if (!hasStaticBrick(nodeColorU)) {
+    releaseBrick(brickAddressToIndex(uintXYZ10ToVec3(nodeColorU)));
+    storeNode(NODE_NEXT, address, 0);
+    storeNode(NODE_COLOR, address, NODE_MASK_TAG_STATIC);
+  }
+
+  storeNode(NODE_X, address, keptNeighbour(loadNode(NODE_X, address), isStatic));
+  storeNode(NODE_Y, address, keptNeighbour(loadNode(NODE_Y, address), isStatic));
+  storeNode(NODE_Z, address, keptNeighbour(loadNode(NODE_Z, address), isStatic));
+  storeNode(NODE_X_NEG, address, keptNeighbour(loadNode(NODE_X_NEG, address), isStatic));
+  storeNode(NODE_Y_NEG, address, keptNeighbour(loadNode(NODE_Y_NEG, address), isStatic));
+  storeNode(NODE_Z_NEG, address, keptNeighbour(loadNode(NODE_Z_NEG, address), isStatic));
+}
+
+// Resets the node pool to the static octree, before the dynamic renderers are inserted again.
+// Nodes without the static tag are cleared, static nodes which were empty in the static octree
+// lose the children and the brick they got since. One thread per tile.
+void main() {
+  int tileAddress = 8 * gl_VertexID + 1;
+
+  // Tiles which are neither static nor allocated hold nothing to clear
+  bool allocated = isStaticNode(loadNode(NODE_COLOR, tileAddress));
+  for (int i = 0; i < 8 && !allocated; ++i) {
+    allocated = hasBrick(loadNode(NODE_NEXT, tileAddress + i));
+  }
+
+  if (allocated) {
+    for (int i = 0; i < 8; ++i) {
+      clearNode(tileAddress + i);
+    }
+  }
+
+  // root node
+  if (gl_VertexID == 0) {
+    clearNode(0);
+  }
+}
@@ -3,12 +3,14 @@
 layout(r32ui) uniform uimage3D voxelFragTex_color;
 layout(r32ui) uniform uimage3D voxelFragTex_normal;
 
+uniform ivec3 regionMin;  // first voxel to clear
+uniform ivec3 regionSize; // voxels to clear along each axis
+
 void main() {
-  int size = imageSize(voxelFragTex_color).x;
-  ivec3 texCoord = ivec3(0);
-  texCoord.x = gl_VertexID % size;
-  texCoord.y = (gl_VertexID / size) % size;
-  texCoord.z = gl_VertexID / (size * size);
+  ivec3 texCoord = regionMin;
+  texCoord.x += gl_VertexID % regionSize.x;
+  texCoord.y += (gl_VertexID / regionSize.x) % regionSize.y;
+  texCoord.z += gl_VertexID / (regionSize.x * regionSize.y);
 
   imageStore(voxelFragTex_color, texCoord, uvec4(0));
   imageStore(voxelFragTex_normal, texCoord, uvec4(0));
@@ -0,0 +1,68 @@
+#define CLEAR_MODE_REGION 0        // one thread per voxel of the update region
+#define CLEAR_MODE_FRAGMENT_LIST 1 // one thread per voxel fragment, starting at firstFragment
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+#endif
+layout(rgba8) uniform writeonly image3D brickPool_color;
+layout(rgba8) uniform writeonly image3D brickPool_irradiance;
+layout(rgba8) uniform writeonly image3D brickPool_normal;
+
+uniform uint numLevels;   // Number of levels in the octree
+
+#if CLEAR_MODE == CLEAR_MODE_FRAGMENT_LIST
+layout(rg32ui) uniform readonly uimageBuffer voxelFragList_position;
+layout(r32ui) uniform writeonly uimage3D voxelFragTex_color;
+layout(r32ui) uniform writeonly uimage3D voxelFragTex_normal;
+
+uniform uint firstFragment; // fragments before it are kept
+#else
+uniform ivec3 regionMin;  // first voxel to clear
+uniform ivec3 regionSize; // voxels to clear along each axis
+#endif
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+// Resets the leaf brick corners of the voxels to the values of clearBrickPool,
+// so the voxels can be written again by writeLeafNode.
+// The fragment list mode also clears the fragment textures of the voxels.
+void main() {
+#if CLEAR_MODE == CLEAR_MODE_FRAGMENT_LIST
+  if (uint(gl_VertexID) < firstFragment) {
+    return;
+  }
+  ivec3 voxel = ivec3(uintXYZ16ToVec3(imageLoad(voxelFragList_position, gl_VertexID).xy));
+  imageStore(voxelFragTex_color, voxel, uvec4(0));
+  imageStore(voxelFragTex_normal, voxel, uvec4(0));
+#else
+  ivec3 voxel = regionMin;
+  voxel.x += gl_VertexID % regionSize.x;
+  voxel.y += (gl_VertexID / regionSize.x) % regionSize.y;
+  voxel.z += gl_VertexID / (regionSize.x * regionSize.y);
+#endif
+
+  // Walk down to the leaf node containing the voxel
+  uint nodeAddress = 0U;
+  for (uint iLevel = 0U; iLevel < numLevels - 1U; ++iLevel) {
+    uint childAddress = loadNode(NODE_NEXT, int(nodeAddress)) & NODE_MASK_VALUE;
+    if (childAddress == 0U) {
+      return;
+    }
+    uvec3 offVec = uvec3(voxel >> int(numLevels - 1U - iLevel)) & 1U;
+    nodeAddress = childAddress + offVec.x + 2U * offVec.y + 4U * offVec.z;
+  }
+
+  if (!hasBrick(loadNode(NODE_NEXT, int(nodeAddress)))) {
+    return;
+  }
+
+  ivec3 brickCoords = ivec3(uintXYZ10ToVec3(loadNode(NODE_COLOR, int(nodeAddress))));
+  ivec3 corner = brickCoords + 2 * (voxel & 1);
+  imageStore(brickPool_color, corner, vec4(0.0, 0.0, 0.0, 0.0));
+  imageStore(brickPool_irradiance, corner, vec4(0.0, 0.0, 0.0, 0.0));
+  imageStore(brickPool_normal, corner, vec4(0.5, 0.5, 0.5, 0.0));
+}
@@ -0,0 +1,40 @@
+#version 430 core
+
+#define NODE_POOL_LAYOUT NODE_POOL_RECORDS
+#include "SparseVoxelOctree/_nodePool.shader"
+
+layout(r32ui) uniform uimageBuffer nodePool_next;
+layout(r32ui) uniform uimageBuffer nodePool_color;
+layout(r32ui) uniform uimageBuffer nodePool_X;
+layout(r32ui) uniform uimageBuffer nodePool_X_neg;
+layout(r32ui) uniform uimageBuffer nodePool_Y;
+layout(r32ui) uniform uimageBuffer nodePool_Y_neg;
+layout(r32ui) uniform uimageBuffer nodePool_Z;
+layout(r32ui) uniform uimageBuffer nodePool_Z_neg;
+
+uniform bool toRecords;
+
+// Copies the node pool between the texture buffers and the records, so the layout benchmark
+// traverses the same octree in both layouts. One thread per node.
+void main() {
+  int address = gl_VertexID;
+  if (toRecords) {
+    storeNode(NODE_NEXT, address, imageLoad(nodePool_next, address).x);
+    storeNode(NODE_COLOR, address, imageLoad(nodePool_color, address).x);
+    storeNode(NODE_X, address, imageLoad(nodePool_X, address).x);
+    storeNode(NODE_X_NEG, address, imageLoad(nodePool_X_neg, address).x);
+    storeNode(NODE_Y, address, imageLoad(nodePool_Y, address).x);
+    storeNode(NODE_Y_NEG, address, imageLoad(nodePool_Y_neg, address).x);
+    storeNode(NODE_Z, address, imageLoad(nodePool_Z, address).x);
+    storeNode(NODE_Z_NEG, address, imageLoad(nodePool_Z_neg, address).x);
+  } else {
+    imageStore(nodePool_next, address, uvec4(loadNode(NODE_NEXT, address)));
+    imageStore(nodePool_color, address, uvec4(loadNode(NODE_COLOR, address)));
+    imageStore(nodePool_X, address, uvec4(loadNode(NODE_X, address)));
+    imageStore(nodePool_X_neg, address, uvec4(loadNode(NODE_X_NEG, address)));
+    imageStore(nodePool_Y, address, uvec4(loadNode(NODE_Y, address)));
+    imageStore(nodePool_Y_neg, address, uvec4(loadNode(NODE_Y_NEG, address)));
+    imageStore(nodePool_Z, address, uvec4(loadNode(NODE_Z, address)));
+    imageStore(nodePool_Z_neg, address, uvec4(loadNode(NODE_Z_NEG, address)));
+  }
+}
@@ -0,0 +1,24 @@
+#version 430 core
+
+layout(rg32ui) uniform readonly uimageBuffer voxelFragList_position;
+layout(r32ui) uniform uimage3D voxelFragTex_color;
+layout(r32ui) uniform uimage3D voxelFragTex_normal;
+layout(r32ui) uniform uimageBuffer staticFragmentValues; // color and normal of every static fragment
+
+uniform bool restore;
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+// Saves the averaged fragment texture values of the static voxel fragments once they are voxelized,
+// or writes them back, so the dynamic fragments are averaged into the static values again.
+// One thread per static fragment.
+void main() {
+  ivec3 voxel = ivec3(uintXYZ16ToVec3(imageLoad(voxelFragList_position, gl_VertexID).xy));
+  if (restore) {
+    imageStore(voxelFragTex_color, voxel, imageLoad(staticFragmentValues, 2 * gl_VertexID));
+    imageStore(voxelFragTex_normal, voxel, imageLoad(staticFragmentValues, 2 * gl_VertexID + 1));
+  } else {
+    imageStore(staticFragmentValues, 2 * gl_VertexID, imageLoad(voxelFragTex_color, voxel));
+    imageStore(staticFragmentValues, 2 * gl_VertexID + 1, imageLoad(voxelFragTex_normal, voxel));
+  }
+}
@@ -1,17 +1,20 @@
 
 #version 430 core
 
-layout(r32ui) uniform uimageBuffer nodePool_next;
-//uniform usamplerBuffer levelAddressBuffer;
-layout(r32ui) uniform uimageBuffer levelAddressBuffer;
-//layout(r32ui) uniform readonly uimageBuffer voxelFragmentListPosition;
+#include "SparseVoxelOctree/_nodePool.shader"
 
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform uimageBuffer nodePool_next;
 layout(r32ui) uniform uimageBuffer nodePool_X;
 layout(r32ui) uniform uimageBuffer nodePool_Y;
 layout(r32ui) uniform uimageBuffer nodePool_Z;
 layout(r32ui) uniform uimageBuffer nodePool_X_neg;
 layout(r32ui) uniform uimageBuffer nodePool_Y_neg;
 layout(r32ui) uniform uimageBuffer nodePool_Z_neg;
+#endif
+//uniform usamplerBuffer levelAddressBuffer;
+layout(r32ui) uniform uimageBuffer levelAddressBuffer;
+//layout(r32ui) uniform readonly uimageBuffer voxelFragmentListPosition;
 
 uniform uint level;
 uniform uint numLevels;
@@ -22,12 +25,13 @@ uniform uint voxelGridResolution;
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 //#include "SparseVoxelOctree/_threadNodeUtil.shader"
 #include "SparseVoxelOctree/_traverseUtil.shader"
+#include "SparseVoxelOctree/_topLevelIndex.shader"
 #include "SparseVoxelOctree/_octreeTraverse.shader"
 
 
 bool isEmpty(int nodeAddress)
 {
-	uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+	uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 	return (nodeNext & NODE_MASK_BRICK) == 0;
 }
 
@@ -40,7 +44,7 @@ void main() {
 		return;
 	}
 
-	uint nodeNextU = imageLoad(nodePool_next, nodeAddress).x;
+	uint nodeNextU = loadNode(NODE_NEXT, nodeAddress);
 
 	if ((nodeNextU & NODE_MASK_TAG) == 0U) {
 		return;
@@ -57,11 +61,13 @@ void main() {
 	//if ((posTexI & NODE_MASK_BRICK) == 0) {
 	//	return;
 	//}
-	vec3 posTex = vec3(uintXYZ10ToVec3(nodeNextU & NODE_MASK_VALUE)) / float(voxelGridResolution);
+	// flagNode stored the cell of the parent, the place in the tile gives the child
+	uvec3 cell = (uintXYZ10ToVec3(nodeNextU & NODE_MASK_VALUE) << 1U) + childOffsets[(nodeAddress - 1) % 8];
+	vec3 posTex = (vec3(cell) + vec3(0.5)) / float(pow2(level));
 	// then set node_next to 0
-	imageStore(nodePool_next, nodeAddress, uvec4(NODE_MASK_BRICK));
+	storeNode(NODE_NEXT, nodeAddress, NODE_MASK_BRICK);
 
-	float stepTex = 1.0 / float(pow2[level]);
+	float stepTex = nodeSize(level);
 	//stepTex *= 0.99;
 
 	uint nodeLevel = 0;
@@ -122,68 +128,69 @@ void main() {
 		}
 	}
 
-	imageStore(nodePool_X, nodeAddress, uvec4(nX));
-	imageStore(nodePool_Y, nodeAddress, uvec4(nY));
-	imageStore(nodePool_Z, nodeAddress, uvec4(nZ));
-	imageStore(nodePool_X_neg, nodeAddress, uvec4(nX_neg));
-	imageStore(nodePool_Y_neg, nodeAddress, uvec4(nY_neg));
-	imageStore(nodePool_Z_neg, nodeAddress, uvec4(nZ_neg));
-/*
+	storeNode(NODE_X, nodeAddress, nX);
+	storeNode(NODE_Y, nodeAddress, nY);
+	storeNode(NODE_Z, nodeAddress, nZ);
+	storeNode(NODE_X_NEG, nodeAddress, nX_neg);
+	storeNode(NODE_Y_NEG, nodeAddress, nY_neg);
+	storeNode(NODE_Z_NEG, nodeAddress, nZ_neg);
+
+	// Link the neighbours back, they may be older nodes which are not flagged anymore
 	if (nY != 0)
 	{
-		imageStore(nodePool_Y_neg, nY, uvec4(nodeAddress));
+		storeNode(NODE_Y_NEG, nY, nodeAddress);
 	}
 	if (nY_neg != 0)
 	{
-		imageStore(nodePool_Y, nY_neg, uvec4(nodeAddress));
+		storeNode(NODE_Y, nY_neg, nodeAddress);
 	}
 	if (nX != 0)
 	{
-		imageStore(nodePool_X_neg, nX, uvec4(nodeAddress));
+		storeNode(NODE_X_NEG, nX, nodeAddress);
 	}
 	if (nX_neg != 0)
 	{
-		imageStore(nodePool_X, nX_neg, uvec4(nodeAddress));
+		storeNode(NODE_X, nX_neg, nodeAddress);
 	}
 	if (nZ != 0)
 	{
-		imageStore(nodePool_Z_neg, nZ, uvec4(nodeAddress));
+		storeNode(NODE_Z_NEG, nZ, nodeAddress);
 	}
 	if (nZ_neg != 0)
 	{
-		imageStore(nodePool_Z, nZ_neg, uvec4(nodeAddress));
-	}*/
+		storeNode(NODE_Z, nZ_neg, nodeAddress);
+	}
 
 	/*
 	// First: Assign the neighbour-pointers between the children
-	imageStore(nodePool_X, int(childStartAddress + 0), uvec4(childStartAddress + 1));
-	imageStore(nodePool_X, int(childStartAddress + 2), uvec4(childStartAddress + 3));
-	imageStore(nodePool_X, int(childStartAddress + 4), uvec4(childStartAddress + 5));
-	imageStore(nodePool_X, int(childStartAddress + 6), uvec4(childStartAddress + 7));
-
-	imageStore(nodePool_X_neg, int(childStartAddress + 1), uvec4(childStartAddress + 0));
-	imageStore(nodePool_X_neg, int(childStartAddress + 3), uvec4(childStartAddress + 2));
-	imageStore(nodePool_X_neg, int(childStartAddress + 5), uvec4(childStartAddress + 4));
-	imageStore(nodePool_X_neg, int(childStartAddress + 7), uvec4(childStartAddress + 6));
-
-	imageStore(nodePool_Y, int(childStartAddress + 0), uvec4(childStartAddress + 2));
-	imageStore(nodePool_Y, int(childStartAddress + 1), uvec4(childStartAddress + 3));
-	imageStore(nodePool_Y, int(childStartAddress + 4), uvec4(childStartAddress + 6));
-	imageStore(nodePool_Y, int(childStartAddress + 5), uvec4(childStartAddress + 7));
-
-	imageStore(nodePool_Y_neg, int(childStartAddress + 2), uvec4(childStartAddress + 0));
-	imageStore(nodePool_Y_neg, int(childStartAddress + 3), uvec4(childStartAddress + 1));
-	imageStore(nodePool_Y_neg, int(childStartAddress + 6), uvec4(childStartAddress + 4));
-	imageStore(nodePool_Y_neg, int(childStartAddress + 7), uvec4(childStartAddress + 5));
-
-	imageStore(nodePool_Z, int(childStartAddress + 0), uvec4(childStartAddress + 4));
-	imageStore(nodePool_Z, int(childStartAddress + 1), uvec4(childStartAddress + 5));
-	imageStore(nodePool_Z, int(childStartAddress + 2), uvec4(childStartAddress + 6));
-	imageStore(nodePool_Z, int(childStartAddress + 3), uvec4(childStartAddress + 7));
-
-	imageStore(nodePool_Z_neg, int(childStartAddress + 4), uvec4(childStartAddress + 0));
-	imageStore(nodePool_Z_neg, int(childStartAddress + 5), uvec4(childStartAddress + 1));
-	imageStore(nodePool_Z_neg, int(childStartAddress + 6), uvec4(childStartAddress + 2));
-	imageStore(nodePool_Z_neg, int(childStartAddress + 7), uvec4(childStartAddress + 3));
+	storeNode(NODE_X, int(childStartAddress + 0), childStartAddress + 1);
+	storeNode(NODE_X, int(childStartAddress + 2), childStartAddress + 3);
+	storeNode(NODE_X, int(childStartAddress + 4), childStartAddress + 5);
+	storeNode(NODE_X, int(childStartAddress + 6), childStartAddress + 7);
+
+	storeNode(NODE_X_NEG, int(childStartAddress + 1), childStartAddress + 0);
+	storeNode(NODE_X_NEG, int(childStartAddress + 3), childStartAddress + 2);
+	storeNode(NODE_X_NEG, int(childStartAddress + 5), childStartAddress + 4);
+	storeNode(NODE_X_NEG, int(childStartAddress + 7), childStartAddress + 6);
+
+	storeNode(NODE_Y, int(childStartAddress + 0), childStartAddress + 2);
+	storeNode(NODE_Y, int(childStartAddress + 1), childStartAddress + 3);
+	storeNode(NODE_Y, int(childStartAddress + 4), childStartAddress + 6);
+	storeNode(NODE_Y, int(childStartAddress + 5), childStartAddress + 7);
+
+	storeNode(NODE_Y_NEG, int(childStartAddress + 2), childStartAddress + 0);
+	storeNode(NODE_Y_NEG, int(childStartAddress + 3), childStartAddress + 1);
+	storeNode(NODE_Y_NEG, int(childStartAddress + 6), childStartAddress + 4);
+	storeNode(NODE_Y_NEG, int(childStartAddress + 7), childStartAddress + 5);
+
+	storeNode(NODE_Z, int(childStartAddress + 0), childStartAddress + 4);
+	storeNode(NODE_Z, int(childStartAddress + 1), childStartAddress + 5);
+	storeNode(NODE_Z, int(childStartAddress + 2), childStartAddress + 6);
+	storeNode(NODE_Z, int(childStartAddress + 3), childStartAddress + 7);
+
+	storeNode(NODE_Z_NEG, int(childStartAddress + 4), childStartAddress + 0);
+	storeNode(NODE_Z_NEG, int(childStartAddress + 5), childStartAddress + 1);
+	storeNode(NODE_Z_NEG, int(childStartAddress + 6), childStartAddress + 2);
+	storeNode(NODE_Z_NEG, int(childStartAddress + 7), childStartAddress + 3);
 	///////////////////////////////////////////////////////////////////////////////// */
 }
\ No newline at end of file
@@ -1,10 +1,15 @@
 
-#version 420 core
+#version 430 core
 
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 
-layout(r32ui) uniform volatile uimageBuffer voxelFragmentListPosition;
+layout(rg32ui) uniform volatile uimageBuffer voxelFragmentListPosition;
+
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform volatile uimageBuffer nodePool_next;
+#endif
 uniform uint voxelGridResolution;
 uniform uint numLevels;
 
@@ -26,9 +31,9 @@ int traverseOctree_simple(in vec3 posTex, out uint foundOnLevel) {
 	float sideLength = 0.5;
 
 	for (uint iLevel = 0; iLevel < numLevels; ++iLevel) {
-		uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+		uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 		// mark brick
-		imageStore(nodePool_next, nodeAddress, uvec4(nodeNext | NODE_MASK_BRICK));
+		storeNode(NODE_NEXT, nodeAddress, nodeNext | NODE_MASK_BRICK);
 
 		uint childStartAddress = nodeNext & NODE_MASK_VALUE;
 		if (childStartAddress == 0U) {
@@ -53,8 +58,8 @@ int traverseOctree_simple(in vec3 posTex, out uint foundOnLevel) {
 }
 
 void main() {
-	uint voxelPosU = imageLoad(voxelFragmentListPosition, gl_VertexID).x;
-	uvec3 voxelPos = uintXYZ10ToVec3(voxelPosU);
+	uvec2 voxelPosU = imageLoad(voxelFragmentListPosition, gl_VertexID).xy;
+	uvec3 voxelPos = uintXYZ16ToVec3(voxelPosU);
 	vec3 posTex = vec3(voxelPos) / vec3(voxelGridResolution);
 
 	uint onLevel = 0;
@@ -1,9 +1,14 @@
 
-#version 420 core
+#version 430 core
 
-layout(r32ui) uniform volatile uimageBuffer voxelFragmentListPosition;
+layout(rg32ui) uniform volatile uimageBuffer voxelFragmentListPosition;
+
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform volatile uimageBuffer nodePool_next;
 //layout(r32ui) uniform volatile uimageBuffer nodePool_color;
+#endif
 uniform uint voxelGridResolution;
 uniform uint numLevels;
 uniform uint level;
@@ -37,14 +42,15 @@ int traverseOctree_simple(in vec3 posTex, out uint foundOnLevel, out vec3 nodeCe
 	vec3 nodePosTex = vec3(0.0);
 	vec3 nodePosMaxTex = vec3(1.0);
 	int nodeAddress = 0;
-	foundOnLevel = 0;
+	foundOnLevel = level;
 	float sideLength = 0.5;
 
 	for (uint iLevel = 0; iLevel < level; ++iLevel) {
-		uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+		uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 
 		uint childStartAddress = nodeNext & NODE_MASK_VALUE;
-		if ((nodeNext & NODE_MASK_BRICK) == 0U) {
+		// Nodes whose level ran out of tiles have no children
+		if ((nodeNext & NODE_MASK_BRICK) == 0U || childStartAddress == 0U) {
 			foundOnLevel = iLevel;
 			break;
 		}
@@ -64,29 +70,34 @@ int traverseOctree_simple(in vec3 posTex, out uint foundOnLevel, out vec3 nodeCe
 	return nodeAddress;
 }
 
-void flagNode(in int address, in vec3 nodeCenterPos, in uint flag) {
-	uvec3 nodeCenterPosI = uvec3(nodeCenterPos * voxelGridResolution);
+// findNeighbours needs the position of the node. The cell of the parent is stored, its level is
+// at most numLevels - 2, so XYZ10 holds it for voxel grids up to 4096. The child follows from the address.
+void flagNode(in int address, in vec3 nodeCenterPos, in uint onLevel, in uint flag) {
+	uvec3 parentCell = uvec3(nodeCenterPos * float(pow2(onLevel))) >> 1U;
 	// uint nodeNext = imageLoad(nodePool_next, address).x;
 	// nodeNext = NODE_MASK_BRICK | nodeNext;
-	uint nodeNext = flag | vec3ToUintXYZ10(nodeCenterPosI);
-	imageStore(nodePool_next, address, uvec4(nodeNext));
+	uint nodeNext = flag | vec3ToUintXYZ10(parentCell);
+	// Only empty nodes are flagged, nodes built by an earlier update keep their children
+	compSwapNode(NODE_NEXT, address, 0U, nodeNext);
 	//imageStore(nodePool_color, address, uvec4(vec3ToUintXYZ10(nodeCenterPosI)));
 	memoryBarrier();
 }
 
 void main() {
-	uint voxelPosU = imageLoad(voxelFragmentListPosition, gl_VertexID).x;
-	uvec3 voxelPos = uintXYZ10ToVec3(voxelPosU);
+	uvec2 voxelPosU = imageLoad(voxelFragmentListPosition, gl_VertexID).xy;
+	uvec3 voxelPos = uintXYZ16ToVec3(voxelPosU);
 	vec3 posTex = vec3(voxelPos) / vec3(voxelGridResolution);
 
-	float nodeOffset = nodeSizes[level];
+	float nodeOffset = nodeSize(level);
+	// Neighbours past the grid are clamped to the last voxel, a position of 1.0 would index past the last child
+	vec3 maxPosTex = vec3(float(voxelGridResolution - 1U) / float(voxelGridResolution));
 	uint onLevel = 0;
 	vec3 nodeCenterPos;
 	// find node without child and return its address
 	// NODE_MASK_TAG means "find neighbour"
 	// NODE_MASK_BRICK means "add bricks"
 	int nodeAddress = traverseOctree_simple(posTex, onLevel, nodeCenterPos);
-	flagNode(nodeAddress, nodeCenterPos, NODE_MASK_TAG | NODE_MASK_BRICK);
+	flagNode(nodeAddress, nodeCenterPos, onLevel, NODE_MASK_TAG | NODE_MASK_BRICK);
 
 	//if (level < numLevels-1)
 	if (level < numLevels)
@@ -99,11 +110,11 @@ void main() {
 			for (int y = -1; y <= 1; y++) {
 				for (int z = -1; z <= 1; z++) {
 					vec3 offset = vec3(float(x), float(y), float(z));
-					vec3 neighPos = clamp(posTex + offset * nodeOffset,vec3(0.0),vec3(1.0));
+					vec3 neighPos = clamp(posTex + offset * nodeOffset, vec3(0.0), maxPosTex);
 					//if (all(greaterThan(neighPos, vec3(0.0))) && all(lessThan(neighPos, vec3(1.0))))
 					{
 						nodeAddress = traverseOctree_simple(neighPos, onLevel, nodeCenterPos);
-						flagNode(nodeAddress, nodeCenterPos, NODE_MASK_TAG | NODE_MASK_BRICK);
+						flagNode(nodeAddress, nodeCenterPos, onLevel, NODE_MASK_TAG | NODE_MASK_BRICK);
 					}
 				}
 			}
@@ -0,0 +1,17 @@
+// Geometry pass of the deferred cone tracing, see Graphics::renderGBuffer. Keeps the closest surface of each
+// pixel, which voxelConeTracingFrag.shader with DEFERRED 1 shades once.
+#version 450 core
+
+uniform mat4 V;
+uniform uint materialID; // index into the material table
+
+in vec3 worldPositionFrag;
+in vec3 normalFrag;
+
+layout(location = 0) out vec4 position; // world position, the material ID in w
+layout(location = 1) out vec4 normalDepth; // normal and view depth, 0 where there is no surface
+
+void main() {
+	position = vec4(worldPositionFrag, float(materialID));
+	normalDepth = vec4(normalize(normalFrag), -(V * vec4(worldPositionFrag, 1.0)).z);
+}
@@ -0,0 +1,76 @@
+#define PROBE_PASS_LIST 0  // lists the cells of the nodes of probeLevel, one thread per node of a level above it
+#define PROBE_PASS_CLEAR 1 // clears the probes of the cells of the previous list that lost their node, one thread per entry
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+#endif
+
+uniform uint level;
+uniform uint probeLevel;
+
+#if PROBE_PASS == PROBE_PASS_LIST
+layout(r32ui) uniform readonly uimageBuffer levelAddressBuffer;
+layout(rg32ui) uniform coherent uimageBuffer nodeCells; // XYZ16 cell of each node above probeLevel, NO_CELL for nodes no link leads to
+layout(rg32ui) uniform writeonly uimageBuffer probeCells; // XYZ16 cells of the nodes of probeLevel
+layout(r32ui) uniform coherent uimageBuffer probeCellCounts; // entries of both lists
+uniform int probeList; // the list written
+#else
+uniform usamplerBuffer probeCells; // the previous list
+layout(rgba16f) uniform writeonly image3D probeGridImage;
+#endif
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+#define NO_CELL 0xFFFFFFFFU
+
+void main() {
+#if PROBE_PASS == PROBE_PASS_LIST
+  // The root is the only node of level 0, the cells of the other nodes were passed on by their parents
+  int nodeAddress = int(imageLoad(levelAddressBuffer, int(level)).x) + gl_VertexID;
+  uvec3 cell = uvec3(0U);
+  if (level > 0U) {
+    uvec2 cellU = imageLoad(nodeCells, nodeAddress).xy;
+    if (cellU.x == NO_CELL) {
+      return;
+    }
+    cell = uintXYZ16ToVec3(cellU);
+  }
+
+  uint childStartAddress = loadNode(NODE_NEXT, nodeAddress) & NODE_MASK_VALUE;
+  if (childStartAddress == 0U) {
+    return;
+  }
+
+  // Every child of a tile is a node, the traversals reach the probe level there
+  for (uint off = 0U; off < 8U; ++off) {
+    uvec3 childCell = 2U * cell + uvec3(off & 1U, (off >> 1U) & 1U, off >> 2U);
+    if (level + 1U < probeLevel) {
+      imageStore(nodeCells, int(childStartAddress + off), uvec4(vec3ToUintXYZ16(childCell), 0U, 0U));
+    } else {
+      int index = int(imageAtomicAdd(probeCellCounts, probeList, 1U));
+      imageStore(probeCells, index, uvec4(vec3ToUintXYZ16(childCell), 0U, 0U));
+    }
+  }
+#else
+  uvec3 cell = uintXYZ16ToVec3(texelFetch(probeCells, gl_VertexID).xy);
+
+  int nodeAddress = 0;
+  for (uint iLevel = 0U; iLevel < probeLevel; ++iLevel) {
+    uint childStartAddress = loadNode(NODE_NEXT, nodeAddress) & NODE_MASK_VALUE;
+    if (childStartAddress == 0U) {
+      // The probe would keep its light, the interpolation leaves it out again
+      int res = int(pow2(probeLevel));
+      for (int k = 0; k < 4; k++) {
+        imageStore(probeGridImage, ivec3(cell.xy, int(cell.z) + k * res), vec4(0.0));
+      }
+      return;
+    }
+
+    uvec3 offVec = (cell >> (probeLevel - iLevel - 1U)) & uvec3(1U);
+    nodeAddress = int(childStartAddress + offVec.x + 2U * offVec.y + 4U * offVec.z);
+  }
+#endif
+}
@@ -0,0 +1,8 @@
+// The quad of Graphics::quadMeshRenderer, covering the screen.
+#version 450 core
+
+layout(location = 0) in vec3 position;
+
+void main() {
+	gl_Position = vec4(position.xy, 0.0, 1.0);
+}
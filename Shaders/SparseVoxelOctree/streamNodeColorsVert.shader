@@ -0,0 +1,16 @@
+#version 430 core
+
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform writeonly uimageBuffer nodePool_color;
+#endif
+
+uniform usamplerBuffer nodeColorWrites; // node address and new color word
+
+// Points the nodes of the bricks BrickStreamer uploaded or evicted this frame to their
+// brick, or to brick 0. One thread per changed node.
+void main() {
+  uvec2 write = texelFetch(nodeColorWrites, gl_VertexID).xy;
+  storeNode(NODE_COLOR, int(write.x), write.y);
+}
@@ -0,0 +1,37 @@
+#version 430 core
+
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+layout(r32ui) uniform uimageBuffer nodePool_color;
+#endif
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+void tagNode(in int address) {
+  uint nodeColorU = loadNode(NODE_COLOR, address);
+  storeNode(NODE_COLOR, address, nodeColorU | uint(NODE_MASK_TAG_STATIC));
+}
+
+// Tags the nodes of the static octree, so clearDynamicNodes keeps them. One thread per tile.
+// Every allocated tile has at least one flagged node. The empty nodes of the tile are tagged
+// as well, they keep their place in the tree when dynamic voxels are inserted into them.
+void main() {
+  int tileAddress = 8 * gl_VertexID + 1;
+  bool allocated = false;
+  for (int i = 0; i < 8 && !allocated; ++i) {
+    allocated = hasBrick(loadNode(NODE_NEXT, tileAddress + i));
+  }
+
+  if (allocated) {
+    for (int i = 0; i < 8; ++i) {
+      tagNode(tileAddress + i);
+    }
+  }
+
+  // root node
+  if (gl_VertexID == 0 && hasBrick(loadNode(NODE_NEXT, 0))) {
+    tagNode(0);
+  }
+}
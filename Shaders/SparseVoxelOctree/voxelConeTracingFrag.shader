@@ -13,7 +13,19 @@
 //                                                                                              // 
 // Course project in TSBK03 (Techniques for Advanced Game Programming) at Linköping University. //
 // ---------------------------------------------------------------------------------------------//
-#version 450 core
+// The #version and CONE_TRACING_PASS come from the material, see Graphics::initSparseVoxelization:
+// 0 - direct and indirect light in one pass
+// 1 - indirect light only, into the reduced resolution target with its depth and normal guide.
+//     The diffuse part can be accumulated over frames, see reprojectHistory
+// 2 - direct light and the indirect light of pass 1, upsampled with a joint bilateral filter
+// 3 - updates irradiance probes, one per fragment, see updateProbe
+// With DEFERRED 1 the passes 0, 1 and 2 shade a screen quad from the G-buffer of Graphics::renderGBuffer.
+#ifndef CONE_TRACING_PASS
+#define CONE_TRACING_PASS 0
+#endif
+#ifndef DEFERRED
+#define DEFERRED 0
+#endif
 #define TSQRT2 2.828427
 #define SQRT2 1.414213
 #define ISQRT2 0.707106
@@ -39,12 +51,39 @@
 #define LINEAR 0 /* Looks meh when using gamma correction. */
 #define QUADRATIC 1
 
+// Joint bilateral upsampling of the indirect light, see upsampleIndirectLight.
+#define UPSAMPLE_NORMAL_POWER 8.0 /* Sharpness of the normal weight. */
+#define UPSAMPLE_DEPTH_SIGMA 0.05 /* Depth difference, relative to the depth, that halves the weight about. */
+
+// Temporal accumulation of the indirect diffuse light, see reprojectHistory.
+#define HISTORY_DEPTH_TOLERANCE 0.02 /* Depth difference, relative to the depth, up to which the history belongs to the surface. */
+#define HISTORY_NORMAL_TOLERANCE 0.9 /* Cosine of the normal difference up to which the history belongs to the surface. */
+
+// Irradiance probes, see updateProbe and probeDiffuseLight.
+#define PROBE_CONES 12 /* The 6 diffuse cones around +Z and mirrored around -Z. */
+#define DIFFUSE_CONE_WEIGHT 2.494 /* Sum of the cosine weighted solid angles of the 6 diffuse cones over pi, */
+                                  /* so that the probes light as bright as indirectDiffuseLight. */
+
+// Single cone diffuse gather, see gatherDiffuseLight.
+#define DIFFUSE_GATHER_HALF_ANGLE 1.22 /* About 70 degrees, most of the hemisphere. */
+
 // Other settings.
 #define GAMMA_CORRECTION 1 /* Whether to use gamma correction or not. */
 
 // Here are my uniform variables
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform readonly uimageBuffer nodePool_next;
 layout(r32ui) uniform readonly uimageBuffer nodePool_color;
+layout(r32ui) uniform readonly uimageBuffer nodePool_X;
+layout(r32ui) uniform readonly uimageBuffer nodePool_X_neg;
+layout(r32ui) uniform readonly uimageBuffer nodePool_Y;
+layout(r32ui) uniform readonly uimageBuffer nodePool_Y_neg;
+layout(r32ui) uniform readonly uimageBuffer nodePool_Z;
+layout(r32ui) uniform readonly uimageBuffer nodePool_Z_neg;
+#endif
 
 //layout(rgba8) uniform image3D brickPool_color;
 //layout(rgba8) uniform image3D brickPool_irradiance;
@@ -52,15 +91,19 @@ layout(r32ui) uniform readonly uimageBuffer nodePool_color;
 uniform sampler3D brickPool_color;
 uniform sampler3D brickPool_irradiance;
 uniform sampler3D brickPool_normal;
+uniform sampler3D brickPool_directional[6]; // irradiance along +X, -X, +Y, -Y, +Z, -Z above the leaves
 
 uniform sampler2D smPosition;
 
 uniform mat4 voxelGridTransformI;
 uniform vec3 voxelSize;
 uniform uint numLevels;
+uniform bool streamedBricks; // the brick pool holds only some of the bricks, see isResident
+uniform bool anisotropicVoxels; // brickPool_directional holds the irradiance of the levels above the leaves
 
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 #include "SparseVoxelOctree/_traverseUtil.shader"
+#include "SparseVoxelOctree/_topLevelIndex.shader"
 #include "SparseVoxelOctree/_octreeTraverse.shader"
 
 
@@ -98,7 +141,20 @@ struct Settings {
 
 uniform float directLightMultiplier;
 uniform float indirectLightMultiplier;
+#if DEFERRED == 1
+// The materials of the G-buffer, packed like Graphics::renderGBuffer writes them
+struct PackedMaterial {
+	vec4 diffuse; // diffuseColor, diffuseReflectivity
+	vec4 specular; // specularColor, specularDiffusion
+	vec4 properties; // specularReflectivity, emissivity, refractiveIndex, transparency
+};
+layout(std430, binding = 1) readonly buffer MaterialTable {
+	PackedMaterial materials[];
+};
+Material material; // of the pixel, see readGBuffer
+#else
 uniform Material material;
+#endif
 uniform Settings settings;
 uniform PointLight pointLights[MAX_LIGHTS];
 uniform int numberOfLights; // Number of lights currently uploaded.
@@ -110,23 +166,73 @@ uniform vec3 cameraPosition; // World campera position.
 uniform int state; // Only used for testing / debugging.
 //uniform sampler3D texture3D; // Voxelization texture.
 
+uniform mat4 V; // the view depth guides the upsampling of the indirect light
+uniform sampler2D indirectLight; // diffuse, written by pass 1
+uniform sampler2D indirectSpecular; // written by pass 1
+uniform sampler2D indirectGuide; // normal and view depth of indirectLight, 0 where there is no surface
+uniform int indirectDownsample; // indirectLight has 1 / indirectDownsample of the resolution
+
+uniform sampler2D historyLight; // indirectLight of the previous frame, the frames it averages in alpha
+uniform sampler2D historyGuide; // indirectGuide of the previous frame
+uniform mat4 previousV; // camera of the previous frame
+uniform mat4 previousVP;
+uniform int maxHistoryLength; // 0 without history
+uniform int temporalCones; // diffuse cones traced per frame where there is history
+uniform int temporalFrame; // rotates the traced diffuse cones
+
+uniform bool irradianceProbes; // the indirect diffuse light comes from the probes
+uniform bool ambientCubeDiffuse; // the indirect diffuse light comes from gatherDiffuseLight
+uniform sampler3D probeGrid; // L1 SH of the probes, the 4 coefficients stacked along z, see updateProbe
+uniform uint probeLevel; // the probes sit at the centres of the nodes of this level
+#if CONE_TRACING_PASS == 3
+layout(rgba16f) uniform writeonly image3D probeGridImage;
+uniform usamplerBuffer probeCells; // XYZ16 cells of the nodes of probeLevel, see Graphics::listProbeCells
+uniform usamplerBuffer probeCellCounts; // entries of both lists
+uniform int probeList; // the current list
+uniform int firstProbe; // entry of the list this frame starts at, the probes are updated round robin
+uniform int probeViewportWidth;
+#endif
+
+#if DEFERRED == 1 || CONE_TRACING_PASS == 3
+uniform sampler2D gBufferPosition; // world position and material ID
+uniform sampler2D gBufferNormal; // normal and view depth, 0 where there is no surface
+vec3 worldPositionFrag;
+vec3 normalFrag;
+#else
 in vec3 worldPositionFrag;
 in vec3 normalFrag;
+#endif
 
-out vec4 color;
+layout(location = 0) out vec4 color;
+#if CONE_TRACING_PASS == 1
+layout(location = 1) out vec4 guide;
+layout(location = 2) out vec4 specular;
+#endif
 
+#if DEFERRED == 1 || CONE_TRACING_PASS == 3
+vec3 normal;
+float MAX_DISTANCE;
+#else
 vec3 normal = normalize(normalFrag); 
 float MAX_DISTANCE = distance(vec3(abs(worldPositionFrag)), vec3(-1));
+#endif
 
-int traverseToLevelAndGetOffset(inout vec3 posTex, out uint foundOnLevel, in uint maxLevel) {
+// Stops above maxLevel at the last node with an uploaded brick when the bricks are streamed,
+// then coarser is set and the node is sampled in place of the missing one.
+int traverseToLevelAndGetOffset(inout vec3 posTex, out uint foundOnLevel, in uint maxLevel, out bool coarser) {
+	// The index does not know which bricks are resident
 	vec3 nodePosTex = vec3(0.0);
-	vec3 nodePosMaxTex = vec3(1.0);
-	int nodeAddress = 0;
-	foundOnLevel = 0;
 	float sideLength = 0.5;
+	int nodeAddress = 0;
+	uint startLevel = 0;
+	if (!streamedBricks) {
+		nodeAddress = startTraversal(posTex, maxLevel, startLevel, nodePosTex, sideLength);
+	}
+	vec3 nodePosMaxTex = nodePosTex + vec3(2.0 * sideLength);
+	coarser = false;
 
-	for (foundOnLevel = 0; foundOnLevel < maxLevel; ++foundOnLevel) {
-		uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+	for (foundOnLevel = startLevel; foundOnLevel < maxLevel; ++foundOnLevel) {
+		uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 		uint childStartAddress = nodeNext & NODE_MASK_VALUE;
 		if (childStartAddress == 0U) {
 			break;
@@ -135,6 +241,14 @@ int traverseToLevelAndGetOffset(inout vec3 posTex, out uint foundOnLevel, in uin
 		uvec3 offVec = uvec3(2.0 * posTex);
 		uint off = offVec.x + 2U * offVec.y + 4U * offVec.z;
 
+		if (streamedBricks) {
+			int childAddress = int(childStartAddress + off);
+			if (!isResident(loadNode(NODE_NEXT, childAddress), loadNode(NODE_COLOR, childAddress))) {
+				coarser = true;
+				break;
+			}
+		}
+
 		// Restart while-loop with the child node (aka recursion)
 		nodeAddress = int(childStartAddress + off);
 		nodePosTex += vec3(childOffsets[off]) * vec3(sideLength);
@@ -147,23 +261,160 @@ int traverseToLevelAndGetOffset(inout vec3 posTex, out uint foundOnLevel, in uin
 	return nodeAddress;
 }
 
-vec4 getSVOValue(vec3 posWorld, sampler3D brickPoolImg, uint maxLevel, vec4 emptyVal = vec4(0)) {
+// Finds the brick pool position of posWorld on maxLevel, returns false if there is no node.
+// All brick pools have the same size.
+bool getSVOBrickPos(vec3 posWorld, uint maxLevel, out vec3 brickPosTex, out uint onLevel) {
 	vec3 posTex = (voxelGridTransformI * vec4(posWorld, 1.0)).xyz;
 
-	vec3 maxDistV = max(max(posTex - vec3(1.0), vec3(0.0) - posTex), vec3(0.0));
-	float maxDist = maxDistV.x + maxDistV.y + maxDistV.z;
-	float weight = max(0.0, 1.0 - maxDist / 0.5);
+	posTex = clamp(posTex, vec3(0.0001), vec3(0.9999));
+	onLevel = 0;
+	bool coarser = false;
+	int nodeAddress = traverseToLevelAndGetOffset(posTex, onLevel, maxLevel, coarser);
+	if (onLevel != maxLevel && !coarser) {
+		return false;
+	}
+	ivec3 brickAddress = ivec3(uintXYZ10ToVec3(loadNode(NODE_COLOR, int(nodeAddress))));
+	brickPosTex = (vec3(brickAddress) + vec3(0.5) + posTex * vec3(2.0)) / vec3(textureSize(brickPool_color, 0));
+	return true;
+}
 
+
+// The path of the last traversal of a cone. The samples of a cone are close to each other, so the
+// next traversal resumes from the deepest node of the path that still contains the sample, or from
+// the neighbour of the node on its level, instead of from the root.
+struct SVOCursor {
+	int nodes[MAX_NODE_POOL_LEVELS]; // nodes[top..level] are the node on each level containing the last sample, MAX_NODE_POOL_LEVELS comes from Shader::setGlobalDefines
+	uint top;   // nodes above top are not on the path, they were left by a step to a neighbour
+	uint level; // level of the last node
+	uvec3 cell; // cell of the last node on its level
+};
+
+SVOCursor startCursor() {
+	SVOCursor cursor;
+	cursor.nodes[0] = 0;
+	cursor.top = 0;
+	cursor.level = 0;
+	cursor.cell = uvec3(0);
+	return cursor;
+}
+
+uvec3 cellOnLevel(in vec3 posTex, in uint level) {
+	return uvec3(posTex * float(pow2(level)));
+}
+
+// Starts the cursor at the node of the top level index instead of the root.
+SVOCursor indexCursor(in vec3 posTex, in uint maxLevel) {
+	SVOCursor cursor = startCursor();
+	uint level;
+	int nodeAddress = lookupTopLevelIndex(posTex, maxLevel, level);
+	cursor.nodes[level] = nodeAddress;
+	cursor.top = level;
+	cursor.level = level;
+	cursor.cell = cellOnLevel(posTex, level);
+	return cursor;
+}
+
+// Steps from the cursor node to the node of cell on the same level through the neighbour links.
+// Returns false if the cell is not adjacent to the node or a neighbour is missing.
+bool stepToNeighbour(inout SVOCursor cursor, in uvec3 cell) {
+	ivec3 delta = ivec3(cell) - ivec3(cursor.cell);
+	if (any(greaterThan(abs(delta), ivec3(1)))) {
+		return false;
+	}
+
+	int nodeAddress = cursor.nodes[cursor.level];
+	if (delta.x != 0) {
+		nodeAddress = int(delta.x > 0 ? loadNode(NODE_X, nodeAddress) : loadNode(NODE_X_NEG, nodeAddress));
+	}
+	if (delta.y != 0 && nodeAddress != 0) {
+		nodeAddress = int(delta.y > 0 ? loadNode(NODE_Y, nodeAddress) : loadNode(NODE_Y_NEG, nodeAddress));
+	}
+	if (delta.z != 0 && nodeAddress != 0) {
+		nodeAddress = int(delta.z > 0 ? loadNode(NODE_Z, nodeAddress) : loadNode(NODE_Z_NEG, nodeAddress));
+	}
+	if (nodeAddress == 0 || (streamedBricks && !isResident(loadNode(NODE_NEXT, nodeAddress), loadNode(NODE_COLOR, nodeAddress)))) {
+		return false;
+	}
+
+	cursor.nodes[cursor.level] = nodeAddress;
+	cursor.top = cursor.level;
+	cursor.cell = cell;
+	return true;
+}
+
+// Same as getSVOBrickPos, but resumes the traversal from the path of the last sample of the cone.
+bool getSVOBrickPosCached(vec3 posWorld, uint maxLevel, inout SVOCursor cursor, out vec3 brickPosTex, out uint onLevel) {
+	vec3 posTex = (voxelGridTransformI * vec4(posWorld, 1.0)).xyz;
 	posTex = clamp(posTex, vec3(0.0001), vec3(0.9999));
-	uint onLevel = 0;
-	int nodeAddress = traverseToLevelAndGetOffset(posTex, onLevel, maxLevel);
-	if (onLevel != maxLevel) {
+
+	// Resume from the node of the last path on the level of the sample, its neighbour on that level,
+	// or the deepest node above which contains the sample
+	uint level = min(cursor.level, maxLevel);
+	uvec3 cell = cellOnLevel(posTex, level);
+	cursor.cell >>= cursor.level - level;
+	cursor.level = level;
+	if (cell != cursor.cell && !stepToNeighbour(cursor, cell)) {
+		while (cursor.level > cursor.top && cellOnLevel(posTex, cursor.level) != cursor.cell) {
+			cursor.level--;
+			cursor.cell >>= 1U;
+		}
+		if (cellOnLevel(posTex, cursor.level) != cursor.cell) {
+			cursor = startCursor();
+		}
+	}
+	// The index is one lookup, the octree nodes above it one load per level. It does not know which bricks are resident.
+	if (!streamedBricks && cursor.level < min(maxLevel, topLevelIndexLevel)) {
+		cursor = indexCursor(posTex, maxLevel);
+	}
+
+	// Down to maxLevel like traverseToLevelAndGetOffset
+	bool coarser = false;
+	while (cursor.level < maxLevel) {
+		int nodeAddress = cursor.nodes[cursor.level];
+		uint childStartAddress = loadNode(NODE_NEXT, nodeAddress) & NODE_MASK_VALUE;
+		if (childStartAddress == 0U) {
+			break;
+		}
+
+		uvec3 childCell = cellOnLevel(posTex, cursor.level + 1U);
+		uvec3 offVec = childCell - (cursor.cell << 1U);
+		int childAddress = int(childStartAddress + offVec.x + 2U * offVec.y + 4U * offVec.z);
+		if (streamedBricks && !isResident(loadNode(NODE_NEXT, childAddress), loadNode(NODE_COLOR, childAddress))) {
+			coarser = true;
+			break;
+		}
+
+		cursor.level++;
+		cursor.nodes[cursor.level] = childAddress;
+		cursor.cell = childCell;
+	}
+
+	onLevel = cursor.level;
+	if (onLevel != maxLevel && !coarser) {
+		return false;
+	}
+	vec3 nodePosTex = posTex * float(pow2(onLevel)) - vec3(cursor.cell);
+	ivec3 brickAddress = ivec3(uintXYZ10ToVec3(loadNode(NODE_COLOR, cursor.nodes[onLevel])));
+	brickPosTex = (vec3(brickAddress) + vec3(0.5) + nodePosTex * vec3(2.0)) / vec3(textureSize(brickPool_color, 0));
+	return true;
+}
+
+vec4 getSVOValue(vec3 posWorld, sampler3D brickPoolImg, uint maxLevel, vec4 emptyVal = vec4(0)) {
+	vec3 brickPosTex;
+	uint onLevel;
+	if (!getSVOBrickPos(posWorld, maxLevel, brickPosTex, onLevel)) {
 		return emptyVal;
 	}
-	ivec3 brickAddress = ivec3(uintXYZ10ToVec3(imageLoad(nodePool_color, int(nodeAddress)).x));
-	vec3 brickAddressF = (vec3(brickAddress) + vec3(0.5) + posTex * vec3(2.0)) / vec3(textureSize(brickPoolImg, 0));
-	vec4 brickVal = textureLod(brickPoolImg, brickAddressF, 0);
-	return brickVal;// *weight;
+	return textureLod(brickPoolImg, brickPosTex, 0);
+}
+
+// Irradiance seen along direction, blended from the directional bricks of the three axes
+vec4 getDirectionalValue(vec3 brickPosTex, vec3 direction) {
+	vec3 weight = direction * direction;
+	vec4 valX = direction.x > 0.0 ? textureLod(brickPool_directional[0], brickPosTex, 0) : textureLod(brickPool_directional[1], brickPosTex, 0);
+	vec4 valY = direction.y > 0.0 ? textureLod(brickPool_directional[2], brickPosTex, 0) : textureLod(brickPool_directional[3], brickPosTex, 0);
+	vec4 valZ = direction.z > 0.0 ? textureLod(brickPool_directional[4], brickPosTex, 0) : textureLod(brickPool_directional[5], brickPosTex, 0);
+	return weight.x * valX + weight.y * valY + weight.z * valZ;
 }
 
 // Returns an attenuation factor given a distance.
@@ -226,12 +477,20 @@ vec3 traceVoxelCone(const vec3 from, vec3 direction, float coneHalfAngle){
 	//return getSVOValue(from + direction * dist, brickPool_irradiance, uint(2)).xyz * 0.5;
 	float nSubStep = 2.0;
 	float radius = voxelLength * 0.5;
+	SVOCursor cursor = startCursor();
 	for (uint i = 0; i < numLevels && acc.a > 0.05; i++, radius *= 2)
 	{
 		float dist = radius / coneSin;
 		vec3 c = from + dist * direction;
-		vec4 irradianceVoxel = getSVOValue(c, brickPool_irradiance, numLevels - i);
-		vec4 normalVoxel = getSVOValue(c, brickPool_normal, numLevels - i, vec4(vec3(0.5), 0));
+		vec4 irradianceVoxel = vec4(0);
+		vec4 normalVoxel = vec4(vec3(0.5), 0);
+		vec3 brickPosTex;
+		uint onLevel;
+		if (getSVOBrickPosCached(c, numLevels - i, cursor, brickPosTex, onLevel)) {
+			irradianceVoxel = anisotropicVoxels && onLevel < numLevels - 1 ?
+				getDirectionalValue(brickPosTex, direction) : textureLod(brickPool_irradiance, brickPosTex, 0);
+			normalVoxel = textureLod(brickPool_normal, brickPosTex, 0);
+		}
 		float normalWeight = clamp(dot((normalVoxel.xyz - 0.5) * 2.0, direction) * -1.0, 0.0, 1.0);
 
 		float depthVoxels = dist * (1 - coneSin) / voxelLength;
@@ -306,7 +565,9 @@ vec3 traceSpecularVoxelCone(vec3 from, vec3 direction) {
 // Calculates indirect diffuse light using voxel cone tracing.
 // The current implementation uses 9 cones. I think 5 cones should be enough, but it might generate
 // more aliasing and bad blur.
-vec3 indirectDiffuseLight() {
+// Traces numCones of the 6 cones, starting at firstCone. The cones that are left out are made up for by
+// scaling, over frames with a rotating firstCone each cone contributes its share.
+vec3 indirectDiffuseLight(int firstCone, int numCones) {
 	const vec3 directionCoef[6] = {
 		normalize(vec3(0, 0, 1)),       normalize(vec3(1,0,0.83)),
 		normalize(vec3(0.31,0.95,0.83)),  normalize(vec3(0.31,-0.95,0.83)),
@@ -324,15 +585,51 @@ vec3 indirectDiffuseLight() {
 	const vec3 origin = worldPositionFrag + normal * length(voxelSize) * 1.0;
 	vec3 acc = vec3(0);
 
-	for (int i = 0; i < 6; i++)
+	for (int j = 0; j < numCones; j++)
 	{
+		const int i = (firstCone + j) % 6;
 		vec3 coef = directionCoef[i];
 		const float coneHalfAngle = coneAngle[i] / 180 * 3.1415;
 		vec3 direction = xAxis * coef.x + yAxis * coef.y + zAxis * coef.z;
 		float solidAngle = 2 * 3.14 * (1 - cos(coneHalfAngle));
 		acc += traceVoxelCone(origin, direction, coneHalfAngle) * coef.z * solidAngle;
 	}
-	return material.diffuseReflectivity * acc * material.diffuseColor;
+	return 6.0 / float(numCones) * material.diffuseReflectivity * acc * material.diffuseColor;
+}
+
+// The diffuse light of one wide cone around the normal. Above the leaves every step reads the directional bricks
+// once, the ambient cube MipmapAnisotropic filters for each voxel, blended for the normal. The normal bricks are
+// not read, the directional bricks already hide the light of the voxels facing away.
+vec3 gatherDiffuseLight() {
+	const vec3 origin = worldPositionFrag + normal * length(voxelSize) * 1.0;
+	const float coneSin = sin(DIFFUSE_GATHER_HALF_ANGLE);
+	float voxelLength = max(max(voxelSize.x, voxelSize.y), voxelSize.z);
+
+	// Starts one level above the leaves, where the directional bricks begin
+	vec4 acc = vec4(0,0,0,1);
+	float radius = voxelLength;
+	SVOCursor cursor = startCursor();
+	for (uint i = 1; i < numLevels && acc.a > 0.05; i++, radius *= 2)
+	{
+		float dist = radius / coneSin;
+		vec3 c = origin + dist * normal;
+		vec4 irradianceVoxel = vec4(0);
+		vec3 brickPosTex;
+		uint onLevel;
+		if (getSVOBrickPosCached(c, numLevels - i, cursor, brickPosTex, onLevel)) {
+			irradianceVoxel = anisotropicVoxels && onLevel < numLevels - 1 ?
+				getDirectionalValue(brickPosTex, normal) : textureLod(brickPool_irradiance, brickPosTex, 0);
+		}
+
+		float depthVoxels = dist * (1 - coneSin) / voxelLength;
+		float trans0 = clamp(1 - irradianceVoxel.a, 0, 1) + 0.01;
+		float transN = pow(trans0, depthVoxels);
+		float colorFactor = trans0 * (1 - transN) / (1 - trans0);
+		acc.xyz += irradianceVoxel.xyz * acc.a * colorFactor;
+		acc.a *= transN;
+	}
+	// As bright as the 6 cones of indirectDiffuseLight for the same light from all directions
+	return DIFFUSE_CONE_WEIGHT * 3.141593 * material.diffuseReflectivity * acc.xyz * material.diffuseColor;
 }
 
 vec3 indirectDiffuseLightOld(){
@@ -555,17 +852,228 @@ vec3 directLight(vec3 viewDirection){
 	return direct;
 }
 
+// The coefficients of the L1 spherical harmonics of the incoming light at the probe of a fragment. The probe grid
+// is 2^probeLevel probes along x and y, and 4 times that along z: the probes with the coefficient of Y00 and in alpha
+// whether the probe is at an occupied node, then the ones of Y1-1, Y10 and Y11. Only the probes at the cells of
+// probeCells are traced, the others are left out of the interpolation.
+#if CONE_TRACING_PASS == 3
+void updateProbe() {
+	const vec3 directionCoef[6] = {
+		normalize(vec3(0, 0, 1)),       normalize(vec3(1,0,0.83)),
+		normalize(vec3(0.31,0.95,0.83)),  normalize(vec3(0.31,-0.95,0.83)),
+		normalize(vec3(-0.81,0.58,0.83)), normalize(vec3(-0.81,-0.58,0.83)),
+	};
+	const float coneAngle[6] = {
+		60,40,40,40,40,40,
+	};
+
+	// The viewport may hold more fragments than the list has entries
+	int numProbes = int(texelFetch(probeCellCounts, probeList).x);
+	int listIndex = int(gl_FragCoord.y) * probeViewportWidth + int(gl_FragCoord.x);
+	if (listIndex >= numProbes) {
+		return;
+	}
+	int res = 1 << probeLevel;
+	ivec3 cell = ivec3(uintXYZ16ToVec3(texelFetch(probeCells, (firstProbe + listIndex) % numProbes).xy));
+	vec3 posTex = (vec3(cell) + vec3(0.5)) / float(res);
+
+	vec4 sh[4] = vec4[4](vec4(0), vec4(0), vec4(0), vec4(0));
+	worldPositionFrag = (inverse(voxelGridTransformI) * vec4(posTex, 1.0)).xyz;
+	normalFrag = vec3(0, 0, 1);
+	normal = normalFrag;
+	MAX_DISTANCE = distance(vec3(abs(worldPositionFrag)), vec3(-1));
+
+	float solidAngleSum = 0.0;
+	for (int i = 0; i < PROBE_CONES; i++) {
+		const float coneHalfAngle = coneAngle[i % 6] / 180 * 3.1415;
+		const vec3 direction = directionCoef[i % 6] * vec3(1, 1, i < 6 ? 1 : -1);
+		const float solidAngle = 2 * 3.14 * (1 - cos(coneHalfAngle));
+		const vec3 radiance = traceVoxelCone(worldPositionFrag, direction, coneHalfAngle) * solidAngle;
+		sh[0].rgb += 0.282095 * radiance;
+		sh[1].rgb += 0.488603 * direction.y * radiance;
+		sh[2].rgb += 0.488603 * direction.z * radiance;
+		sh[3].rgb += 0.488603 * direction.x * radiance;
+		solidAngleSum += solidAngle;
+	}
+	// The cones overlap, they are weighted to cover the sphere once
+	for (int k = 0; k < 4; k++) {
+		sh[k].rgb *= 4.0 * 3.141593 / solidAngleSum;
+	}
+	sh[0].a = 1.0;
+	for (int k = 0; k < 4; k++) {
+		imageStore(probeGridImage, ivec3(cell.xy, cell.z + k * res), sh[k]);
+	}
+}
+#endif
+
+// The indirect diffuse light interpolated between the probes around the fragment. The probes which are not at
+// occupied nodes have no weight.
+vec3 probeDiffuseLight() {
+	float res = float(1 << probeLevel);
+	vec3 posTex = (voxelGridTransformI * vec4(worldPositionFrag + normal * length(voxelSize), 1.0)).xyz;
+	vec3 probePos = clamp(posTex * res, vec3(0.5), vec3(res - 0.5)); // stays within the coefficients along z
+	vec4 sh[4];
+	for (int k = 0; k < 4; k++) {
+		sh[k] = textureLod(probeGrid, vec3(probePos.xy / res, (probePos.z + k * res) / (4.0 * res)), 0);
+	}
+	if (sh[0].a < 0.001) {
+		return vec3(0);
+	}
+
+	// Irradiance of the L1 SH for the normal, with the cosine lobe coefficients pi and 2 pi / 3
+	vec3 irradiance = 3.141593 * 0.282095 * sh[0].rgb
+		+ 2.094395 * 0.488603 * (sh[1].rgb * normal.y + sh[2].rgb * normal.z + sh[3].rgb * normal.x);
+	irradiance = max(irradiance / sh[0].a, vec3(0));
+	return DIFFUSE_CONE_WEIGHT * material.diffuseReflectivity * irradiance * material.diffuseColor;
+}
+
+// The indirect diffuse light by the method the settings select, numCones of the six cones starting at firstCone
+// when they are traced.
+vec3 diffuseLight(int firstCone, int numCones) {
+	if (irradianceProbes) {
+		return probeDiffuseLight();
+	}
+	if (ambientCubeDiffuse) {
+		return gatherDiffuseLight();
+	}
+	return indirectDiffuseLight(firstCone, numCones);
+}
+
+// The accumulated indirect diffuse light of the previous frame where it was written for the same surface, with
+// the number of frames it averages in alpha. Rejected by view depth and normal, then vec4(0).
+vec4 reprojectHistory() {
+	if (maxHistoryLength == 0) {
+		return vec4(0);
+	}
+	vec4 clipPos = previousVP * vec4(worldPositionFrag, 1.0);
+	if (clipPos.w <= 0.0) {
+		return vec4(0);
+	}
+	vec2 uv = clipPos.xy / clipPos.w * 0.5 + 0.5;
+	if (any(lessThan(uv, vec2(0.0))) || any(greaterThanEqual(uv, vec2(1.0)))) {
+		return vec4(0);
+	}
+
+	ivec2 texel = ivec2(uv * vec2(textureSize(historyGuide, 0)));
+	vec4 previousGuide = texelFetch(historyGuide, texel, 0);
+	float depth = -(previousV * vec4(worldPositionFrag, 1.0)).z;
+	if (previousGuide.w <= 0.0 || abs(previousGuide.w - depth) > HISTORY_DEPTH_TOLERANCE * depth
+		|| dot(previousGuide.xyz, normal) < HISTORY_NORMAL_TOLERANCE) {
+		return vec4(0);
+	}
+	return texelFetch(historyLight, texel, 0);
+}
+
+// The indirect light of pass 1 at this pixel. The low resolution texels around it are weighted by their
+// bilinear weights and by how close their normal and view depth are to the ones of the fragment.
+vec3 upsampleIndirectLight() {
+	float depth = -(V * vec4(worldPositionFrag, 1.0)).z;
+	ivec2 lowResSize = textureSize(indirectLight, 0);
+	vec2 lowResPos = gl_FragCoord.xy / float(indirectDownsample) - 0.5;
+	ivec2 base = ivec2(floor(lowResPos));
+	vec2 f = lowResPos - vec2(base);
+
+	vec3 acc = vec3(0);
+	float weightSum = 0.0;
+	vec3 closest = vec3(0); // of the texel with the closest depth, where no texel matches
+	float closestDepthDiff = 1e30;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), lowResSize - 1);
+		vec4 texelGuide = texelFetch(indirectGuide, texel, 0);
+		if (texelGuide.w <= 0.0) {
+			continue;
+		}
+
+		vec3 value = texelFetch(indirectLight, texel, 0).rgb + texelFetch(indirectSpecular, texel, 0).rgb;
+		float depthDiff = abs(depth - texelGuide.w);
+		if (depthDiff < closestDepthDiff) {
+			closestDepthDiff = depthDiff;
+			closest = value;
+		}
+
+		vec2 bilinear = mix(vec2(1.0) - f, f, vec2(offset));
+		float normalWeight = pow(max(dot(normal, texelGuide.xyz), 0.0), UPSAMPLE_NORMAL_POWER);
+		float depthWeight = exp(-depthDiff / (UPSAMPLE_DEPTH_SIGMA * depth));
+		float weight = max(bilinear.x * bilinear.y, 0.001) * normalWeight * depthWeight;
+		acc += weight * value;
+		weightSum += weight;
+	}
+	return weightSum > 0.0001 ? acc / weightSum : closest;
+}
+
+#if DEFERRED == 1
+// Fills the surface and material of the pixel in, false where there is no surface.
+// Pass 1 reads the G-buffer pixel under the centre of its reduced resolution texel.
+bool readGBuffer() {
+#if CONE_TRACING_PASS == 1
+	ivec2 texel = ivec2(gl_FragCoord.xy * float(indirectDownsample));
+#else
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+#endif
+	vec4 normalDepth = texelFetch(gBufferNormal, texel, 0);
+	if (normalDepth.w <= 0.0) {
+		return false;
+	}
+	vec4 position = texelFetch(gBufferPosition, texel, 0);
+	worldPositionFrag = position.xyz;
+	normalFrag = normalDepth.xyz;
+	normal = normalize(normalFrag);
+	MAX_DISTANCE = distance(vec3(abs(worldPositionFrag)), vec3(-1));
+
+	PackedMaterial packed = materials[int(position.w)];
+	material.diffuseColor = packed.diffuse.rgb;
+	material.diffuseReflectivity = packed.diffuse.a;
+	material.specularColor = packed.specular.rgb;
+	material.specularDiffusion = packed.specular.a;
+	material.specularReflectivity = packed.properties.x;
+	material.emissivity = packed.properties.y;
+	material.refractiveIndex = packed.properties.z;
+	material.transparency = packed.properties.w;
+	return true;
+}
+#endif
+
 void main(){
+#if CONE_TRACING_PASS == 3
+	updateProbe();
+	return;
+#endif
+#if DEFERRED == 1
+	if (!readGBuffer()) {
+		discard;
+	}
+#endif
 	color = vec4(0, 0, 0, 1);
 	vec3 viewDir = normalize(worldPositionFrag - cameraPosition);
 
+#if CONE_TRACING_PASS == 1
+	guide = vec4(normal, -(V * vec4(worldPositionFrag, 1.0)).z);
+	specular = vec4(0, 0, 0, 1);
+
+	// The diffuse light is averaged over the frames, the pixels without history trace all cones
+	vec4 history = reprojectHistory();
+	int numCones = history.a > 0.0 ? temporalCones : 6;
+	vec3 diffuse = vec3(0);
+	if(settings.indirectDiffuseLight && material.diffuseReflectivity * (1.0f - material.transparency) > 0.01f) 
+		diffuse = indirectLightMultiplier * diffuseLight((temporalFrame * temporalCones) % 6, numCones);
+	float historyLength = max(min(history.a + 1.0, float(maxHistoryLength)), 1.0);
+	color = vec4(mix(history.rgb, diffuse, 1.0 / historyLength), historyLength);
+
+	// The specular light depends on the view, it is traced every frame
+	if(settings.indirectSpecularLight && material.specularReflectivity * (1.0f - material.transparency) > 0.01f) 
+		specular.rgb = indirectLightMultiplier * indirectSpecularLight(viewDir);
+#elif CONE_TRACING_PASS == 2
+	color.rgb += upsampleIndirectLight();
+#else
 	// Indirect diffuse light.
 	if(settings.indirectDiffuseLight && material.diffuseReflectivity * (1.0f - material.transparency) > 0.01f) 
-		color.rgb += indirectLightMultiplier * indirectDiffuseLight();
+		color.rgb += indirectLightMultiplier * diffuseLight(0, 6);
 
 	//// Indirect specular light (glossy reflections).
 	if(settings.indirectSpecularLight && material.specularReflectivity * (1.0f - material.transparency) > 0.01f) 
 		color.rgb += indirectLightMultiplier * indirectSpecularLight(viewDir);
+#endif
 
 	//// Emissivity.
 	//color.rgb += material.emissivity * material.diffuseColor;
@@ -575,8 +1083,10 @@ void main(){
 	//	color.rgb = mix(color.rgb, indirectRefractiveLight(viewDir), material.transparency);
 
 	// Direct light.
+#if CONE_TRACING_PASS != 1
 	if(settings.directLight)
 		color.rgb += directLightMultiplier * directLight(viewDir);
+#endif
 
 //#if (GAMMA_CORRECTION == 1)
 //	color.rgb = pow(color.rgb, vec3(1.0 / 2.2));
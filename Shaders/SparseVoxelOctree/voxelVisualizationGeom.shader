@@ -10,9 +10,6 @@ layout(rgba8) uniform image3D brickPool_color;
 uniform mat4 voxelGridTransformG;
 uniform uint levelG;
 uniform uint numLevels;  // Number of levels in the octree
-const float levelTexSizeG[] = {1.0,       1 / 2.0,  1 / 4.0,  1 / 8.0,
-                              1 / 16.0,  1 / 32.0, 1 / 64.0, 1 / 128.0,
-                              1 / 256.0, 1 / 512.0};
 
 in VertexData{
 	vec4 posWorldSpace;
@@ -51,7 +48,7 @@ void main(){
 	vec4 posWorldSpace = In[0].posWorldSpace;
 	ivec3 brickAddress = In[0].brickAddress;
 
-	float deltaTex = levelTexSizeG[levelG+1];
+	float deltaTex = 1.0 / float(1U << (levelG + 1U));
 	vec4 deltaWorld = voxelGridTransformG * vec4(deltaTex, deltaTex, deltaTex, 0.0) * 0.98;
 	bool validAddress = brickAddress.r >= 0;
 
@@ -9,18 +9,19 @@ uniform uint level;
 #include "SparseVoxelOctree/_utilityFunctions.shader"
 #include "SparseVoxelOctree/_traverseUtil.shader"
 
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
 layout(r32ui) uniform uimageBuffer nodePool_next;
 layout(r32ui) uniform uimageBuffer nodePool_color;
-layout(r32ui) uniform uimageBuffer voxelFragList_position;
+#endif
+layout(rg32ui) uniform uimageBuffer voxelFragList_position;
 layout(r32ui) uniform uimage3D voxelFragTex_color;
 
 uniform uint voxelTexSize;
 uniform mat4 voxelGridTransform;
 
-const float levelTexSize[] = {1.0,   2.0,  4.0,  8.0,
-                              16.0,  32.0, 64.0, 128.0,
-                              256.0, 512.0};
-
 out VertexData{
 	vec4 posWorldSpace;
 	//vec4 color;
@@ -35,7 +36,7 @@ int traverseToLevel(inout vec3 posTex, out uint foundOnLevel) {
 	float sideLength = 0.5;
 
 	for (foundOnLevel = 0; foundOnLevel < level; ++foundOnLevel) {
-		uint nodeNext = imageLoad(nodePool_next, nodeAddress).x;
+		uint nodeNext = loadNode(NODE_NEXT, nodeAddress);
 		uint childStartAddress = nodeNext & NODE_MASK_VALUE;
 		if (childStartAddress == 0U) {
 			break;
@@ -60,10 +61,10 @@ int traverseToLevel(inout vec3 posTex, out uint foundOnLevel) {
 void main(){
 	// Get position
 	uvec4 positionU = imageLoad(voxelFragList_position, int(gl_VertexID));
-	uvec3 baseVoxel = uintXYZ10ToVec3(positionU.x);
+	uvec3 baseVoxel = uintXYZ16ToVec3(positionU.xy);
 	vec3 posTexSpace = vec3(baseVoxel) / float(voxelTexSize); // = [0,1]
-	uvec3 posTexSpacei = uvec3(posTexSpace * levelTexSize[level+1]);
-	posTexSpace = vec3(posTexSpacei) / levelTexSize[level+1];
+	uvec3 posTexSpacei = uvec3(posTexSpace * float(pow2(level + 1)));
+	posTexSpace = vec3(posTexSpacei) / float(pow2(level + 1));
 
 	Out.posWorldSpace = voxelGridTransform * vec4(posTexSpace, 1.0);
 
@@ -76,7 +77,7 @@ void main(){
 	int nodeAddress = traverseToLevel(posTexSpace, onLevel);
 	//Out.brickAddress = ivec3(uintXYZ10ToVec3(imageLoad(nodePool_color, int(nodeAddress)).x));
 	if (onLevel == level) {
-		Out.brickAddress = ivec3(uintXYZ10ToVec3(imageLoad(nodePool_color, int(nodeAddress)).x) + ceil(posTexSpace));
+		Out.brickAddress = ivec3(uintXYZ10ToVec3(loadNode(NODE_COLOR, int(nodeAddress))) + ceil(posTexSpace));
 		//vec4 brickColor = imageLoad(brickPool_color, brickAddress);
 		//Out.color = brickColor;
 	}
@@ -2,7 +2,7 @@
 #version 430
 #define MAX_NUM_AVG_ITERATIONS 100
 
-layout(r32ui) uniform coherent uimageBuffer voxelFragList_position;
+layout(rg32ui) uniform coherent uimageBuffer voxelFragList_position;
 layout(r32ui) uniform volatile uimage3D voxelFragTex_color;
 layout(r32ui) uniform volatile uimage3D voxelFragTex_normal;
 
@@ -10,6 +10,8 @@ layout(binding = 0) uniform atomic_uint voxel_index;
 
 uniform sampler2D diffuseTex;
 uniform uint voxelTexSize;
+uniform ivec3 voxelRegionMin; // only voxels inside the region are written
+uniform ivec3 voxelRegionMax;
 
 struct Material {
 	vec3 diffuseColor;
@@ -44,26 +46,29 @@ uint convVec4ToRGBA8(vec4 val) {
 		| (uint(val.x) & 0x000000FF);
 }
 
-uint vec3ToUintXYZ10(uvec3 val) {
-	return (uint(val.z) & 0x000003FF) << 20U
-		| (uint(val.y) & 0x000003FF) << 10U
-		| (uint(val.x) & 0x000003FF);
+uvec2 vec3ToUintXYZ16(uvec3 val) {
+	return uvec2((val.x & 0x0000FFFF) | (val.y & 0x0000FFFF) << 16U,
+		val.z & 0x0000FFFF);
 }
 
 
+// firstValue is set for the one fragment which wrote the empty voxel
 uint imageAtomicRGBA8Avg(layout(r32ui) volatile uimage3D img,
 	ivec3 coords,
-	vec4 newVal) {
+	vec4 newVal,
+	out bool firstValue) {
 	newVal.xyz *= 255.0; // Optimise following calculations
 	uint newValU = convVec4ToRGBA8(newVal);
 	uint lastValU = 0;
 	uint currValU;
 	vec4 currVal;
 	uint numIterations = 0;
+	firstValue = true;
 	// Loop as long as destination value gets changed by other threads
 	while ((currValU = imageAtomicCompSwap(img, coords, lastValU, newValU)) != lastValU
 		&& numIterations < MAX_NUM_AVG_ITERATIONS) {
 		lastValU = currValU;
+		firstValue = false;
 
 		// Compute average value newValU
 		currVal = convRGBA8ToVec4(currValU);
@@ -86,7 +91,12 @@ uint imageAtomicRGBA8Avg(layout(r32ui) volatile uimage3D img,
 
 void main() {
 	//uvec3 baseVoxel = uvec3(floor(In.posTexSpace * (voxelTexSize)));
-	uvec3 baseVoxel = uvec3(floor(min(In.posTexSpace,vec3(0.999)) * voxelTexSize));
+	// Clamped to the last voxel, a fixed margin below 1.0 would skip voxels on large grids
+	ivec3 voxelCoords = min(ivec3(floor(In.posTexSpace * float(voxelTexSize))), ivec3(voxelTexSize - 1U));
+	uvec3 baseVoxel = uvec3(voxelCoords);
+	if (any(lessThan(voxelCoords, voxelRegionMin)) || any(greaterThan(voxelCoords, voxelRegionMax))) {
+		discard;
+	}
 
 	vec4 diffColor = texture(diffuseTex, vec2(In.uv.x, 1.0 - In.uv.y));
 	// Pre-multiply alpha:
@@ -97,17 +107,20 @@ void main() {
 	normal.a = diffColor.a;
 
 
-	uint voxelIndex = atomicCounterIncrement(voxel_index);
-	memoryBarrier();
-
-	//Store voxel position in FragmentList
 	uint diffColorU = convVec4ToRGBA8(diffColor * 255.0);
 	uint normalU = convVec4ToRGBA8(normal * 255.0);
-	imageStore(voxelFragList_position, int(voxelIndex), uvec4(vec3ToUintXYZ10(baseVoxel)));
 	//imageStore(voxelFragTex_color, ivec3(baseVoxel), uvec4(diffColorU));
 	//imageStore(voxelFragTex_normal, ivec3(baseVoxel), uvec4(normalU));
 
 	//Avg voxel attributes and store in FragmentTexXXX
-	imageAtomicRGBA8Avg(voxelFragTex_color, ivec3(baseVoxel), diffColor);
-	imageAtomicRGBA8Avg(voxelFragTex_normal, ivec3(baseVoxel), normal);
+	bool firstInVoxel, firstNormal;
+	imageAtomicRGBA8Avg(voxelFragTex_color, ivec3(baseVoxel), diffColor, firstInVoxel);
+	imageAtomicRGBA8Avg(voxelFragTex_normal, ivec3(baseVoxel), normal, firstNormal);
+
+	// The fragment which claimed the empty voxel in the color texture stores the voxel position in the
+	// FragmentList, so every voxel is listed once and the passes over the list scale with the voxels
+	if (firstInVoxel) {
+		uint voxelIndex = atomicCounterIncrement(voxel_index);
+		imageStore(voxelFragList_position, int(voxelIndex), uvec4(vec3ToUintXYZ16(baseVoxel), 0U, 0U));
+	}
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 430 core
+
+layout(r32ui) uniform readonly uimageBuffer nextFreeTile;   // tile counters of all levels
+layout(r32ui) uniform readonly uimageBuffer levelAddressBuffer;
+layout(r32ui) uniform writeonly uimageBuffer levelCommands; // one indirect draw command per level
+
+uniform uint numLevels;
+
+// Writes the draw commands of the passes with one thread per node of a level. The nodes of level
+// L + 1 are the children of the tiles handed out on level L, they are stored consecutively from
+// levelAddress[L + 1] on, so only the nodes of those tiles get a thread. The counters of levels
+// which ran out of tiles exceed the range of the level. One thread in total.
+void main() {
+  for (uint level = 0U; level < numLevels; ++level) {
+    uint levelNodes = imageLoad(levelAddressBuffer, int(level + 1U)).x - imageLoad(levelAddressBuffer, int(level)).x;
+    uint numNodes = level == 0U ? 1U : min(8U * imageLoad(nextFreeTile, int(level - 1U)).x, levelNodes);
+    int command = 4 * int(level);
+    imageStore(levelCommands, command, uvec4(numNodes)); // Vertex-Count
+    imageStore(levelCommands, command + 1, uvec4(1U));   // Primitive Count
+    imageStore(levelCommands, command + 2, uvec4(0U));   // First Vertex
+    imageStore(levelCommands, command + 3, uvec4(0U));   // Base Instance
+  }
+}
@@ -0,0 +1,25 @@
+#version 430 core
+
+layout(r32ui) uniform readonly uimageBuffer litNodeCounts; // nodes LightInjection.shader listed per level
+layout(r32ui) uniform readonly uimageBuffer levelCommands; // the commands of all nodes of a level, see writeLevelCommandsVert.shader
+layout(r32ui) uniform writeonly uimageBuffer lightCommands; // one indirect draw command per level
+
+uniform uint numLevels;
+
+#include "SparseVoxelOctree/_threadNodeUtil.shader"
+
+// Writes the draw commands of the passes with one thread per lit node of a level (THREAD_MODE_LIGHT).
+// A level listing more nodes than its region of the node map holds gets the command of all its nodes,
+// _threadNodeUtil.shader then runs over the whole level. One thread in total.
+void main() {
+  for (uint level = 0U; level < numLevels; ++level) {
+    uint litNodes = imageLoad(litNodeCounts, int(level)).x;
+    uint capacity = uint(nodeMapSize[level].x * nodeMapSize[level].y);
+    uint numNodes = litNodes > capacity ? imageLoad(levelCommands, 4 * int(level)).x : litNodes;
+    int command = 4 * int(level);
+    imageStore(lightCommands, command, uvec4(numNodes)); // Vertex-Count
+    imageStore(lightCommands, command + 1, uvec4(1U));   // Primitive Count
+    imageStore(lightCommands, command + 2, uvec4(0U));   // First Vertex
+    imageStore(lightCommands, command + 3, uvec4(0U));   // Base Instance
+  }
+}
@@ -0,0 +1,34 @@
+// Writes one level of the dense top level index (see _topLevelIndex.shader), one thread per cell of the level.
+#version 430 core
+
+#define NODE_POOL_ACCESS readonly
+#include "SparseVoxelOctree/_nodePool.shader"
+
+#if NODE_POOL_LAYOUT == NODE_POOL_TEXTURES
+layout(r32ui) uniform readonly uimageBuffer nodePool_next;
+#endif
+layout(rg32ui) uniform writeonly uimage3D topLevelIndex_level; // the mip of the index for level
+
+uniform uint level;
+
+#include "SparseVoxelOctree/_utilityFunctions.shader"
+
+void main() {
+  uint res = pow2(level);
+  uint cellIdx = uint(gl_VertexID);
+  uvec3 cell = uvec3(cellIdx % res, (cellIdx / res) % res, cellIdx / (res * res));
+
+  int nodeAddress = 0;
+  uint iLevel = 0U;
+  for (; iLevel < level; ++iLevel) {
+    uint childStartAddress = loadNode(NODE_NEXT, nodeAddress) & NODE_MASK_VALUE;
+    if (childStartAddress == 0U) {
+      break;
+    }
+
+    uvec3 offVec = (cell >> (level - iLevel - 1U)) & uvec3(1U);
+    nodeAddress = int(childStartAddress + offVec.x + 2U * offVec.y + 4U * offVec.z);
+  }
+
+  imageStore(topLevelIndex_level, ivec3(cell), uvec4(uint(nodeAddress), iLevel, 0U, 0U));
+}
@@ -120,7 +120,7 @@ void Application::init() {
 	TwType brickTexType = TwDefineEnum("BrickTexture", NULL, 0);
 	for (auto * meshRenderer : scene->renderers) if (meshRenderer->tweakable) tweakableRenderers.push_back(meshRenderer);
 	TwAddVarRW(mainTweakBar, "Application state", TW_TYPE_INT32, &state, "label='State' group=Rendering");
-	TwAddVarRW(mainTweakBar, "Rendering mode", renderingMode, &currentRenderingMode, "enum='0 {Voxel Visualization}, 1 {Voxel Cone Tracing}' group=Rendering");
+	TwAddVarRW(mainTweakBar, "Rendering mode", renderingMode, &currentRenderingMode, "enum='0 {Voxel Visualization}, 1 {Voxel Cone Tracing}, 2 {Clipmap Cone Tracing}' group=Rendering");
 	TwAddVarRW(mainTweakBar, "Voxel Blend Mode", voxelBlendMode, &graphics.m_voxelBlendMode, "enum='0 {No Blend}, 1 {Alpha Add}, 2 {Alpha Blend}' group=Rendering");
 	TwAddVarRW(mainTweakBar, "Brick Texture Type", brickTexType, &graphics.m_brickTexType, "enum='0 {Color}, 1 {Irradiance}, 2{Normal}' group=Rendering");
 	TwAddVarRW(mainTweakBar, "Visualization Level", TW_TYPE_INT32, &graphics.m_ithVisualizeLevel, "label='Visualization Level' group=Rendering");
@@ -129,7 +129,30 @@ void Application::init() {
 	TwAddVarRW(mainTweakBar, "Shadows", TW_TYPE_BOOL8, &graphics.shadows, "group=Settings");
 	TwAddVarRW(mainTweakBar, "Update Scene", TW_TYPE_BOOL8, &graphics.updateScene, "group=Settings");
 	TwAddVarRW(mainTweakBar, "Voxelize", TW_TYPE_BOOL8, &graphics.buildSVO, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Incremental SVO", TW_TYPE_BOOL8, &graphics.incrementalSVO, "group=Settings");
+	TwAddVarRW(mainTweakBar, "SVO Full Rebuild Interval", TW_TYPE_INT32, &graphics.svoFullRebuildInterval, "group=Settings min=0");
+	TwAddVarRW(mainTweakBar, "Static SVO", TW_TYPE_BOOL8, &graphics.staticSVO, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Morton SVO Build", TW_TYPE_BOOL8, &graphics.mortonSVOBuild, "group=Settings");
+	TwAddVarRW(mainTweakBar, "SVO Node Pool Budget (MB)", TW_TYPE_INT32, &graphics.svoNodePoolBudgetMB, "group=Settings min=1");
+	TwAddVarRW(mainTweakBar, "Validate SVO on CPU", TW_TYPE_BOOL8, &graphics.validateSVOQueued, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Benchmark Node Pool Layouts", TW_TYPE_BOOL8, &graphics.benchmarkNodePoolQueued, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Benchmark Border Transfer", TW_TYPE_BOOL8, &graphics.benchmarkBorderTransferQueued, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Indirect Light Downsample", TW_TYPE_INT32, &graphics.indirectLightDownsample, "group=Settings min=1 max=4");
+	TwAddVarRW(mainTweakBar, "Temporal Indirect Light", TW_TYPE_BOOL8, &graphics.temporalIndirectLight, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Temporal Diffuse Cones", TW_TYPE_INT32, &graphics.temporalDiffuseCones, "group=Settings min=1 max=6");
+	TwAddVarRW(mainTweakBar, "Temporal History Length", TW_TYPE_INT32, &graphics.temporalHistoryLength, "group=Settings min=1 max=64");
+	TwAddVarRW(mainTweakBar, "Deferred Shading", TW_TYPE_BOOL8, &graphics.deferredShading, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Ambient Cube Diffuse", TW_TYPE_BOOL8, &graphics.ambientCubeDiffuse, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Irradiance Probes", TW_TYPE_BOOL8, &graphics.irradianceProbes, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Probe Grid Level", TW_TYPE_INT32, &graphics.probeGridLevel, "group=Settings min=1 max=8");
+	TwAddVarRW(mainTweakBar, "Probes Per Frame", TW_TYPE_INT32, &graphics.probesPerFrame, "group=Settings min=1 step=256");
+	TwAddVarRW(mainTweakBar, "Benchmark Indirect Light", TW_TYPE_BOOL8, &graphics.benchmarkIndirectLightQueued, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Save SVO", TW_TYPE_BOOL8, &graphics.saveSVOQueued, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Bake SVO on CPU", TW_TYPE_BOOL8, &graphics.bakeSVOOnCPU, "group=Settings");
+	TwAddVarRW(mainTweakBar, "SVO Stream LOD Distance", TW_TYPE_FLOAT, &graphics.svoStreamLodDistance, "group=Settings min=0 step=0.1");
 	TwAddVarRW(mainTweakBar, "Inject Light", TW_TYPE_BOOL8, &graphics.injectLight, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Anisotropic Voxels", TW_TYPE_BOOL8, &graphics.anisotropicVoxels, "group=Settings");
+	TwAddVarRW(mainTweakBar, "Filter Lit Nodes", TW_TYPE_BOOL8, &graphics.filterLitNodes, "group=Settings");
 	graphics.lightDirection = glm::vec3(0,-1,0);
 	TwAddVarRW(mainTweakBar, "LightDir", TW_TYPE_DIR3F, &graphics.lightDirection,
 		" label='Light direction' axisz=z help='Change the light direction.' ");
@@ -484,6 +507,9 @@ void Application::GLFWKeyCallback(GLFWwindow * window, int key, int scanmode, in
 			if (app.currentRenderingMode == GRM::VOXELIZATION_VISUALIZATION) {
 				app.currentRenderingMode = GRM::VOXEL_CONE_TRACING;
 			}
+			else if (app.currentRenderingMode == GRM::VOXEL_CONE_TRACING) {
+				app.currentRenderingMode = GRM::CLIPMAP_CONE_TRACING;
+			}
 			else {
 				app.currentRenderingMode = GRM::VOXELIZATION_VISUALIZATION;
 			}
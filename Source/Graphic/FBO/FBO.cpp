@@ -2,7 +2,7 @@
 
 #include <iostream>
 
-FBO::FBO(GLuint w, GLuint h, GLenum magFilter, GLenum minFilter, GLint internalFormat, GLint format, GLint wrap)
+FBO::FBO(GLuint w, GLuint h, GLenum magFilter, GLenum minFilter, GLint internalFormat, GLint format, GLint wrap, GLuint colorAttachments)
 	: width(w), height(h)
 {
 	GLint previousFrameBuffer;
@@ -12,17 +12,25 @@ FBO::FBO(GLuint w, GLuint h, GLenum magFilter, GLenum minFilter, GLint internalF
 	glGenFramebuffers(1, &frameBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
 
-	glGenTextures(1, &textureColorBuffer);
-	glBindTexture(GL_TEXTURE_2D, textureColorBuffer);
+	// All color attachments have the same format.
+	textureColorBuffers.resize(colorAttachments);
+	glGenTextures(colorAttachments, textureColorBuffers.data());
+	std::vector<GLenum> drawBuffers(colorAttachments);
+	for (GLuint i = 0; i < colorAttachments; ++i) {
+		glBindTexture(GL_TEXTURE_2D, textureColorBuffers[i]);
 
-	// Texture parameters.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		// Texture parameters.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, GL_RGBA, format, NULL);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorBuffer, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, GL_RGBA, format, NULL);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textureColorBuffers[i], 0);
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	textureColorBuffer = textureColorBuffers[0];
+	glDrawBuffers(colorAttachments, drawBuffers.data());
 
 	glGenRenderbuffers(1, &rbo);
 	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
@@ -63,15 +71,16 @@ GLuint FBO::generateAttachment(GLuint w, GLuint h, GLboolean depth, GLboolean st
 	return textureID;
 }
 
-void FBO::ActivateAsTexture(const int shaderProgram, const std::string glSamplerName, const int textureUnit)
+void FBO::ActivateAsTexture(const int shaderProgram, const std::string glSamplerName, const int textureUnit, const int colorAttachment)
 {
 	glActiveTexture(GL_TEXTURE0 + textureUnit);
-	glBindTexture(GL_TEXTURE_2D, textureColorBuffer);
+	glBindTexture(GL_TEXTURE_2D, textureColorBuffers[colorAttachment]);
 	glUniform1i(glGetUniformLocation(shaderProgram, glSamplerName.c_str()), textureUnit);
 }
 
 FBO::~FBO()
 {
-	glDeleteTextures(1, &textureColorBuffer);
+	glDeleteTextures((GLsizei)textureColorBuffers.size(), textureColorBuffers.data());
+	glDeleteRenderbuffers(1, &rbo);
 	glDeleteFramebuffers(1, &frameBuffer);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #define GLEW_STATIC
 #include <glew.h>
 
+#include <string>
 #include <vector>
 
 // https://www.opengl.org/wiki/Framebuffer_Object_Examples
@@ -10,10 +11,11 @@
 class FBO {
 public:
 	GLuint width, height, frameBuffer, textureColorBuffer, attachment, rbo;
-	void ActivateAsTexture(const int shaderProgram, const std::string glSamplerName, const int textureUnit = GL_TEXTURE0);
+	std::vector<GLuint> textureColorBuffers; // one per color attachment, the first is textureColorBuffer
+	void ActivateAsTexture(const int shaderProgram, const std::string glSamplerName, const int textureUnit = GL_TEXTURE0, const int colorAttachment = 0);
 	FBO(
 		GLuint w, GLuint h, GLenum magFilter = GL_NEAREST, GLenum minFilter = GL_NEAREST,
-		GLint internalFormat = GL_RGB16F, GLint format = GL_FLOAT, GLint wrap = GL_REPEAT);
+		GLint internalFormat = GL_RGB16F, GLint format = GL_FLOAT, GLint wrap = GL_REPEAT, GLuint colorAttachments = 1);
 	~FBO();
 private:
 	GLuint generateAttachment(GLuint w, GLuint h, GLboolean depth, GLboolean stencil, GLenum magFilter, GLenum minFilter, GLenum wrap);
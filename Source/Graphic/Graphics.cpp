@@ -4,6 +4,7 @@
 #include <queue>
 #include <algorithm>
 #include <vector>
+#include <iostream>
 
 // External.
 #include <glm.hpp>
@@ -14,6 +15,7 @@
 #include "Material\Material.h"
 #include "Camera\OrthographicCamera.h"
 #include "Material\MaterialStore.h"
+#include "Material\Shader.h"
 #include "../Time/Time.h"
 #include "../Shape/Mesh.h"
 #include "../Shape/StandardShapes.h"
@@ -21,6 +23,8 @@
 #include "../Utility/ObjLoader.h"
 #include "../Shape/Shape.h"
 #include "../Application.h"
+#include "../SparseVoxelOctree/CpuOctreeBuilder.h"
+#include "../SparseVoxelOctree/SvoFile.h"
 
 // ----------------------
 // Rendering pipeline.
@@ -45,13 +49,74 @@ void Graphics::render(Scene & renderingScene, unsigned int viewportWidth, unsign
 	//	ticksSinceLastVoxelization = 0;
 	//	voxelizationQueued = false;
 	//}
-	if (buildSVO)
+	// A baked octree is only used for the scene it was baked from
+	if (!m_svoFileChecked)
 	{
-		sparseVoxelize(renderingScene, true);
+		m_svoFileChecked = true;
+		if (m_brickStreamer && m_brickStreamer->getFile().getSceneHash() != SvoFile::hashScene(renderingScene.renderers))
+		{
+			std::cout << "The SVO of " << svoFile << " was baked from a different scene, it is built instead." << std::endl;
+			m_brickStreamer = nullptr;
+		}
+		else if (!m_brickStreamer && useSVOBake)
+		{
+			m_svoBakeLoaded = loadSVO(renderingScene, svoFile);
+			saveSVOQueued = saveSVOQueued || !m_svoBakeLoaded;
+		}
+	}
+
+	if (renderingMode == RenderingMode::CLIPMAP_CONE_TRACING)
+	{
+		// The clipmap replaces the octree, it is voxelized and lit around the camera
+		updateClipmap(renderingScene);
+	}
+	else if (m_brickStreamer)
+	{
+		// The streamed octree has its irradiance baked, only the shadow map of the direct light is rendered
+		streamBricks(renderingScene);
+		for (unsigned int i = 0; i < renderingScene.directionalLights.size(); ++i)
+		{
+			shadowMap(renderingScene, renderingScene.directionalLights[i]);
+		}
 	}
-	if (injectLight)
+	else
 	{
-		lightUpdate(renderingScene, true);
+		if (buildSVO && !m_svoBakeLoaded)
+		{
+			// The validation, the fragment list visualization and the saved file need a complete build
+			sparseVoxelize(renderingScene, validateSVOQueued || (saveSVOQueued && !bakeSVOOnCPU) || renderingMode == RenderingMode::VOXELIZATION_VISUALIZATION);
+		}
+		if (validateSVOQueued)
+		{
+			validateSparseVoxelization(renderingScene);
+			validateSVOQueued = false;
+		}
+		if (benchmarkNodePoolQueued)
+		{
+			benchmarkNodePoolLayouts();
+			benchmarkNodePoolQueued = false;
+		}
+		if (benchmarkBorderTransferQueued)
+		{
+			benchmarkBorderTransfer();
+			benchmarkBorderTransferQueued = false;
+		}
+		if (injectLight)
+		{
+			lightUpdate(renderingScene, true);
+		}
+		if (saveSVOQueued)
+		{
+			if (bakeSVOOnCPU)
+			{
+				bakeSVO(renderingScene, svoFile);
+			}
+			else
+			{
+				saveSVO(renderingScene, svoFile);
+			}
+			saveSVOQueued = false;
+		}
 	}
 
 	// Render.
@@ -61,9 +126,17 @@ void Graphics::render(Scene & renderingScene, unsigned int viewportWidth, unsign
 		visualizeVoxel(renderingScene, viewportWidth, viewportHeight, m_ithVisualizeLevel);
 		break;
 	case RenderingMode::VOXEL_CONE_TRACING:
+		if (benchmarkIndirectLightQueued)
+		{
+			benchmarkIndirectLight(renderingScene, viewportWidth, viewportHeight);
+			benchmarkIndirectLightQueued = false;
+		}
 		//renderScene(renderingScene, viewportWidth, viewportHeight);
 		renderSceneWithSVO(renderingScene, viewportWidth, viewportHeight);
 		break;
+	case RenderingMode::CLIPMAP_CONE_TRACING:
+		renderSceneWithClipmap(renderingScene, viewportWidth, viewportHeight);
+		break;
 	}
 }
 
@@ -107,11 +180,31 @@ void Graphics::renderScene(Scene & renderingScene, unsigned int viewportWidth, u
 
 void Graphics::renderSceneWithSVO(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
 {
+	if (irradianceProbes)
+	{
+		updateProbes(renderingScene);
+	}
+
+	// The deferred path shades the closest surface of each pixel once, from the G-buffer. The indirect
+	// light pass reads it as well.
+	if (deferredShading)
+	{
+		renderGBuffer(renderingScene, viewportWidth, viewportHeight);
+	}
+	// The indirect light is traced at a reduced resolution or accumulated over frames first and upsampled by the composite pass
+	const bool downsampled = indirectLightDownsample > 1 || temporalIndirectLight;
+	if (downsampled)
+	{
+		traceIndirectLight(renderingScene, viewportWidth, viewportHeight, indirectLightDownsample);
+	}
+
 	// Fetch references.
 	MaterialStore& matStore = MaterialStore::getInstance();
-	const Material * material = matStore.findMaterialWithName("voxelConeTracing");
+	const char * materialNames[2][2] = {
+		{ "voxelConeTracing", "voxelConeTracingComposite" },
+		{ "voxelConeTracingDeferred", "voxelConeTracingCompositeDeferred" } };
+	const Material * material = matStore.findMaterialWithName(materialNames[deferredShading][downsampled]);
 
-	auto & camera = *renderingScene.renderingCamera;
 	const GLuint program = material->program;
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -131,35 +224,428 @@ void Graphics::renderSceneWithSVO(Scene & renderingScene, unsigned int viewportW
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	}
 
-	// Texture.
 	int textureUnitIdx = 0;
-	//voxelTexture->Activate(material->program, "texture3D", textureUnitIdx);
+	setupConeTracing(renderingScene, program, viewportWidth, viewportHeight, textureUnitIdx);
+	if (downsampled)
+	{
+		m_indirectLightBuffer->ActivateAsTexture(program, "indirectLight", textureUnitIdx, 0);
+		textureUnitIdx++;
+		m_indirectLightBuffer->ActivateAsTexture(program, "indirectGuide", textureUnitIdx, 1);
+		textureUnitIdx++;
+		m_indirectLightBuffer->ActivateAsTexture(program, "indirectSpecular", textureUnitIdx, 2);
+		textureUnitIdx++;
+		glUniform1i(glGetUniformLocation(program, "indirectDownsample"), indirectLightDownsample);
+	}
+
+	// Render.
+	if (deferredShading)
+	{
+		m_gBuffer->ActivateAsTexture(program, "gBufferPosition", textureUnitIdx, 0);
+		textureUnitIdx++;
+		m_gBuffer->ActivateAsTexture(program, "gBufferNormal", textureUnitIdx, 1);
+		textureUnitIdx++;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_materialTable->m_bufferID);
+		glDisable(GL_DEPTH_TEST);
+		quadMeshRenderer->render(program);
+	}
+	else
+	{
+		renderQueue(renderingScene.renderers, program, true);
+	}
+}
+
+void Graphics::renderGBuffer(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	if (!m_gBuffer || m_gBuffer->width != viewportWidth || m_gBuffer->height != viewportHeight)
+	{
+		// Attachment 0 is the world position and material ID, 1 the normal and view depth
+		m_gBuffer = std::shared_ptr<FBO>(new FBO(viewportWidth, viewportHeight, GL_NEAREST, GL_NEAREST, GL_RGBA32F, GL_FLOAT, GL_CLAMP_TO_EDGE, 2));
+	}
+	if (!m_materialTable)
+	{
+		m_materialTable = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_SHADER_STORAGE_BUFFER, 0, GL_DYNAMIC_DRAW, nullptr));
+	}
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("gBuffer");
+	const GLuint program = material->program;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer->frameBuffer);
+	glUseProgram(program);
+
+	// GL Settings. The normal and depth of the pixels without a surface stay 0.
+	{
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glViewport(0, 0, viewportWidth, viewportHeight);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glCullFace(GL_BACK);
+	}
+
+	uploadCamera(*renderingScene.renderingCamera, program);
+
+	// Renderers share material settings, each setting goes into the table once. The table is packed like
+	// PackedMaterial in voxelConeTracingFrag.shader.
+	const MaterialSetting defaultSetting;
+	std::vector<const MaterialSetting *> settings;
+	std::vector<glm::vec4> table;
+	for (MeshRenderer * renderer : renderingScene.renderers) if (renderer->enabled)
+	{
+		const MaterialSetting * setting = renderer->materialSetting ? renderer->materialSetting : &defaultSetting;
+		auto it = std::find(settings.begin(), settings.end(), setting);
+		const GLuint materialID = GLuint(it - settings.begin());
+		if (it == settings.end())
+		{
+			settings.push_back(setting);
+			table.push_back(glm::vec4(setting->diffuseColor, setting->diffuseReflectivity));
+			table.push_back(glm::vec4(setting->specularColor, setting->specularDiffusion));
+			table.push_back(glm::vec4(setting->specularReflectivity, setting->emissivity, setting->refractiveIndex, setting->transparency));
+		}
+		glUniform1ui(glGetUniformLocation(program, "materialID"), materialID);
+		renderer->transform.updateTransformMatrix();
+		renderer->render(program);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialTable->m_bufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, table.size() * sizeof(glm::vec4), table.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Graphics::traceIndirectLight(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight, int downsample)
+{
+	const GLuint width = std::max(1u, viewportWidth / downsample);
+	const GLuint height = std::max(1u, viewportHeight / downsample);
+	if (!m_indirectLightBuffer || m_indirectLightBuffer->width != width || m_indirectLightBuffer->height != height)
+	{
+		// Attachment 0 is the diffuse indirect light, 1 the normal and view depth which guide the upsampling and
+		// the reprojection, 2 the specular indirect light
+		m_indirectLightBuffer = std::shared_ptr<FBO>(new FBO(width, height, GL_NEAREST, GL_NEAREST, GL_RGBA32F, GL_FLOAT, GL_CLAMP_TO_EDGE, 3));
+		m_indirectLightHistory = std::shared_ptr<FBO>(new FBO(width, height, GL_NEAREST, GL_NEAREST, GL_RGBA32F, GL_FLOAT, GL_CLAMP_TO_EDGE, 3));
+		m_indirectHistoryValid = false;
+	}
+	if (temporalIndirectLight)
+	{
+		std::swap(m_indirectLightBuffer, m_indirectLightHistory);
+	}
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName(deferredShading ? "voxelConeTracingIndirectDeferred" : "voxelConeTracingIndirect");
+	const GLuint program = material->program;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_indirectLightBuffer->frameBuffer);
+	glUseProgram(program);
+
+	// GL Settings. The guide of the texels without a surface stays 0.
+	{
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glViewport(0, 0, width, height);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glCullFace(GL_BACK);
+	}
+
+	int textureUnitIdx = 0;
+	setupConeTracing(renderingScene, program, width, height, textureUnitIdx);
+
+	// Temporal accumulation. The history is rejected where it belongs to another surface, these pixels trace all cones.
+	auto & camera = *renderingScene.renderingCamera;
+	const bool useHistory = temporalIndirectLight && m_indirectHistoryValid;
+	m_indirectLightHistory->ActivateAsTexture(program, "historyLight", textureUnitIdx, 0);
+	textureUnitIdx++;
+	m_indirectLightHistory->ActivateAsTexture(program, "historyGuide", textureUnitIdx, 1);
+	textureUnitIdx++;
+	glm::mat4 previousVP = m_previousProjectionMatrix * m_previousViewMatrix;
+	glUniformMatrix4fv(glGetUniformLocation(program, "previousV"), 1, GL_FALSE, glm::value_ptr(m_previousViewMatrix));
+	glUniformMatrix4fv(glGetUniformLocation(program, "previousVP"), 1, GL_FALSE, glm::value_ptr(previousVP));
+	glUniform1i(glGetUniformLocation(program, "maxHistoryLength"), useHistory ? std::max(temporalHistoryLength, 1) : 0);
+	glUniform1i(glGetUniformLocation(program, "temporalCones"), temporalIndirectLight ? glm::clamp(temporalDiffuseCones, 1, 6) : 6);
+	glUniform1i(glGetUniformLocation(program, "temporalFrame"), m_temporalFrame % 6);
+	m_temporalFrame++;
+
+	// Render. The deferred pass traces once per texel, from the G-buffer pixel under its centre.
+	if (deferredShading)
+	{
+		m_gBuffer->ActivateAsTexture(program, "gBufferPosition", textureUnitIdx, 0);
+		textureUnitIdx++;
+		m_gBuffer->ActivateAsTexture(program, "gBufferNormal", textureUnitIdx, 1);
+		textureUnitIdx++;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_materialTable->m_bufferID);
+		glUniform1i(glGetUniformLocation(program, "indirectDownsample"), downsample);
+		glDisable(GL_DEPTH_TEST);
+		quadMeshRenderer->render(program);
+	}
+	else
+	{
+		renderQueue(renderingScene.renderers, program, true);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	m_indirectHistoryValid = temporalIndirectLight;
+	m_previousViewMatrix = camera.viewMatrix;
+	m_previousProjectionMatrix = camera.getProjectionMatrix();
+}
+
+// Binds the SVO and uploads the uniforms of the cone tracing passes, textureUnitIdx is the next free unit afterwards
+void Graphics::setupConeTracing(Scene & renderingScene, const GLuint program, unsigned int viewportWidth, unsigned int viewportHeight, int & textureUnitIdx)
+{
+	// Texture.
+	//voxelTexture->Activate(program, "texture3D", textureUnitIdx);
 	//glBindImageTexture(textureUnitIdx, voxelTexture->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
 	//textureUnitIdx++;
-	m_shadowMapBuffer->ActivateAsTexture(material->program, "smPosition", textureUnitIdx);
+	m_shadowMapBuffer->ActivateAsTexture(program, "smPosition", textureUnitIdx);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	m_brickPoolTextures[BRICK_POOL_COLOR]->Activate(material->program, "brickPool_color", textureUnitIdx);
+	// The cones step to the neighbours of the nodes they sampled last
+	std::string neighbourNames[6] = { "nodePool_X", "nodePool_X_neg", "nodePool_Y", "nodePool_Y_neg", "nodePool_Z", "nodePool_Z_neg" };
+	for (int i = 0; i < 6; i++, textureUnitIdx++)
+	{
+		bindNodePool(program, NODE_POOL_NEIGH_X + i, neighbourNames[i], textureUnitIdx, GL_READ_ONLY);
+	}
+	m_brickPoolTextures[BRICK_POOL_COLOR]->Activate(program, "brickPool_color", textureUnitIdx);
 	textureUnitIdx++;
-	m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->Activate(material->program, "brickPool_irradiance", textureUnitIdx);
+	m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->Activate(program, "brickPool_irradiance", textureUnitIdx);
+	textureUnitIdx++;
+	m_brickPoolTextures[BRICK_POOL_NORMAL]->Activate(program, "brickPool_normal", textureUnitIdx);
+	for (int i = BRICK_POOL_COLOR_X; i <= BRICK_POOL_COLOR_Z_NEG; i++)
+	{
+		textureUnitIdx++;
+		m_brickPoolTextures[i]->Activate(program, "brickPool_directional[" + std::to_string(i - BRICK_POOL_COLOR_X) + "]", textureUnitIdx);
+	}
 	textureUnitIdx++;
-	m_brickPoolTextures[BRICK_POOL_NORMAL]->Activate(material->program, "brickPool_normal", textureUnitIdx);
+	bindTopLevelIndex(program, textureUnitIdx);
 
 	// Upload uniforms.
 	glm::vec3 boxMin, boxMax;
 	renderingScene.getBoundingBox(boxMin, boxMax);
 	glm::vec3 voxelSize = (boxMax - boxMin) / float(m_nodePoolDim); 
-	glUniform3fv(glGetUniformLocation(material->program, "voxelSize"), 1, glm::value_ptr(voxelSize));
+	glUniform3fv(glGetUniformLocation(program, "voxelSize"), 1, glm::value_ptr(voxelSize));
 	glm::mat4 voxelGridTransformI = getVoxelTransformInverse(renderingScene);
-	glUniformMatrix4fv(glGetUniformLocation(material->program, "voxelGridTransformI"), 1, GL_FALSE, glm::value_ptr(voxelGridTransformI));
-	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels); 
-	glUniform1f(glGetUniformLocation(material->program, "directLightMultiplier"), directLightMultiplier);
-	glUniform1f(glGetUniformLocation(material->program, "indirectLightMultiplier"), indirectLightMultiplier);
+	glUniformMatrix4fv(glGetUniformLocation(program, "voxelGridTransformI"), 1, GL_FALSE, glm::value_ptr(voxelGridTransformI));
+	glUniform1ui(glGetUniformLocation(program, "numLevels"), m_numLevels); 
+	glUniform1i(glGetUniformLocation(program, "streamedBricks"), m_brickStreamer ? 1 : 0);
+	glUniform1i(glGetUniformLocation(program, "anisotropicVoxels"), anisotropicVoxels && !m_brickStreamer ? 1 : 0);
+	glUniform1i(glGetUniformLocation(program, "ambientCubeDiffuse"), ambientCubeDiffuse ? 1 : 0);
+	glUniform1f(glGetUniformLocation(program, "directLightMultiplier"), directLightMultiplier);
+	glUniform1f(glGetUniformLocation(program, "indirectLightMultiplier"), indirectLightMultiplier);
+
+	uploadCamera(*renderingScene.renderingCamera, program);
+	uploadGlobalConstants(program, viewportWidth, viewportHeight);
+	uploadLighting(renderingScene, program);
+	uploadRenderingSettings(program);
+	textureUnitIdx++;
+
+	// Irradiance probes
+	glUniform1i(glGetUniformLocation(program, "irradianceProbes"), irradianceProbes && m_probeGrid ? 1 : 0);
+	glUniform1ui(glGetUniformLocation(program, "probeLevel"), m_probeLevel);
+	if (m_probeGrid)
+	{
+		m_probeGrid->Activate(program, "probeGrid", textureUnitIdx);
+		textureUnitIdx++;
+	}
+}
+
+void Graphics::updateProbes(Scene & renderingScene)
+{
+	// The probes sit at the centres of the nodes of a level, the levels below the root
+	const int level = glm::clamp(probeGridLevel, 1, m_numLevels - 1);
+	const int res = 1 << level;
+	// A list holds at most the nodes of the level range
+	const GLuint listCapacity = m_levelAddress[level + 1] - m_levelAddress[level];
+	if (!m_probeGrid || m_probeLevel != level || !m_probeNodeCells)
+	{
+		// The 4 L1 SH coefficients of a probe are stacked along z
+		if (m_probeGrid)
+		{
+			glDeleteTextures(1, &m_probeGrid->textureID);
+		}
+		m_probeGrid = std::shared_ptr<Texture3D>(new Texture3D(res, res, 4 * res, false, GL_RGBA16F, GL_RGBA));
+		glClearTexImage(m_probeGrid->textureID, 0, GL_RGBA, GL_FLOAT, nullptr);
+		m_probeLevel = level;
+		m_nextProbe = 0;
+
+		m_probeNodeCells = std::shared_ptr<TextureBuffer>(new TextureBuffer(m_levelAddress[level] * 2 * sizeof(GLuint), nullptr, GL_RG32UI));
+		for (int i = 0; i < 2; i++)
+		{
+			m_probeCells[i] = std::shared_ptr<TextureBuffer>(new TextureBuffer(listCapacity * 2 * sizeof(GLuint), nullptr, GL_RG32UI));
+		}
+		glClearNamedBufferData(m_probeCellCounts->m_bufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		m_numProbeCells = 0;
+		m_probeCellCountPending = false;
+		m_probeCellsListed = false;
+	}
+
+	// The list of the last build was copied to m_probeCellCountReadback, a frame ago
+	if (m_probeCellCountPending)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_probeCellCountReadback->m_bufferID);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &m_numProbeCells);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		m_probeCellCountPending = false;
+	}
+	// The length of a list written now is not known yet, the pass skips the fragments past its end
+	GLuint numProbes = m_numProbeCells;
+	if (!m_probeCellsListed)
+	{
+		listProbeCells();
+		numProbes = listCapacity;
+	}
+	if (numProbes == 0)
+	{
+		return;
+	}
+
+	// One fragment per entry of the list, in rows of the voxelization framebuffer
+	const int numUpdates = (int)std::min((GLuint)glm::clamp(probesPerFrame, 1, m_nodePoolDim * m_nodePoolDim), numProbes);
+	const int width = std::min(numUpdates, m_nodePoolDim);
+	const int height = (numUpdates + width - 1) / width;
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("updateProbes");
+	const GLuint program = material->program;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_voxelizeFBO);
+	glUseProgram(program);
+
+	// GL Settings.
+	{
+		glViewport(0, 0, width, height);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+	}
+
+	int textureUnitIdx = 0;
+	setupConeTracing(renderingScene, program, width, height, textureUnitIdx);
+	// The node pool images take the image units of their texture units, from 1 on
+	glBindImageTexture(0, m_probeGrid->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glUniform1i(glGetUniformLocation(program, "probeGridImage"), 0);
+	m_probeCells[m_probeList]->Activate(program, "probeCells", textureUnitIdx);
+	textureUnitIdx++;
+	m_probeCellCounts->Activate(program, "probeCellCounts", textureUnitIdx);
+	textureUnitIdx++;
+	glUniform1i(glGetUniformLocation(program, "probeList"), m_probeList);
+	glUniform1i(glGetUniformLocation(program, "firstProbe"), m_nextProbe);
+	glUniform1i(glGetUniformLocation(program, "probeViewportWidth"), width);
+
+	// Render.
+	quadMeshRenderer->render(program);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	m_nextProbe = (int)((m_nextProbe + width * height) % numProbes);
+}
+
+void Graphics::listProbeCells()
+{
+	// The nodes of the probe level are the probes traced round robin. Their cells are passed down from
+	// the root, one pass per level, and the children of the level above the probe level are listed.
+	const int level = m_probeLevel;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	// The probes of cells that lost their node would keep their light, the current list is checked first
+	if (m_numProbeCells > 0)
+	{
+		const Material * material = MaterialStore::getInstance().findMaterialWithName("clearStaleProbes");
+		glUseProgram(material->program);
+
+		int textureUnitIdx = 0;
+		bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
+		textureUnitIdx++;
+		m_probeCells[m_probeList]->Activate(material->program, "probeCells", textureUnitIdx);
+		textureUnitIdx++;
+		glBindImageTexture(textureUnitIdx, m_probeGrid->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glUniform1i(glGetUniformLocation(material->program, "probeGridImage"), textureUnitIdx);
+		glUniform1ui(glGetUniformLocation(material->program, "probeLevel"), level);
+
+		glDrawArrays(GL_POINTS, 0, m_numProbeCells);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	m_probeList = 1 - m_probeList;
+	m_numProbeCells = 0;
+	GLuint noCell[2] = { 0xFFFFFFFF, 0xFFFFFFFF };
+	glClearNamedBufferData(m_probeNodeCells->m_bufferID, GL_RG32UI, GL_RG_INTEGER, GL_UNSIGNED_INT, noCell);
+	glClearNamedBufferSubData(m_probeCellCounts->m_bufferID, GL_R32UI, m_probeList * sizeof(GLuint), sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("listProbeCells");
+	glUseProgram(material->program);
+
+	int textureUnitIdx = 0;
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
+	textureUnitIdx++;
+	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	textureUnitIdx++;
+	m_probeNodeCells->Activate(material->program, "nodeCells", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_probeNodeCells->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RG32UI);
+	textureUnitIdx++;
+	m_probeCells[m_probeList]->Activate(material->program, "probeCells", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_probeCells[m_probeList]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32UI);
+	textureUnitIdx++;
+	m_probeCellCounts->Activate(material->program, "probeCellCounts", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_probeCellCounts->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	glUniform1ui(glGetUniformLocation(material->program, "probeLevel"), level);
+	glUniform1i(glGetUniformLocation(material->program, "probeList"), m_probeList);
+
+	// One thread per node of the level, like the passes of drawLevelThreads over complete levels
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_levelNodesCmdBuf->m_bufferID);
+	for (int i = 0; i < level; i++)
+	{
+		glUniform1ui(glGetUniformLocation(material->program, "level"), i);
+		glDrawArraysIndirect(GL_POINTS, (const void*)(i * sizeof(IndirectDrawCommand)));
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	// Read by updateProbes a frame later, without waiting for the GPU now
+	glCopyNamedBufferSubData(m_probeCellCounts->m_bufferID, m_probeCellCountReadback->m_bufferID, m_probeList * sizeof(GLuint), 0, sizeof(GLuint));
+	m_probeCellCountPending = true;
+	m_probeCellsListed = true;
+}
+
+void Graphics::renderSceneWithClipmap(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	// Fetch references.
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName("clipmapConeTracing");
+
+	auto & camera = *renderingScene.renderingCamera;
+	const GLuint program = material->program;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glUseProgram(program);
+
+	// GL Settings.
+	{
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glViewport(0, 0, viewportWidth, viewportHeight);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glCullFace(GL_BACK);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+
+	// Texture.
+	int textureUnitIdx = 0;
+	m_shadowMapBuffer->ActivateAsTexture(program, "smPosition", textureUnitIdx);
+	textureUnitIdx++;
+	bindClipmap(program, textureUnitIdx, false);
+
+	// Upload uniforms.
+	glUniform1f(glGetUniformLocation(program, "directLightMultiplier"), directLightMultiplier);
+	glUniform1f(glGetUniformLocation(program, "indirectLightMultiplier"), indirectLightMultiplier);
 
 	uploadCamera(camera, program);
 	uploadGlobalConstants(program, viewportWidth, viewportHeight);
@@ -167,7 +653,7 @@ void Graphics::renderSceneWithSVO(Scene & renderingScene, unsigned int viewportW
 	uploadRenderingSettings(program);
 
 	// Render.
-	renderQueue(renderingScene.renderers, material->program, true);
+	renderQueue(renderingScene.renderers, program, true);
 }
 
 void Graphics::uploadLighting(Scene & renderingScene, const GLuint program) const
@@ -237,61 +723,136 @@ void Graphics::initVoxelization()
 void Graphics::initSparseVoxelization() {
 
   // Initialize node pool
+	// The fragment positions (XYZ16) and MAX_NODE_POOL_LEVELS hold grids up to 4096 voxels along an edge.
+	// The fragment textures are dense, the 3D texture size limit and svoFragmentBudgetMB apply to them.
+	GLint max3DTextureSize = 0;
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3DTextureSize);
+	GLint maxTexBufferSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexBufferSize);
+	// Two R32UI fragment textures and the RG32UI fragment list, which holds at most every voxel
+	auto fragmentBytes = [maxTexBufferSize](int dim) {
+		size_t voxels = (size_t)dim * dim * dim;
+		return 2 * sizeof(GLuint) * voxels + 2 * sizeof(GLuint) * std::min(voxels, (size_t)maxTexBufferSize);
+	};
+	// A streamed octree has the resolution it was baked with
+	std::shared_ptr<SvoFile> streamedFile;
+	if (streamSVO)
+	{
+		streamedFile = std::make_shared<SvoFile>();
+		if (streamedFile->open(svoFile))
+		{
+			svoResolution = (int)streamedFile->getInfo().nodePoolDim;
+		}
+		else
+		{
+			std::cout << "Cannot stream the SVO of " << svoFile << ", it is built instead." << std::endl;
+			streamedFile = nullptr;
+		}
+	}
 	m_nodePoolDim = 256;
+	while (m_nodePoolDim * 2 <= std::min(svoResolution, 4096) && m_nodePoolDim * 2 <= max3DTextureSize
+		&& fragmentBytes(m_nodePoolDim * 2) <= ((size_t)svoFragmentBudgetMB << 20))
+	{
+		m_nodePoolDim *= 2;
+	}
+	if (m_nodePoolDim * 2 <= std::min(svoResolution, 4096) && m_nodePoolDim * 2 <= max3DTextureSize)
+	{
+		std::cout << "SVO resolution " << svoResolution << " needs " << (fragmentBytes(m_nodePoolDim * 2) >> 20) << " MB of fragment textures for "
+			<< m_nodePoolDim * 2 << ", more than the budget of " << svoFragmentBudgetMB << " MB, using " << m_nodePoolDim << "." << std::endl;
+	}
+	else if (m_nodePoolDim != svoResolution)
+	{
+		std::cout << "SVO resolution " << svoResolution << " is not supported, using " << m_nodePoolDim << "." << std::endl;
+	}
 	m_numLevels = (int)log2f(m_nodePoolDim);
 	m_ithVisualizeLevel = m_numLevels - 1;
-  int levelVoxels = m_nodePoolDim * m_nodePoolDim * m_nodePoolDim;
-  int nLevels = 0;
-  int totalVoxels = 0;
-  while (levelVoxels)
+  // The levels start with a share of the tiles of a dense octree, small levels are kept dense.
+  // Below level 6 the tiles of surfaces grow by about 4 per level rather than 8.
+  // The leaf level hands out no tiles.
+  for (int i = 0; i < MAX_NODE_POOL_LEVELS; i++)
   {
-    totalVoxels += levelVoxels;
-    levelVoxels /= 8;
-    nLevels++;
+    GLuint denseTiles = i < m_numLevels - 1 ? 1U << (3 * i) : 0U;
+    GLuint surfaceTiles = i < m_numLevels - 1 ? 64U << (2 * i) : 0U;
+    GLuint estimate = (GLuint)std::ceil(svoNodePoolOccupancy * std::min(denseTiles, surfaceTiles));
+    m_levelTileCapacity[i] = std::min(denseTiles, std::max(estimate, 4096U));
   }
-  m_maxNodes = totalVoxels;
-  for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+  if (streamedFile && m_nodePoolDim == svoResolution)
   {
-    m_nodePoolTextures[i] = std::shared_ptr<TextureBuffer>(new TextureBuffer(totalVoxels * sizeof(int)));
+    std::copy(streamedFile->getInfo().levelTileCapacity, streamedFile->getInfo().levelTileCapacity + MAX_NODE_POOL_LEVELS, m_levelTileCapacity);
+  }
+  // Records are written through a storage buffer, the passes after a node pass need its barrier as well
+  if (nodePoolLayout == NODE_POOL_RECORDS)
+  {
+    m_nodePoolBarrierBits = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT;
+  }
+  resizeNodePool();
+
+  // The top level index has a mip per level, the finest for m_topLevelIndexLevel. It stops above the leaf level.
+  m_topLevelIndexLevel = glm::clamp(svoTopLevelIndexLevel, 0, m_numLevels - 2);
+  if (m_topLevelIndexLevel != svoTopLevelIndexLevel)
+  {
+	  std::cout << "SVO top level index of level " << svoTopLevelIndexLevel << " is not supported, using " << m_topLevelIndexLevel << "." << std::endl;
+  }
+  if (m_topLevelIndexLevel > 0)
+  {
+	  int indexDim = 1 << m_topLevelIndexLevel;
+	  m_topLevelIndex = std::shared_ptr<Texture3D>(new Texture3D(indexDim, indexDim, indexDim, false, GL_RG32UI, GL_RG_INTEGER));
+	  glBindTexture(GL_TEXTURE_3D, m_topLevelIndex->textureID);
+	  for (int mip = 1; mip < m_topLevelIndexLevel; mip++)
+	  {
+		  glTexImage3D(GL_TEXTURE_3D, mip, GL_RG32UI, indexDim >> mip, indexDim >> mip, indexDim >> mip, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+	  }
+	  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, m_topLevelIndexLevel - 1);
+	  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	  glBindTexture(GL_TEXTURE_3D, 0);
+  }
+
+  // Initialize brick pool
+  m_brickPoolDim = 3 * glm::clamp(svoBrickPoolBricks, 2, std::min(1024, max3DTextureSize) / 3);
+  if (m_brickPoolDim != 3 * svoBrickPoolBricks)
+  {
+	  std::cout << "Brick pool of " << svoBrickPoolBricks << " bricks per edge is not supported, using " << m_brickPoolDim / 3 << "." << std::endl;
+  }
+  m_brickPoolTextures[BRICK_POOL_COLOR] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
+  m_brickPoolTextures[BRICK_POOL_NORMAL] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
+  m_brickPoolTextures[BRICK_POOL_IRRADIANCE] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
+  // The directional pools use the brick addresses of the isotropic pools, so they have the same size
+  for (int i = BRICK_POOL_COLOR_X; i <= BRICK_POOL_COLOR_Z_NEG; i++)
+  {
+	  m_brickPoolTextures[i] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
+  }
+  if (streamedFile && !loadStreamedSVO(streamedFile))
+  {
+	  std::cout << "Cannot stream the SVO of " << svoFile << ", it is built instead." << std::endl;
   }
-  std::vector<int> initialValues;
-  initialValues.resize(MAX_NODE_POOL_LEVELS, 0x3FFFFFFF);
-  initialValues[0] = 0;
-  initialValues[1] = 1;
-  m_levelAddressBuffer = std::shared_ptr<TextureBuffer>(new TextureBuffer(MAX_NODE_POOL_LEVELS * sizeof(int), (char*)&initialValues[0]));
-
-  // Initialize brick pool
-  m_brickPoolDim = 70 * 3;
-  m_brickPoolTextures[BRICK_POOL_COLOR] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_NORMAL] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_IRRADIANCE] = std::shared_ptr<Texture3D>(new Texture3D( m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA));
-  int brickPoolHalfDim = m_brickPoolDim / 2;
-  m_brickPoolTextures[BRICK_POOL_COLOR_X] = std::shared_ptr<Texture3D>(new Texture3D( brickPoolHalfDim, brickPoolHalfDim, brickPoolHalfDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_COLOR_Y] = std::shared_ptr<Texture3D>(new Texture3D( brickPoolHalfDim, brickPoolHalfDim, brickPoolHalfDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_COLOR_Z] = std::shared_ptr<Texture3D>(new Texture3D( brickPoolHalfDim, brickPoolHalfDim, brickPoolHalfDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_COLOR_X_NEG] = std::shared_ptr<Texture3D>(new Texture3D( brickPoolHalfDim, brickPoolHalfDim, brickPoolHalfDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_COLOR_Y_NEG] = std::shared_ptr<Texture3D>(new Texture3D( brickPoolHalfDim, brickPoolHalfDim, brickPoolHalfDim, false, GL_RGBA8, GL_RGBA));
-  m_brickPoolTextures[BRICK_POOL_COLOR_Z_NEG] = std::shared_ptr<Texture3D>(new Texture3D( brickPoolHalfDim, brickPoolHalfDim, brickPoolHalfDim, false, GL_RGBA8, GL_RGBA));
 
   // Initialize fragment texture
   m_fragmentTextures[FRAG_TEX_COLOR] = std::shared_ptr<Texture3D>(new  Texture3D(m_nodePoolDim, m_nodePoolDim, m_nodePoolDim, false, GL_R32UI, GL_RED_INTEGER));
   m_fragmentTextures[FRAG_TEX_NORMAL] = std::shared_ptr<Texture3D>(new  Texture3D(m_nodePoolDim, m_nodePoolDim, m_nodePoolDim, false, GL_R32UI, GL_RED_INTEGER));
 
-  // Initialize fragment list
-  int fragmentListSize = m_nodePoolDim * m_nodePoolDim * m_nodePoolDim * 2 * sizeof(int);
-  GLint maxTexBufferSize = 0;
-  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexBufferSize);
-  if (maxTexBufferSize < fragmentListSize)
-  {
-	  fragmentListSize = maxTexBufferSize;
-  }
-  m_fragmentList = std::shared_ptr<TextureBuffer>(new TextureBuffer(fragmentListSize));
+  // Voxelization draws into a framebuffer of the grid size, without attachments
+  glCreateFramebuffers(1, &m_voxelizeFBO);
+  glNamedFramebufferParameteri(m_voxelizeFBO, GL_FRAMEBUFFER_DEFAULT_WIDTH, m_nodePoolDim);
+  glNamedFramebufferParameteri(m_voxelizeFBO, GL_FRAMEBUFFER_DEFAULT_HEIGHT, m_nodePoolDim);
+
+  // Initialize fragment list, every voxel is listed once with its XYZ16 position
+  size_t fragmentListEntries = std::min((size_t)m_nodePoolDim * m_nodePoolDim * m_nodePoolDim, (size_t)maxTexBufferSize);
+  m_fragmentList = std::shared_ptr<TextureBuffer>(new TextureBuffer(fragmentListEntries * 2 * sizeof(GLuint), nullptr, GL_RG32UI));
 
   // Initialize atomic counter
   int counterVal = 0;
-  m_nextFreeNode = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_ATOMIC_COUNTER_BUFFER, sizeof(counterVal), GL_STATIC_DRAW, &counterVal));
+  std::vector<GLuint> levelCounterVals(MAX_NODE_POOL_LEVELS, 0);
+  m_nextFreeNode = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(GLuint) * MAX_NODE_POOL_LEVELS, (char*)&levelCounterVals[0]));
   m_nextFreeBrick = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_ATOMIC_COUNTER_BUFFER, sizeof(counterVal), GL_STATIC_DRAW, &counterVal));
   m_fragmentListCounter = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_ATOMIC_COUNTER_BUFFER, sizeof(counterVal), GL_STATIC_DRAW, &counterVal));
+  m_tileCountReadback = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * MAX_NODE_POOL_LEVELS, GL_STREAM_READ, nullptr));
+  m_probeCellCounts = std::shared_ptr<TextureBuffer>(new TextureBuffer(2 * sizeof(GLuint)));
+  m_probeCellCountReadback = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_COPY_WRITE_BUFFER, sizeof(GLuint), GL_STREAM_READ, nullptr));
+  m_brickCountReadback = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_COPY_WRITE_BUFFER, sizeof(GLuint), GL_STREAM_READ, nullptr));
+  size_t numBricks = (size_t)(m_brickPoolDim / 3) * (m_brickPoolDim / 3) * (m_brickPoolDim / 3);
+  m_freeBricks = std::shared_ptr<TextureBuffer>(new TextureBuffer((numBricks + 1) * sizeof(GLuint)));
+  glClearNamedBufferData(m_freeBricks->m_bufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
 
   // Init light node map
   m_shadowMapRes = 512;
@@ -325,38 +886,32 @@ void Graphics::initSparseVoxelization() {
   indirectCommand.baseInstanceIdx = 0;
   indirectCommand.firstVertexIdx = 0;
   indirectCommand.numPrimitives = 1;
-  indirectCommand.numVertices = totalVoxels;
-  m_nodePoolCmdBuf = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
   indirectCommand.numVertices = m_brickPoolDim * m_brickPoolDim * m_brickPoolDim;
   m_brickPoolCmdBuf = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
-  indirectCommand.numVertices = m_nodePoolDim * m_nodePoolDim * m_nodePoolDim;
-  m_fragmentTexCmdBuf = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
   indirectCommand.numVertices = 1;
   m_modifyIndirectBufferCmdBuf = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
   m_fragmentListCmdBuf = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(indirectCommand), (char*)&indirectCommand));
-  m_nodePoolNodesCmdBuf = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(indirectCommand), (char*)&indirectCommand));
-  int numVoxelsUpToLevel = 0;
+  GLuint64 numVoxelsUpToLevel = 0;
   for (int iLevel = 0; iLevel < MAX_NODE_POOL_LEVELS; ++iLevel)
   {
-	  int numVoxelsOnLevel = pow(8U, iLevel);
+	  GLuint64 numVoxelsOnLevel = (GLuint64)1 << (3 * iLevel);
 	  numVoxelsUpToLevel += numVoxelsOnLevel;
-	  indirectCommand.numVertices = numVoxelsUpToLevel;
+	  indirectCommand.numVertices = (uint32_t)std::min<GLuint64>(numVoxelsUpToLevel, 0xFFFFFFFF);
 	  m_nodePoolUpToLevelCmdBuf[iLevel] = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
-	  indirectCommand.numVertices = numVoxelsOnLevel;
-	  m_nodePoolOnLevelCmdBuf[iLevel] = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
   }
-  for (int iLevel = 0; iLevel < m_nNodeMapLevels; ++iLevel)
-  {
-	  int res = m_nodeMapSizes[iLevel].x;
-	  indirectCommand.numVertices = res * res;
-	  m_nodeMapOnLevelCmdBuf[iLevel] = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
-  }
-  indirectCommand.numVertices = (m_shadowMapRes + m_shadowMapRes / 2)* m_shadowMapRes;
-  m_lightNodeMapCmdBuf = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
+  // Written by updateLevelCommands once the nodes of a level are allocated
+  std::vector<IndirectDrawCommand> levelCommands(MAX_NODE_POOL_LEVELS, { 0, 1, 0, 0 });
+  m_levelNodesCmdBuf = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(IndirectDrawCommand) * MAX_NODE_POOL_LEVELS, (char*)&levelCommands[0]));
+  // Written by writeLightCommands from the nodes the light injection listed
+  m_lightNodesCmdBuf = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(IndirectDrawCommand) * MAX_NODE_POOL_LEVELS, (char*)&levelCommands[0]));
+  m_litNodeCounts = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(GLuint) * MAX_NODE_POOL_LEVELS));
 
   // Add shaders
   auto& store = MaterialStore::getInstance();
   MaterialStore::ShaderInfo vertInfo, geomInfo, fragInfo;
+  Shader::setGlobalDefines("#define NODE_POOL_DEFAULT_LAYOUT " + std::to_string((int)nodePoolLayout) + "\n"
+                           "#define MAX_NODE_POOL_LEVELS " + std::to_string(MAX_NODE_POOL_LEVELS) + "\n"
+                           "#define MAX_DIRECTIONAL_LIGHTS " + std::to_string(MAX_DIRECTIONAL_LIGHTS) + "\n");
   store.AddNewMaterial("clearNodePool", "SparseVoxelOctree\\clearNodePoolVert.shader");
   store.AddNewMaterial("clearNodePoolNeigh", "SparseVoxelOctree\\clearNodePoolNeighVert.shader");
   store.AddNewMaterial("clearBrickPool", "SparseVoxelOctree\\clearBrickPoolVert.shader");
@@ -369,41 +924,113 @@ void Graphics::initSparseVoxelization() {
   store.AddNewMaterial("allocateNode", "SparseVoxelOctree\\allocateNodeVert.shader");
   store.AddNewMaterial("findNeighbours", "SparseVoxelOctree\\findNeighbours.shader");
   store.AddNewMaterial("allocateBrick", "SparseVoxelOctree\\allocBricks.shader");
+  store.AddNewMaterial("writeLevelCommands", "SparseVoxelOctree\\writeLevelCommandsVert.shader");
+  store.AddNewMaterial("writeTopLevelIndex", "SparseVoxelOctree\\writeTopLevelIndexVert.shader");
   store.AddNewMaterial("writeLeafs", "SparseVoxelOctree\\WriteLeafs.shader");
 
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\SpreadLeafBricks.shader", "#version 420 core\n#define THREAD_MODE 0\n");
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\SpreadLeafBricks.shader", "#version 430 core\n#define THREAD_MODE 0\n");
   store.AddNewMaterial("spreadLeaf", &vertInfo);
   vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\BorderTransfer.shader", "#version 430 core\n#define THREAD_MODE 0\n");
   store.AddNewMaterial("borderTransfer", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapCenter.shader", "#version 430 core\n#define THREAD_MODE 0\n");
-  store.AddNewMaterial("mipmapCenter", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapFaces.shader", "#version 430 core\n#define THREAD_MODE 0\n");
-  store.AddNewMaterial("mipmapFaces", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapCorners.shader", "#version 430 core\n#define THREAD_MODE 0\n");
-  store.AddNewMaterial("mipmapCorners", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapEdges.shader", "#version 430 core\n#define THREAD_MODE 0\n");
-  store.AddNewMaterial("mipmapEdges", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\BorderTransferBricks.shader", "#version 430 core\n#define THREAD_MODE 0\n");
+  store.AddNewMaterial("borderTransferBricks", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapBricks.shader", "#version 430 core\n#define THREAD_MODE 0\n");
+  store.AddNewMaterial("mipmapBricks", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapAnisotropic.shader", "#version 430 core\n#define THREAD_MODE 0\n");
+  store.AddNewMaterial("mipmapAnisotropic", &vertInfo);
+
+  // incremental update shaders
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\SpreadLeafBricks.shader", "#version 430 core\n#define THREAD_MODE 2\n");
+  store.AddNewMaterial("spreadLeafRegion", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\BorderTransfer.shader", "#version 430 core\n#define THREAD_MODE 2\n");
+  store.AddNewMaterial("borderTransferRegion", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\BorderTransferBricks.shader", "#version 430 core\n#define THREAD_MODE 2\n");
+  store.AddNewMaterial("borderTransferBricksRegion", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapBricks.shader", "#version 430 core\n#define THREAD_MODE 2\n");
+  store.AddNewMaterial("mipmapBricksRegion", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapAnisotropic.shader", "#version 430 core\n#define THREAD_MODE 2\n");
+  store.AddNewMaterial("mipmapAnisotropicRegion", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\clearLeafVoxelsVert.shader", "#version 430 core\n#define CLEAR_MODE 0\n");
+  store.AddNewMaterial("clearLeafVoxels", &vertInfo);
+
+  // static / dynamic split shaders
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\clearLeafVoxelsVert.shader", "#version 430 core\n#define CLEAR_MODE 1\n");
+  store.AddNewMaterial("clearLeafVoxelsFragments", &vertInfo);
+  store.AddNewMaterial("tagStaticNodes", "SparseVoxelOctree\\tagStaticNodesVert.shader");
+  store.AddNewMaterial("clearDynamicNodes", "SparseVoxelOctree\\clearDynamicNodesVert.shader");
+  store.AddNewMaterial("copyStaticFragments", "SparseVoxelOctree\\copyStaticFragmentsVert.shader");
+
+  // bottom-up node build shaders
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\buildNodesMortonVert.shader", "#version 430 core\n#define BUILD_PASS 0\n");
+  store.AddNewMaterial("flagCellsMorton", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\buildNodesMortonVert.shader", "#version 430 core\n#define BUILD_PASS 1\n");
+  store.AddNewMaterial("writeNodesMorton", &vertInfo);
+
+  // node pool layout benchmark
+  store.AddNewMaterial("copyNodePool", "SparseVoxelOctree\\copyNodePoolVert.shader");
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\benchmarkTraversalVert.shader", "#version 430 core\n#define NODE_POOL_LAYOUT 0\n");
+  store.AddNewMaterial("benchmarkTraversalTextures", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\benchmarkTraversalVert.shader", "#version 430 core\n#define NODE_POOL_LAYOUT 1\n");
+  store.AddNewMaterial("benchmarkTraversalRecords", &vertInfo);
+
+  // streamed octree shaders
+  store.AddNewMaterial("streamNodeColors", "SparseVoxelOctree\\streamNodeColorsVert.shader");
 
   // light shaders
-  store.AddNewMaterial("clearNodeMap", "SparseVoxelOctree\\ClearNodeMap.shader");
   store.AddNewMaterial("lightInjection", "SparseVoxelOctree\\LightInjection.shader");
   store.AddNewMaterial("shadowMap", "SparseVoxelOctree\\ShadowMapVert.shader", "SparseVoxelOctree\\ShadowMapFrag.shader");
-
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\SpreadLeafBricks.shader", "#version 420 core\n#define THREAD_MODE 1\n");
+  store.AddNewMaterial("shadowMapLayered", "SparseVoxelOctree\\ShadowMapVert.shader", "SparseVoxelOctree\\ShadowMapLayeredFrag.shader", "SparseVoxelOctree\\ShadowMapLayeredGeom.shader");
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\ResolveLightInjection.shader", "#version 430 core\n#define THREAD_MODE 0\n");
+  store.AddNewMaterial("resolveLightInjection", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\ResolveLightInjection.shader", "#version 430 core\n#define THREAD_MODE 2\n");
+  store.AddNewMaterial("resolveLightInjectionRegion", &vertInfo);
+
+  store.AddNewMaterial("writeLightCommands", "SparseVoxelOctree\\writeLightCommandsVert.shader");
+
+  // lit node shaders, the passes of lightUpdate with filterLitNodes
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\ResolveLightInjection.shader", "#version 430 core\n#define THREAD_MODE 1\n");
+  store.AddNewMaterial("resolveLightInjectionLight", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\ClearLitBricks.shader", "#version 430 core\n#define THREAD_MODE 1\n");
+  store.AddNewMaterial("clearLitBricksLight", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\SpreadLeafBricks.shader", "#version 430 core\n#define THREAD_MODE 1\n");
   store.AddNewMaterial("spreadLeafLight", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\BorderTransfer.shader", "#version 430 core\n#define THREAD_MODE 1\n");
-  store.AddNewMaterial("borderTransferLight", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapCenter.shader", "#version 430 core\n#define THREAD_MODE 1\n");
-  store.AddNewMaterial("mipmapCenterLight", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapFaces.shader", "#version 430 core\n#define THREAD_MODE 1\n");
-  store.AddNewMaterial("mipmapFacesLight", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapCorners.shader", "#version 430 core\n#define THREAD_MODE 1\n");
-  store.AddNewMaterial("mipmapCornersLight", &vertInfo);
-  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapEdges.shader", "#version 430 core\n#define THREAD_MODE 1\n");
-  store.AddNewMaterial("mipmapEdgesLight", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\BorderTransferBricks.shader", "#version 430 core\n#define THREAD_MODE 1\n");
+  store.AddNewMaterial("borderTransferBricksLight", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapBricks.shader", "#version 430 core\n#define THREAD_MODE 1\n");
+  store.AddNewMaterial("mipmapBricksLight", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\MipmapAnisotropic.shader", "#version 430 core\n#define THREAD_MODE 1\n");
+  store.AddNewMaterial("mipmapAnisotropicLight", &vertInfo);
 
   // cone tracing shaders
-  store.AddNewMaterial("voxelConeTracing", "Voxel Cone Tracing\\voxel_cone_tracing.vert", "SparseVoxelOctree\\voxelConeTracingFrag.shader");
+  // CONE_TRACING_PASS: 0 all light, 1 indirect light into a reduced resolution target, 2 direct light and the upsampled indirect light
+  vertInfo = MaterialStore::ShaderInfo("Voxel Cone Tracing\\voxel_cone_tracing.vert", "");
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 0\n");
+  store.AddNewMaterial("voxelConeTracing", &vertInfo, &fragInfo);
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 1\n");
+  store.AddNewMaterial("voxelConeTracingIndirect", &vertInfo, &fragInfo);
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 2\n");
+  store.AddNewMaterial("voxelConeTracingComposite", &vertInfo, &fragInfo);
+  // deferred: the passes 0, 1 and 2 shade a screen quad from the G-buffer
+  store.AddNewMaterial("gBuffer", "Voxel Cone Tracing\\voxel_cone_tracing.vert", "SparseVoxelOctree\\gBufferFrag.shader");
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\screenQuadVert.shader", "");
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 0\n#define DEFERRED 1\n");
+  store.AddNewMaterial("voxelConeTracingDeferred", &vertInfo, &fragInfo);
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 2\n#define DEFERRED 1\n");
+  store.AddNewMaterial("voxelConeTracingCompositeDeferred", &vertInfo, &fragInfo);
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 1\n#define DEFERRED 1\n");
+  store.AddNewMaterial("voxelConeTracingIndirectDeferred", &vertInfo, &fragInfo);
+  // irradiance probes: one fragment of the screen quad per probe
+  fragInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\voxelConeTracingFrag.shader", "#version 450 core\n#define CONE_TRACING_PASS 3\n");
+  store.AddNewMaterial("updateProbes", &vertInfo, &fragInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\listProbeCellsVert.shader", "#version 430 core\n#define PROBE_PASS 0\n");
+  store.AddNewMaterial("listProbeCells", &vertInfo);
+  vertInfo = MaterialStore::ShaderInfo("SparseVoxelOctree\\listProbeCellsVert.shader", "#version 430 core\n#define PROBE_PASS 1\n");
+  store.AddNewMaterial("clearStaleProbes", &vertInfo);
+
+  // voxel clipmap shaders
+  store.AddNewMaterial("clipmapVoxelize", "SparseVoxelOctree\\VoxelizeVert.shader", "Clipmap\\clipmapVoxelizeFrag.shader", "Clipmap\\clipmapVoxelizeGeom.shader");
+  store.AddNewMaterial("clipmapLightInjection", "Clipmap\\ClipmapLightInjection.shader");
+  store.AddNewMaterial("clipmapConeTracing", "Voxel Cone Tracing\\voxel_cone_tracing.vert", "Clipmap\\clipmapConeTracingFrag.shader");
 }
 
 glm::mat4 Graphics::getVoxelTransformInverse(Scene & renderingScene)
@@ -432,156 +1059,1162 @@ glm::mat4 Graphics::getVoxelTransform(Scene & renderingScene)
 	return voxelTransform;
 }
 
+void Graphics::resizeNodePool()
+{
+	// The children of the tiles of level L are the nodes of level L + 1, the tile ranges give the node ranges
+	GLuint levelFirstTile = 0;
+	m_levelAddress[0] = 0;
+	for (int i = 1; i < MAX_NODE_POOL_LEVELS; i++)
+	{
+		m_levelAddress[i] = 1 + 8 * levelFirstTile;
+		levelFirstTile += m_levelTileCapacity[i - 1];
+	}
+	m_maxNodes = m_levelAddress[m_numLevels];
+
+	// The Morton build keeps the siblings of the occupied cells of a level in a slot of a hash table.
+	// The parents of the occupied cells are occupied, a level has at most as many slots in use as the
+	// level above has tiles: twice as many slots keep the probe sequences short.
+	m_mortonCellTableWords = 0;
+	for (int i = 0; i < MAX_NODE_POOL_LEVELS; i++)
+	{
+		m_mortonTableOffset[i] = (GLuint)(m_mortonCellTableWords / MORTON_SLOT_WORDS);
+		m_mortonTableSlots[i] = i == 0 ? 1U : (GLuint)std::min((GLuint64)2 * m_levelTileCapacity[i - 1], (GLuint64)1 << (3 * (i - 1)));
+		m_mortonCellTableWords += i < m_numLevels ? (GLuint64)m_mortonTableSlots[i] * MORTON_SLOT_WORDS : 0;
+	}
+	m_mortonCellTable = nullptr;
+	m_probeNodeCells = nullptr; // sized by the level ranges, updateProbes starts over
+	GLint maxTexBufferSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexBufferSize);
+	m_mortonCellTableFits = m_mortonCellTableWords <= (GLuint64)maxTexBufferSize;
+	if (!m_mortonCellTableFits && mortonSVOBuild)
+	{
+		std::cout << "The Morton SVO build needs " << m_mortonCellTableWords << " cell table entries, the octree is built level by level." << std::endl;
+	}
+
+	if (nodePoolLayout == NODE_POOL_RECORDS)
+	{
+		m_nodePoolRecords = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_SHADER_STORAGE_BUFFER, (size_t)m_maxNodes * NODE_POOL_NUM_TEXTURES * sizeof(GLuint), GL_DYNAMIC_COPY, nullptr));
+	}
+	else
+	{
+		for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+		{
+			m_nodePoolTextures[i] = std::shared_ptr<TextureBuffer>(new TextureBuffer(m_maxNodes * sizeof(int)));
+		}
+	}
+	m_levelAddressBuffer = std::shared_ptr<TextureBuffer>(new TextureBuffer(MAX_NODE_POOL_LEVELS * sizeof(int), (char*)&m_levelAddress[0]));
+	m_litNodeFlags = std::shared_ptr<TextureBuffer>(new TextureBuffer((m_maxNodes + 31) / 32 * sizeof(GLuint)));
+
+	IndirectDrawCommand indirectCommand;
+	indirectCommand.baseInstanceIdx = 0;
+	indirectCommand.firstVertexIdx = 0;
+	indirectCommand.numPrimitives = 1;
+	indirectCommand.numVertices = m_maxNodes;
+	m_nodePoolCmdBuf = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_DRAW_INDIRECT_BUFFER, sizeof(indirectCommand), GL_STATIC_DRAW, &indirectCommand));
+	indirectCommand.numVertices = (m_levelAddress[m_numLevels] - 1) / 8; // tiles up to the leaf level
+	m_nodePoolNodesCmdBuf = std::shared_ptr<TextureBuffer>(new TextureBuffer(sizeof(indirectCommand), (char*)&indirectCommand));
+
+	// Nothing of the old pool is kept
+	m_svoBuilt = false;
+	m_staticSVOBuilt = false;
+}
+
+bool Graphics::growNodePoolOnOverflow()
+{
+	// The tile counters of the last build were copied to m_tileCountReadback, a frame ago.
+	// Counters past the capacity of a level mean some nodes did not get their children.
+	if (!m_tileCountPending)
+	{
+		return false;
+	}
+	m_tileCountPending = false;
+	GLuint levelTiles[MAX_NODE_POOL_LEVELS];
+	glBindBuffer(GL_COPY_READ_BUFFER, m_tileCountReadback->m_bufferID);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(levelTiles), levelTiles);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	bool overflow = false;
+	GLuint tileCapacity[MAX_NODE_POOL_LEVELS];
+	size_t numNodes = 1;
+	for (int i = 0; i < MAX_NODE_POOL_LEVELS; i++)
+	{
+		tileCapacity[i] = m_levelTileCapacity[i];
+		if (i < m_numLevels - 1 && levelTiles[i] > tileCapacity[i])
+		{
+			overflow = true;
+			tileCapacity[i] = std::min(1U << (3 * i), levelTiles[i] + levelTiles[i] / 2);
+		}
+		numNodes += 8 * (size_t)tileCapacity[i];
+	}
+	if (!overflow)
+	{
+		m_nodePoolOverBudget = false;
+		return false;
+	}
+
+	// Node addresses have 30 bits (NODE_MASK_VALUE)
+	size_t poolBytes = numNodes * sizeof(GLuint) * NODE_POOL_NUM_TEXTURES;
+	if (poolBytes > ((size_t)svoNodePoolBudgetMB << 20) || numNodes > ((size_t)1 << 30))
+	{
+		if (!m_nodePoolOverBudget)
+		{
+			std::cout << "SVO node pool needs " << (poolBytes >> 20) << " MB, more than the budget of " << svoNodePoolBudgetMB << " MB. Nodes are missing." << std::endl;
+			m_nodePoolOverBudget = true;
+		}
+		return false;
+	}
+
+	std::copy(tileCapacity, tileCapacity + MAX_NODE_POOL_LEVELS, m_levelTileCapacity);
+	resizeNodePool();
+	std::cout << "SVO node pool grown to " << (poolBytes >> 20) << " MB." << std::endl;
+	return true;
+}
+
+void Graphics::reportBrickPoolOverflow()
+{
+	// The brick counter of the last build was copied to m_brickCountReadback, a frame ago.
+	// It keeps counting past the pool, the nodes which got no brick were left empty.
+	if (!m_brickCountPending)
+	{
+		return;
+	}
+	m_brickCountPending = false;
+	GLuint brickCount = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, m_brickCountReadback->m_bufferID);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &brickCount);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	GLuint numBricks = (m_brickPoolDim / 3) * (m_brickPoolDim / 3) * (m_brickPoolDim / 3);
+	bool overflow = brickCount > numBricks;
+	if (overflow && !m_brickPoolOverflow)
+	{
+		int bricksPerEdge = (int)std::ceil(std::cbrt((double)brickCount));
+		std::cout << "SVO brick pool overflow: " << brickCount << " bricks needed, " << numBricks
+			<< " available. Nodes are missing, svoBrickPoolBricks = " << bricksPerEdge << " would fit." << std::endl;
+	}
+	m_brickPoolOverflow = overflow;
+}
+
 void Graphics::sparseVoxelize(Scene & renderingScene, bool clearVoxelization)
 {
-	// Clear everything
-  clearNodePool(renderingScene);
-  clearBrickPool(renderingScene, true);
-  clearFragmentTex(renderingScene);
+  // A larger pool is built from scratch, resizeNodePool resets the build state
+  growNodePoolOnOverflow();
+  reportBrickPoolOverflow();
+
+  if (staticSVO && !clearVoxelization)
+  {
+	  sparseVoxelizeDynamic(renderingScene);
+	  return;
+  }
+  m_staticSVOBuilt = false; // the static octree gets overwritten
+
+  if (!findUpdateRegion(renderingScene, clearVoxelization))
+  {
+	  return; // nothing moved
+  }
+
+  if (m_updateRegionActive)
+  {
+	  // Only clear the voxels of the update region, the remaining octree is kept
+	  clearFragmentTex(renderingScene);
+	  clearLeafVoxels();
+  }
+  else
+  {
+	  // Clear everything
+	  clearNodePool(renderingScene);
+	  clearBrickPool(renderingScene, true);
+	  clearFragmentTex(renderingScene);
+  }
+
+  voxelizeScene(renderingScene, m_svoRenderers);
+  buildOctreeNodes(renderingScene, !m_updateRegionActive);
+  writeOctreeBricks();
+
+  m_updateRegionActive = false;
+  for (auto * renderer : renderingScene.renderers)
+  {
+	  renderer->acceptChanges();
+  }
+}
+
+void Graphics::sparseVoxelizeDynamic(Scene & renderingScene)
+{
+	// The static renderers are only voxelized again if one of them changed or the voxel grid moved.
+	// Otherwise the pools are reset to the static octree and the dynamic renderers are inserted on top.
+	bool staticChanged = false;
+	bool dynamicChanged = false;
+	for (auto * renderer : renderingScene.renderers)
+	{
+		if (renderer->enabled)
+		{
+			renderer->transform.updateTransformMatrix();
+		}
+		if (renderer->hasChanged())
+		{
+			staticChanged = staticChanged || renderer->isStatic;
+			dynamicChanged = dynamicChanged || !renderer->isStatic;
+		}
+	}
+
+	glm::mat4 voxelGridTransformI = getVoxelTransformInverse(renderingScene);
+	if (!m_staticSVOBuilt || staticChanged || voxelGridTransformI != m_svoVoxelGridTransformI)
+	{
+		m_svoVoxelGridTransformI = voxelGridTransformI;
+		buildStaticOctree(renderingScene);
+	}
+	else if (!dynamicChanged)
+	{
+		return; // nothing moved
+	}
+	else
+	{
+		// Remove last frame's dynamic voxels
+		clearLeafVoxels(true);
+		copyStaticFragments(true);
+		clearDynamicNodes();
+	}
+
+	m_svoRenderers.clear();
+	for (auto * renderer : renderingScene.renderers)
+	{
+		if (renderer->enabled && !renderer->isStatic)
+		{
+			m_svoRenderers.push_back(renderer);
+		}
+	}
+	voxelizeScene(renderingScene, m_svoRenderers, m_staticFragmentCount);
+	buildOctreeNodes(renderingScene, false);
+	writeOctreeBricks();
 
-  voxelizeScene(renderingScene);
+	m_svoBuilt = false; // the incremental update has to start with a full build
+	for (auto * renderer : renderingScene.renderers)
+	{
+		renderer->acceptChanges();
+	}
+}
+
+void Graphics::buildOctreeNodes(Scene & renderingScene, bool completeBuild)
+{
+  // Nodes and bricks move, the lit node lists no longer name the lit bricks, nor the probe list the nodes
+  m_litBricksListed = false;
+  m_probeCellsListed = false;
 
   // write fragment list length to draw buffer
   modifyIndirectBuffer(m_fragmentListCounter, m_fragmentListCmdBuf);
 
-  flagNode(renderingScene, 0);
-  for (int level = 1; level < m_numLevels; level++)
+  if (completeBuild && mortonSVOBuild && m_mortonCellTableFits)
+  {
+	  // The node pool was cleared, all levels are built at once from the fragments.
+	  // The cell table has hash tables sized by the tile capacities, it grows with the node pool.
+	  if (!m_mortonCellTable)
+	  {
+		  m_mortonCellTable = std::shared_ptr<TextureBuffer>(new TextureBuffer((size_t)m_mortonCellTableWords * sizeof(GLuint)));
+	  }
+	  glClearNamedBufferData(m_mortonCellTable->m_bufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	  buildNodesMorton(true);
+	  updateLevelCommands();
+	  buildNodesMorton(false);
+  }
+  else
   {
-	  // allocate nodes for level+1
-	  allocateNode(renderingScene, level-1);
-	  flagNode(renderingScene, level);
-	  findNeighbours(renderingScene, level);
+	  flagNode(renderingScene, 0);
+	  for (int level = 1; level < m_numLevels; level++)
+	  {
+		  // allocate nodes for level+1
+		  allocateNode(renderingScene, level-1);
+		  updateLevelCommands();
+		  flagNode(renderingScene, level);
+		  findNeighbours(renderingScene, level);
+	  }
   }
+  writeTopLevelIndex();
 
-  //flagBrick();
-  // write node count to draw buffer
-  modifyIndirectBuffer(m_nextFreeNode, m_nodePoolNodesCmdBuf);
+  // Checked for overflow before the next build, without waiting for the GPU now
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glCopyNamedBufferSubData(m_nextFreeNode->m_bufferID, m_tileCountReadback->m_bufferID, 0, 0, sizeof(GLuint) * MAX_NODE_POOL_LEVELS);
+  m_tileCountPending = true;
 
+  //flagBrick();
   allocateBrick();
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glCopyNamedBufferSubData(m_nextFreeBrick->m_bufferID, m_brickCountReadback->m_bufferID, 0, 0, sizeof(GLuint));
+  m_brickCountPending = true;
+}
 
+void Graphics::writeOctreeBricks()
+{
   writeLeafNode();
 
   spreadLeafBrick(m_brickPoolTextures[BRICK_POOL_COLOR]);
   spreadLeafBrick(m_brickPoolTextures[BRICK_POOL_NORMAL]);
 
-  borderTransfer(m_numLevels - 1, m_brickPoolTextures[BRICK_POOL_COLOR]);
-  borderTransfer(m_numLevels - 1, m_brickPoolTextures[BRICK_POOL_NORMAL]);
+  borderTransferBricks(m_numLevels - 1, { BRICK_POOL_COLOR, BRICK_POOL_NORMAL });
 
   for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
-	  mipmapCenter(ithLevel, m_brickPoolTextures[BRICK_POOL_COLOR]);
-	  mipmapFaces(ithLevel, m_brickPoolTextures[BRICK_POOL_COLOR]);
-	  mipmapCorners(ithLevel, m_brickPoolTextures[BRICK_POOL_COLOR]);
-	  mipmapEdges(ithLevel, m_brickPoolTextures[BRICK_POOL_COLOR]);
-	  if (ithLevel > 0)
-	  {
-		  borderTransfer(ithLevel, m_brickPoolTextures[BRICK_POOL_COLOR]);
-	  }
-  }
-  for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
-	  mipmapCenter(ithLevel, m_brickPoolTextures[BRICK_POOL_NORMAL], glm::vec4(0.5, 0.5, 0.5, 0.0));
-	  mipmapFaces(ithLevel, m_brickPoolTextures[BRICK_POOL_NORMAL], glm::vec4(0.5, 0.5, 0.5, 0.0));
-	  mipmapCorners(ithLevel, m_brickPoolTextures[BRICK_POOL_NORMAL], glm::vec4(0.5, 0.5, 0.5, 0.0));
-	  mipmapEdges(ithLevel, m_brickPoolTextures[BRICK_POOL_NORMAL], glm::vec4(0.5, 0.5, 0.5, 0.0));
+	  mipmapBricks(ithLevel, { BRICK_POOL_COLOR, BRICK_POOL_NORMAL });
 	  if (ithLevel > 0)
 	  {
-		  borderTransfer(ithLevel, m_brickPoolTextures[BRICK_POOL_NORMAL]);
+		  borderTransferBricks(ithLevel, { BRICK_POOL_COLOR, BRICK_POOL_NORMAL });
 	  }
   }
 }
 
+bool Graphics::findUpdateRegion(Scene & renderingScene, bool fullRebuild)
+{
+	// Returns false if there is nothing to update. Otherwise either prepares a full rebuild,
+	// or sets the update region around the old and new bounds of the changed renderers.
+	m_updateRegionActive = false;
+	m_svoRenderers.clear();
+	for (auto * renderer : renderingScene.renderers)
+	{
+		if (renderer->enabled)
+		{
+			renderer->transform.updateTransformMatrix();
+		}
+	}
+
+	glm::mat4 voxelGridTransformI = getVoxelTransformInverse(renderingScene);
+	fullRebuild = fullRebuild || !incrementalSVO || !m_svoBuilt || voxelGridTransformI != m_svoVoxelGridTransformI
+		|| (svoFullRebuildInterval > 0 && m_svoUpdatesSinceRebuild >= svoFullRebuildInterval);
+	if (fullRebuild)
+	{
+		m_svoBuilt = true;
+		m_svoVoxelGridTransformI = voxelGridTransformI;
+		m_svoUpdatesSinceRebuild = 0;
+		m_svoRenderers = renderingScene.renderers;
+		return true;
+	}
+
+	// Voxels covered by the changed renderers before and after the change
+	glm::ivec3 voxelMin(m_nodePoolDim), voxelMax(-1);
+	bool changed = false;
+	for (auto * renderer : renderingScene.renderers)
+	{
+		if (!renderer->hasChanged())
+		{
+			continue;
+		}
+		changed = true;
+
+		glm::vec3 boxMin, boxMax;
+		glm::ivec3 rendererMin, rendererMax;
+		if (renderer->getAcceptedBoundingBox(boxMin, boxMax))
+		{
+			getVoxelRange(voxelGridTransformI, boxMin, boxMax, rendererMin, rendererMax);
+			voxelMin = glm::min(voxelMin, rendererMin);
+			voxelMax = glm::max(voxelMax, rendererMax);
+		}
+		if (renderer->enabled)
+		{
+			renderer->getBoundingBox(boxMin, boxMax);
+			getVoxelRange(voxelGridTransformI, boxMin, boxMax, rendererMin, rendererMax);
+			voxelMin = glm::min(voxelMin, rendererMin);
+			voxelMax = glm::max(voxelMax, rendererMax);
+		}
+	}
+	if (!changed)
+	{
+		return false;
+	}
+	m_svoUpdatesSinceRebuild++;
+	if (glm::any(glm::greaterThan(voxelMin, voxelMax)))
+	{
+		// e.g. disabled and enabled again before it was built
+		for (auto * renderer : renderingScene.renderers)
+		{
+			renderer->acceptChanges();
+		}
+		return false;
+	}
+
+	// Everything reaching into the region is voxelized again, clipped to the region
+	for (auto * renderer : renderingScene.renderers)
+	{
+		if (!renderer->enabled)
+		{
+			continue;
+		}
+		glm::vec3 boxMin, boxMax;
+		if (renderer->hasChanged() || !renderer->getAcceptedBoundingBox(boxMin, boxMax))
+		{
+			renderer->getBoundingBox(boxMin, boxMax);
+		}
+		glm::ivec3 rendererMin, rendererMax;
+		getVoxelRange(voxelGridTransformI, boxMin, boxMax, rendererMin, rendererMax);
+		if (glm::all(glm::lessThanEqual(rendererMin, voxelMax)) && glm::all(glm::greaterThanEqual(rendererMax, voxelMin)))
+		{
+			m_svoRenderers.push_back(renderer);
+		}
+	}
+
+	setUpdateRegion(voxelMin, voxelMax);
+	return true;
+}
+
+void Graphics::setUpdateRegion(const glm::ivec3 & voxelMin, const glm::ivec3 & voxelMax)
+{
+	m_updateRegionActive = true;
+	m_updateVoxelMin = voxelMin;
+	m_updateVoxelMax = voxelMax;
+
+	// New nodes are flagged up to one cell around the changed voxels, so their bricks and the bricks
+	// next to them change. One more ring of unchanged bricks is rebuilt, so the border transfer
+	// can average against bricks holding their own values.
+	for (int level = 0; level < m_numLevels; level++)
+	{
+		int shift = m_numLevels - level;
+		glm::ivec3 maxCell((1 << level) - 1);
+		m_updateCellMin[level] = glm::clamp((voxelMin >> shift) - 2, glm::ivec3(0), maxCell);
+		m_updateCellMax[level] = glm::clamp((voxelMax >> shift) + 2, glm::ivec3(0), maxCell);
+	}
+}
+
+void Graphics::getVoxelRange(const glm::mat4 & voxelGridTransformI, const glm::vec3 & boxMin, const glm::vec3 & boxMax,
+	glm::ivec3 & voxelMin, glm::ivec3 & voxelMax) const
+{
+	// The voxel grid transform only scales and translates. One voxel is added for rounding.
+	glm::vec3 texMin = glm::vec3(voxelGridTransformI * glm::vec4(boxMin, 1.0f));
+	glm::vec3 texMax = glm::vec3(voxelGridTransformI * glm::vec4(boxMax, 1.0f));
+	voxelMin = glm::ivec3(glm::floor(glm::clamp(glm::min(texMin, texMax), 0.0f, 1.0f) * float(m_nodePoolDim))) - 1;
+	voxelMax = glm::ivec3(glm::floor(glm::clamp(glm::max(texMin, texMax), 0.0f, 1.0f) * float(m_nodePoolDim))) + 1;
+	voxelMin = glm::clamp(voxelMin, glm::ivec3(0), glm::ivec3(m_nodePoolDim - 1));
+	voxelMax = glm::clamp(voxelMax, glm::ivec3(0), glm::ivec3(m_nodePoolDim - 1));
+}
+
+void Graphics::drawLevelThreads(const GLuint program, int level, int negativeMargin, int positiveMargin)
+{
+	// One thread per node on the level, per lit node, or per cell of the update region on that level
+	if (m_lightThreadsActive)
+	{
+		// The lists of the lit nodes and the flags of isLitNode, on units above the ones of the passes
+		int textureUnitIdx = LIGHT_THREADS_TEXTURE_UNIT;
+		m_lightNodeMap->Activate(program, textureUnitIdx, "nodeMap");
+		textureUnitIdx++;
+		m_litNodeCounts->Activate(program, "litNodeCounts", textureUnitIdx);
+		textureUnitIdx++;
+		m_litNodeFlags->Activate(program, "litNodeFlags", textureUnitIdx);
+		glUniform2iv(glGetUniformLocation(program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
+		glUniform2iv(glGetUniformLocation(program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_lightNodesCmdBuf->m_bufferID);
+		glDrawArraysIndirect(GL_POINTS, (const void*)(level * sizeof(IndirectDrawCommand)));
+		return;
+	}
+	if (!m_updateRegionActive)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_levelNodesCmdBuf->m_bufferID);
+		glDrawArraysIndirect(GL_POINTS, (const void*)(level * sizeof(IndirectDrawCommand)));
+		return;
+	}
+
+	glm::ivec3 regionMin = glm::max(m_updateCellMin[level] - negativeMargin, glm::ivec3(0));
+	glm::ivec3 regionMax = glm::min(m_updateCellMax[level] + positiveMargin, glm::ivec3((1 << level) - 1));
+	glm::ivec3 regionSize = regionMax - regionMin + 1;
+	glUniform3iv(glGetUniformLocation(program, "threadRegionMin"), 1, glm::value_ptr(regionMin));
+	glUniform3iv(glGetUniformLocation(program, "threadRegionSize"), 1, glm::value_ptr(regionSize));
+	glDrawArrays(GL_POINTS, 0, regionSize.x * regionSize.y * regionSize.z);
+}
+
+std::string Graphics::threadMaterialName(const std::string & name) const
+{
+	// The THREAD_MODE variant of a pass run with drawLevelThreads
+	if (m_lightThreadsActive)
+	{
+		return name + "Light";
+	}
+	return m_updateRegionActive ? name + "Region" : name;
+}
+
+void Graphics::bindNodePool(const GLuint program, int field, const std::string & name, int textureUnit, GLenum access)
+{
+	// The records hold all fields, the buffer is bound again for every field a pass uses
+	if (nodePoolLayout == NODE_POOL_RECORDS)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_nodePoolRecords->m_bufferID);
+		return;
+	}
+	m_nodePoolTextures[field]->Activate(program, name, textureUnit);
+	glBindImageTexture(textureUnit, m_nodePoolTextures[field]->m_textureID, 0, GL_TRUE, 0, access, GL_R32UI);
+}
+
+void Graphics::writeTopLevelIndex()
+{
+	if (m_topLevelIndexLevel == 0)
+	{
+		return;
+	}
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("writeTopLevelIndex");
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	int textureUnitIdx = 0;
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
+	textureUnitIdx++;
+	glUniform1i(glGetUniformLocation(material->program, "topLevelIndex_level"), textureUnitIdx);
+
+	// One pass per level, each writes its mip of the index
+	for (int level = 1; level <= m_topLevelIndexLevel; level++)
+	{
+		glBindImageTexture(textureUnitIdx, m_topLevelIndex->textureID, m_topLevelIndexLevel - level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32UI);
+		glUniform1ui(glGetUniformLocation(material->program, "level"), level);
+		glDrawArrays(GL_POINTS, 0, 1 << (3 * level));
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Graphics::bindTopLevelIndex(const GLuint program, int textureUnit)
+{
+	// Without index the traversals start at the root
+	glUniform1ui(glGetUniformLocation(program, "topLevelIndexLevel"), m_topLevelIndexLevel);
+	if (m_topLevelIndex)
+	{
+		m_topLevelIndex->Activate(program, "topLevelIndex", textureUnit);
+	}
+}
+
+void Graphics::validateSparseVoxelization(Scene & renderingScene)
+{
+	// Read back the GPU octree. Only the node pool up to the last allocated leaf tile is needed.
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	GLuint levelTiles[MAX_NODE_POOL_LEVELS], numFragments = 0;
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeNode->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(levelTiles), levelTiles);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_fragmentListCounter->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &numFragments);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	GLuint numTiles = 0;
+	for (int i = 0; i < m_numLevels - 1; i++) {
+		numTiles += levelTiles[i];
+	}
+	size_t numNodes = std::min<size_t>(m_levelAddress[m_numLevels - 1] + 8 * (size_t)levelTiles[m_numLevels - 2], m_maxNodes);
+	std::vector<uint32_t> gpuNodePool[NODE_POOL_NUM_TEXTURES];
+	readNodePool(numNodes, gpuNodePool);
+	std::vector<uint32_t> gpuBrickPool[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES];
+	readBrickPools(gpuBrickPool);
+
+	// Rebuild on the CPU. The irradiance pool is compared before light injection ran.
+	CpuOctreeBuilder builder(m_nodePoolDim, m_brickPoolDim, m_levelTileCapacity);
+	builder.addRenderers(renderingScene.renderers);
+	double startTime = glfwGetTime();
+	builder.build(getVoxelTransformInverse(renderingScene));
+	double buildTime = glfwGetTime() - startTime;
+
+	CpuOctreeBuilder::Comparison result = builder.compare(gpuNodePool, gpuBrickPool, numFragments);
+	std::cout << "SVO validation: CPU build took " << buildTime << " seconds." << std::endl;
+	std::cout << " - fragment list voxels: GPU " << numFragments << ", CPU " << builder.getFragmentList().size()
+		<< (result.fragmentCountMatches ? "" : " (mismatch)") << std::endl;
+	std::cout << " - tiles: GPU " << numTiles << ", CPU " << builder.getNumTiles() << std::endl;
+	std::cout << " - nodes compared: " << result.comparedNodes << ", structure mismatches: " << result.structureMismatches
+		<< ", neighbour mismatches: " << result.neighbourMismatches << std::endl;
+	std::cout << " - brick voxel mismatches (color, irradiance, normal): " << result.brickVoxelMismatches[CpuOctreeBuilder::BRICK_POOL_COLOR]
+		<< ", " << result.brickVoxelMismatches[CpuOctreeBuilder::BRICK_POOL_IRRADIANCE]
+		<< ", " << result.brickVoxelMismatches[CpuOctreeBuilder::BRICK_POOL_NORMAL]
+		<< " (max error " << result.maxBrickError << "/255)" << std::endl;
+}
+
+void Graphics::readNodePool(size_t numNodes, std::vector<uint32_t> nodePool[])
+{
+	// Field by field, in the order of NodePoolData
+	if (nodePoolLayout == NODE_POOL_RECORDS) {
+		std::vector<uint32_t> records(numNodes * NODE_POOL_NUM_TEXTURES);
+		glGetNamedBufferSubData(m_nodePoolRecords->m_bufferID, 0, sizeof(GLuint) * records.size(), records.data());
+		for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+			nodePool[i].resize(numNodes);
+			for (size_t node = 0; node < numNodes; node++) {
+				nodePool[i][node] = records[node * NODE_POOL_NUM_TEXTURES + i];
+			}
+		}
+	}
+	else {
+		for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+			nodePool[i].resize(numNodes);
+			glBindBuffer(GL_TEXTURE_BUFFER, m_nodePoolTextures[i]->m_bufferID);
+			glGetBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(GLuint) * numNodes, nodePool[i].data());
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+}
+
+void Graphics::readBrickPools(std::vector<uint32_t> brickPools[])
+{
+	// The color, irradiance and normal pools, in the order of CpuOctreeBuilder::BrickPoolData
+	const BrickPoolData pools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES] = { BRICK_POOL_COLOR, BRICK_POOL_IRRADIANCE, BRICK_POOL_NORMAL };
+	for (int i = 0; i < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; i++) {
+		brickPools[i].resize((size_t)m_brickPoolDim * m_brickPoolDim * m_brickPoolDim);
+		glBindTexture(GL_TEXTURE_3D, m_brickPoolTextures[pools[i]]->textureID);
+		glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, brickPools[i].data());
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void Graphics::uploadNodePool(const uint32_t * const nodePool[])
+{
+	m_litBricksListed = false;
+	m_probeCellsListed = false;
+	// m_maxNodes words of every field, in the order of NodePoolData
+	if (nodePoolLayout == NODE_POOL_RECORDS) {
+		std::vector<uint32_t> records((size_t)m_maxNodes * NODE_POOL_NUM_TEXTURES);
+		for (size_t node = 0; node < (size_t)m_maxNodes; node++) {
+			for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+				records[node * NODE_POOL_NUM_TEXTURES + i] = nodePool[i][node];
+			}
+		}
+		glNamedBufferSubData(m_nodePoolRecords->m_bufferID, 0, sizeof(GLuint) * records.size(), records.data());
+	}
+	else {
+		for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+			glNamedBufferSubData(m_nodePoolTextures[i]->m_bufferID, 0, sizeof(GLuint) * m_maxNodes, nodePool[i]);
+		}
+	}
+	writeTopLevelIndex();
+}
+
+void Graphics::saveSVO(Scene & renderingScene, const std::string & path)
+{
+	// The whole node pool is written, a loaded octree gets the same level ranges
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	SvoFile::Levels levels;
+	std::copy(m_levelAddress, m_levelAddress + MAX_NODE_POOL_LEVELS, levels.levelAddress);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeNode->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(levels.levelTiles), levels.levelTiles);
+	GLuint numBricks = 0;
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeBrick->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &numBricks);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	std::vector<uint32_t> nodePool[NODE_POOL_NUM_TEXTURES];
+	readNodePool(m_maxNodes, nodePool);
+	std::vector<uint32_t> brickPools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES];
+	readBrickPools(brickPools);
+
+	SvoFile::Info info;
+	info.nodePoolDim = m_nodePoolDim;
+	info.numLevels = m_numLevels;
+	info.maxNodes = m_maxNodes;
+	info.brickPoolDim = m_brickPoolDim;
+	info.numBricks = std::min<GLuint>(numBricks, (m_brickPoolDim / 3) * (m_brickPoolDim / 3) * (m_brickPoolDim / 3));
+	std::copy(m_levelTileCapacity, m_levelTileCapacity + MAX_NODE_POOL_LEVELS, info.levelTileCapacity);
+
+	const uint32_t * nodeFields[NODE_POOL_NUM_TEXTURES];
+	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+		nodeFields[i] = nodePool[i].data();
+	}
+	const uint32_t * brickData[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES];
+	for (int i = 0; i < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; i++) {
+		brickData[i] = brickPools[i].data();
+	}
+	if (SvoFile::write(path, SvoFile::hashScene(renderingScene.renderers), info, levels, nodeFields, brickData)) {
+		std::cout << "SVO saved to " << path << ": " << m_maxNodes << " nodes, " << info.numBricks << " bricks." << std::endl;
+	}
+	else {
+		std::cout << "Cannot write the SVO to " << path << "." << std::endl;
+	}
+}
+
+void Graphics::bakeSVO(Scene & renderingScene, const std::string & path)
+{
+	// Builds the octree with the CPU builder and writes it, no GL call is made. Levels which ran out
+	// of tiles grow as in growNodePoolOnOverflow, and the octree is built again.
+	double startTime = glfwGetTime();
+	GLuint tileCapacity[MAX_NODE_POOL_LEVELS];
+	std::copy(m_levelTileCapacity, m_levelTileCapacity + MAX_NODE_POOL_LEVELS, tileCapacity);
+	std::unique_ptr<CpuOctreeBuilder> builder;
+	bool overflow = true;
+	while (overflow)
+	{
+		builder.reset(new CpuOctreeBuilder(m_nodePoolDim, m_brickPoolDim, tileCapacity));
+		builder->addRenderers(renderingScene.renderers);
+		builder->build(getVoxelTransformInverse(renderingScene));
+
+		overflow = false;
+		for (int i = 0; i < m_numLevels - 1; i++)
+		{
+			GLuint levelTiles = builder->getLevelTiles(i);
+			if (levelTiles > tileCapacity[i])
+			{
+				overflow = true;
+				tileCapacity[i] = std::min(1U << (3 * i), levelTiles + levelTiles / 2);
+			}
+		}
+	}
+
+	if (SvoFile::write(path, SvoFile::hashScene(renderingScene.renderers), *builder)) {
+		std::cout << "SVO baked on the CPU to " << path << " in " << glfwGetTime() - startTime << " seconds: "
+			<< builder->getMaxNodes() << " nodes, " << builder->getNumBricks() << " bricks." << std::endl;
+	}
+	else {
+		std::cout << "Cannot write the SVO to " << path << "." << std::endl;
+	}
+}
+
+bool Graphics::loadSVO(Scene & renderingScene, const std::string & path)
+{
+	double startTime = glfwGetTime();
+	SvoFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	const SvoFile::Info & info = file.getInfo();
+	if (file.getSceneHash() != SvoFile::hashScene(renderingScene.renderers)) {
+		std::cout << "The SVO of " << path << " was baked from a different scene, it is baked again." << std::endl;
+		return false;
+	}
+	if ((int)info.nodePoolDim != m_nodePoolDim || (int)info.numLevels != m_numLevels || (int)info.brickPoolDim != m_brickPoolDim) {
+		std::cout << "The SVO of " << path << " was baked with a different resolution or brick pool, it is baked again." << std::endl;
+		return false;
+	}
+
+	// The node pool gets the level ranges of the bake
+	std::copy(info.levelTileCapacity, info.levelTileCapacity + MAX_NODE_POOL_LEVELS, m_levelTileCapacity);
+	resizeNodePool();
+	const SvoFile::Levels & levels = file.getLevels();
+	if ((int)info.maxNodes != m_maxNodes || !std::equal(m_levelAddress, m_levelAddress + MAX_NODE_POOL_LEVELS, levels.levelAddress)) {
+		std::cout << "The SVO of " << path << " has inconsistent level ranges, it is baked again." << std::endl;
+		return false;
+	}
+
+	// One upload per buffer, straight from the mapping
+	const uint32_t * fields[NODE_POOL_NUM_TEXTURES];
+	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+		fields[i] = file.getNodePool((CpuOctreeBuilder::NodePoolData)i);
+	}
+	uploadNodePool(fields);
+	glNamedBufferSubData(m_nextFreeNode->m_bufferID, 0, sizeof(levels.levelTiles), levels.levelTiles);
+	updateLevelCommands();
+
+	const BrickPoolData pools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES] = { BRICK_POOL_COLOR, BRICK_POOL_IRRADIANCE, BRICK_POOL_NORMAL };
+	for (int i = 0; i < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; i++) {
+		glBindTexture(GL_TEXTURE_3D, m_brickPoolTextures[pools[i]]->textureID);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, GL_RGBA, GL_UNSIGNED_BYTE, file.getBrickPool((CpuOctreeBuilder::BrickPoolData)i));
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+
+	// The brick allocator continues after the baked bricks
+	glNamedBufferSubData(m_nextFreeBrick->m_bufferID, 0, sizeof(GLuint), &info.numBricks);
+	glClearNamedBufferSubData(m_freeBricks->m_bufferID, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	std::cout << "SVO loaded from " << path << " in " << glfwGetTime() - startTime << " seconds: " << info.maxNodes << " nodes, "
+		<< info.numBricks << " bricks." << std::endl;
+	return true;
+}
+
+bool Graphics::loadStreamedSVO(std::shared_ptr<SvoFile> file)
+{
+	const SvoFile::Info & info = file->getInfo();
+	if ((int)info.nodePoolDim != m_nodePoolDim || (int)info.numLevels != m_numLevels || (int)info.maxNodes != m_maxNodes) {
+		return false;
+	}
+
+	// All nodes are loaded without bricks, BrickStreamer points them to the bricks it uploads
+	std::vector<uint32_t> noBricks(info.maxNodes, 0U);
+	const uint32_t * fields[NODE_POOL_NUM_TEXTURES];
+	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+		fields[i] = file->getNodePool((CpuOctreeBuilder::NodePoolData)i);
+	}
+	for (size_t node = 0; node < info.maxNodes; node++) {
+		noBricks[node] = fields[NODE_POOL_COLOR][node] & ~0x3FFFFFFFU; // keeps the static tag above NODE_MASK_VALUE
+	}
+	fields[NODE_POOL_COLOR] = noBricks.data();
+	uploadNodePool(fields);
+
+	// Brick 0 is sampled by the nodes which are missing
+	const BrickPoolData pools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES] = { BRICK_POOL_COLOR, BRICK_POOL_IRRADIANCE, BRICK_POOL_NORMAL };
+	for (int i = 0; i < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; i++) {
+		glClearTexImage(m_brickPoolTextures[pools[i]]->textureID, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	m_brickStreamer = std::unique_ptr<BrickStreamer>(new BrickStreamer(file, m_brickPoolDim, svoStreamBricksPerFrame));
+	std::cout << "Streaming the SVO of " << svoFile << ": " << info.maxNodes << " nodes, " << info.numBricks << " bricks, "
+		<< (m_brickPoolDim / 3) * (m_brickPoolDim / 3) * (m_brickPoolDim / 3) << " of them resident at most." << std::endl;
+	return true;
+}
+
+void Graphics::streamBricks(Scene & renderingScene)
+{
+	glm::vec3 cameraPosTex = glm::vec3(getVoxelTransformInverse(renderingScene) * glm::vec4(renderingScene.renderingCamera->position, 1.0f));
+	Texture3D * brickPools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES] = {
+		m_brickPoolTextures[BRICK_POOL_COLOR].get(), m_brickPoolTextures[BRICK_POOL_IRRADIANCE].get(), m_brickPoolTextures[BRICK_POOL_NORMAL].get() };
+	m_streamedColorWrites.clear();
+	m_brickStreamer->update(cameraPosTex, svoStreamLodDistance, brickPools, m_streamedColorWrites);
+	if (m_streamedColorWrites.empty()) {
+		return;
+	}
+
+	// Point the nodes to the bricks which were uploaded or evicted
+	size_t numWrites = m_streamedColorWrites.size();
+	if (numWrites > m_streamedColorWriteCapacity) {
+		m_streamedColorWriteCapacity = std::max(numWrites, 2 * m_streamedColorWriteCapacity);
+		m_streamedColorWriteBuffer = std::shared_ptr<TextureBuffer>(new TextureBuffer(m_streamedColorWriteCapacity * sizeof(BrickStreamer::NodeColorWrite), nullptr, GL_RG32UI));
+	}
+	glNamedBufferSubData(m_streamedColorWriteBuffer->m_bufferID, 0, numWrites * sizeof(BrickStreamer::NodeColorWrite), m_streamedColorWrites.data());
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("streamNodeColors");
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	int textureUnitIdx = 0;
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_WRITE_ONLY);
+	textureUnitIdx++;
+	m_streamedColorWriteBuffer->Activate(material->program, "nodeColorWrites", textureUnitIdx);
+
+	glDrawArrays(GL_POINTS, 0, (GLsizei)numWrites);
+	glMemoryBarrier(m_nodePoolBarrierBits);
+}
+
+void Graphics::benchmarkNodePoolLayouts()
+{
+	// Both layouts traverse the same octree, the nodes are copied into the layout which is not in use
+	std::shared_ptr<TextureBuffer> nodeTextures[NODE_POOL_NUM_TEXTURES];
+	std::shared_ptr<IndexBuffer> nodeRecords = m_nodePoolRecords;
+	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+	{
+		nodeTextures[i] = m_nodePoolTextures[i];
+		if (nodePoolLayout == NODE_POOL_RECORDS)
+		{
+			nodeTextures[i] = std::shared_ptr<TextureBuffer>(new TextureBuffer(m_maxNodes * sizeof(int)));
+		}
+	}
+	if (nodePoolLayout == NODE_POOL_TEXTURES)
+	{
+		nodeRecords = std::shared_ptr<IndexBuffer>(new IndexBuffer(GL_SHADER_STORAGE_BUFFER, (size_t)m_maxNodes * NODE_POOL_NUM_TEXTURES * sizeof(GLuint), GL_DYNAMIC_COPY, nullptr));
+	}
+
+	const char * nodePoolNames[NODE_POOL_NUM_TEXTURES] = {
+		"nodePool_next",
+		"nodePool_color",
+		"nodePool_X",
+		"nodePool_X_neg",
+		"nodePool_Y",
+		"nodePool_Y_neg",
+		"nodePool_Z",
+		"nodePool_Z_neg",
+	};
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName("copyNodePool");
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+	{
+		nodeTextures[i]->Activate(material->program, nodePoolNames[i], i);
+		glBindImageTexture(i, nodeTextures[i]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, nodeRecords->m_bufferID);
+	glUniform1ui(glGetUniformLocation(material->program, "toRecords"), nodePoolLayout == NODE_POOL_TEXTURES);
+	glDrawArrays(GL_POINTS, 0, m_maxNodes);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// The traversals start at random voxel fragments, so they all reach the leaf level
+	GLuint numFragments = 0;
+	glGetNamedBufferSubData(m_fragmentListCounter->m_bufferID, 0, sizeof(GLuint), &numFragments);
+	if (numFragments == 0)
+	{
+		std::cout << "Node pool layout benchmark: the octree is empty." << std::endl;
+		return;
+	}
+
+	std::shared_ptr<TextureBuffer> traversalResult(new TextureBuffer(sizeof(GLuint)));
+	const GLuint numTraversals = 1 << 22;
+	const int numRuns = 10;
+	const char * materialNames[] = { "benchmarkTraversalTextures", "benchmarkTraversalRecords" };
+	const char * layoutNames[] = { "texture buffers", "records" };
+	GLuint query;
+	glGenQueries(1, &query);
+	std::cout << "Node pool layout benchmark: " << numRuns << " x " << numTraversals << " traversals to the leaves of " << numFragments << " fragments." << std::endl;
+	for (int layout = NODE_POOL_TEXTURES; layout <= NODE_POOL_RECORDS; layout++)
+	{
+		material = matStore.findMaterialWithName(materialNames[layout]);
+		glUseProgram(material->program);
+
+		int textureUnitIdx = 0;
+		m_fragmentList->Activate(material->program, "voxelFragList_position", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
+		textureUnitIdx++;
+		traversalResult->Activate(material->program, "traversalResult", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, traversalResult->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+		if (layout == NODE_POOL_TEXTURES)
+		{
+			const int fields[] = { NODE_POOL_NEXT, NODE_POOL_COLOR, NODE_POOL_NEIGH_X, NODE_POOL_NEIGH_Y, NODE_POOL_NEIGH_Z };
+			for (int field : fields)
+			{
+				textureUnitIdx++;
+				nodeTextures[field]->Activate(material->program, nodePoolNames[field], textureUnitIdx);
+				glBindImageTexture(textureUnitIdx, nodeTextures[field]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+			}
+		}
+		else
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, nodeRecords->m_bufferID);
+		}
+		glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
+		glUniform1ui(glGetUniformLocation(material->program, "numFragments"), numFragments);
+
+		// The first draw is not timed, it fills the caches
+		GLint seedLocation = glGetUniformLocation(material->program, "seed");
+		glUniform1ui(seedLocation, 0);
+		glDrawArrays(GL_POINTS, 0, numTraversals);
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		for (int run = 1; run <= numRuns; run++)
+		{
+			glUniform1ui(seedLocation, run * numTraversals);
+			glDrawArrays(GL_POINTS, 0, numTraversals);
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+		std::cout << " - " << layoutNames[layout] << ": " << elapsedNs / 1e6 << " ms, "
+			<< numRuns * (double)numTraversals / (elapsedNs / 1e3) << " M traversals/s" << std::endl;
+	}
+	glDeleteQueries(1, &query);
+}
+
+void Graphics::benchmarkBorderTransfer()
+{
+	// Both versions run on all levels of the complete octree and start from the same color bricks
+	const bool updateRegionActive = m_updateRegionActive;
+	m_updateRegionActive = false;
+	std::shared_ptr<Texture3D> & colorPool = m_brickPoolTextures[BRICK_POOL_COLOR];
+	Texture3D savedPool(m_brickPoolDim, m_brickPoolDim, m_brickPoolDim, false, GL_RGBA8, GL_RGBA);
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	glCopyImageSubData(colorPool->textureID, GL_TEXTURE_3D, 0, 0, 0, 0, savedPool.textureID, GL_TEXTURE_3D, 0, 0, 0, 0, m_brickPoolDim, m_brickPoolDim, m_brickPoolDim);
+
+	const int numRuns = 10;
+	const char * versionNames[] = { "three passes", "single pass" };
+	std::vector<uint32_t> results[2];
+	GLuint query;
+	glGenQueries(1, &query);
+	std::cout << "Border transfer benchmark: " << numRuns << " x levels 1 to " << m_numLevels - 1 << " of the color bricks." << std::endl;
+	for (int version = 0; version < 2; version++)
+	{
+		// The first run is not timed, its result is compared
+		for (int run = 0; run <= numRuns; run++)
+		{
+			if (run == 1)
+			{
+				results[version].resize((size_t)m_brickPoolDim * m_brickPoolDim * m_brickPoolDim);
+				glBindTexture(GL_TEXTURE_3D, colorPool->textureID);
+				glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, results[version].data());
+				glBindTexture(GL_TEXTURE_3D, 0);
+				glBeginQuery(GL_TIME_ELAPSED, query);
+			}
+			for (int level = m_numLevels - 1; level > 0; --level)
+			{
+				if (version == 0)
+				{
+					borderTransfer(level, colorPool);
+				}
+				else
+				{
+					borderTransferBricks(level, { BRICK_POOL_COLOR });
+				}
+			}
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		glCopyImageSubData(savedPool.textureID, GL_TEXTURE_3D, 0, 0, 0, 0, colorPool->textureID, GL_TEXTURE_3D, 0, 0, 0, 0, m_brickPoolDim, m_brickPoolDim, m_brickPoolDim);
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+		std::cout << " - " << versionNames[version] << ": " << elapsedNs / 1e6 / numRuns << " ms per run" << std::endl;
+	}
+	glDeleteQueries(1, &query);
+	glDeleteTextures(1, &savedPool.textureID);
+	m_updateRegionActive = updateRegionActive;
+
+	size_t numDifferent = 0;
+	for (size_t i = 0; i < results[0].size(); i++)
+	{
+		numDifferent += results[0][i] != results[1][i];
+	}
+	std::cout << " - " << numDifferent << " voxels differ." << std::endl;
+}
+
+void Graphics::benchmarkIndirectLight(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight)
+{
+	// Whole cone tracing frames, so the cost of the upsampling and of the extra geometry passes is included
+	const int indirectDownsample = indirectLightDownsample;
+	const bool temporal = temporalIndirectLight;
+	const bool deferred = deferredShading;
+	const bool probes = irradianceProbes;
+	const bool gather = ambientCubeDiffuse;
+	struct Variant { int downsample; bool temporal; bool deferred; bool probes; bool gather; };
+	const Variant variants[] = {
+		{ 1, false, false, false, false }, { 2, false, false, false, false }, { 4, false, false, false, false },
+		{ 1, true, false, false, false }, { 2, true, false, false, false }, { 4, true, false, false, false },
+		{ 1, false, true, false, false }, { 2, false, true, false, false }, { 2, true, true, false, false },
+		{ 1, false, false, true, false }, { 1, false, true, true, false },
+		{ 1, false, false, false, true }, { 1, false, true, false, true } };
+	const int numRuns = 10;
+	double fullResolutionMs = 0.0;
+	GLuint query;
+	glGenQueries(1, &query);
+	std::cout << "Indirect light benchmark: " << numRuns << " frames at " << viewportWidth << " x " << viewportHeight << "." << std::endl;
+	for (const Variant & variant : variants)
+	{
+		// The first frame is not timed, it creates the render targets and the history
+		indirectLightDownsample = variant.downsample;
+		temporalIndirectLight = variant.temporal;
+		deferredShading = variant.deferred;
+		irradianceProbes = variant.probes;
+		ambientCubeDiffuse = variant.gather;
+		renderSceneWithSVO(renderingScene, viewportWidth, viewportHeight);
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		for (int run = 0; run < numRuns; run++)
+		{
+			renderSceneWithSVO(renderingScene, viewportWidth, viewportHeight);
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+		const double ms = elapsedNs / 1e6 / numRuns;
+		if (&variant == &variants[0])
+		{
+			fullResolutionMs = ms;
+		}
+		std::cout << " - " << (variant.deferred ? "deferred" : "forward") << ", indirect light at 1 / " << variant.downsample;
+		if (variant.temporal)
+		{
+			std::cout << ", " << glm::clamp(temporalDiffuseCones, 1, 6) << " of 6 diffuse cones per frame";
+		}
+		if (variant.probes)
+		{
+			std::cout << ", diffuse light of the probes";
+		}
+		if (variant.gather)
+		{
+			std::cout << ", diffuse light of one ambient cube cone";
+		}
+		std::cout << ": " << ms << " ms per frame, " << fullResolutionMs - ms << " ms saved" << std::endl;
+	}
+	glDeleteQueries(1, &query);
+	indirectLightDownsample = indirectDownsample;
+	temporalIndirectLight = temporal;
+	deferredShading = deferred;
+	irradianceProbes = probes;
+	ambientCubeDiffuse = gather;
+}
+
 void Graphics::lightUpdate(Scene & renderingScene, bool clearVoxelizationFirst)
 {
-	// only clear irradiance pool
-	clearBrickPool(renderingScene, false);
+	if (filterLitNodes && m_litBricksListed && (m_litBricksAnisotropic || !anisotropicVoxels))
+	{
+		// Only the bricks of last frame's lit nodes hold light, the other ones are still empty
+		clearLitBricks();
+	}
+	else
+	{
+		// only clear irradiance pool
+		clearBrickPool(renderingScene, false);
+		if (filterLitNodes && anisotropicVoxels)
+		{
+			// The directional bricks of the nodes the light left are not filtered again
+			const int directionalPools[] = { BRICK_POOL_COLOR_X, BRICK_POOL_COLOR_X_NEG, BRICK_POOL_COLOR_Y, BRICK_POOL_COLOR_Y_NEG, BRICK_POOL_COLOR_Z, BRICK_POOL_COLOR_Z_NEG };
+			for (int pool : directionalPools)
+			{
+				glClearTexImage(m_brickPoolTextures[pool]->textureID, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+	}
 	clearNodeMap();
 
-	for (unsigned int i = 0; i < renderingScene.directionalLights.size(); ++i)
-	{
-		auto& light = renderingScene.directionalLights[i];
-		shadowMap(renderingScene, light);
-		lightInjection(renderingScene, light);
-
-		//spreadLeafBrickLight(m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		//borderTransferLight(m_numLevels - 1, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-
-		//int ithLevel;
-		//for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
-		//	mipmapCenterLight(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		//	mipmapFacesLight(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		//	mipmapCornersLight(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		//	mipmapEdges(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		//	if (ithLevel > 0)
-		//	{
-		//		borderTransferLight(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		//	}
-		//}
-
-		spreadLeafBrick(m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-		borderTransfer(m_numLevels - 1, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-
-		int ithLevel = m_numLevels - 2;
-		for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
-			mipmapCenter(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-			mipmapFaces(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-			mipmapCorners(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
-			mipmapEdges(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
+	// All lights are injected into the leaves first, the bricks are filtered once for all of them
+	shadowMapLayered(renderingScene);
+	lightInjection(renderingScene);
+
+	// The filtering passes run over the lit nodes and their ancestors, the other bricks stay empty
+	writeLightCommands();
+	m_lightThreadsActive = filterLitNodes;
+	resolveLightInjection(renderingScene);
+
+	spreadLeafBrick(m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
+	borderTransferBricks(m_numLevels - 1, { BRICK_POOL_IRRADIANCE });
+
+	for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
+		mipmapBricks(ithLevel, { BRICK_POOL_IRRADIANCE });
+		if (ithLevel > 0)
+		{
+			borderTransferBricks(ithLevel, { BRICK_POOL_IRRADIANCE });
+		}
+		if (anisotropicVoxels)
+		{
+			mipmapAnisotropic(ithLevel);
 			if (ithLevel > 0)
 			{
-				borderTransfer(ithLevel, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]);
+				borderTransferBricks(ithLevel, { BRICK_POOL_COLOR_X, BRICK_POOL_COLOR_Y, BRICK_POOL_COLOR_Z });
+				borderTransferBricks(ithLevel, { BRICK_POOL_COLOR_X_NEG, BRICK_POOL_COLOR_Y_NEG, BRICK_POOL_COLOR_Z_NEG });
 			}
 		}
 	}
+	m_lightThreadsActive = false;
+
+	// The next update clears the bricks of this update's lists, until the octree changes
+	m_litBricksListed = filterLitNodes;
+	m_litBricksAnisotropic = anisotropicVoxels;
 }
 
 void Graphics::clearNodePool(Scene & renderingScene) {
 	glColorMask(false, false, false, false);
 	MaterialStore& matStore = MaterialStore::getInstance();
-	// Clear node pool
-	// Because opengl only supports 8 texture units per draw, at least 2 draws are needed for 9 textures
-	std::string nodePoolNames[] = {
-		"nodePool_next",
-		"nodePool_color",
-		"nodePool_normal",
-		"nodePool_X",
-		"nodePool_X_neg",
-		"nodePool_Y",
-		"nodePool_Y_neg",
-		"nodePool_Z",
-		"nodePool_Z_neg",
-	};
-	Material* clearShader = matStore.findMaterialWithName("clearNodePool");
-	glUseProgram(clearShader->program);
-	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+	if (nodePoolLayout == NODE_POOL_RECORDS)
 	{
-		m_nodePoolTextures[i]->Activate(clearShader->program, nodePoolNames[i], i);
-		glBindImageTexture(i, m_nodePoolTextures[i]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+		// All fields are in one buffer
+		glClearNamedBufferData(m_nodePoolRecords->m_bufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
 	}
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolCmdBuf->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-	// Clear node pool neighbour
-	clearShader = matStore.findMaterialWithName("clearNodePoolNeigh");
-	glUseProgram(clearShader->program);
-	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+	else
 	{
-		m_nodePoolTextures[i]->Activate(clearShader->program, nodePoolNames[i], i);
-		glBindImageTexture(i, m_nodePoolTextures[i]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+		// Clear node pool
+		std::string nodePoolNames[] = {
+			"nodePool_next",
+			"nodePool_color",
+			"nodePool_X",
+			"nodePool_X_neg",
+			"nodePool_Y",
+			"nodePool_Y_neg",
+			"nodePool_Z",
+			"nodePool_Z_neg",
+		};
+		Material* clearShader = matStore.findMaterialWithName("clearNodePool");
+		glUseProgram(clearShader->program);
+		for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+		{
+			bindNodePool(clearShader->program, i, nodePoolNames[i], i, GL_WRITE_ONLY);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolCmdBuf->m_bufferID);
+		glDrawArraysIndirect(GL_POINTS, 0);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		// Clear node pool neighbour
+		clearShader = matStore.findMaterialWithName("clearNodePoolNeigh");
+		glUseProgram(clearShader->program);
+		for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++)
+		{
+			bindNodePool(clearShader->program, i, nodePoolNames[i], i, GL_WRITE_ONLY);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolCmdBuf->m_bufferID);
+		glDrawArraysIndirect(GL_POINTS, 0);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 	}
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolCmdBuf->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
-	// Clear level address buffer first
+	// Reset level address buffer
 	glBindBuffer(GL_TEXTURE_BUFFER, m_levelAddressBuffer->m_bufferID);
 	GLuint *ptr = (GLuint *)glMapBufferRange(GL_TEXTURE_BUFFER, 0, sizeof(GLuint) * MAX_NODE_POOL_LEVELS, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
 	for (int i = 0; i < MAX_NODE_POOL_LEVELS; i++)
 	{
-		ptr[i] = 0x0;
+		ptr[i] = m_levelAddress[i];
 	}
-	ptr[0] = 0;
-	ptr[1] = 1;
 	glUnmapBuffer(GL_TEXTURE_BUFFER);
+
+	// Reset the tile counters of all levels
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeNode->m_bufferID);
+	ptr = (GLuint *)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint) * MAX_NODE_POOL_LEVELS, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	for (int i = 0; i < MAX_NODE_POOL_LEVELS; i++)
+	{
+		ptr[i] = 0;
+	}
+	glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
@@ -602,6 +2235,16 @@ void Graphics::clearBrickPool(Scene & renderingScene, bool isClearAll) {
 	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_brickPoolCmdBuf->m_bufferID);
 	glDrawArraysIndirect(GL_POINTS, 0);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	if (isClearAll)
+	{
+		// All bricks are free again, brick 0 stays reserved for missing nodes
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeBrick->m_bufferID);
+		GLuint *ptr = (GLuint *)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		ptr[0] = 1;
+		glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
+		glClearNamedBufferSubData(m_freeBricks->m_bufferID, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	}
 }
 
 void Graphics::clearFragmentTex(Scene & renderingScene) {
@@ -617,12 +2260,76 @@ void Graphics::clearFragmentTex(Scene & renderingScene) {
 		m_fragmentTextures[fIdx]->Activate(clearShader->program, fragmentTexNames[i], i);
 		glBindImageTexture(i, m_fragmentTextures[fIdx]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
 	}
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentTexCmdBuf->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	if (m_updateRegionActive)
+	{
+		glm::ivec3 regionSize = m_updateVoxelMax - m_updateVoxelMin + 1;
+		glUniform3iv(glGetUniformLocation(clearShader->program, "regionMin"), 1, glm::value_ptr(m_updateVoxelMin));
+		glUniform3iv(glGetUniformLocation(clearShader->program, "regionSize"), 1, glm::value_ptr(regionSize));
+		glDrawArrays(GL_POINTS, 0, regionSize.x * regionSize.y * regionSize.z);
+	}
+	else
+	{
+		// One thread per voxel would exceed the vertex count of a draw for large grids
+		for (int i = 0; i < 2; i++)
+		{
+			glClearTexImage(m_fragmentTextures[fragmentTexIndices[i]]->textureID, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		}
+	}
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void Graphics::clearLeafVoxels(bool fromFragmentList) {
+	// Reset the leaf brick corners of the update region, or of the fragments after the static ones.
+	// The octree nodes are kept.
+	MaterialStore& matStore = MaterialStore::getInstance();
+	auto clearShader = matStore.findMaterialWithName(fromFragmentList ? "clearLeafVoxelsFragments" : "clearLeafVoxels");
+	glUseProgram(clearShader->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	int textureUnitIdx = 0;
+	bindNodePool(clearShader->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
+	textureUnitIdx++;
+	bindNodePool(clearShader->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
+	textureUnitIdx++;
+	std::string brickPoolNames[3] = { "brickPool_color", "brickPool_irradiance","brickPool_normal" };
+	int brickPoolIndices[3] = { BRICK_POOL_COLOR, BRICK_POOL_IRRADIANCE, BRICK_POOL_NORMAL };
+	for (int i = 0; i < 3; i++, textureUnitIdx++)
+	{
+		int bIdx = brickPoolIndices[i];
+		m_brickPoolTextures[bIdx]->Activate(clearShader->program, brickPoolNames[i], textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_brickPoolTextures[bIdx]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	}
+	glUniform1ui(glGetUniformLocation(clearShader->program, "numLevels"), m_numLevels);
+
+	if (fromFragmentList)
+	{
+		// The fragment list and its draw command still hold last frame's fragments
+		m_fragmentList->Activate(clearShader->program, "voxelFragList_position", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
+		textureUnitIdx++;
+		std::string fragmentTexNames[2] = { "voxelFragTex_color", "voxelFragTex_normal" };
+		int fragmentTexIndices[2] = { FRAG_TEX_COLOR, FRAG_TEX_NORMAL };
+		for (int i = 0; i < 2; i++, textureUnitIdx++)
+		{
+			int fIdx = fragmentTexIndices[i];
+			m_fragmentTextures[fIdx]->Activate(clearShader->program, fragmentTexNames[i], textureUnitIdx);
+			glBindImageTexture(textureUnitIdx, m_fragmentTextures[fIdx]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+		}
+		glUniform1ui(glGetUniformLocation(clearShader->program, "firstFragment"), m_staticFragmentCount);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentListCmdBuf->m_bufferID);
+		glDrawArraysIndirect(GL_POINTS, 0);
+	}
+	else
+	{
+		glm::ivec3 regionSize = m_updateVoxelMax - m_updateVoxelMin + 1;
+		glUniform3iv(glGetUniformLocation(clearShader->program, "regionMin"), 1, glm::value_ptr(m_updateVoxelMin));
+		glUniform3iv(glGetUniformLocation(clearShader->program, "regionSize"), 1, glm::value_ptr(regionSize));
+		glDrawArrays(GL_POINTS, 0, regionSize.x * regionSize.y * regionSize.z);
+	}
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::voxelizeScene(Scene & renderingScene) {
+void Graphics::voxelizeScene(Scene & renderingScene, RenderingQueue renderers, GLuint firstFragment) {
 	// Voxelize
 	MaterialStore& matStore = MaterialStore::getInstance();
 	auto voxelizeShader = matStore.findMaterialWithName("voxelize");
@@ -638,7 +2345,7 @@ void Graphics::voxelizeScene(Scene & renderingScene) {
 		glBindImageTexture(textureUnitIdx, m_fragmentTextures[fIdx]->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	}
 	m_fragmentList->Activate(voxelizeShader->program, "voxelFragList_position", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32UI);
 
 	glm::mat4 viewMatrix = glm::mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
 	glUniformMatrix4fv(glGetUniformLocation(voxelizeShader->program, "V"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
@@ -666,23 +2373,28 @@ void Graphics::voxelizeScene(Scene & renderingScene) {
 	glUniformMatrix4fv(glGetUniformLocation(voxelizeShader->program, "voxelGridTransformI"), 1, GL_FALSE, glm::value_ptr(voxelGridTransformI));
 
 	glUniform1ui(glGetUniformLocation(voxelizeShader->program, "voxelTexSize"), m_nodePoolDim);
+	glm::ivec3 voxelRegionMin = m_updateRegionActive ? m_updateVoxelMin : glm::ivec3(0);
+	glm::ivec3 voxelRegionMax = m_updateRegionActive ? m_updateVoxelMax : glm::ivec3(m_nodePoolDim - 1);
+	glUniform3iv(glGetUniformLocation(voxelizeShader->program, "voxelRegionMin"), 1, glm::value_ptr(voxelRegionMin));
+	glUniform3iv(glGetUniformLocation(voxelizeShader->program, "voxelRegionMax"), 1, glm::value_ptr(voxelRegionMax));
 
-	// Bind atomic variable and set its value
+	// Bind atomic variable and set its value, the fragments are appended after firstFragment
 	int bindingPoint = 0;
 	glGetActiveAtomicCounterBufferiv(voxelizeShader->program, 0, GL_ATOMIC_COUNTER_BUFFER_BINDING, &bindingPoint);
 	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, bindingPoint, m_fragmentListCounter->m_bufferID);
 	GLuint *ptr = (GLuint *)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
-	ptr[0] = 0;
+	ptr[0] = firstFragment;
 	glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_voxelizeFBO);
 	glViewport(0, 0, m_nodePoolDim, m_nodePoolDim);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 	glDisable(GL_CULL_FACE);
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_BLEND);
 	//uploadLighting(renderingScene, voxelizeShader->program);
-	renderQueue(renderingScene.renderers, voxelizeShader->program, true);
+	renderQueue(renderers, voxelizeShader->program, true);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
 }
@@ -765,16 +2477,14 @@ void Graphics::visualizeVoxel(Scene& renderingScene, unsigned int viewportWidth,
 	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
 	m_fragmentList->Activate(material->program, "voxelFragList_position", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
 	textureUnitIdx++;
 	m_fragmentTextures[FRAG_TEX_COLOR]->Activate(material->program, "voxelFragTex_color", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, m_fragmentTextures[FRAG_TEX_COLOR]->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
 	if (m_brickTexType == 0)
 	{
@@ -808,11 +2518,10 @@ void Graphics::flagNode(Scene & renderingScene, int level) {
 
 	int textureUnitIdx = 0;
 	m_fragmentList->Activate(material->program, "voxelFragmentListPosition", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
 
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_WRITE);
 	//textureUnitIdx++;
 	//m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
 	//glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
@@ -824,7 +2533,7 @@ void Graphics::flagNode(Scene & renderingScene, int level) {
 
 	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentListCmdBuf->m_bufferID);
 	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glMemoryBarrier(m_nodePoolBarrierBits);
 }
 
 void Graphics::allocateNode(Scene & renderingScene, int level) {
@@ -841,22 +2550,15 @@ void Graphics::allocateNode(Scene & renderingScene, int level) {
 	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_WRITE_ONLY);
 
-	// Bind atomic variable and set its value
+	// Bind the tile counter of this level, it is reset in clearNodePool
 	int bindingPoint = 0;
 	glGetActiveAtomicCounterBufferiv(material->program, 0, GL_ATOMIC_COUNTER_BUFFER_BINDING, &bindingPoint);
-	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, bindingPoint, m_nextFreeNode->m_bufferID);
-	if (level == 0)
-	{
-		GLuint *ptr = (GLuint *)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
-		ptr[0] = 0;
-		glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
-	}
+	glBindBufferRange(GL_ATOMIC_COUNTER_BUFFER, bindingPoint, m_nextFreeNode->m_bufferID, level * sizeof(GLuint), sizeof(GLuint));
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_levelNodesCmdBuf->m_bufferID);
+	glDrawArraysIndirect(GL_POINTS, (const void*)(level * sizeof(IndirectDrawCommand)));
 	glMemoryBarrier(GL_ALL_BARRIER_BITS);
 }
 
@@ -870,12 +2572,11 @@ void Graphics::findNeighbours(Scene & renderingScene, int level) {
 	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	//m_fragmentList->Activate(material->program, "voxelFragmentListPosition", textureUnitIdx);
-	//glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	//glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
 	//m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
 	//glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 
 	int nodePoolIndices[] = {
 		NODE_POOL_NEIGH_X,
@@ -898,17 +2599,98 @@ void Graphics::findNeighbours(Scene & renderingScene, int level) {
 		textureUnitIdx++;
 		int nodePoolTexID = nodePoolIndices[i];
 		std::string& shaderVarName = shaderVars[i];
-		m_nodePoolTextures[nodePoolTexID]->Activate(material->program, shaderVarName, textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[nodePoolTexID]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+		bindNodePool(material->program, nodePoolTexID, shaderVarName, textureUnitIdx, GL_READ_WRITE);
 	}
 	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
 	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 	glUniform1ui(glGetUniformLocation(material->program, "voxelGridResolution"), m_nodePoolDim);
 
 	//glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentListCmdBuf->m_bufferID);
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_levelNodesCmdBuf->m_bufferID);
+	glDrawArraysIndirect(GL_POINTS, (const void*)(level * sizeof(IndirectDrawCommand)));
+	glMemoryBarrier(m_nodePoolBarrierBits);
+}
+
+void Graphics::buildNodesMorton(bool flagPass) {
+	const Material * material = MaterialStore::getInstance().findMaterialWithName(flagPass ? "flagCellsMorton" : "writeNodesMorton");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	int textureUnitIdx = 0;
+	m_fragmentList->Activate(material->program, "voxelFragmentListPosition", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
+	textureUnitIdx++;
+	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	textureUnitIdx++;
+	m_mortonCellTable->Activate(material->program, "cellTable", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_mortonCellTable->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	glUniform1uiv(glGetUniformLocation(material->program, "tableOffset[0]"), m_numLevels, m_mortonTableOffset);
+	glUniform1uiv(glGetUniformLocation(material->program, "tableSlots[0]"), m_numLevels, m_mortonTableSlots);
+
+	if (flagPass)
+	{
+		textureUnitIdx++;
+		m_nextFreeNode->Activate(material->program, "nextFreeTile", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_nextFreeNode->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	}
+	else
+	{
+		int nodePoolIndices[] = {
+			NODE_POOL_NEXT,
+			NODE_POOL_NEIGH_X,
+			NODE_POOL_NEIGH_Y,
+			NODE_POOL_NEIGH_Z,
+			NODE_POOL_NEIGH_X_NEG,
+			NODE_POOL_NEIGH_Y_NEG,
+			NODE_POOL_NEIGH_Z_NEG,
+		};
+		std::string shaderVars[] = {
+			"nodePool_next",
+			"nodePool_X",
+			"nodePool_Y",
+			"nodePool_Z",
+			"nodePool_X_neg",
+			"nodePool_Y_neg",
+			"nodePool_Z_neg",
+		};
+		for (int i = 0; i < 7; i++)
+		{
+			textureUnitIdx++;
+			bindNodePool(material->program, nodePoolIndices[i], shaderVars[i], textureUnitIdx, GL_WRITE_ONLY);
+		}
+	}
+
+	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentListCmdBuf->m_bufferID);
 	glDrawArraysIndirect(GL_POINTS, 0);
+	// The tile counters are read as atomic counters by the passes after the build
+	glMemoryBarrier(m_nodePoolBarrierBits | GL_ATOMIC_COUNTER_BARRIER_BIT);
+}
+
+void Graphics::updateLevelCommands() {
+	// Size the passes over the nodes of a level by the tiles handed out so far
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("writeLevelCommands");
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	int textureUnitIdx = 0;
+	m_nextFreeNode->Activate(material->program, "nextFreeTile", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_nextFreeNode->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	textureUnitIdx++;
+	m_levelNodesCmdBuf->Activate(material->program, "levelCommands", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_levelNodesCmdBuf->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	textureUnitIdx++;
+	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
+
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glDrawArrays(GL_POINTS, 0, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
 }
 
 void Graphics::flagBrick() {
@@ -921,11 +2703,10 @@ void Graphics::flagBrick() {
 
 	int textureUnitIdx = 0;
 	m_fragmentList->Activate(material->program, "voxelFragmentListPosition", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
 
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_WRITE_ONLY);
 
 	glUniform1ui(glGetUniformLocation(material->program, "voxelGridResolution"), m_nodePoolDim);
 
@@ -933,7 +2714,7 @@ void Graphics::flagBrick() {
 
 	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentListCmdBuf->m_bufferID);
 	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glMemoryBarrier(m_nodePoolBarrierBits);
 }
 
 void Graphics::allocateBrick() {
@@ -945,23 +2726,21 @@ void Graphics::allocateBrick() {
 	glUniform1ui(glGetUniformLocation(material->program, "brickPoolResolution"), m_brickPoolDim);
 
 	int textureUnitIdx = 0;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_WRITE);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_WRITE);
+	textureUnitIdx++;
+	m_freeBricks->Activate(material->program, "freeBricks", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_freeBricks->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 
-	// bind atomic counter
+	// bind atomic counter, it is reset in clearBrickPool
 	int bindingPoint = 0;
 	glGetActiveAtomicCounterBufferiv(material->program, 0, GL_ATOMIC_COUNTER_BUFFER_BINDING, &bindingPoint);
 	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, bindingPoint, m_nextFreeBrick->m_bufferID);
-	GLuint *ptr = (GLuint *)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
-	ptr[0] = 1;
-	glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
 
 	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolNodesCmdBuf->m_bufferID);
 	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glMemoryBarrier(m_nodePoolBarrierBits);
 }
 
 void Graphics::writeLeafNode() {
@@ -984,13 +2763,11 @@ void Graphics::writeLeafNode() {
 		glBindImageTexture(textureUnitIdx, m_fragmentTextures[fIdx]->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	}
 	m_fragmentList->Activate(material->program, "voxelFragList_position", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
 	std::string brickPoolNames[3] = { "brickPool_color", "brickPool_irradiance","brickPool_normal" };
 	int brickPoolIndices[3] = { BRICK_POOL_COLOR, BRICK_POOL_IRRADIANCE, BRICK_POOL_NORMAL };
@@ -1000,6 +2777,7 @@ void Graphics::writeLeafNode() {
 		m_brickPoolTextures[bIdx]->Activate(material->program, brickPoolNames[i], textureUnitIdx);
 		glBindImageTexture(textureUnitIdx, m_brickPoolTextures[bIdx]->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
 	}
+	bindTopLevelIndex(material->program, textureUnitIdx);
 	glUniform1ui(glGetUniformLocation(material->program, "voxelGridResolution"), m_nodePoolDim);
 
 	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_fragmentListCmdBuf->m_bufferID);
@@ -1010,11 +2788,10 @@ void Graphics::writeLeafNode() {
 void Graphics::spreadLeafBrick(std::shared_ptr<Texture3D> brickPoolTexture) {
 	// Interpolate values in corner voxels and store the results into remaining voxels
 	MaterialStore& matStore = MaterialStore::getInstance();
-	const Material * material = matStore.findMaterialWithName("spreadLeaf");
+	const Material * material = matStore.findMaterialWithName(threadMaterialName("spreadLeaf"));
 
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[m_numLevels]->m_bufferID);
 
 	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 	glUniform1ui(glGetUniformLocation(material->program, "level"), m_numLevels-1);
@@ -1023,181 +2800,328 @@ void Graphics::spreadLeafBrick(std::shared_ptr<Texture3D> brickPoolTexture) {
 	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
 	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	textureUnitIdx++;
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 	
-	glDrawArraysIndirect(GL_POINTS, 0);
+	drawLevelThreads(material->program, m_numLevels - 1);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
 void Graphics::borderTransfer(int level, std::shared_ptr<Texture3D> brickPoolTexture) {
 	MaterialStore& matStore = MaterialStore::getInstance();
-	const Material * material = matStore.findMaterialWithName("borderTransfer");
+	const Material * material = matStore.findMaterialWithName(m_updateRegionActive ? "borderTransferRegion" : "borderTransfer");
 
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
 	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
+	if (m_updateRegionActive)
+	{
+		glUniform3iv(glGetUniformLocation(material->program, "updateRegionMin"), 1, glm::value_ptr(m_updateCellMin[level]));
+		glUniform3iv(glGetUniformLocation(material->program, "updateRegionMax"), 1, glm::value_ptr(m_updateCellMax[level]));
+	}
 
 	int textureUnitIdx = 0;
 	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_WRITE);
 	textureUnitIdx++;
 	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	textureUnitIdx++;
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 
 
 	textureUnitIdx++;
 	for (int i = 0; i < 1; i++)
 	{
 		glUniform1ui(glGetUniformLocation(material->program, "axis"), 0);
-		m_nodePoolTextures[NODE_POOL_NEIGH_X]->Activate(material->program, "nodePool_Neighbour", textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEIGH_X]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-		glDrawArraysIndirect(GL_POINTS, 0);
+		bindNodePool(material->program, NODE_POOL_NEIGH_X, "nodePool_Neighbour", textureUnitIdx, GL_READ_WRITE);
+		drawLevelThreads(material->program, level, 1);
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
 		glUniform1ui(glGetUniformLocation(material->program, "axis"), 1);
-		m_nodePoolTextures[NODE_POOL_NEIGH_Y]->Activate(material->program, "nodePool_Neighbour", textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEIGH_Y]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-		glDrawArraysIndirect(GL_POINTS, 0);
+		bindNodePool(material->program, NODE_POOL_NEIGH_Y, "nodePool_Neighbour", textureUnitIdx, GL_READ_WRITE);
+		drawLevelThreads(material->program, level, 1);
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
 		glUniform1ui(glGetUniformLocation(material->program, "axis"), 2);
-		m_nodePoolTextures[NODE_POOL_NEIGH_Z]->Activate(material->program, "nodePool_Neighbour", textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEIGH_Z]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-		glDrawArraysIndirect(GL_POINTS, 0);
+		bindNodePool(material->program, NODE_POOL_NEIGH_Z, "nodePool_Neighbour", textureUnitIdx, GL_READ_WRITE);
+		drawLevelThreads(material->program, level, 1);
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 	}
 }
 
-void Graphics::mipmapCenter(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapCenter");
+void Graphics::borderTransferBricks(int level, const std::vector<int> & pools) {
+	// Averages the brick borders along all three axes for all given pools in one pass, the same as borderTransfer on each
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName(threadMaterialName("borderTransferBricks"));
 
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-
 	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+	if (m_updateRegionActive)
+	{
+		glUniform3iv(glGetUniformLocation(material->program, "updateRegionMin"), 1, glm::value_ptr(m_updateCellMin[level]));
+		glUniform3iv(glGetUniformLocation(material->program, "updateRegionMax"), 1, glm::value_ptr(m_updateCellMax[level]));
+	}
+	const size_t numPools = std::min(pools.size(), (size_t)MAX_MIPMAP_POOLS);
+	glUniform1i(glGetUniformLocation(material->program, "numBrickPools"), (GLint)numPools);
 
+	// The images first, the node pool fields are read as texture buffers
 	int textureUnitIdx = 0;
-	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	for (size_t i = 0; i < numPools; ++i)
+	{
+		std::shared_ptr<Texture3D> & brickPoolTexture = m_brickPoolTextures[pools[i]];
+		brickPoolTexture->Activate(material->program, "brickPools[" + std::to_string(i) + "]", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+		textureUnitIdx++;
+	}
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+	if (nodePoolLayout == NODE_POOL_TEXTURES)
+	{
+		const int fields[] = { NODE_POOL_COLOR, NODE_POOL_NEIGH_X, NODE_POOL_NEIGH_X_NEG, NODE_POOL_NEIGH_Y, NODE_POOL_NEIGH_Y_NEG, NODE_POOL_NEIGH_Z, NODE_POOL_NEIGH_Z_NEG };
+		const char * names[] = { "nodePool_color", "nodePool_X", "nodePool_X_neg", "nodePool_Y", "nodePool_Y_neg", "nodePool_Z", "nodePool_Z_neg" };
+		for (int i = 0; i < 7; i++)
+		{
+			textureUnitIdx++;
+			m_nodePoolTextures[fields[i]]->Activate(material->program, names[i], textureUnitIdx);
+		}
+	}
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	// Groups at the region's upper bound can be owned by the node one cell beyond it
+	drawLevelThreads(material->program, level, 1, 1);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::mipmapFaces(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapFaces");
+void Graphics::mipmapBricks(int level, const std::vector<int> & pools) {
+	// Filters the bricks of the level from their children's bricks, for all given pools in one pass
+	const Material * material = MaterialStore::getInstance().findMaterialWithName(threadMaterialName("mipmapBricks"));
+
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
 	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+	const size_t numPools = std::min(pools.size(), (size_t)MAX_MIPMAP_POOLS);
+	glUniform1i(glGetUniformLocation(material->program, "numBrickPools"), (GLint)numPools);
 
 	int textureUnitIdx = 0;
 	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
 	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	for (size_t i = 0; i < numPools; ++i)
+	{
+		// Empty children of the normal pool count as the zero normal
+		glm::vec4 emptyColor = pools[i] == BRICK_POOL_NORMAL ? glm::vec4(0.5, 0.5, 0.5, 0.0) : glm::vec4(0);
+		std::string index = "[" + std::to_string(i) + "]";
+		glUniform4fv(glGetUniformLocation(material->program, ("emptyColors" + index).c_str()), 1, glm::value_ptr(emptyColor));
+
+		std::shared_ptr<Texture3D> & brickPoolTexture = m_brickPoolTextures[pools[i]];
+		brickPoolTexture->Activate(material->program, "brickPools" + index, textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+		textureUnitIdx++;
+	}
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_WRITE);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_WRITE);
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	drawLevelThreads(material->program, level);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::mipmapCorners(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapCorners");
+void Graphics::mipmapAnisotropic(int level) {
+	// Filters the directional irradiance bricks of the level, the positive directions first
+	const Material * material = MaterialStore::getInstance().findMaterialWithName(threadMaterialName("mipmapAnisotropic"));
+
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
 	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+
+	const int pools[2][3] = {
+		{ BRICK_POOL_COLOR_X, BRICK_POOL_COLOR_Y, BRICK_POOL_COLOR_Z },
+		{ BRICK_POOL_COLOR_X_NEG, BRICK_POOL_COLOR_Y_NEG, BRICK_POOL_COLOR_Z_NEG }
+	};
+	for (int sign = 0; sign < 2; sign++)
+	{
+		glUniform1i(glGetUniformLocation(material->program, "directionSign"), sign == 0 ? 1 : -1);
+
+		int textureUnitIdx = 0;
+		m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+		textureUnitIdx++;
+		m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->Activate(material->program, "brickPool_value", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			textureUnitIdx++;
+			std::shared_ptr<Texture3D> & brickPoolTexture = m_brickPoolTextures[pools[sign][axis]];
+			brickPoolTexture->Activate(material->program, "brickPools[" + std::to_string(axis) + "]", textureUnitIdx);
+			glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+		}
+		textureUnitIdx++;
+		bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_WRITE);
+		textureUnitIdx++;
+		bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_WRITE);
+
+		drawLevelThreads(material->program, level);
+	}
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void Graphics::buildStaticOctree(Scene & renderingScene) {
+	// Build the octree of the static renderers only and tag its nodes
+	clearNodePool(renderingScene);
+	clearBrickPool(renderingScene, true);
+	clearFragmentTex(renderingScene);
+
+	std::vector<MeshRenderer*> staticRenderers;
+	for (auto * renderer : renderingScene.renderers)
+	{
+		if (renderer->enabled && renderer->isStatic)
+		{
+			staticRenderers.push_back(renderer);
+		}
+	}
+	voxelizeScene(renderingScene, staticRenderers);
+	buildOctreeNodes(renderingScene, true);
+	tagStaticNodes();
+
+	// Remember where the dynamic part of the pools and the fragment list starts
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeNode->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(m_staticLevelTiles), m_staticLevelTiles);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeBrick->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &m_staticBrickCount);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_fragmentListCounter->m_bufferID);
+	glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &m_staticFragmentCount);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	if (m_staticFragmentCount > m_staticFragmentCapacity)
+	{
+		m_staticFragmentCapacity = m_staticFragmentCount;
+		m_staticFragmentValues = std::shared_ptr<TextureBuffer>(new TextureBuffer(2 * m_staticFragmentCapacity * sizeof(GLuint)));
+	}
+	copyStaticFragments(false);
+	m_staticSVOBuilt = true;
+}
+
+void Graphics::tagStaticNodes() {
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName("tagStaticNodes");
+
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
 	int textureUnitIdx = 0;
-	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_WRITE);
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolNodesCmdBuf->m_bufferID);
 	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glMemoryBarrier(m_nodePoolBarrierBits);
 }
 
-void Graphics::mipmapEdges(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapEdges");
+void Graphics::clearDynamicNodes() {
+	// Reset the node pool to the static octree
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName("clearDynamicNodes");
+
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
-	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+	int nodePoolIndices[] = {
+		NODE_POOL_NEXT,
+		NODE_POOL_COLOR,
+		NODE_POOL_NEIGH_X,
+		NODE_POOL_NEIGH_Y,
+		NODE_POOL_NEIGH_Z,
+		NODE_POOL_NEIGH_X_NEG,
+		NODE_POOL_NEIGH_Y_NEG,
+		NODE_POOL_NEIGH_Z_NEG,
+	};
+	std::string shaderVars[] = {
+		"nodePool_next",
+		"nodePool_color",
+		"nodePool_X",
+		"nodePool_Y",
+		"nodePool_Z",
+		"nodePool_X_neg",
+		"nodePool_Y_neg",
+		"nodePool_Z_neg",
+	};
+	for (int i = 0; i < 8; i++)
+	{
+		int nodePoolTexID = nodePoolIndices[i];
+		bindNodePool(material->program, nodePoolTexID, shaderVars[i], i, GL_READ_WRITE);
+	}
+	m_freeBricks->Activate(material->program, "freeBricks", 8);
+	glBindImageTexture(8, m_freeBricks->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	glUniform1ui(glGetUniformLocation(material->program, "brickPoolResolution"), m_brickPoolDim);
+	glUniform1ui(glGetUniformLocation(material->program, "numStaticBricks"), m_staticBrickCount);
 
-	int textureUnitIdx = 0;
-	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolNodesCmdBuf->m_bufferID);
+	glDrawArraysIndirect(GL_POINTS, 0);
+	glMemoryBarrier(m_nodePoolBarrierBits);
+
+	// The dynamic tiles are handed out again, the dynamic bricks were put on the free list
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, m_nextFreeNode->m_bufferID);
+	GLuint *ptr = (GLuint *)glMapBufferRange(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint) * MAX_NODE_POOL_LEVELS, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	for (int i = 0; i < MAX_NODE_POOL_LEVELS; i++)
+	{
+		ptr[i] = m_staticLevelTiles[i];
+	}
+	glUnmapBuffer(GL_ATOMIC_COUNTER_BUFFER);
+}
+
+void Graphics::copyStaticFragments(bool restore) {
+	// Save the fragment texture values of the static fragments, or write them back
+	if (m_staticFragmentCount == 0)
+	{
+		return;
+	}
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName("copyStaticFragments");
+
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	int textureUnitIdx = 0;
+	std::string fragmentTexNames[2] = { "voxelFragTex_color", "voxelFragTex_normal" };
+	int fragmentTexIndices[2] = { FRAG_TEX_COLOR, FRAG_TEX_NORMAL };
+	for (textureUnitIdx = 0; textureUnitIdx < 2; textureUnitIdx++)
+	{
+		int fIdx = fragmentTexIndices[textureUnitIdx];
+		m_fragmentTextures[fIdx]->Activate(material->program, fragmentTexNames[textureUnitIdx], textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, m_fragmentTextures[fIdx]->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	}
+	m_fragmentList->Activate(material->program, "voxelFragList_position", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_fragmentList->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_staticFragmentValues->Activate(material->program, "staticFragmentValues", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_staticFragmentValues->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodePoolOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	glUniform1i(glGetUniformLocation(material->program, "restore"), restore ? 1 : 0);
+	glDrawArrays(GL_POINTS, 0, m_staticFragmentCount);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
 void Graphics::clearNodeMap()
 {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("clearNodeMap");
-	glUseProgram(material->program);
-	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-
-	int textureUnitIdx = 0;
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_lightNodeMapCmdBuf->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	// The lists in the node map are read up to their counts, only the counts and the flags are reset
+	glClearNamedBufferData(m_litNodeCounts->m_bufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glClearNamedBufferData(m_litNodeFlags->m_bufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
 }
 
 void Graphics::shadowMap(Scene & renderingScene, const DirectionalLight& light) {
@@ -1230,231 +3154,222 @@ void Graphics::shadowMap(Scene & renderingScene, const DirectionalLight& light)
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::lightInjection(Scene& renderingScene, const DirectionalLight& light) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("lightInjection");
-	glUseProgram(material->program);
-	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+void Graphics::shadowMapLayered(Scene & renderingScene) {
+	// The shadow maps of all lights in one pass, the geometry shader renders every triangle into the layer of each light
+	const int numLights = std::min((int)renderingScene.directionalLights.size(), MAX_DIRECTIONAL_LIGHTS);
+	if (numLights != m_shadowMapLayers)
+	{
+		if (m_shadowMapArrayFBO)
+		{
+			glDeleteFramebuffers(1, &m_shadowMapArrayFBO);
+			glDeleteTextures(1, &m_shadowMapArray);
+			glDeleteTextures(1, &m_shadowMapArrayDepth);
+			m_shadowMapArrayFBO = 0;
+		}
+		m_shadowMapLayers = numLights;
+		if (numLights == 0)
+		{
+			return;
+		}
 
-	// TODO: add shadow map
-	glm::mat4 voxelGridTransformI = getVoxelTransformInverse(renderingScene);
-	glUniformMatrix4fv(glGetUniformLocation(material->program, "voxelGridTransformI"), 1, GL_FALSE, glm::value_ptr(voxelGridTransformI));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
+		// Same format as m_shadowMapBuffer, the first layer is copied into it
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_shadowMapArray);
+		glTextureStorage3D(m_shadowMapArray, 1, GL_RGB32F, m_shadowMapRes, m_shadowMapRes, numLights);
+		glTextureParameteri(m_shadowMapArray, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_shadowMapArray, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(m_shadowMapArray, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_shadowMapArray, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_shadowMapArrayDepth);
+		glTextureStorage3D(m_shadowMapArrayDepth, 1, GL_DEPTH_COMPONENT24, m_shadowMapRes, m_shadowMapRes, numLights);
+
+		glCreateFramebuffers(1, &m_shadowMapArrayFBO);
+		glNamedFramebufferTexture(m_shadowMapArrayFBO, GL_COLOR_ATTACHMENT0, m_shadowMapArray, 0);
+		glNamedFramebufferTexture(m_shadowMapArrayFBO, GL_DEPTH_ATTACHMENT, m_shadowMapArrayDepth, 0);
+	}
+	if (numLights == 0)
+	{
+		return;
+	}
 
-	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
-	uploadLighting(renderingScene, material->program);
-	//glm::vec3 lightColor(1,1,1);
-	//glUniform3f(glGetUniformLocation(material->program, "lightColor"), lightColor.r, lightColor.g, lightColor.b);
-	//glUniform3f(glGetUniformLocation(material->program, "lightDir"), m_lightDir.r, m_lightDir.g, m_lightDir.b);
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("shadowMapLayered");
+	glUseProgram(material->program);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_shadowMapArrayFBO);
 
-	int textureUnitIdx = 0;
-	m_shadowMapBuffer->ActivateAsTexture(material->program, "smPosition", textureUnitIdx);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
-	textureUnitIdx++;
+	glEnable(GL_DEPTH_TEST);
+	glViewport(0, 0, m_shadowMapRes, m_shadowMapRes);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_CULL_FACE);
 
-	std::string brickPoolNames[3] = { "brickPool_color", "brickPool_irradiance","brickPool_normal" };
-	int brickPoolIndices[3] = { BRICK_POOL_COLOR, BRICK_POOL_IRRADIANCE, BRICK_POOL_NORMAL };
-	for (int i = 0; i < 2; i++, textureUnitIdx++)
+	glm::mat4 lightViewProj[MAX_DIRECTIONAL_LIGHTS];
+	for (int i = 0; i < numLights; ++i)
 	{
-		int bIdx = brickPoolIndices[i];
-		m_brickPoolTextures[bIdx]->Activate(material->program, brickPoolNames[i], textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_brickPoolTextures[bIdx]->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+		const DirectionalLight & light = renderingScene.directionalLights[i];
+		lightViewProj[i] = light.getLightProjectionMatrix() * light.getLightViewMatrix();
 	}
+	glUniformMatrix4fv(glGetUniformLocation(material->program, "lightViewProj[0]"), numLights, GL_FALSE, glm::value_ptr(lightViewProj[0]));
+	glUniform1i(glGetUniformLocation(material->program, NUMBER_OF_DIRECTIONAL_LIGHTS_NAME), numLights);
 
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	renderQueue(renderingScene.renderers, material->program, true);
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[m_numLevels-1]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	// The cone tracer shadows the first light, as with shadowMap
+	const DirectionalLight & light = renderingScene.directionalLights[0];
+	m_lightViewMat = light.getLightViewMatrix();
+	m_lightProjMat = light.getLightProjectionMatrix();
+	m_lightDir = light.m_direction;
+	glCopyImageSubData(m_shadowMapArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+		m_shadowMapBuffer->textureColorBuffer, GL_TEXTURE_2D, 0, 0, 0, 0, m_shadowMapRes, m_shadowMapRes, 1);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::spreadLeafBrickLight(std::shared_ptr<Texture3D> brickPoolTexture) {
-	// Interpolate values in corner voxels and store the results into remaining voxels
-	MaterialStore& matStore = MaterialStore::getInstance();
-	const Material * material = matStore.findMaterialWithName("spreadLeafLight");
+void Graphics::lightInjection(Scene& renderingScene) {
+	// One thread per texel of every layer, the lights set their bit in the leaf brick corners they reach
+	if (m_shadowMapLayers == 0)
+	{
+		return;
+	}
 
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("lightInjection");
 	glUseProgram(material->program);
-	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[m_numLevels - 1]->m_bufferID);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // the layered shadow map is still bound
 
-	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
-	glUniform1ui(glGetUniformLocation(material->program, "level"), m_numLevels - 1);
+	glm::mat4 voxelGridTransformI = getVoxelTransformInverse(renderingScene);
+	glUniformMatrix4fv(glGetUniformLocation(material->program, "voxelGridTransformI"), 1, GL_FALSE, glm::value_ptr(voxelGridTransformI));
 	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
 	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
 
-	int textureUnitIdx = 0;
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
-	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-
-	glDrawArraysIndirect(GL_POINTS, 0);
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-}
-
-void Graphics::borderTransferLight(int level, std::shared_ptr<Texture3D> brickPoolTexture) {
-	MaterialStore& matStore = MaterialStore::getInstance();
-	const Material * material = matStore.findMaterialWithName("borderTransfer");
-
-	glUseProgram(material->program);
-	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[level]->m_bufferID);
-	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
+	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 
 	int textureUnitIdx = 0;
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	glBindTextureUnit(textureUnitIdx, m_shadowMapArray);
+	glUniform1i(glGetUniformLocation(material->program, "smPosition"), textureUnitIdx);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
+	textureUnitIdx++;
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
 	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-
-	{
-		textureUnitIdx++;
-		glUniform1ui(glGetUniformLocation(material->program, "axis"), 0);
-		m_nodePoolTextures[NODE_POOL_NEIGH_X]->Activate(material->program, "nodePool_Neighbour", textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEIGH_X]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-		glDrawArraysIndirect(GL_POINTS, 0);
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-		glUniform1ui(glGetUniformLocation(material->program, "axis"), 1);
-		m_nodePoolTextures[NODE_POOL_NEIGH_Y]->Activate(material->program, "nodePool_Neighbour", textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEIGH_Y]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-		glDrawArraysIndirect(GL_POINTS, 0);
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-		glUniform1ui(glGetUniformLocation(material->program, "axis"), 2);
-		m_nodePoolTextures[NODE_POOL_NEIGH_Z]->Activate(material->program, "nodePool_Neighbour", textureUnitIdx);
-		glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEIGH_Z]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-		glDrawArraysIndirect(GL_POINTS, 0);
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	}
-}
-
-void Graphics::mipmapCenterLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapCenterLight");
-
-	glUseProgram(material->program);
-	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+	// The rgba8 pool is cleared to zero, it holds the light bits until resolveLightInjection
+	m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->Activate(material->program, "brickPool_irradiance", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	textureUnitIdx++;
 
-	int textureUnitIdx = 0;
+	// The lit nodes are listed per level, for the passes of drawLevelThreads with m_lightThreadsActive
 	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	m_litNodeCounts->Activate(material->program, "litNodeCounts", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_litNodeCounts->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_litNodeFlags->Activate(material->program, "litNodeFlags", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_litNodeFlags->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	bindTopLevelIndex(material->program, textureUnitIdx);
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	glDrawArrays(GL_POINTS, 0, m_shadowMapRes * m_shadowMapRes * m_shadowMapLayers);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::mipmapFacesLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapFacesLight");
+void Graphics::writeLightCommands() {
+	// Size the passes over the lit nodes of a level by the nodes the light injection listed
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("writeLightCommands");
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-	
-	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
 
 	int textureUnitIdx = 0;
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	m_litNodeCounts->Activate(material->program, "litNodeCounts", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_litNodeCounts->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_levelNodesCmdBuf->Activate(material->program, "levelCommands", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_levelNodesCmdBuf->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_lightNodesCmdBuf->Activate(material->program, "lightCommands", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_lightNodesCmdBuf->m_textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32UI);
+	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
+	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glDrawArrays(GL_POINTS, 0, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
 }
 
-void Graphics::mipmapCornersLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapCornersLight");
+void Graphics::clearLitBricks() {
+	// Clear the bricks of the nodes in the last light update's lists, with the borders it wrote into their neighbours
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("clearLitBricksLight");
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
 
-	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+	std::vector<int> pools = { BRICK_POOL_IRRADIANCE };
+	if (m_litBricksAnisotropic)
+	{
+		pools.insert(pools.end(), { BRICK_POOL_COLOR_X, BRICK_POOL_COLOR_X_NEG, BRICK_POOL_COLOR_Y, BRICK_POOL_COLOR_Y_NEG, BRICK_POOL_COLOR_Z, BRICK_POOL_COLOR_Z_NEG });
+	}
+	glUniform1i(glGetUniformLocation(material->program, "numBrickPools"), (GLint)pools.size());
 
 	int textureUnitIdx = 0;
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
-	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	for (size_t i = 0; i < pools.size(); ++i)
+	{
+		std::shared_ptr<Texture3D> & brickPoolTexture = m_brickPoolTextures[pools[i]];
+		brickPoolTexture->Activate(material->program, "brickPools[" + std::to_string(i) + "]", textureUnitIdx);
+		glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		textureUnitIdx++;
+	}
+	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+	if (nodePoolLayout == NODE_POOL_TEXTURES)
+	{
+		const int fields[] = { NODE_POOL_COLOR, NODE_POOL_NEIGH_X, NODE_POOL_NEIGH_X_NEG, NODE_POOL_NEIGH_Y, NODE_POOL_NEIGH_Y_NEG, NODE_POOL_NEIGH_Z, NODE_POOL_NEIGH_Z_NEG };
+		const char * names[] = { "nodePool_color", "nodePool_X", "nodePool_X_neg", "nodePool_Y", "nodePool_Y_neg", "nodePool_Z", "nodePool_Z_neg" };
+		for (int i = 0; i < 7; i++)
+		{
+			textureUnitIdx++;
+			m_nodePoolTextures[fields[i]]->Activate(material->program, names[i], textureUnitIdx);
+		}
+	}
+	else
+	{
+		bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
+	}
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	// The lists, counts and commands of the last update are still in place, clearNodeMap runs after this
+	m_lightThreadsActive = true;
+	for (int level = 0; level < m_numLevels; ++level)
+	{
+		glUniform1ui(glGetUniformLocation(material->program, "level"), level);
+		drawLevelThreads(material->program, level);
+	}
+	m_lightThreadsActive = false;
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void Graphics::mipmapEdgesLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor) {
-	const Material * material = MaterialStore::getInstance().findMaterialWithName("mipmapEdgesLight");
+void Graphics::resolveLightInjection(Scene& renderingScene) {
+	// Sum the colors of the lights that reached each leaf brick corner and reflect them with the voxel color
+	MaterialStore& matStore = MaterialStore::getInstance();
+	const Material * material = matStore.findMaterialWithName(threadMaterialName("resolveLightInjection"));
+
 	glUseProgram(material->program);
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-	glUniform1ui(glGetUniformLocation(material->program, "level"), level);
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapOffset[0]"), m_nodeMapOffsets.size(), glm::value_ptr(m_nodeMapOffsets[0]));
-	glUniform2iv(glGetUniformLocation(material->program, "nodeMapSize[0]"), m_nodeMapSizes.size(), glm::value_ptr(m_nodeMapSizes[0]));
-	glUniform4f(glGetUniformLocation(material->program, "emptyColor"), emptyColor.r, emptyColor.g, emptyColor.b, emptyColor.a);
+	glUniform1ui(glGetUniformLocation(material->program, "numLevels"), m_numLevels);
+	uploadLighting(renderingScene, material->program);
+	glUniform1i(glGetUniformLocation(material->program, NUMBER_OF_DIRECTIONAL_LIGHTS_NAME), m_shadowMapLayers);
 
 	int textureUnitIdx = 0;
-	m_lightNodeMap->Activate(material->program, textureUnitIdx, "nodeMap");
-	glBindImageTexture(textureUnitIdx, m_lightNodeMap->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_levelAddressBuffer->Activate(material->program, "levelAddressBuffer", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_levelAddressBuffer->m_textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
 	textureUnitIdx++;
-	brickPoolTexture->Activate(material->program, "brickPool_value", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, brickPoolTexture->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA8);
+	bindNodePool(material->program, NODE_POOL_COLOR, "nodePool_color", textureUnitIdx, GL_READ_ONLY);
+	textureUnitIdx++;
+	m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->Activate(material->program, "brickPool_irradiance", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_brickPoolTextures[BRICK_POOL_IRRADIANCE]->textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_NEXT]->Activate(material->program, "nodePool_next", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_NEXT]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	m_brickPoolTextures[BRICK_POOL_COLOR]->Activate(material->program, "brickPool_color", textureUnitIdx);
+	glBindImageTexture(textureUnitIdx, m_brickPoolTextures[BRICK_POOL_COLOR]->textureID, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
 	textureUnitIdx++;
-	m_nodePoolTextures[NODE_POOL_COLOR]->Activate(material->program, "nodePool_color", textureUnitIdx);
-	glBindImageTexture(textureUnitIdx, m_nodePoolTextures[NODE_POOL_COLOR]->m_textureID, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+	bindNodePool(material->program, NODE_POOL_NEXT, "nodePool_next", textureUnitIdx, GL_READ_ONLY);
 
-	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_nodeMapOnLevelCmdBuf[level]->m_bufferID);
-	glDrawArraysIndirect(GL_POINTS, 0);
+	drawLevelThreads(material->program, m_numLevels - 1);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
@@ -1492,6 +3407,174 @@ void Graphics::voxelize(Scene & renderingScene, bool clearVoxelization)
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
+// ----------------------
+// Voxel clipmap.
+// ----------------------
+void Graphics::updateClipmap(Scene & renderingScene)
+{
+	if (!m_clipmap)
+	{
+		// The cascades are voxelized through the framebuffer of the SVO voxelization, which has the SVO resolution
+		int resolution = 16;
+		while (resolution * 2 <= std::min(clipmapResolution, m_nodePoolDim))
+		{
+			resolution *= 2;
+		}
+		if (resolution != clipmapResolution)
+		{
+			std::cout << "Clipmap resolution " << clipmapResolution << " is not supported, using " << resolution << "." << std::endl;
+		}
+		m_clipmap = std::unique_ptr<VoxelClipmap>(new VoxelClipmap(resolution, clipmapCascades, clipmapVoxelSize));
+	}
+
+	// Only the slabs the cascades moved into and the cells around changed renderers are voxelized again
+	std::vector<VoxelClipmap::Region> regions;
+	m_clipmap->update(renderingScene.renderingCamera->position, renderingScene.renderers, regions);
+	if (!regions.empty())
+	{
+		voxelizeClipmap(renderingScene, regions);
+	}
+
+	// The radiance is injected again every frame, the light may have changed anywhere
+	GLubyte clearColor[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < m_clipmap->getNumCascades(); ++i)
+	{
+		glClearTexImage(m_clipmap->getTexture(i, VoxelClipmap::CLIPMAP_RADIANCE)->textureID, 0, GL_RGBA, GL_UNSIGNED_BYTE, clearColor);
+	}
+	for (unsigned int i = 0; i < renderingScene.directionalLights.size(); ++i)
+	{
+		auto& light = renderingScene.directionalLights[i];
+		shadowMap(renderingScene, light);
+		if (injectLight)
+		{
+			injectClipmapLight(renderingScene, light);
+		}
+	}
+}
+
+void Graphics::voxelizeClipmap(Scene & renderingScene, const std::vector<VoxelClipmap::Region> & regions)
+{
+	// Clear the cells of the regions first, they may overlap
+	std::vector<VoxelClipmap::TexelBox> boxes;
+	GLubyte clearColor[4] = { 0, 0, 0, 0 };
+	for (auto & region : regions)
+	{
+		boxes.clear();
+		m_clipmap->getTexelBoxes(region, boxes);
+		GLuint textureID = m_clipmap->getTexture(region.cascade, VoxelClipmap::CLIPMAP_ALBEDO)->textureID;
+		for (auto & box : boxes)
+		{
+			glClearTexSubImage(textureID, 0, box.offset.x, box.offset.y, box.offset.z, box.size.x, box.size.y, box.size.z, GL_RGBA, GL_UNSIGNED_BYTE, clearColor);
+		}
+	}
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("clipmapVoxelize");
+	glUseProgram(material->program);
+
+	int resolution = m_clipmap->getResolution();
+	glUniform1i(glGetUniformLocation(material->program, "clipmapResolution"), resolution);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_voxelizeFBO);
+	glViewport(0, 0, resolution, resolution);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	std::vector<MeshRenderer*> renderers;
+	for (auto & region : regions)
+	{
+		// Only the renderers overlapping the region are drawn into it
+		float voxelSize = m_clipmap->getVoxelSize(region.cascade);
+		glm::vec3 regionMin = glm::vec3(region.cellMin) * voxelSize;
+		glm::vec3 regionMax = glm::vec3(region.cellMax + 1) * voxelSize;
+		renderers.clear();
+		for (auto * renderer : renderingScene.renderers) if (renderer->enabled)
+		{
+			glm::vec3 boxMin, boxMax;
+			renderer->getBoundingBox(boxMin, boxMax);
+			if (glm::all(glm::lessThanEqual(boxMin, regionMax)) && glm::all(glm::greaterThanEqual(boxMax, regionMin)))
+			{
+				renderers.push_back(renderer);
+			}
+		}
+		if (renderers.empty())
+		{
+			continue;
+		}
+
+		auto albedo = m_clipmap->getTexture(region.cascade, VoxelClipmap::CLIPMAP_ALBEDO);
+		albedo->Activate(material->program, "clipmapAlbedo", 0);
+		glBindImageTexture(0, albedo->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		glUniform1f(glGetUniformLocation(material->program, "voxelSize"), voxelSize);
+		glUniform3iv(glGetUniformLocation(material->program, "regionMin"), 1, glm::value_ptr(region.cellMin));
+		glUniform3iv(glGetUniformLocation(material->program, "regionMax"), 1, glm::value_ptr(region.cellMax));
+
+		renderQueue(renderers, material->program, true);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Graphics::injectClipmapLight(Scene & renderingScene, const DirectionalLight & light)
+{
+	const Material * material = MaterialStore::getInstance().findMaterialWithName("clipmapLightInjection");
+	glUseProgram(material->program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	// The shader injects the first light, which is the one the shadow map was rendered for
+	light.Upload(material->program, 0);
+	glUniform1i(glGetUniformLocation(material->program, NUMBER_OF_DIRECTIONAL_LIGHTS_NAME), 1);
+	glm::mat4 lightViewProj = m_lightProjMat * m_lightViewMat;
+	glUniformMatrix4fv(glGetUniformLocation(material->program, "lightViewProj"), 1, GL_FALSE, glm::value_ptr(lightViewProj));
+
+	int textureUnitIdx = 0;
+	m_shadowMapBuffer->ActivateAsTexture(material->program, "smPosition", textureUnitIdx);
+	textureUnitIdx++;
+	bindClipmap(material->program, textureUnitIdx, true);
+
+	glDrawArrays(GL_POINTS, 0, m_shadowMapRes * m_shadowMapRes);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Graphics::bindClipmap(const GLuint program, int & textureUnitIdx, bool radianceAsImage)
+{
+	int numCascades = m_clipmap->getNumCascades();
+	glm::ivec3 origins[MAX_CLIPMAP_CASCADES];
+	for (int i = 0; i < numCascades; ++i)
+	{
+		origins[i] = m_clipmap->getOrigin(i);
+	}
+	glUniform1i(glGetUniformLocation(program, "clipmapResolution"), m_clipmap->getResolution());
+	glUniform1i(glGetUniformLocation(program, "numCascades"), numCascades);
+	glUniform1f(glGetUniformLocation(program, "clipmapVoxelSize"), m_clipmap->getVoxelSize(0));
+	glUniform3iv(glGetUniformLocation(program, "clipmapOrigin[0]"), numCascades, glm::value_ptr(origins[0]));
+
+	// Every sampler of the arrays needs a texture, the unused ones get the last cascade
+	for (int i = 0; i < MAX_CLIPMAP_CASCADES; ++i)
+	{
+		int cascade = std::min(i, numCascades - 1);
+		std::string index = "[" + std::to_string(i) + "]";
+		m_clipmap->getTexture(cascade, VoxelClipmap::CLIPMAP_ALBEDO)->Activate(program, "clipmapAlbedo" + index, textureUnitIdx);
+		textureUnitIdx++;
+		auto radiance = m_clipmap->getTexture(cascade, VoxelClipmap::CLIPMAP_RADIANCE);
+		if (radianceAsImage)
+		{
+			// Image units are fewer than texture units, the cascades take the first ones
+			glUniform1i(glGetUniformLocation(program, ("clipmapRadiance" + index).c_str()), i);
+			glBindImageTexture(i, radiance->textureID, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		}
+		else
+		{
+			radiance->Activate(program, "clipmapRadiance" + index, textureUnitIdx);
+			textureUnitIdx++;
+		}
+	}
+}
+
 // ----------------------
 // Voxelization visualization.
 // ----------------------
@@ -1580,4 +3663,11 @@ Graphics::~Graphics()
 	if (cubeMeshRenderer) delete cubeMeshRenderer;
 	if (cubeShape) delete cubeShape;
 	if (voxelTexture) delete voxelTexture;
+	if (m_voxelizeFBO) glDeleteFramebuffers(1, &m_voxelizeFBO);
+	if (m_shadowMapArrayFBO)
+	{
+		glDeleteFramebuffers(1, &m_shadowMapArrayFBO);
+		glDeleteTextures(1, &m_shadowMapArray);
+		glDeleteTextures(1, &m_shadowMapArrayDepth);
+	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <string>
 
 #define GLEW_STATIC
 #include <glew.h>
@@ -15,8 +16,14 @@
 #include "Texture2D.h"
 #include "TextureBuffer.h"
 #include "IndexBuffer.h"
+#include "VoxelClipmap.h"
+#include "../SparseVoxelOctree/BrickStreamer.h"
 
-#define MAX_NODE_POOL_LEVELS 12
+#define MAX_NODE_POOL_LEVELS 13 // the 12 levels of a 4096^3 voxel grid and the end of the leaf level
+#define MAX_MIPMAP_POOLS 3 // brick pools filtered by one mipmapBricks or borderTransferBricks pass
+#define LIGHT_THREADS_TEXTURE_UNIT 16 // first of the units drawLevelThreads binds the lit node lists to
+#define MAX_DIRECTIONAL_LIGHTS 8 // layers of the layered shadow map, each light is one bit of the light injection
+#define MORTON_SLOT_WORDS 9 // key and 8 sibling cells of a slot of the Morton build hash tables, SLOT_WORDS of buildNodesMortonVert
 class MeshRenderer;
 class Shape;
 
@@ -26,7 +33,13 @@ class Graphics {
 public:
 	enum RenderingMode {
 		VOXELIZATION_VISUALIZATION = 0, // Voxelization visualization.
-		VOXEL_CONE_TRACING = 1			// Global illumination using voxel cone tracing.
+		VOXEL_CONE_TRACING = 1,			// Global illumination using voxel cone tracing.
+		CLIPMAP_CONE_TRACING = 2		// Voxel cone tracing through camera centred voxel cascades instead of the SVO.
+	};
+
+	enum NodePoolLayout {
+		NODE_POOL_TEXTURES = 0, // One R32UI texture buffer per node field.
+		NODE_POOL_RECORDS = 1	// One record per node in a shader storage buffer. Same values as in _nodePool.shader.
 	};
 
 	/// <summary> Initializes rendering. </summary>
@@ -48,6 +61,42 @@ public:
 	bool updateScene = true;
 	bool buildSVO = true;
 	bool injectLight = true;
+	bool anisotropicVoxels = true; // Cones sample irradiance mipmapped per direction above the leaves.
+	bool filterLitNodes = true; // The light update filters only the bricks of the nodes light reached and their ancestors, not the whole octree.
+	bool validateSVOQueued = false; // Rebuild the SVO on the CPU after the next GPU build and compare.
+	bool incrementalSVO = true; // Only rebuild the SVO around renderers that moved or were enabled / disabled.
+	int svoFullRebuildInterval = 600; // Incremental updates between full rebuilds, which free the nodes and bricks left in empty space.
+	bool staticSVO = false; // Keep the static renderers in the SVO and insert only the dynamic ones again. Replaces the incremental update.
+	int svoResolution = 256; // Voxels along one edge of the SVO, a power of two from 256 to 4096, limited by svoFragmentBudgetMB. Read once by init.
+	int svoFragmentBudgetMB = 2048; // The dense fragment textures and the fragment list take 16 bytes per voxel of the grid: 512 needs 2 GB, 1024 16 GB. Read once by init.
+	float svoNodePoolOccupancy = 0.25f; // Share of the dense node count each level of the node pool starts with. Levels which overflow grow.
+	int svoNodePoolBudgetMB = 1024; // The node pool does not grow beyond this.
+	int svoTopLevelIndexLevel = 5; // Levels of the SVO in a dense index (2^level cells along an edge) the traversals start from, 0 for none. Read once by init.
+	int svoBrickPoolBricks = 70; // Bricks along one edge of the brick pool, at most 341 (XYZ10 brick addresses). Read once by init.
+	bool mortonSVOBuild = false; // Build the nodes of complete octrees bottom-up from the fragment list in two passes instead of level by level.
+	NodePoolLayout nodePoolLayout = NODE_POOL_TEXTURES; // Read once by init, the SVO shaders are compiled for it.
+	bool benchmarkNodePoolQueued = false; // Time octree traversals with both node pool layouts after the next SVO build.
+	bool benchmarkBorderTransferQueued = false; // Time and compare the three pass and the single pass border transfer after the next SVO build.
+	int indirectLightDownsample = 1; // Trace the indirect light at 1 / 1, 1 / 2 or 1 / 4 of the resolution and upsample it guided by depth and normals.
+	bool temporalIndirectLight = false; // Average the diffuse indirect light over frames, reprojected with the previous camera, and trace only temporalDiffuseCones of its cones per frame.
+	int temporalDiffuseCones = 2; // Diffuse cones, of 6, traced per frame by temporalIndirectLight. They rotate from frame to frame.
+	int temporalHistoryLength = 16; // Frames temporalIndirectLight averages at most, fewer follow changes of the light faster.
+	bool deferredShading = false; // Cone trace once per pixel (or per texel of the reduced resolution indirect light) from a G-buffer of the closest surfaces instead of once per rasterized fragment.
+	bool ambientCubeDiffuse = false; // Gather the diffuse indirect light with one cone reading the ambient cubes of the directional bricks instead of six cones. Needs anisotropicVoxels.
+	bool irradianceProbes = false; // Interpolate the diffuse indirect light between SH probes at the occupied nodes of probeGridLevel instead of tracing its cones per pixel.
+	int probeGridLevel = 5; // Octree level of the probes, 2^level along an edge.
+	int probesPerFrame = 4096; // Probes traced per frame, round robin.
+	bool benchmarkIndirectLightQueued = false; // Time the cone tracing with the indirect light at each resolution, accumulated, deferred and from the probes on the next frame.
+	std::string svoFile = "scene.svo"; // Baked octree written by saveSVOQueued and read by useSVOBake and streamSVO.
+	bool saveSVOQueued = false; // Write the octree to svoFile after the next SVO build and light injection.
+	bool bakeSVOOnCPU = false; // saveSVOQueued builds the octree on the CPU and writes it, without a GPU build or read back.
+	bool useSVOBake = false; // Load the octree of a static scene from svoFile if it was baked from the same scene, otherwise build it and bake it into svoFile.
+	bool streamSVO = false; // Load the octree of svoFile and stream its bricks around the camera instead of building it. Read once by init.
+	int svoStreamBricksPerFrame = 512; // Bricks uploaded per frame at most when streaming.
+	float svoStreamLodDistance = 4.0f; // Streamed nodes closer to the camera than this many times their size get the bricks of their children.
+	int clipmapResolution = 64; // Voxels along one edge of a clipmap cascade, a power of two up to svoResolution. Read when the clipmap is first used.
+	int clipmapCascades = 4; // Clipmap cascades, each with twice the voxel size of the one before. At most MAX_CLIPMAP_CASCADES. Read when the clipmap is first used.
+	float clipmapVoxelSize = 1.0f / 64.0f; // World space size of the voxels of the finest clipmap cascade. Read when the clipmap is first used.
 	glm::vec3 lightDirection;
 	float directLightMultiplier = 1.0;
 	float indirectLightMultiplier = 0.2;
@@ -97,39 +146,81 @@ private:
   // Sparse Voxel Tree
   // ----------------
   void initSparseVoxelization();
+  void resizeNodePool();
+  bool growNodePoolOnOverflow();
+  void reportBrickPoolOverflow();
   void sparseVoxelize(Scene & renderingScene, bool clearVoxelizationFirst = true);
+  void sparseVoxelizeDynamic(Scene & renderingScene);
+  void buildOctreeNodes(Scene & renderingScene, bool completeBuild);
+  void writeOctreeBricks();
   void lightUpdate(Scene & renderingScene, bool clearVoxelizationFirst = true);
+  bool findUpdateRegion(Scene & renderingScene, bool fullRebuild);
+  void setUpdateRegion(const glm::ivec3 & voxelMin, const glm::ivec3 & voxelMax);
+  void getVoxelRange(const glm::mat4 & voxelGridTransformI, const glm::vec3 & boxMin, const glm::vec3 & boxMax, glm::ivec3 & voxelMin, glm::ivec3 & voxelMax) const;
+  void drawLevelThreads(const GLuint program, int level, int negativeMargin = 0, int positiveMargin = 0);
+  std::string threadMaterialName(const std::string & name) const;
+  void updateLevelCommands();
+  void bindNodePool(const GLuint program, int field, const std::string & name, int textureUnit, GLenum access);
+  void writeTopLevelIndex();
+  void bindTopLevelIndex(const GLuint program, int textureUnit);
+  void benchmarkNodePoolLayouts();
+  void benchmarkBorderTransfer();
+  void validateSparseVoxelization(Scene & renderingScene);
+  void readNodePool(size_t numNodes, std::vector<uint32_t> nodePool[]);
+  void readBrickPools(std::vector<uint32_t> brickPools[]);
+  void uploadNodePool(const uint32_t * const nodePool[]);
+  void saveSVO(Scene & renderingScene, const std::string & path);
+  void bakeSVO(Scene & renderingScene, const std::string & path);
+  bool loadSVO(Scene & renderingScene, const std::string & path);
+  bool loadStreamedSVO(std::shared_ptr<SvoFile> file);
+  void streamBricks(Scene & renderingScene);
   // sparse voxelize functions
   void clearNodePool(Scene& renderingScene);
   void clearBrickPool(Scene& renderingScene, bool isClearAll);
   void clearFragmentTex(Scene& renderingScene);
-  void voxelizeScene(Scene& renderingScene);
+  void clearLeafVoxels(bool fromFragmentList = false);
+  void voxelizeScene(Scene& renderingScene, RenderingQueue renderers, GLuint firstFragment = 0);
   void modifyIndirectBuffer(std::shared_ptr<IndexBuffer> valueBuffer, std::shared_ptr<TextureBuffer> commandBuffer);
   void visualizeVoxel(Scene& renderingScene, unsigned int viewportWidth, unsigned int viewportHeight, int level);
   void flagNode(Scene& renderingScene, int level);
   void allocateNode(Scene& renderingScene, int level);
   void findNeighbours(Scene& renderingScene, int level);
+  void buildNodesMorton(bool flagPass);
   void flagBrick();
   void allocateBrick();
   void writeLeafNode();
   void spreadLeafBrick(std::shared_ptr<Texture3D> brickPoolTexture);
   void borderTransfer(int level, std::shared_ptr<Texture3D> brickPoolTexture);
-  void mipmapCenter(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
-  void mipmapFaces(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
-  void mipmapCorners(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
-  void mipmapEdges(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
+  void borderTransferBricks(int level, const std::vector<int> & pools);
+  void mipmapBricks(int level, const std::vector<int> & pools);
+  void mipmapAnisotropic(int level);
+  // static / dynamic split functions
+  void buildStaticOctree(Scene& renderingScene);
+  void tagStaticNodes();
+  void clearDynamicNodes();
+  void copyStaticFragments(bool restore);
   // light update function
   void clearNodeMap();
+  void clearLitBricks();
   void shadowMap(Scene& renderingScene, const DirectionalLight& light);
-  void lightInjection(Scene& renderingScene, const DirectionalLight& light);
-  void spreadLeafBrickLight(std::shared_ptr<Texture3D> brickPoolTexture);
-  void borderTransferLight(int level, std::shared_ptr<Texture3D> brickPoolTexture);
-  void mipmapCenterLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
-  void mipmapFacesLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
-  void mipmapCornersLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
-  void mipmapEdgesLight(int level, std::shared_ptr<Texture3D> brickPoolTexture, glm::vec4 emptyColor = glm::vec4(0));
+  void shadowMapLayered(Scene& renderingScene);
+  void lightInjection(Scene& renderingScene);
+  void writeLightCommands();
+  void resolveLightInjection(Scene& renderingScene);
   // hierarchical cone tracing
   void renderSceneWithSVO(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
+  void setupConeTracing(Scene & renderingScene, const GLuint program, unsigned int viewportWidth, unsigned int viewportHeight, int & textureUnitIdx);
+  void traceIndirectLight(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight, int downsample);
+  void updateProbes(Scene & renderingScene);
+  void listProbeCells();
+  void renderGBuffer(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
+  void benchmarkIndirectLight(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
+  // voxel clipmap
+  void updateClipmap(Scene & renderingScene);
+  void voxelizeClipmap(Scene & renderingScene, const std::vector<VoxelClipmap::Region> & regions);
+  void injectClipmapLight(Scene & renderingScene, const DirectionalLight & light);
+  void bindClipmap(const GLuint program, int & textureUnitIdx, bool radianceAsImage);
+  void renderSceneWithClipmap(Scene & renderingScene, unsigned int viewportWidth, unsigned int viewportHeight);
 
   struct IndirectDrawCommand {
     uint32_t numVertices;
@@ -143,7 +234,6 @@ private:
   {
     NODE_POOL_NEXT,
     NODE_POOL_COLOR, // node pool -> brick pool address map
-    NODE_POOL_NORMAL,
     NODE_POOL_NEIGH_X,
     NODE_POOL_NEIGH_X_NEG,
     NODE_POOL_NEIGH_Y,
@@ -152,18 +242,33 @@ private:
     NODE_POOL_NEIGH_Z_NEG,
     NODE_POOL_NUM_TEXTURES
   };
-  std::shared_ptr<TextureBuffer> m_nodePoolTextures[NODE_POOL_NUM_TEXTURES];
+  std::shared_ptr<TextureBuffer> m_nodePoolTextures[NODE_POOL_NUM_TEXTURES]; // with NODE_POOL_TEXTURES
+  std::shared_ptr<IndexBuffer> m_nodePoolRecords; // with NODE_POOL_RECORDS, the fields of a node in the order of NodePoolData
+  GLbitfield m_nodePoolBarrierBits = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT; // makes the nodes written by a pass visible to the next ones
   std::shared_ptr<TextureBuffer> m_levelAddressBuffer;
+  GLuint m_levelAddress[MAX_NODE_POOL_LEVELS]; // first node of each level, the levels have fixed ranges: 1 + 8 * (tiles of the levels above)
+  GLuint m_levelTileCapacity[MAX_NODE_POOL_LEVELS]; // tiles each level can hand out to its children, at most 8^level
   int m_nodePoolDim; // number of different voxels along one edge
   int m_numLevels; // number of levels of **interior** nodes
-  int m_maxNodes; // max nodes = 1 + 8 + 8^2 + ... + nodePoolDim ^ 3
-  std::shared_ptr<IndexBuffer> m_nextFreeNode;		// atomic counter for next free node
+  int m_maxNodes; // nodes of all level ranges, up to the end of the leaf level
+  std::shared_ptr<TextureBuffer> m_nextFreeNode;	// atomic counters for the next free tile, one per level. Also bound as an image by the Morton build
+  std::shared_ptr<IndexBuffer> m_tileCountReadback; // tile counters of the last build, read by growNodePoolOnOverflow
+  bool m_tileCountPending = false;
+  bool m_nodePoolOverBudget = false;
+  std::shared_ptr<TextureBuffer> m_mortonCellTable; // hash tables of the occupied cells of each level, for the Morton build. Allocated by the first Morton build
+  GLuint m_mortonTableOffset[MAX_NODE_POOL_LEVELS]; // first slot of the hash table of each level
+  GLuint m_mortonTableSlots[MAX_NODE_POOL_LEVELS]; // slots of the hash table of each level, twice the tiles of the level above
+  GLuint64 m_mortonCellTableWords = 0;
+  bool m_mortonCellTableFits = false; // a node pool too large for one texture buffer of hash tables falls back to the build level by level
+  std::shared_ptr<Texture3D> m_topLevelIndex; // node and level per cell of the top levels, mip i for level m_topLevelIndexLevel - i
+  int m_topLevelIndexLevel = 0; // deepest level of m_topLevelIndex, 0 without index
 
   // Brick pool
   enum BrickPoolData {
 	  BRICK_POOL_COLOR,
 	  BRICK_POOL_IRRADIANCE,
 	  BRICK_POOL_NORMAL,
+	  // Irradiance seen by the cones along +X, -X, ..., on the levels above the leaves (anisotropicVoxels)
 	  BRICK_POOL_COLOR_X,
 	  BRICK_POOL_COLOR_X_NEG,
 	  BRICK_POOL_COLOR_Y,
@@ -175,6 +280,21 @@ private:
   int m_brickPoolDim; // brick pool voxels = dim * dim * dim
   std::shared_ptr<Texture3D> m_brickPoolTextures[BRICK_POOL_NUM_TEXTURES];
   std::shared_ptr<IndexBuffer> m_nextFreeBrick;		// atomic counter for next free brick
+  std::shared_ptr<TextureBuffer> m_freeBricks;      // number of released bricks, then their indices
+  std::shared_ptr<IndexBuffer> m_brickCountReadback; // brick counter of the last build, read by reportBrickPoolOverflow
+  bool m_brickCountPending = false;
+  bool m_brickPoolOverflow = false;
+
+  // Streamed octree, the node pool is loaded from a file and the bricks are uploaded around the camera
+  std::unique_ptr<BrickStreamer> m_brickStreamer;
+  std::vector<BrickStreamer::NodeColorWrite> m_streamedColorWrites;
+  std::shared_ptr<TextureBuffer> m_streamedColorWriteBuffer; // m_streamedColorWrites for streamNodeColors
+  size_t m_streamedColorWriteCapacity = 0;
+  bool m_svoFileChecked = false; // the scene hash of svoFile was compared on the first frame
+  bool m_svoBakeLoaded = false;  // the octree was loaded from svoFile and is not built
+
+  // Camera centred voxel cascades of CLIPMAP_CONE_TRACING, created when that mode is first rendered
+  std::unique_ptr<VoxelClipmap> m_clipmap;
 
 
   // Fragment Texure
@@ -184,6 +304,7 @@ private:
 	  FRAG_TEX_NUM_TEXTURES,
   };
   std::shared_ptr<Texture3D> m_fragmentTextures[FRAG_TEX_NUM_TEXTURES];
+  GLuint m_voxelizeFBO = 0; // no attachments, voxel grid sized. The window may be smaller than the grid
 
   // Fragment List
   std::shared_ptr<TextureBuffer> m_fragmentList;
@@ -191,11 +312,20 @@ private:
 
   // Light node map
   int m_shadowMapRes;
-  std::shared_ptr<Texture2D> m_lightNodeMap;
+  std::shared_ptr<Texture2D> m_lightNodeMap; // a region per level, listing the nodes light reached
+  std::shared_ptr<TextureBuffer> m_litNodeCounts; // nodes listed per level, more than the region holds if it overflowed
+  std::shared_ptr<TextureBuffer> m_litNodeFlags;  // one bit per node of the pool, set for the listed nodes
+  bool m_lightThreadsActive = false;              // drawLevelThreads runs over the listed nodes, see lightUpdate
+  bool m_litBricksListed = false;                 // the lists still name every brick the last light update wrote
+  bool m_litBricksAnisotropic = false;            // the last light update also filtered the directional pools
   std::vector<glm::ivec2> m_nodeMapSizes;
   std::vector<glm::ivec2> m_nodeMapOffsets;
   int m_nNodeMapLevels;
   std::shared_ptr<FBO> m_shadowMapBuffer;
+  GLuint m_shadowMapArray = 0;      // world positions seen by the lights, one layer per light
+  GLuint m_shadowMapArrayDepth = 0;
+  GLuint m_shadowMapArrayFBO = 0;
+  int m_shadowMapLayers = 0;        // lights the array was created for
   glm::vec3 m_lightDir;
   glm::mat4 m_lightViewMat;
   glm::mat4 m_lightProjMat;
@@ -203,18 +333,58 @@ private:
   // Draw command buffers
   std::shared_ptr<IndexBuffer> m_nodePoolCmdBuf;     // all voxels in node pool
   std::shared_ptr<IndexBuffer> m_brickPoolCmdBuf;    // all voxels in brick pool
-  std::shared_ptr<IndexBuffer> m_fragmentTexCmdBuf;
   std::shared_ptr<IndexBuffer> m_modifyIndirectBufferCmdBuf;
   std::shared_ptr<TextureBuffer> m_fragmentListCmdBuf;	// actual fragment list length
   std::shared_ptr<TextureBuffer> m_nodePoolNodesCmdBuf; // tiles in node pool
   std::shared_ptr<IndexBuffer> m_nodePoolUpToLevelCmdBuf[MAX_NODE_POOL_LEVELS];
-  std::shared_ptr<IndexBuffer> m_nodePoolOnLevelCmdBuf[MAX_NODE_POOL_LEVELS];
-  std::shared_ptr<IndexBuffer> m_lightNodeMapCmdBuf; // all pixels in m_lightNodeMap
-  std::shared_ptr<IndexBuffer> m_nodeMapOnLevelCmdBuf[MAX_NODE_POOL_LEVELS];
+  std::shared_ptr<TextureBuffer> m_levelNodesCmdBuf;	// one command per level, for the node slots the level has in use. See updateLevelCommands
+  std::shared_ptr<TextureBuffer> m_lightNodesCmdBuf;	// one command per level, for the nodes listed in m_lightNodeMap. See writeLightCommands
+
+  // Reduced resolution indirect light, see traceIndirectLight
+  std::shared_ptr<FBO> m_indirectLightBuffer; // diffuse indirect light, its guide (the normal and view depth) and specular indirect light
+  std::shared_ptr<FBO> m_indirectLightHistory; // m_indirectLightBuffer of the previous frame, with temporalIndirectLight
+  bool m_indirectHistoryValid = false;
+  unsigned int m_temporalFrame = 0; // rotates the diffuse cones
+  glm::mat4 m_previousViewMatrix;
+  glm::mat4 m_previousProjectionMatrix;
+
+  // Deferred cone tracing, see renderGBuffer
+  std::shared_ptr<FBO> m_gBuffer; // world position and material ID, normal and view depth
+  std::shared_ptr<IndexBuffer> m_materialTable; // material settings of the G-buffer, 3 vec4 each
+
+  // Irradiance probes, see updateProbes
+  std::shared_ptr<Texture3D> m_probeGrid; // L1 SH of the probes, the 4 coefficients stacked along z
+  int m_probeLevel = 0;
+  int m_nextProbe = 0; // entry of the probe cell list the next update starts at
+  std::shared_ptr<TextureBuffer> m_probeNodeCells; // XYZ16 cells of the nodes above the probe level, see listProbeCells
+  std::shared_ptr<TextureBuffer> m_probeCells[2]; // XYZ16 cells of the nodes of the probe level, the current list and the one before
+  std::shared_ptr<TextureBuffer> m_probeCellCounts; // entries of both lists
+  std::shared_ptr<IndexBuffer> m_probeCellCountReadback; // entries of the current list, read by updateProbes a frame later
+  int m_probeList = 0; // the current list
+  GLuint m_numProbeCells = 0; // entries of the current list once they were read back
+  bool m_probeCellCountPending = false;
+  bool m_probeCellsListed = false; // the current list has the nodes of the octree, reset by every build
 
   glm::vec3 sceneBoxMin;
   glm::vec3 sceneBoxMax;
 
+  // Incremental update
+  bool m_svoBuilt = false;
+  int m_svoUpdatesSinceRebuild = 0;
+  glm::mat4 m_svoVoxelGridTransformI;      // voxel grid of the last build
+  std::vector<MeshRenderer*> m_svoRenderers; // renderers touching the update region
+  bool m_updateRegionActive = false;       // restricts the SVO passes to the update region
+  glm::ivec3 m_updateVoxelMin, m_updateVoxelMax; // voxels that are voxelized again
+  glm::ivec3 m_updateCellMin[MAX_NODE_POOL_LEVELS], m_updateCellMax[MAX_NODE_POOL_LEVELS]; // nodes that are filtered again, per level
+
+  // Static / dynamic split
+  bool m_staticSVOBuilt = false;
+  GLuint m_staticLevelTiles[MAX_NODE_POOL_LEVELS]; // tile counters after the static renderers were inserted
+  GLuint m_staticBrickCount = 0;                   // brick counter after the static renderers were inserted
+  GLuint m_staticFragmentCount = 0;                // static fragments at the start of the fragment list
+  GLuint m_staticFragmentCapacity = 0;
+  std::shared_ptr<TextureBuffer> m_staticFragmentValues; // fragment texture values of the static fragments
+
 	// ----------------
 	// Voxelization.
 	// ----------------
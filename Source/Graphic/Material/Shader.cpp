@@ -6,6 +6,7 @@
 #include <vector>
 
 std::string Shader::s_includePath = "Shaders/";
+std::string Shader::s_globalDefines = "";
 
 GLuint Shader::compile() {
 	// Create and compile shader.
@@ -71,6 +72,13 @@ Shader::Shader(std::string _path, ShaderType _type, std::string preprocessorDefs
 		}
 	}
 	fileStream.close();
+
+	// The global definitions have to follow the #version directive, which comes either from the file or from preprocessorDefs
+	size_t versionPos = rawShader.find("#version");
+	if (versionPos != std::string::npos && !s_globalDefines.empty()) {
+		size_t lineEnd = rawShader.find('\n', versionPos);
+		rawShader.insert(lineEnd == std::string::npos ? rawShader.size() : lineEnd + 1, s_globalDefines);
+	}
 }
 
 std::string Shader::GetShaderTypeName()
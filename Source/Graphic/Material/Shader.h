@@ -32,9 +32,13 @@ public:
 	Shader(std::string path, ShaderType shaderType, std::string preprocessorDefs="");
 
 	static void setIncludePath(const std::string& includePath) { s_includePath = includePath; }
+
+	/// <summary> Sets preprocessor definitions added after the #version directive of every shader loaded from then on. </summary>
+	static void setGlobalDefines(const std::string& globalDefines) { s_globalDefines = globalDefines; }
 private:
 	std::string rawShader;
 	Shader();
 
 	static std::string s_includePath;
+	static std::string s_globalDefines;
 };
\ No newline at end of file
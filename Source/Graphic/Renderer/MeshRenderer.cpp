@@ -54,6 +54,44 @@ void MeshRenderer::render(const GLuint program)
 	glDrawElements(GL_TRIANGLES, mesh->indices.size(), GL_UNSIGNED_INT, 0);
 }
 
+void MeshRenderer::getBoundingBox(glm::vec3 & boxMin, glm::vec3 & boxMax)
+{
+	glm::vec3 meshMin, meshMax;
+	mesh->getBoundingBox(meshMin, meshMax);
+
+	// Transform the corners of the mesh bounds.
+	const glm::mat4 & M = transform.getTransformMatrix();
+	boxMin = glm::vec3(FLT_MAX);
+	boxMax = glm::vec3(-FLT_MAX);
+	for (int i = 0; i < 8; ++i) {
+		glm::vec3 corner((i & 1) ? meshMax.x : meshMin.x, (i & 2) ? meshMax.y : meshMin.y, (i & 4) ? meshMax.z : meshMin.z);
+		glm::vec3 p = glm::vec3(M * glm::vec4(corner, 1.0f));
+		boxMin = glm::min(boxMin, p);
+		boxMax = glm::max(boxMax, p);
+	}
+}
+
+bool MeshRenderer::hasChanged() const
+{
+	return enabled != acceptedEnabled || (enabled && transform.getVersion() != acceptedTransformVersion);
+}
+
+void MeshRenderer::acceptChanges()
+{
+	if (enabled && (!acceptedEnabled || transform.getVersion() != acceptedTransformVersion)) {
+		getBoundingBox(acceptedBoxMin, acceptedBoxMax);
+	}
+	acceptedEnabled = enabled;
+	acceptedTransformVersion = transform.getVersion();
+}
+
+bool MeshRenderer::getAcceptedBoundingBox(glm::vec3 & boxMin, glm::vec3 & boxMax) const
+{
+	boxMin = acceptedBoxMin;
+	boxMax = acceptedBoxMax;
+	return acceptedEnabled;
+}
+
 void MeshRenderer::reuploadIndexDataToGPU()
 {
 	glBindVertexArray(mesh->vao);
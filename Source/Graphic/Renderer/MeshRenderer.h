@@ -16,6 +16,7 @@ class MeshRenderer {
 public:
 	bool enabled = true;
 	bool tweakable = false; // Automatically adds a window for this mesh renderer.
+	bool isStatic = false; // Kept in the static part of the SVO (see Graphics::staticSVO). Moving it rebuilds that part.
 	std::string name = "Mesh renderer"; // Is displayed in the tweak bar.
 
 	Transform transform;
@@ -28,7 +29,24 @@ public:
 	// Rendering.
 	MaterialSetting * materialSetting = nullptr;
 	void render(const GLuint program);
+
+	/// <summary> World space bounding box of the transformed mesh. </summary>
+	void getBoundingBox(glm::vec3 & boxMin, glm::vec3 & boxMax);
+
+	// ----------------
+	// Change tracking.
+	// ----------------
+	/// <summary> Returns true if the renderer has been moved, enabled or disabled since the last call to acceptChanges. </summary>
+	bool hasChanged() const;
+	/// <summary> Remembers the current transform, enabled state and bounding box as the unchanged state. </summary>
+	void acceptChanges();
+	/// <summary> Bounding box at the last call to acceptChanges. Returns false if the renderer was disabled (or never accepted) then. </summary>
+	bool getAcceptedBoundingBox(glm::vec3 & boxMin, glm::vec3 & boxMax) const;
 private:
+	bool acceptedEnabled = false;
+	unsigned int acceptedTransformVersion = 0;
+	glm::vec3 acceptedBoxMin, acceptedBoxMax;
+
 	void setupMeshRenderer();
 	void reuploadIndexDataToGPU();
 	void reuploadVertexDataToGPU();
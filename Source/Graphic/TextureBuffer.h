@@ -10,7 +10,7 @@
 class TextureBuffer
 {
 public:
-  TextureBuffer(int sizeOfBytes, char* data = nullptr)
+  TextureBuffer(GLsizeiptr sizeOfBytes, char* data = nullptr, GLenum internalFormat = GL_R32UI)
   {
     glGenTextures(1, &m_textureID);
     glBindTexture(GL_TEXTURE_BUFFER, m_textureID);
@@ -19,7 +19,7 @@ public:
     glBindBuffer(GL_TEXTURE_BUFFER, m_bufferID);
     glBufferData(GL_TEXTURE_BUFFER, sizeOfBytes, data, GL_STATIC_DRAW);
     
-    glTextureBuffer(m_textureID, GL_R32UI, m_bufferID);
+    glTextureBuffer(m_textureID, internalFormat, m_bufferID);
   }
 
   ~TextureBuffer() {
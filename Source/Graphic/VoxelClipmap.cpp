@@ -0,0 +1,147 @@
+#include "VoxelClipmap.h"
+
+// Stdlib.
+#include <algorithm>
+
+#include "Renderer/MeshRenderer.h"
+
+VoxelClipmap::VoxelClipmap(int resolution, int numCascades, float voxelSize)
+	: m_resolution(resolution), m_numCascades(std::min(std::max(numCascades, 1), MAX_CLIPMAP_CASCADES)), m_voxelSize(voxelSize)
+{
+	for (int i = 0; i < m_numCascades; ++i) {
+		m_origins[i] = glm::ivec3(0);
+		for (int data = 0; data < CLIPMAP_NUM_TEXTURES; ++data) {
+			m_textures[i][data] = std::shared_ptr<Texture3D>(new Texture3D(m_resolution, m_resolution, m_resolution, false, GL_RGBA8, GL_RGBA));
+
+			// The cells are stored modulo the resolution, the filtering wraps around the edges the same way
+			glBindTexture(GL_TEXTURE_3D, m_textures[i][data]->textureID);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+			GLubyte clearColor[4] = { 0, 0, 0, 0 };
+			glClearTexImage(m_textures[i][data]->textureID, 0, GL_RGBA, GL_UNSIGNED_BYTE, clearColor);
+		}
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+VoxelClipmap::~VoxelClipmap()
+{
+	for (int i = 0; i < m_numCascades; ++i) {
+		for (int data = 0; data < CLIPMAP_NUM_TEXTURES; ++data) {
+			glDeleteTextures(1, &m_textures[i][data]->textureID);
+		}
+	}
+}
+
+void VoxelClipmap::update(const glm::vec3 & cameraPos, const std::vector<MeshRenderer*> & renderers, std::vector<Region> & regions)
+{
+	const glm::ivec3 last(m_resolution - 1);
+	for (int i = 0; i < m_numCascades; ++i) {
+		glm::ivec3 origin = glm::ivec3(glm::floor(cameraPos / getVoxelSize(i))) - m_resolution / 2;
+		glm::ivec3 delta = origin - m_origins[i];
+		m_origins[i] = origin;
+
+		if (!m_valid || glm::any(glm::greaterThanEqual(glm::abs(delta), glm::ivec3(m_resolution)))) {
+			regions.push_back({ i, origin, origin + last });
+			continue;
+		}
+
+		// The slabs the cascade moved into. They overlap at the edges, which are voxelized twice.
+		for (int axis = 0; axis < 3; ++axis) {
+			if (delta[axis] == 0) {
+				continue;
+			}
+			Region slab = { i, origin, origin + last };
+			if (delta[axis] > 0) {
+				slab.cellMin[axis] = slab.cellMax[axis] - delta[axis] + 1;
+			}
+			else {
+				slab.cellMax[axis] = slab.cellMin[axis] - delta[axis] - 1;
+			}
+			regions.push_back(slab);
+		}
+	}
+
+	for (auto * renderer : renderers) {
+		RendererState state = { renderer->enabled, glm::vec3(0.0f), glm::vec3(0.0f) };
+		if (state.enabled) {
+			renderer->getBoundingBox(state.boxMin, state.boxMax);
+		}
+
+		auto previous = m_rendererStates.find(renderer);
+		if (previous == m_rendererStates.end()) {
+			if (m_valid && state.enabled) {
+				addBoxRegions(state.boxMin, state.boxMax, regions);
+			}
+			m_rendererStates[renderer] = state;
+			continue;
+		}
+
+		const RendererState & old = previous->second;
+		bool changed = old.enabled != state.enabled ||
+			(state.enabled && (old.boxMin != state.boxMin || old.boxMax != state.boxMax));
+		if (m_valid && changed) {
+			if (old.enabled) {
+				addBoxRegions(old.boxMin, old.boxMax, regions);
+			}
+			if (state.enabled) {
+				addBoxRegions(state.boxMin, state.boxMax, regions);
+			}
+		}
+		previous->second = state;
+	}
+
+	m_valid = true;
+}
+
+void VoxelClipmap::invalidate()
+{
+	m_valid = false;
+}
+
+void VoxelClipmap::getTexelBoxes(const Region & region, std::vector<TexelBox> & boxes) const
+{
+	// Per axis the region wraps at most once, as it is never larger than a cascade
+	int numRanges[3];
+	glm::ivec3 rangeOffset[2], rangeSize[2];
+	for (int axis = 0; axis < 3; ++axis) {
+		int start = region.cellMin[axis] & (m_resolution - 1);
+		int size = region.cellMax[axis] - region.cellMin[axis] + 1;
+		rangeOffset[0][axis] = start;
+		rangeSize[0][axis] = std::min(size, m_resolution - start);
+		rangeOffset[1][axis] = 0;
+		rangeSize[1][axis] = size - rangeSize[0][axis];
+		numRanges[axis] = rangeSize[1][axis] > 0 ? 2 : 1;
+	}
+
+	for (int z = 0; z < numRanges[2]; ++z) {
+		for (int y = 0; y < numRanges[1]; ++y) {
+			for (int x = 0; x < numRanges[0]; ++x) {
+				TexelBox box;
+				box.offset = glm::ivec3(rangeOffset[x].x, rangeOffset[y].y, rangeOffset[z].z);
+				box.size = glm::ivec3(rangeSize[x].x, rangeSize[y].y, rangeSize[z].z);
+				boxes.push_back(box);
+			}
+		}
+	}
+}
+
+bool VoxelClipmap::getCellRange(int cascade, const glm::vec3 & boxMin, const glm::vec3 & boxMax, glm::ivec3 & cellMin, glm::ivec3 & cellMax) const
+{
+	float voxelSize = getVoxelSize(cascade);
+	cellMin = glm::max(glm::ivec3(glm::floor(boxMin / voxelSize)), m_origins[cascade]);
+	cellMax = glm::min(glm::ivec3(glm::floor(boxMax / voxelSize)), m_origins[cascade] + m_resolution - 1);
+	return glm::all(glm::lessThanEqual(cellMin, cellMax));
+}
+
+void VoxelClipmap::addBoxRegions(const glm::vec3 & boxMin, const glm::vec3 & boxMax, std::vector<Region> & regions) const
+{
+	for (int i = 0; i < m_numCascades; ++i) {
+		Region region;
+		region.cascade = i;
+		if (getCellRange(i, boxMin, boxMax, region.cellMin, region.cellMax)) {
+			regions.push_back(region);
+		}
+	}
+}
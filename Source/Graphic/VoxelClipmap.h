@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#define GLEW_STATIC
+#include <glew.h>
+#include <glm.hpp>
+
+#include "Texture3D.h"
+
+class MeshRenderer;
+
+#define MAX_CLIPMAP_CASCADES 6 // same as in _clipmap.shader
+
+/// <summary> Camera centred cascades of dense voxel textures, an alternative to the SVO for large scenes.
+/// Every cascade has the same resolution and twice the voxel size of the one before it. The textures are
+/// addressed toroidally: voxel cell c of a cascade (in its voxels, from the world origin) is stored in texel
+/// c mod resolution, so moving a cascade only invalidates the slabs of cells it newly covers and sampling
+/// wraps with GL_REPEAT. update computes these slabs and the cells around renderers that changed. </summary>
+class VoxelClipmap {
+public:
+	enum ClipmapData {
+		CLIPMAP_ALBEDO,   // diffuse color and opacity, written by the voxelization
+		CLIPMAP_RADIANCE, // reflected direct light, premultiplied by the opacity, written by the light injection
+		CLIPMAP_NUM_TEXTURES
+	};
+
+	/// <summary> Cells of one cascade that have to be cleared and voxelized again, min and max inclusive. </summary>
+	struct Region {
+		int cascade;
+		glm::ivec3 cellMin, cellMax;
+	};
+
+	/// <summary> A box of texels, the part of a region between two wraps of the texture. </summary>
+	struct TexelBox {
+		glm::ivec3 offset, size;
+	};
+
+	/// <summary> resolution is the number of voxels along one edge of a cascade, a power of two.
+	/// voxelSize is the world space size of the voxels of the finest cascade. </summary>
+	VoxelClipmap(int resolution, int numCascades, float voxelSize);
+	~VoxelClipmap();
+
+	/// <summary> Centres the cascades on cameraPos and appends the regions that have to be voxelized again:
+	/// everything on the first update, the slabs a cascade moved into, and the old and new bounds of the
+	/// renderers that moved or were enabled / disabled since the last update. </summary>
+	void update(const glm::vec3 & cameraPos, const std::vector<MeshRenderer*> & renderers, std::vector<Region> & regions);
+
+	/// <summary> Voxelizes all cascades again with the next update. </summary>
+	void invalidate();
+
+	/// <summary> Splits a region into boxes of texels that do not wrap around the texture edges. </summary>
+	void getTexelBoxes(const Region & region, std::vector<TexelBox> & boxes) const;
+
+	/// <summary> Cells of the cascade that overlap a world space box, clipped to the cascade. Returns false if there are none. </summary>
+	bool getCellRange(int cascade, const glm::vec3 & boxMin, const glm::vec3 & boxMax, glm::ivec3 & cellMin, glm::ivec3 & cellMax) const;
+
+	int getResolution() const { return m_resolution; }
+	int getNumCascades() const { return m_numCascades; }
+	float getVoxelSize(int cascade) const { return m_voxelSize * float(1 << cascade); }
+	const glm::ivec3 & getOrigin(int cascade) const { return m_origins[cascade]; } // first cell of the cascade
+	std::shared_ptr<Texture3D> getTexture(int cascade, ClipmapData data) const { return m_textures[cascade][data]; }
+
+private:
+	struct RendererState {
+		bool enabled;
+		glm::vec3 boxMin, boxMax;
+	};
+
+	VoxelClipmap(VoxelClipmap const &) = delete;
+	void operator=(VoxelClipmap const &) = delete;
+
+	void addBoxRegions(const glm::vec3 & boxMin, const glm::vec3 & boxMax, std::vector<Region> & regions) const;
+
+	int m_resolution;
+	int m_numCascades;
+	float m_voxelSize;
+	bool m_valid = false; // the cascades have been voxelized at m_origins
+	glm::ivec3 m_origins[MAX_CLIPMAP_CASCADES];
+	std::shared_ptr<Texture3D> m_textures[MAX_CLIPMAP_CASCADES][CLIPMAP_NUM_TEXTURES];
+	std::unordered_map<MeshRenderer*, RendererState> m_rendererStates; // at the last update
+};
@@ -34,6 +34,7 @@ void CornellScene::init(unsigned int viewportWidth, unsigned int viewportHeight)
 	}
 	for (auto & r : renderers) {
 		r->tweakable = true;
+		r->isStatic = true;
 		r->transform.position -= glm::vec3(0.00f, 0.0f, 0);
 		r->transform.scale = glm::vec3(0.995f);
 		r->transform.updateTransformMatrix();
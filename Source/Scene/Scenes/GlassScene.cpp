@@ -28,6 +28,7 @@ void GlassScene::init(unsigned int viewportWidth, unsigned int viewportHeight) {
 		renderers.push_back(new MeshRenderer(&(cornell->meshes[i])));
 	}
 	for (auto & r : renderers) {
+		r->isStatic = true;
 		r->transform.position -= glm::vec3(0.00f, 0.0f, 0);
 		r->transform.scale = glm::vec3(0.995f);
 		r->transform.updateTransformMatrix();
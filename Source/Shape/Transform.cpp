@@ -7,7 +7,11 @@ Transform::Transform() {
 }
 
 void Transform::updateTransformMatrix() {
-	transform = glm::translate(position) * glm::mat4_cast(glm::quat(rotation)) * glm::scale(scale);
+	glm::mat4 newTransform = glm::translate(position) * glm::mat4_cast(glm::quat(rotation)) * glm::scale(scale);
+	if (newTransform != transform) {
+		transform = newTransform;
+		++version;
+	}
 	transformIsInvalid = false;
 }
 
@@ -25,6 +25,9 @@ public:
 	/// <summary> Returns a reference to the transform matrix </summary>
 	glm::mat4 & getTransformMatrix();
 
+	/// <summary> Is incremented every time updateTransformMatrix results in a different matrix. </summary>
+	unsigned int getVersion() const { return version; }
+
 	/// <summary> Output. </summary>
 	friend std::ostream & operator<<(std::ostream &, const Transform &);
 
@@ -34,4 +37,5 @@ public:
 	glm::vec3 right();
 private:
 	glm::mat4 transform;
+	unsigned int version = 0;
 };
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include "BrickStreamer.h"
+
+// Stdlib.
+#include <queue>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+#include "SvoFile.h"
+#include "../Graphic/Texture3D.h"
+#include "../Utility/ThreadPool.h"
+
+namespace {
+	const uint32_t NODE_MASK_VALUE = 0x3FFFFFFF;
+	const uint32_t NODE_MASK_BRICK = 0x00000001U << 30;
+	const uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+
+	uint32_t vec3ToUintXYZ10(const glm::uvec3 & val) {
+		return (val.z & 0x000003FF) << 20U | (val.y & 0x000003FF) << 10U | (val.x & 0x000003FF);
+	}
+
+	glm::uvec3 uintXYZ10ToVec3(uint32_t val) {
+		return glm::uvec3(val & 0x000003FF, (val & 0x000FFC00) >> 10U, (val & 0x3FF00000) >> 20U);
+	}
+
+	// Distance from a point to a box, 0 inside.
+	float boxDistance(const glm::vec3 & pos, const glm::vec3 & boxMin, float size) {
+		glm::vec3 d = glm::max(glm::max(boxMin - pos, pos - (boxMin + glm::vec3(size))), glm::vec3(0.0f));
+		return glm::length(d);
+	}
+
+	struct Candidate {
+		float priority;
+		uint32_t address;
+		uint32_t level;
+		glm::uvec3 cell; // node position in nodes of its level
+
+		bool operator<(const Candidate & other) const { return priority < other.priority; }
+	};
+}
+
+BrickStreamer::BrickStreamer(std::shared_ptr<SvoFile> file, int brickPoolDim, int bricksPerFrame, ThreadPool * threadPool)
+	: m_file(file), m_threadPool(threadPool ? threadPool : &ThreadPool::getInstance()),
+	m_brickPoolDim(brickPoolDim), m_bricksPerFrame(std::max(bricksPerFrame, 1)),
+	m_selectionDone(false), m_copyDone(false)
+{
+	const uint32_t bricksPerEdge = (uint32_t)brickPoolDim / 3U;
+	const uint32_t numSlots = bricksPerEdge * bricksPerEdge * bricksPerEdge;
+	m_slotNode.assign(numSlots, EMPTY_SLOT);
+	m_slotGeneration.assign(numSlots, 0);
+	m_slotLru.resize(numSlots);
+	for (uint32_t slot = numSlots - 1; slot > 0; --slot) {
+		m_freeSlots.push_back(slot);
+	}
+
+	for (int i = 0; i < NUM_STAGING_SEGMENTS; ++i) {
+		m_segmentFences[i] = 0;
+	}
+
+	// One segment is filled by a worker while the GPU may still read the other one
+	const GLsizeiptr stagingSize = (GLsizeiptr)NUM_STAGING_SEGMENTS * m_bricksPerFrame * STAGED_BRICK_SIZE;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_stagingBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, stagingSize, nullptr, flags);
+	m_stagingData = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stagingSize, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+BrickStreamer::~BrickStreamer()
+{
+	// The workers write to members and the staging buffer
+	while ((m_selecting && !m_selectionDone) || (m_copying && !m_copyDone)) {
+		std::this_thread::yield();
+	}
+
+	for (int i = 0; i < NUM_STAGING_SEGMENTS; ++i) {
+		if (m_segmentFences[i]) {
+			glDeleteSync(m_segmentFences[i]);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &m_stagingBuffer);
+}
+
+void BrickStreamer::update(const glm::vec3 & cameraPosTex, float lodDistance, Texture3D * const brickPools[3], std::vector<NodeColorWrite> & nodeColorWrites)
+{
+	if (m_copying && m_copyDone) {
+		uploadBricks(brickPools);
+		nodeColorWrites.insert(nodeColorWrites.end(), m_batchColorWrites.begin(), m_batchColorWrites.end());
+		m_copying = false;
+	}
+
+	if (m_selecting && m_selectionDone) {
+		m_selection.swap(m_nextSelection);
+		m_selectionCursor = 0;
+		m_selecting = false;
+		++m_generation;
+
+		// The most important nodes end up at the front of the LRU list
+		for (auto it = m_selection.rbegin(); it != m_selection.rend(); ++it) {
+			auto slot = m_nodeSlot.find(*it);
+			if (slot != m_nodeSlot.end()) {
+				touchSlot(slot->second);
+			}
+		}
+	}
+
+	if (!m_selecting) {
+		m_selecting = true;
+		m_selectionDone = false;
+		m_threadPool->run([this, cameraPosTex, lodDistance]() {
+			selectNodes(cameraPosTex, lodDistance, m_nextSelection);
+			m_selectionDone = true;
+		});
+	}
+
+	if (!m_copying) {
+		// Wait for the GPU to finish reading the staging segment, without blocking
+		GLsync & fence = m_segmentFences[m_segment];
+		if (fence) {
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				return;
+			}
+			glDeleteSync(fence);
+			fence = 0;
+		}
+
+		if (startBatch(nodeColorWrites)) {
+			m_copying = true;
+			m_copyDone = false;
+			unsigned char * staging = m_stagingData + (size_t)m_segment * m_bricksPerFrame * STAGED_BRICK_SIZE;
+			m_threadPool->run([this, staging]() {
+				copyBricks(m_batch, staging);
+				m_copyDone = true;
+			});
+		}
+	}
+}
+
+void BrickStreamer::selectNodes(const glm::vec3 & cameraPosTex, float lodDistance, std::vector<uint32_t> & selection) const
+{
+	const SvoFile::Info & info = m_file->getInfo();
+	const uint32_t * nodeNext = m_file->getNodePool(CpuOctreeBuilder::NODE_POOL_NEXT);
+	const uint32_t * nodeColor = m_file->getNodePool(CpuOctreeBuilder::NODE_POOL_COLOR);
+	const size_t maxSelection = m_slotNode.size() - 1;
+
+	// Best-first from the root. A child is never more important than its parent, so
+	// the selection is top-down and the ancestors of a selected node are selected as well.
+	selection.clear();
+	std::priority_queue<Candidate> candidates;
+	candidates.push({ 1.0f, 0U, 0U, glm::uvec3(0) });
+	while (!candidates.empty() && selection.size() < maxSelection) {
+		Candidate node = candidates.top();
+		candidates.pop();
+
+		if ((nodeColor[node.address] & NODE_MASK_VALUE) != 0U) {
+			selection.push_back(node.address);
+		}
+
+		uint32_t childTile = nodeNext[node.address] & NODE_MASK_VALUE;
+		if (childTile == 0U || node.level + 1 >= info.numLevels) {
+			continue;
+		}
+
+		float size = 1.0f / float(1U << node.level);
+		if (boxDistance(cameraPosTex, glm::vec3(node.cell) * size, size) >= lodDistance * size) {
+			continue;
+		}
+
+		float childSize = 0.5f * size;
+		for (uint32_t i = 0; i < 8; ++i) {
+			uint32_t childAddress = childTile + i;
+			if (childAddress >= info.maxNodes || (nodeNext[childAddress] & NODE_MASK_BRICK) == 0U) {
+				continue;
+			}
+			glm::uvec3 childCell = node.cell * 2U + glm::uvec3(i & 1U, (i >> 1U) & 1U, (i >> 2U) & 1U);
+			float dist = boxDistance(cameraPosTex, glm::vec3(childCell) * childSize, childSize);
+			float priority = std::min(node.priority, childSize / (dist + childSize));
+			candidates.push({ priority, childAddress, node.level + 1, childCell });
+		}
+	}
+}
+
+bool BrickStreamer::startBatch(std::vector<NodeColorWrite> & nodeColorWrites)
+{
+	const uint32_t * nodeColor = m_file->getNodePool(CpuOctreeBuilder::NODE_POOL_COLOR);
+
+	m_batch.clear();
+	m_batchColorWrites.clear();
+	while (m_selectionCursor < m_selection.size() && m_batch.size() < (size_t)m_bricksPerFrame) {
+		uint32_t address = m_selection[m_selectionCursor];
+		if (m_nodeSlot.find(address) == m_nodeSlot.end()) {
+			uint32_t slot = takeSlot(nodeColorWrites);
+			if (slot == 0U) {
+				// Every brick is in use by the current selection
+				break;
+			}
+			m_slotNode[slot] = address;
+			m_nodeSlot[address] = slot;
+			m_lru.push_front(slot);
+			m_slotLru[slot] = m_lru.begin();
+			m_slotGeneration[slot] = m_generation;
+
+			uint32_t fileColor = nodeColor[address];
+			m_batch.push_back({ fileColor & NODE_MASK_VALUE, slot });
+			m_batchColorWrites.push_back({ address, (fileColor & ~NODE_MASK_VALUE) | vec3ToUintXYZ10(slotAddress(slot)) });
+		}
+		++m_selectionCursor;
+	}
+	return !m_batch.empty();
+}
+
+uint32_t BrickStreamer::takeSlot(std::vector<NodeColorWrite> & nodeColorWrites)
+{
+	if (!m_freeSlots.empty()) {
+		uint32_t slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+		return slot;
+	}
+
+	// Evict the least recently selected brick, unless the current selection still uses it
+	if (m_lru.empty() || m_slotGeneration[m_lru.back()] >= m_generation) {
+		return 0U;
+	}
+	uint32_t slot = m_lru.back();
+	m_lru.pop_back();
+
+	uint32_t address = m_slotNode[slot];
+	uint32_t fileColor = m_file->getNodePool(CpuOctreeBuilder::NODE_POOL_COLOR)[address];
+	nodeColorWrites.push_back({ address, fileColor & ~NODE_MASK_VALUE });
+	m_nodeSlot.erase(address);
+	m_slotNode[slot] = EMPTY_SLOT;
+	return slot;
+}
+
+void BrickStreamer::touchSlot(uint32_t slot)
+{
+	m_lru.splice(m_lru.begin(), m_lru, m_slotLru[slot]);
+	m_slotGeneration[slot] = m_generation;
+}
+
+void BrickStreamer::copyBricks(const std::vector<StagedBrick> & bricks, unsigned char * staging) const
+{
+	const size_t fileDim = m_file->getInfo().brickPoolDim;
+	const size_t rowSize = 3 * sizeof(uint32_t);
+
+	for (size_t i = 0; i < bricks.size(); ++i) {
+		glm::uvec3 brick = uintXYZ10ToVec3(bricks[i].fileBrick);
+		for (int pool = 0; pool < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; ++pool) {
+			const uint32_t * voxels = m_file->getBrickPool((CpuOctreeBuilder::BrickPoolData)pool);
+			unsigned char * dst = staging + (i * CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES + pool) * 27 * sizeof(uint32_t);
+			for (size_t z = 0; z < 3; ++z) {
+				for (size_t y = 0; y < 3; ++y) {
+					const uint32_t * row = voxels + ((brick.z + z) * fileDim + brick.y + y) * fileDim + brick.x;
+					memcpy(dst + (z * 3 + y) * rowSize, row, rowSize);
+				}
+			}
+		}
+	}
+}
+
+void BrickStreamer::uploadBricks(Texture3D * const brickPools[3])
+{
+	const size_t segmentOffset = (size_t)m_segment * m_bricksPerFrame * STAGED_BRICK_SIZE;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer);
+	for (int pool = 0; pool < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; ++pool) {
+		glBindTexture(GL_TEXTURE_3D, brickPools[pool]->textureID);
+		for (size_t i = 0; i < m_batch.size(); ++i) {
+			glm::uvec3 address = slotAddress(m_batch[i].slot);
+			size_t offset = segmentOffset + (i * CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES + pool) * 27 * sizeof(uint32_t);
+			glTexSubImage3D(GL_TEXTURE_3D, 0, address.x, address.y, address.z, 3, 3, 3, GL_RGBA, GL_UNSIGNED_BYTE, (const void *)offset);
+		}
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	m_segmentFences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_segment = (m_segment + 1) % NUM_STAGING_SEGMENTS;
+}
+
+glm::uvec3 BrickStreamer::slotAddress(uint32_t slot) const
+{
+	const uint32_t bricksPerEdge = (uint32_t)m_brickPoolDim / 3U;
+	return glm::uvec3(slot % bricksPerEdge, (slot / bricksPerEdge) % bricksPerEdge, slot / (bricksPerEdge * bricksPerEdge)) * 3U;
+}
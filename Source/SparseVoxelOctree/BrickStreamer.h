@@ -0,0 +1,97 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+#define GLEW_STATIC
+#include <glew.h>
+#include <glm.hpp>
+
+class SvoFile;
+class Texture3D;
+class ThreadPool;
+
+/// <summary> Streams the bricks of a baked octree (SvoFile) into the brick pool textures, for octrees whose
+/// bricks do not fit into the GPU brick pool. The node pool holds the whole octree of the file; nodes whose
+/// brick is not resident have a brick pointer of 0 (see isResident in _utilityFunctions.shader) and cone tracing
+/// samples their closest resident ancestor instead.
+/// Every frame the nodes around the camera are selected on a worker thread, top-down, so the ancestors of a
+/// resident brick are resident as well. Missing bricks are copied from the mapped file into a persistently
+/// mapped staging buffer on a worker thread and uploaded in the frame after the copy finished. When the pool
+/// is full, the bricks that were not selected for the longest time are evicted. </summary>
+class BrickStreamer {
+public:
+	/// <summary> A changed word of the node color field. </summary>
+	struct NodeColorWrite {
+		uint32_t address;
+		uint32_t value;
+	};
+
+	/// <summary> brickPoolDim is the size of the GPU brick pool textures, bricksPerFrame the most bricks uploaded in one frame. </summary>
+	BrickStreamer(std::shared_ptr<SvoFile> file, int brickPoolDim, int bricksPerFrame, ThreadPool * threadPool = nullptr);
+	~BrickStreamer();
+
+	/// <summary> Advances the streaming by one frame and never waits for the workers or the GPU.
+	/// cameraPosTex is the camera in voxel texture space. Nodes are refined while the camera is closer than
+	/// lodDistance times their size. Uploads the finished copies into brickPools (color, irradiance, normal)
+	/// and appends the node colors which changed with them; they have to be written before the next draw. </summary>
+	void update(const glm::vec3 & cameraPosTex, float lodDistance, Texture3D * const brickPools[3], std::vector<NodeColorWrite> & nodeColorWrites);
+
+	size_t getNumResidentBricks() const { return m_nodeSlot.size(); }
+	const SvoFile & getFile() const { return *m_file; }
+
+private:
+	static const int NUM_STAGING_SEGMENTS = 2;
+	static const size_t STAGED_BRICK_SIZE = 3 * 27 * sizeof(uint32_t); // color, irradiance and normal voxels
+
+	struct StagedBrick {
+		uint32_t fileBrick; // XYZ10 brick address in the file
+		uint32_t slot;      // brick index in the GPU pool
+	};
+
+	BrickStreamer(BrickStreamer const &) = delete;
+	void operator=(BrickStreamer const &) = delete;
+
+	void selectNodes(const glm::vec3 & cameraPosTex, float lodDistance, std::vector<uint32_t> & selection) const;
+	void copyBricks(const std::vector<StagedBrick> & bricks, unsigned char * staging) const;
+	void uploadBricks(Texture3D * const brickPools[3]);
+	bool startBatch(std::vector<NodeColorWrite> & nodeColorWrites);
+	uint32_t takeSlot(std::vector<NodeColorWrite> & nodeColorWrites);
+	void touchSlot(uint32_t slot);
+	glm::uvec3 slotAddress(uint32_t slot) const;
+
+	std::shared_ptr<SvoFile> m_file;
+	ThreadPool * m_threadPool;
+	int m_brickPoolDim;
+	int m_bricksPerFrame;
+
+	// Residency. Slot 0 is brick 0, never handed out.
+	std::vector<uint32_t> m_slotNode;       // node address per slot, or EMPTY_SLOT
+	std::vector<uint32_t> m_slotGeneration; // selection generation the slot's node was last selected in
+	std::vector<std::list<uint32_t>::iterator> m_slotLru; // position in m_lru of the occupied slots
+	std::list<uint32_t> m_lru;              // occupied slots, most recently selected first
+	std::vector<uint32_t> m_freeSlots;
+	std::unordered_map<uint32_t, uint32_t> m_nodeSlot;
+
+	// Selection, running on a worker while m_selecting is set
+	std::vector<uint32_t> m_selection;      // node addresses, most important first
+	std::vector<uint32_t> m_nextSelection;
+	size_t m_selectionCursor = 0;           // nodes before it are resident
+	uint32_t m_generation = 0;              // counts the finished selections
+	bool m_selecting = false;
+	std::atomic<bool> m_selectionDone;
+
+	// Copy of a batch into the staging buffer, running on a worker while m_copying is set
+	GLuint m_stagingBuffer = 0;
+	unsigned char * m_stagingData = nullptr;
+	GLsync m_segmentFences[NUM_STAGING_SEGMENTS];
+	int m_segment = 0;
+	std::vector<StagedBrick> m_batch;
+	std::vector<NodeColorWrite> m_batchColorWrites;
+	bool m_copying = false;
+	std::atomic<bool> m_copyDone;
+};
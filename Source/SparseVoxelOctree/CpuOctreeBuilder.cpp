@@ -0,0 +1,988 @@
+#include "CpuOctreeBuilder.h"
+
+// Stdlib.
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+// External.
+#include <gtc/matrix_inverse.hpp>
+
+// Internal.
+#include "../Utility/ThreadPool.h"
+#include "../Graphic/Renderer/MeshRenderer.h"
+#include "../Shape/Mesh.h"
+
+// The constants and helpers below mirror Shaders/SparseVoxelOctree/_utilityFunctions.shader.
+namespace {
+	const uint32_t NODE_MASK_VALUE = 0x3FFFFFFF;
+	const uint32_t NODE_MASK_TAG = 0x00000001U << 31;
+	const uint32_t NODE_MASK_BRICK = 0x00000001U << 30;
+	const int NUM_LEVEL_ADDRESSES = 13; // Size of the level address buffer (MAX_NODE_POOL_LEVELS).
+	const int SUBPIXEL_BITS = 8; // Sub-pixel precision of the rasterizer.
+
+	const glm::uvec3 childOffsets[8] = {
+		glm::uvec3(0, 0, 0),
+		glm::uvec3(1, 0, 0),
+		glm::uvec3(0, 1, 0),
+		glm::uvec3(1, 1, 0),
+		glm::uvec3(0, 0, 1),
+		glm::uvec3(1, 0, 1),
+		glm::uvec3(0, 1, 1),
+		glm::uvec3(1, 1, 1) };
+
+	const float gaussianWeight[4] = { 0.25f, 0.125f, 0.0625f, 0.03125f };
+
+	// The shaders index childOffsets with the unchecked child offset, which exceeds 7 for positions
+	// clamped to 1.0. Out of range reads of a const array are undefined in GLSL; we read zero.
+	glm::vec3 childOffset(uint32_t off) {
+		return off < 8 ? glm::vec3(childOffsets[off]) : glm::vec3(0.0f);
+	}
+
+	glm::uvec3 toUint(const glm::vec3 & val) {
+		return glm::uvec3(
+			val.x > 0.0f ? (uint32_t)val.x : 0U,
+			val.y > 0.0f ? (uint32_t)val.y : 0U,
+			val.z > 0.0f ? (uint32_t)val.z : 0U);
+	}
+
+	uint32_t vec3ToUintXYZ10(const glm::uvec3 & val) {
+		return (val.z & 0x000003FF) << 20U
+			| (val.y & 0x000003FF) << 10U
+			| (val.x & 0x000003FF);
+	}
+
+	glm::uvec3 uintXYZ10ToVec3(uint32_t val) {
+		return glm::uvec3(val & 0x000003FF, (val & 0x000FFC00) >> 10U, (val & 0x3FF00000) >> 20U);
+	}
+
+	// The two words of the fragment list (XY, Z) in one value, Z in the high word.
+	uint64_t vec3ToUintXYZ16(const glm::uvec3 & val) {
+		return (uint64_t)(val.z & 0x0000FFFF) << 32U
+			| (val.y & 0x0000FFFF) << 16U
+			| (val.x & 0x0000FFFF);
+	}
+
+	glm::uvec3 uintXYZ16ToVec3(uint64_t val) {
+		return glm::uvec3(uint32_t(val & 0x0000FFFF), uint32_t((val >> 16U) & 0x0000FFFF), uint32_t((val >> 32U) & 0x0000FFFF));
+	}
+
+	glm::vec4 convRGBA8ToVec4(uint32_t val) {
+		return glm::vec4(
+			float(val & 0x000000FF),
+			float((val & 0x0000FF00) >> 8U),
+			float((val & 0x00FF0000) >> 16U),
+			float((val & 0xFF000000) >> 24U));
+	}
+
+	uint32_t convVec4ToRGBA8(const glm::vec4 & val) {
+		glm::uvec3 xyz = toUint(glm::vec3(val));
+		uint32_t w = val.w > 0.0f ? (uint32_t)val.w : 0U;
+		return (w & 0x000000FF) << 24U
+			| (xyz.z & 0x000000FF) << 16U
+			| (xyz.y & 0x000000FF) << 8U
+			| (xyz.x & 0x000000FF);
+	}
+
+	// imageStore into a GL_RGBA8 image. Ties round up.
+	uint32_t packUnorm(const glm::vec4 & val) {
+		uint32_t result = 0;
+		for (int i = 0; i < 4; ++i) {
+			float v = std::min(std::max(val[i], 0.0f), 1.0f);
+			result |= (uint32_t)std::floor(v * 255.0f + 0.5f) << (8 * i);
+		}
+		return result;
+	}
+
+	// imageLoad from a GL_RGBA8 image.
+	glm::vec4 unpackUnorm(uint32_t val) {
+		return convRGBA8ToVec4(val) / 255.0f;
+	}
+
+	// Sequential version of imageAtomicRGBA8Avg in voxelizeFrag.shader.
+	void imageRGBA8Avg(uint32_t & texel, glm::vec4 newVal) {
+		newVal.x *= 255.0f;
+		newVal.y *= 255.0f;
+		newVal.z *= 255.0f;
+		if (texel == 0) {
+			texel = convVec4ToRGBA8(newVal);
+			return;
+		}
+		glm::vec4 currVal = convRGBA8ToVec4(texel);
+		currVal.x *= currVal.w;
+		currVal.y *= currVal.w;
+		currVal.z *= currVal.w;
+		currVal += newVal;
+		currVal.x /= currVal.w;
+		currVal.y /= currVal.w;
+		currVal.z /= currVal.w;
+		texel = convVec4ToRGBA8(currVal);
+	}
+
+	// Edge function in fixed point; positive on the left of a -> b.
+	int64_t edgeFunction(const glm::i64vec2 & a, const glm::i64vec2 & b, const glm::i64vec2 & p) {
+		return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	}
+
+	// Top-left fill rule for counter clockwise triangles with y pointing up.
+	bool isTopLeft(const glm::i64vec2 & a, const glm::i64vec2 & b) {
+		return (b.y < a.y) || (b.y == a.y && b.x < a.x);
+	}
+}
+
+CpuOctreeBuilder::CpuOctreeBuilder(int nodePoolDim, int brickPoolDim, const uint32_t * levelTileCapacity, ThreadPool * threadPool) :
+	m_threadPool(threadPool ? threadPool : &ThreadPool::getInstance()),
+	m_nodePoolDim(nodePoolDim),
+	m_brickPoolDim(brickPoolDim),
+	m_nextFreeBrick(1)
+{
+	m_numLevels = (int)log2f((float)m_nodePoolDim);
+
+	// The leaf level hands out no tiles, as in Graphics::initSparseVoxelization.
+	m_levelTileCapacity.assign(NUM_LEVEL_ADDRESSES, 0);
+	for (int i = 0; i < m_numLevels - 1; i++) {
+		m_levelTileCapacity[i] = levelTileCapacity ? levelTileCapacity[i] : 1U << (3 * i);
+	}
+
+	// The children of the tiles of level L are the nodes of level L + 1, as in Graphics::resizeNodePool.
+	m_levelAddress.assign(NUM_LEVEL_ADDRESSES, 0);
+	uint32_t levelFirstTile = 0;
+	for (int i = 1; i < NUM_LEVEL_ADDRESSES; i++) {
+		m_levelAddress[i] = 1 + 8 * levelFirstTile;
+		levelFirstTile += m_levelTileCapacity[i - 1];
+	}
+	m_maxNodes = (int)m_levelAddress[m_numLevels];
+}
+
+void CpuOctreeBuilder::clearGeometry()
+{
+	m_triangles.clear();
+}
+
+void CpuOctreeBuilder::addRenderers(const std::vector<MeshRenderer *> & renderers)
+{
+	// The diffuse color is a uniform that keeps its value when a renderer has no material setting,
+	// so such renderers get the color of the last renderer drawn before them (in the previous frame, if need be).
+	glm::vec3 diffuseColor(0.0f);
+	for (auto * renderer : renderers) {
+		if (renderer->enabled && renderer->materialSetting != nullptr) {
+			diffuseColor = renderer->materialSetting->diffuseColor;
+		}
+	}
+
+	for (auto * renderer : renderers) {
+		if (!renderer->enabled) continue;
+		renderer->transform.updateTransformMatrix();
+		if (renderer->materialSetting != nullptr) {
+			diffuseColor = renderer->materialSetting->diffuseColor;
+		}
+
+		const glm::mat4 & M = renderer->transform.getTransformMatrix();
+		const glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(M)));
+		const Mesh & mesh = *renderer->mesh;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			Triangle triangle;
+			for (int j = 0; j < 3; ++j) {
+				const VertexData & vertex = mesh.vertexData[mesh.indices[i + j]];
+				triangle.position[j] = glm::vec3(M * glm::vec4(vertex.position, 1));
+				triangle.normal[j] = glm::normalize(normalMatrix * vertex.normal);
+			}
+			triangle.diffuseColor = diffuseColor;
+			m_triangles.push_back(triangle);
+		}
+	}
+}
+
+template<typename Body>
+void CpuOctreeBuilder::parallelFor(size_t count, size_t grainSize, const Body & body)
+{
+	m_threadPool->parallelFor(0, count, grainSize, body);
+}
+
+void CpuOctreeBuilder::build(const glm::mat4 & voxelGridTransformI)
+{
+	clearPools();
+
+	voxelizeScene(voxelGridTransformI);
+
+	flagNode(0);
+	for (int level = 1; level < m_numLevels; level++) {
+		allocateNode(level - 1);
+		flagNode(level);
+		findNeighbours(level);
+	}
+
+	allocateBrick();
+
+	writeLeafNode();
+
+	spreadLeafBrick(BRICK_POOL_COLOR);
+	spreadLeafBrick(BRICK_POOL_NORMAL);
+
+	borderTransfer(m_numLevels - 1, BRICK_POOL_COLOR);
+	borderTransfer(m_numLevels - 1, BRICK_POOL_NORMAL);
+
+	for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
+		mipmap(ithLevel, BRICK_POOL_COLOR, glm::vec4(0));
+		if (ithLevel > 0) {
+			borderTransfer(ithLevel, BRICK_POOL_COLOR);
+		}
+	}
+	for (int ithLevel = m_numLevels - 2; ithLevel >= 0; --ithLevel) {
+		mipmap(ithLevel, BRICK_POOL_NORMAL, glm::vec4(0.5, 0.5, 0.5, 0.0));
+		if (ithLevel > 0) {
+			borderTransfer(ithLevel, BRICK_POOL_NORMAL);
+		}
+	}
+}
+
+// ----------------------
+// Passes.
+// ----------------------
+void CpuOctreeBuilder::clearPools()
+{
+	for (int i = 0; i < NODE_POOL_NUM_TEXTURES; i++) {
+		m_nodePool[i].clear();
+	}
+
+	// Same clear values as clearBrickPoolVert.shader.
+	size_t brickVoxels = (size_t)m_brickPoolDim * m_brickPoolDim * m_brickPoolDim;
+	m_brickPool[BRICK_POOL_COLOR].assign(brickVoxels, packUnorm(glm::vec4(0.0)));
+	m_brickPool[BRICK_POOL_IRRADIANCE].assign(brickVoxels, packUnorm(glm::vec4(0.0)));
+	m_brickPool[BRICK_POOL_NORMAL].assign(brickVoxels, packUnorm(glm::vec4(0.5, 0.5, 0.5, 0.0)));
+
+	m_fragmentList.clear();
+	m_voxelColor.clear();
+	m_voxelNormal.clear();
+
+	m_nextFreeTile.assign(NUM_LEVEL_ADDRESSES, 0);
+	m_nextFreeBrick = 1;
+}
+
+unsigned int CpuOctreeBuilder::getNumTiles() const
+{
+	unsigned int numTiles = 0;
+	for (uint32_t levelTiles : m_nextFreeTile) {
+		numTiles += levelTiles;
+	}
+	return numTiles;
+}
+
+void CpuOctreeBuilder::rasterizeTriangle(const Triangle & triangle, const glm::mat4 & voxelGridTransformI, std::vector<Fragment> & fragments) const
+{
+	// Dominant axis of the first vertex normal, see calcProjAxis in voxelizeGeom.shader.
+	int projAxis = 0;
+	float maxArea = 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		float area = std::abs(triangle.normal[0][i]);
+		if (area > maxArea) {
+			maxArea = area;
+			projAxis = i;
+		}
+	}
+
+	glm::vec3 posTexSpace[3];
+	glm::i64vec2 window[3];
+	const float subPixels = float(1 << SUBPIXEL_BITS);
+	for (int i = 0; i < 3; ++i) {
+		posTexSpace[i] = glm::vec3(voxelGridTransformI * glm::vec4(triangle.position[i], 1.0f));
+		glm::vec2 proj;
+		switch (projAxis) {
+		case 0: proj = glm::vec2(posTexSpace[i].z, posTexSpace[i].y); break;
+		case 1: proj = glm::vec2(posTexSpace[i].x, posTexSpace[i].z); break;
+		default: proj = glm::vec2(posTexSpace[i].x, posTexSpace[i].y); break;
+		}
+		// gl_Position = (proj - 0.5) * 2 followed by the viewport transform of a dim x dim viewport.
+		glm::vec2 ndc = (proj - 0.5f) * 2.0f;
+		glm::vec2 windowPos = (ndc + 1.0f) * 0.5f * float(m_nodePoolDim);
+		window[i] = glm::i64vec2((int64_t)std::llround(windowPos.x * subPixels), (int64_t)std::llround(windowPos.y * subPixels));
+	}
+
+	int order[3] = { 0, 1, 2 };
+	int64_t area = edgeFunction(window[0], window[1], window[2]);
+	if (area == 0) {
+		return;
+	}
+	if (area < 0) {
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+	const glm::i64vec2 & v0 = window[order[0]];
+	const glm::i64vec2 & v1 = window[order[1]];
+	const glm::i64vec2 & v2 = window[order[2]];
+	const bool topLeft0 = isTopLeft(v1, v2);
+	const bool topLeft1 = isTopLeft(v2, v0);
+	const bool topLeft2 = isTopLeft(v0, v1);
+
+	const int64_t pixelSize = 1 << SUBPIXEL_BITS;
+	int64_t minX = std::min(v0.x, std::min(v1.x, v2.x)), maxX = std::max(v0.x, std::max(v1.x, v2.x));
+	int64_t minY = std::min(v0.y, std::min(v1.y, v2.y)), maxY = std::max(v0.y, std::max(v1.y, v2.y));
+	int x0 = (int)std::max<int64_t>(0, minX / pixelSize - 1), x1 = (int)std::min<int64_t>(m_nodePoolDim - 1, maxX / pixelSize + 1);
+	int y0 = (int)std::max<int64_t>(0, minY / pixelSize - 1), y1 = (int)std::min<int64_t>(m_nodePoolDim - 1, maxY / pixelSize + 1);
+
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			// Sample at the pixel center.
+			glm::i64vec2 p(x * pixelSize + pixelSize / 2, y * pixelSize + pixelSize / 2);
+			int64_t w0 = edgeFunction(v1, v2, p);
+			int64_t w1 = edgeFunction(v2, v0, p);
+			int64_t w2 = edgeFunction(v0, v1, p);
+			if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+			if ((w0 == 0 && !topLeft0) || (w1 == 0 && !topLeft1) || (w2 == 0 && !topLeft2)) continue;
+
+			float b0 = float(double(w0) / double(area));
+			float b1 = float(double(w1) / double(area));
+			float b2 = float(double(w2) / double(area));
+			glm::vec3 pos = b0 * posTexSpace[order[0]] + b1 * posTexSpace[order[1]] + b2 * posTexSpace[order[2]];
+			glm::vec3 normal = b0 * triangle.normal[order[0]] + b1 * triangle.normal[order[1]] + b2 * triangle.normal[order[2]];
+
+			// voxelizeFrag.shader
+			glm::uvec3 baseVoxel = glm::min(toUint(glm::floor(pos * float(m_nodePoolDim))), glm::uvec3(m_nodePoolDim - 1));
+			Fragment fragment;
+			fragment.position = vec3ToUintXYZ16(baseVoxel);
+			fragment.color = glm::vec4(triangle.diffuseColor, 1.0f);
+			fragment.normal = glm::vec4(glm::normalize(normal) * 0.5f + 0.5f, 1.0f);
+			fragments.push_back(fragment);
+		}
+	}
+}
+
+void CpuOctreeBuilder::voxelizeScene(const glm::mat4 & voxelGridTransformI)
+{
+	// Rasterize chunks of triangles in parallel; the chunks are concatenated in draw order.
+	const size_t grainSize = 256;
+	std::vector<std::vector<Fragment>> chunkFragments((m_triangles.size() + grainSize - 1) / grainSize);
+	parallelFor(m_triangles.size(), grainSize, [&](size_t begin, size_t end) {
+		auto & fragments = chunkFragments[begin / grainSize];
+		for (size_t i = begin; i < end; ++i) {
+			rasterizeTriangle(m_triangles[i], voxelGridTransformI, fragments);
+		}
+	});
+
+	std::vector<Fragment> fragments;
+	for (auto & chunk : chunkFragments) {
+		fragments.insert(fragments.end(), chunk.begin(), chunk.end());
+	}
+
+	// Only the fragment claiming an empty voxel stores its position (firstInVoxel in voxelizeFrag.shader),
+	// so the list holds every voxel once. The first fragment in draw order claims it here.
+	std::unordered_map<uint64_t, uint32_t> listIndices;
+	std::vector<uint32_t> fragmentVoxels(fragments.size());
+	for (size_t i = 0; i < fragments.size(); ++i) {
+		auto inserted = listIndices.emplace(fragments[i].position, (uint32_t)m_fragmentList.size());
+		if (inserted.second) {
+			m_fragmentList.push_back(fragments[i].position);
+		}
+		fragmentVoxels[i] = inserted.first->second;
+	}
+
+	// Average the fragment attributes per voxel in fragment order. Slabs of z are independent.
+	// Only the listed voxels keep attributes instead of the dense voxelFragTex textures.
+	m_voxelColor.assign(m_fragmentList.size(), 0);
+	m_voxelNormal.assign(m_fragmentList.size(), 0);
+	std::vector<std::vector<uint32_t>> slabFragments(m_nodePoolDim);
+	for (size_t i = 0; i < fragments.size(); ++i) {
+		slabFragments[uintXYZ16ToVec3(fragments[i].position).z].push_back((uint32_t)i);
+	}
+	parallelFor(slabFragments.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t z = begin; z < end; ++z) {
+			for (uint32_t i : slabFragments[z]) {
+				imageRGBA8Avg(m_voxelColor[fragmentVoxels[i]], fragments[i].color);
+				imageRGBA8Avg(m_voxelNormal[fragmentVoxels[i]], fragments[i].normal);
+			}
+		}
+	});
+}
+
+void CpuOctreeBuilder::flagNode(int level)
+{
+	const float nodeOffset = 1.0f / float(1 << level);
+	const glm::vec3 maxPosTex(float(m_nodePoolDim - 1) / float(m_nodePoolDim));
+	const size_t grainSize = 1024;
+	std::vector<std::vector<Write>> writes((m_fragmentList.size() + grainSize - 1) / grainSize);
+	parallelFor(m_fragmentList.size(), grainSize, [&](size_t begin, size_t end) {
+		auto & chunkWrites = writes[begin / grainSize];
+		for (size_t i = begin; i < end; ++i) {
+			glm::vec3 posTex = glm::vec3(uintXYZ16ToVec3(m_fragmentList[i])) / glm::vec3(float(m_nodePoolDim));
+			glm::vec3 nodeCenterPos;
+			int onLevel = 0;
+			// The cell of the parent, like flagNodeVert.shader
+			int nodeAddress = traverseSimple(posTex, level, nodeCenterPos, onLevel);
+			uint32_t nodeNext = NODE_MASK_TAG | NODE_MASK_BRICK | vec3ToUintXYZ10(toUint(nodeCenterPos * float(1 << onLevel)) >> 1U);
+			if (loadNode(NODE_POOL_NEXT, (uint32_t)nodeAddress) == 0U) {
+				chunkWrites.push_back({ (uint32_t)nodeAddress, nodeNext, NODE_POOL_NEXT });
+			}
+
+			for (int x = -1; x <= 1; x++) {
+				for (int y = -1; y <= 1; y++) {
+					for (int z = -1; z <= 1; z++) {
+						glm::vec3 offset = glm::vec3(float(x), float(y), float(z));
+						glm::vec3 neighPos = glm::clamp(posTex + offset * nodeOffset, glm::vec3(0.0f), maxPosTex);
+						nodeAddress = traverseSimple(neighPos, level, nodeCenterPos, onLevel);
+						nodeNext = NODE_MASK_TAG | NODE_MASK_BRICK | vec3ToUintXYZ10(toUint(nodeCenterPos * float(1 << onLevel)) >> 1U);
+						if (loadNode(NODE_POOL_NEXT, (uint32_t)nodeAddress) == 0U) {
+							chunkWrites.push_back({ (uint32_t)nodeAddress, nodeNext, NODE_POOL_NEXT });
+						}
+					}
+				}
+			}
+		}
+	});
+	applyWrites(NODE_POOL_NEXT, writes);
+}
+
+void CpuOctreeBuilder::allocateNode(int level)
+{
+	// Find the marked nodes in parallel, then hand out tiles in address order.
+	uint32_t levelBeginAddress, levelEndAddress;
+	getLevelRange(level, levelBeginAddress, levelEndAddress);
+	const size_t numThreads = levelEndAddress - levelBeginAddress;
+	const size_t grainSize = 4096;
+	std::vector<std::vector<uint32_t>> marked((numThreads + grainSize - 1) / grainSize);
+	parallelFor(numThreads, grainSize, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			uint32_t address = levelBeginAddress + (uint32_t)i;
+			uint32_t nodeNextU = loadNode(NODE_POOL_NEXT, address);
+			if ((nodeNextU & NODE_MASK_BRICK) != 0U && ((nodeNextU & NODE_MASK_TAG) != 0U || (nodeNextU & NODE_MASK_VALUE) == 0U)) {
+				marked[begin / grainSize].push_back(address);
+			}
+		}
+	});
+
+	// The tiles of level + 1 fill the range of its nodes, see allocChildTile in allocateNodeVert.shader.
+	// A full range leaves the node without children, the counter still counts the tile.
+	const uint32_t levelFirstTile = (m_levelAddress[level + 1] - 1U) / 8U;
+	const uint32_t levelEndTile = (m_levelAddress[level + 2] - 1U) / 8U;
+	for (auto & chunk : marked) {
+		for (uint32_t address : chunk) {
+			uint32_t nextFreeTile = levelFirstTile + m_nextFreeTile[level]++;
+			uint32_t nextFreeAddress = nextFreeTile < levelEndTile ? 1U + 8U * nextFreeTile : 0U;
+			storeNode(NODE_POOL_NEXT, address, NODE_MASK_BRICK | (NODE_MASK_VALUE & nextFreeAddress));
+		}
+	}
+}
+
+void CpuOctreeBuilder::findNeighbours(int level)
+{
+	uint32_t levelBeginAddress, levelEndAddress;
+	getLevelRange(level, levelBeginAddress, levelEndAddress);
+	const size_t numThreads = levelEndAddress - levelBeginAddress;
+	const size_t grainSize = 1024;
+	const float stepTex = 1.0f / float(1 << level);
+
+	auto isEmpty = [this](int nodeAddress) {
+		return (loadNode(NODE_POOL_NEXT, (uint32_t)nodeAddress) & NODE_MASK_BRICK) == 0;
+	};
+
+	std::vector<std::vector<Write>> writes((numThreads + grainSize - 1) / grainSize);
+	parallelFor(numThreads, grainSize, [&](size_t begin, size_t end) {
+		auto & chunkWrites = writes[begin / grainSize];
+		for (size_t i = begin; i < end; ++i) {
+			uint32_t nodeAddress = levelBeginAddress + (uint32_t)i;
+			if (nodeAddress >= levelEndAddress) break;
+
+			uint32_t nodeNextU = loadNode(NODE_POOL_NEXT, nodeAddress);
+			if ((nodeNextU & NODE_MASK_TAG) == 0U) continue;
+
+			glm::uvec3 cell = (uintXYZ10ToVec3(nodeNextU & NODE_MASK_VALUE) << 1U) + childOffsets[(nodeAddress - 1) % 8];
+			glm::vec3 posTex = (glm::vec3(cell) + glm::vec3(0.5f)) / float(1 << level);
+			chunkWrites.push_back({ nodeAddress, NODE_MASK_BRICK, NODE_POOL_NEXT });
+
+			unsigned int nodeLevel = 0;
+			traverseToLevel(posTex, nodeLevel, level + 1);
+
+			// X, Y, Z, X_neg, Y_neg, Z_neg in the order of findNeighbours.shader.
+			const NodePoolData neighbourPools[6] = {
+				NODE_POOL_NEIGH_X, NODE_POOL_NEIGH_Y, NODE_POOL_NEIGH_Z,
+				NODE_POOL_NEIGH_X_NEG, NODE_POOL_NEIGH_Y_NEG, NODE_POOL_NEIGH_Z_NEG };
+			for (int n = 0; n < 6; ++n) {
+				int axis = n % 3;
+				bool positive = n < 3;
+				int neighbour = 0;
+				if (positive ? posTex[axis] + stepTex < 1 : posTex[axis] - stepTex > 0) {
+					glm::vec3 neighPos = posTex;
+					neighPos[axis] = positive ? posTex[axis] + stepTex : posTex[axis] - stepTex;
+					unsigned int neighbourLevel = 0;
+					neighbour = traverseToLevel(neighPos, neighbourLevel, level + 1);
+					if (nodeLevel != neighbourLevel || isEmpty(neighbour)) {
+						neighbour = 0; // invalidate neighbour-pointer if they are not on the same level
+					}
+				}
+				chunkWrites.push_back({ nodeAddress, (uint32_t)neighbour, neighbourPools[n] });
+			}
+			// Links back from the neighbours, after all own pointers like the shader.
+			for (int n = 0; n < 6; ++n) {
+				uint32_t neighbour = chunkWrites[chunkWrites.size() - 6 + n].value;
+				if (neighbour != 0) {
+					chunkWrites.push_back({ neighbour, nodeAddress, neighbourPools[(n + 3) % 6] });
+				}
+			}
+		}
+	});
+	for (auto & chunk : writes) {
+		for (auto & write : chunk) {
+			storeNode((NodePoolData)write.data, write.address, write.value);
+		}
+	}
+}
+
+void CpuOctreeBuilder::allocateBrick()
+{
+	// One GPU thread per tile up to the leaf level: the tile's nodes in order, then the root after tile 0.
+	// Nodes which already have a brick are skipped.
+	const uint32_t numTiles = (m_levelAddress[m_numLevels] - 1) / 8;
+	const size_t grainSize = 1024;
+	std::vector<std::vector<uint32_t>> marked((numTiles + grainSize - 1) / grainSize);
+	parallelFor(numTiles, grainSize, [&](size_t begin, size_t end) {
+		auto & chunk = marked[begin / grainSize];
+		for (size_t tile = begin; tile < end; ++tile) {
+			uint32_t tileAddress = 8U * (uint32_t)tile + 1;
+			for (uint32_t i = 0; i < 8; ++i) {
+				if ((loadNode(NODE_POOL_NEXT, tileAddress + i) & NODE_MASK_BRICK) != 0 && loadNode(NODE_POOL_COLOR, tileAddress + i) == 0U) {
+					chunk.push_back(tileAddress + i);
+				}
+			}
+			if (tile == 0 && loadNode(NODE_POOL_COLOR, 0) == 0U) {
+				chunk.push_back(0);
+			}
+		}
+	});
+
+	// Nodes which find the brick pool full are left empty, as in _brickAllocator.shader.
+	const uint32_t brickPoolResBricks = m_brickPoolDim / 3;
+	for (auto & chunk : marked) {
+		for (uint32_t address : chunk) {
+			uint32_t nextFreeTexBrick = m_nextFreeBrick++;
+			if (nextFreeTexBrick >= brickPoolResBricks * brickPoolResBricks * brickPoolResBricks) {
+				storeNode(NODE_POOL_NEXT, address, loadNode(NODE_POOL_NEXT, address) & ~NODE_MASK_BRICK);
+				continue;
+			}
+			glm::uvec3 texAddress;
+			texAddress.x = nextFreeTexBrick % brickPoolResBricks;
+			texAddress.y = (nextFreeTexBrick / brickPoolResBricks) % brickPoolResBricks;
+			texAddress.z = nextFreeTexBrick / (brickPoolResBricks * brickPoolResBricks);
+			texAddress *= 3U;
+			storeNode(NODE_POOL_COLOR, address, vec3ToUintXYZ10(texAddress));
+		}
+	}
+}
+
+void CpuOctreeBuilder::writeLeafNode()
+{
+	const size_t grainSize = 1024;
+	std::vector<std::vector<Write>> writes((m_fragmentList.size() + grainSize - 1) / grainSize);
+	parallelFor(m_fragmentList.size(), grainSize, [&](size_t begin, size_t end) {
+		auto & chunkWrites = writes[begin / grainSize];
+		for (size_t i = begin; i < end; ++i) {
+			glm::uvec3 voxelPos = uintXYZ16ToVec3(m_fragmentList[i]);
+			uint32_t voxelColorU = m_voxelColor[i];
+			uint32_t voxelNormalU = m_voxelNormal[i];
+
+			glm::vec3 posTex = glm::vec3(voxelPos) / glm::vec3(float(m_nodePoolDim));
+			int nodeAddress = traversePosOut(posTex);
+
+			glm::ivec3 brickCoords = glm::ivec3(uintXYZ10ToVec3(loadNode(NODE_POOL_COLOR, (uint32_t)nodeAddress)));
+			glm::uvec3 offVec = toUint(2.0f * posTex);
+			uint32_t off = offVec.x + 2U * offVec.y + 4U * offVec.z;
+			int voxel = brickVoxelIndex(brickCoords + 2 * glm::ivec3(childOffset(off)));
+			if (voxel < 0) continue;
+
+			chunkWrites.push_back({ (uint32_t)voxel, packUnorm(convRGBA8ToVec4(voxelColorU) / 255.0f), BRICK_POOL_COLOR });
+			chunkWrites.push_back({ (uint32_t)voxel, packUnorm(convRGBA8ToVec4(voxelNormalU) / 255.0f), BRICK_POOL_NORMAL });
+			chunkWrites.push_back({ (uint32_t)voxel, packUnorm(glm::vec4(0.0, 0.0, 0.0, 1.0)), BRICK_POOL_IRRADIANCE });
+		}
+	});
+	for (auto & chunk : writes) {
+		for (auto & write : chunk) {
+			m_brickPool[write.data][write.address] = write.value;
+		}
+	}
+}
+
+void CpuOctreeBuilder::spreadLeafBrick(BrickPoolData pool)
+{
+	// One thread per node of the leaf level's tiles. The empty nodes among them (color 0) spread brick 0.
+	uint32_t levelStart, levelEnd;
+	getLevelRange(m_numLevels - 1, levelStart, levelEnd);
+
+	std::vector<uint32_t> bricks;
+	for (uint32_t address = levelStart; address < levelEnd; ++address) {
+		bricks.push_back(loadNode(NODE_POOL_COLOR, address));
+	}
+	// Nodes sharing a brick write the same values.
+	std::sort(bricks.begin(), bricks.end());
+	bricks.erase(std::unique(bricks.begin(), bricks.end()), bricks.end());
+
+	// Voxels written from the 8 corners, as in SpreadLeafBricks.shader: center, faces, then edges.
+	struct Spread {
+		glm::ivec3 offset;
+		int numCorners;
+		int corners[8];
+	};
+	static const Spread spreads[] = {
+		{ glm::ivec3(1,1,1), 8, { 0, 1, 2, 3, 4, 5, 6, 7 } },
+		{ glm::ivec3(2,1,1), 4, { 1, 3, 5, 7 } },
+		{ glm::ivec3(0,1,1), 4, { 0, 2, 4, 6 } },
+		{ glm::ivec3(1,2,1), 4, { 2, 3, 6, 7 } },
+		{ glm::ivec3(1,0,1), 4, { 0, 1, 4, 5 } },
+		{ glm::ivec3(1,1,2), 4, { 4, 5, 6, 7 } },
+		{ glm::ivec3(1,1,0), 4, { 0, 1, 2, 3 } },
+		{ glm::ivec3(1,0,0), 2, { 0, 1 } },
+		{ glm::ivec3(0,1,0), 2, { 0, 2 } },
+		{ glm::ivec3(1,2,0), 2, { 2, 3 } },
+		{ glm::ivec3(2,1,0), 2, { 3, 1 } },
+		{ glm::ivec3(0,0,1), 2, { 0, 4 } },
+		{ glm::ivec3(0,2,1), 2, { 2, 6 } },
+		{ glm::ivec3(2,2,1), 2, { 3, 7 } },
+		{ glm::ivec3(2,0,1), 2, { 1, 5 } },
+		{ glm::ivec3(0,1,2), 2, { 4, 6 } },
+		{ glm::ivec3(1,2,2), 2, { 6, 7 } },
+		{ glm::ivec3(2,1,2), 2, { 5, 7 } },
+		{ glm::ivec3(1,0,2), 2, { 4, 5 } },
+	};
+
+	parallelFor(bricks.size(), 256, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			glm::ivec3 brickAddress = glm::ivec3(uintXYZ10ToVec3(bricks[i]));
+			glm::vec4 voxelValues[8];
+			for (int c = 0; c < 8; ++c) {
+				voxelValues[c] = loadBrick(pool, brickAddress + 2 * glm::ivec3(childOffsets[c]));
+			}
+			for (auto & spread : spreads) {
+				float weight = 1.0f / float(spread.numCorners);
+				glm::vec4 col(0.0f);
+				for (int c = 0; c < spread.numCorners; ++c) {
+					col += weight * voxelValues[spread.corners[c]];
+				}
+				int voxel = brickVoxelIndex(brickAddress + spread.offset);
+				if (voxel >= 0) {
+					m_brickPool[pool][voxel] = packUnorm(col);
+				}
+			}
+		}
+	});
+}
+
+void CpuOctreeBuilder::borderTransfer(int level, BrickPoolData pool)
+{
+	uint32_t begin, end;
+	getLevelRange(level, begin, end);
+
+	const NodePoolData neighbourPools[3] = { NODE_POOL_NEIGH_X, NODE_POOL_NEIGH_Y, NODE_POOL_NEIGH_Z };
+	for (int axis = 0; axis < 3; ++axis) {
+		const NodePoolData neighbourPool = neighbourPools[axis];
+		const size_t grainSize = 1024;
+		std::vector<std::vector<Write>> writes(((end - begin) + grainSize - 1) / grainSize);
+		parallelFor(end - begin, grainSize, [&](size_t chunkBegin, size_t chunkEnd) {
+			auto & chunkWrites = writes[chunkBegin / grainSize];
+			for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+				uint32_t nodeAddress = begin + (uint32_t)i;
+				glm::ivec3 brickAddr = glm::ivec3(uintXYZ10ToVec3(loadNode(NODE_POOL_COLOR, nodeAddress)));
+				uint32_t neighbourAddress = loadNode(neighbourPool, nodeAddress);
+				if (neighbourAddress == 0) continue;
+				glm::ivec3 nBrickAddr = glm::ivec3(uintXYZ10ToVec3(loadNode(NODE_POOL_COLOR, neighbourAddress)));
+
+				// Loop over the face perpendicular to the axis in the shader's order.
+				int u = axis == 0 ? 1 : 0;
+				int v = axis == 2 ? 1 : 2;
+				for (int a = 0; a <= 2; ++a) {
+					for (int b = 0; b <= 2; ++b) {
+						glm::ivec3 offset(0), nOffset(0);
+						offset[axis] = 2;
+						offset[u] = nOffset[u] = a;
+						offset[v] = nOffset[v] = b;
+						glm::vec4 borderVal = loadBrick(pool, brickAddr + offset);
+						glm::vec4 neighbourBorderVal = loadBrick(pool, nBrickAddr + nOffset);
+						uint32_t finalVal = packUnorm(0.5f * (borderVal + neighbourBorderVal));
+						int voxel = brickVoxelIndex(brickAddr + offset);
+						int nVoxel = brickVoxelIndex(nBrickAddr + nOffset);
+						if (voxel >= 0) chunkWrites.push_back({ (uint32_t)voxel, finalVal, pool });
+						if (nVoxel >= 0) chunkWrites.push_back({ (uint32_t)nVoxel, finalVal, pool });
+					}
+				}
+			}
+		});
+		applyWrites(pool, writes);
+	}
+}
+
+void CpuOctreeBuilder::mipmap(int level, BrickPoolData pool, const glm::vec4 & emptyColor)
+{
+	// MipmapCenter, MipmapFaces, MipmapCorners and MipmapEdges fused: they only read the child
+	// bricks and write disjoint voxels of the parent brick.
+	uint32_t begin, end;
+	getLevelRange(level, begin, end);
+
+	const size_t grainSize = 256;
+	std::vector<std::vector<Write>> writes(((end - begin) + grainSize - 1) / grainSize);
+	parallelFor(end - begin, grainSize, [&](size_t chunkBegin, size_t chunkEnd) {
+		auto & chunkWrites = writes[chunkBegin / grainSize];
+		for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+			uint32_t nodeAddress = begin + (uint32_t)i;
+			uint32_t nodeNextU = loadNode(NODE_POOL_NEXT, nodeAddress);
+			if ((NODE_MASK_VALUE & nodeNextU) == 0) continue; // No child-pointer set - mipmapping is not possible anyway
+
+			glm::ivec3 brickAddress = glm::ivec3(uintXYZ10ToVec3(loadNode(NODE_POOL_COLOR, nodeAddress)));
+			uint32_t childAddress = NODE_MASK_VALUE & nodeNextU;
+			uint32_t childNextU[8], childColorU[8];
+			for (uint32_t c = 0; c < 8; ++c) {
+				childNextU[c] = loadNode(NODE_POOL_NEXT, childAddress + c);
+				childColorU[c] = loadNode(NODE_POOL_COLOR, childAddress + c);
+			}
+
+			// _mipmapUtil.shader
+			auto getColor = [&](const glm::ivec3 & pos) {
+				// GLSL round() of .5 rounds to even on the hardware we compare against.
+				glm::ivec3 childPos = glm::ivec3(std::nearbyint(pos.x / 4.0f), std::nearbyint(pos.y / 4.0f), std::nearbyint(pos.z / 4.0f));
+				int childIndex = childPos.x + 2 * childPos.y + 4 * childPos.z;
+				glm::ivec3 localPos = pos - 2 * childPos;
+				if ((NODE_MASK_VALUE & childNextU[childIndex]) == 0 && level != m_numLevels - 2)
+					return emptyColor;
+				glm::ivec3 childBrickAddress = glm::ivec3(uintXYZ10ToVec3(childColorU[childIndex]));
+				return loadBrick(pool, childBrickAddress + localPos);
+			};
+
+			for (int px = 0; px <= 4; px += 2) {
+				for (int py = 0; py <= 4; py += 2) {
+					for (int pz = 0; pz <= 4; pz += 2) {
+						glm::ivec3 pos(px, py, pz);
+						glm::vec4 col(0.0f);
+						float weightSum = 0.0f;
+						for (int x = -1; x <= 1; ++x) {
+							for (int y = -1; y <= 1; ++y) {
+								for (int z = -1; z <= 1; ++z) {
+									glm::ivec3 lookupPos = pos + glm::ivec3(x, y, z);
+									if (lookupPos.x >= 0 && lookupPos.y >= 0 && lookupPos.z >= 0 &&
+										lookupPos.x <= 4 && lookupPos.y <= 4 && lookupPos.z <= 4) {
+										float weight = gaussianWeight[std::abs(x) + std::abs(y) + std::abs(z)];
+										col += weight * getColor(lookupPos);
+										weightSum += weight;
+									}
+								}
+							}
+						}
+						int voxel = brickVoxelIndex(brickAddress + pos / 2);
+						if (voxel >= 0) {
+							chunkWrites.push_back({ (uint32_t)voxel, packUnorm(col / weightSum), pool });
+						}
+					}
+				}
+			}
+		}
+	});
+	applyWrites(pool, writes);
+}
+
+// ----------------------
+// Helpers.
+// ----------------------
+uint32_t CpuOctreeBuilder::loadNode(NodePoolData data, uint32_t address) const
+{
+	// Nodes that were never written are still cleared to zero.
+	return address < m_nodePool[data].size() ? m_nodePool[data][address] : 0U;
+}
+
+void CpuOctreeBuilder::storeNode(NodePoolData data, uint32_t address, uint32_t value)
+{
+	// Stores past the end of the texture buffer are discarded.
+	if (address >= (uint32_t)m_maxNodes) return;
+	if (address >= m_nodePool[data].size()) {
+		m_nodePool[data].resize(address + 1, 0U);
+	}
+	m_nodePool[data][address] = value;
+}
+
+void CpuOctreeBuilder::applyWrites(NodePoolData data, const std::vector<std::vector<Write>> & writes)
+{
+	for (auto & chunk : writes) {
+		for (auto & write : chunk) {
+			storeNode(data, write.address, write.value);
+		}
+	}
+}
+
+void CpuOctreeBuilder::applyWrites(BrickPoolData pool, const std::vector<std::vector<Write>> & writes)
+{
+	for (auto & chunk : writes) {
+		for (auto & write : chunk) {
+			m_brickPool[pool][write.address] = write.value;
+		}
+	}
+}
+
+int CpuOctreeBuilder::brickVoxelIndex(const glm::ivec3 & coords) const
+{
+	if (glm::any(glm::lessThan(coords, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(coords, glm::ivec3(m_brickPoolDim)))) {
+		return -1;
+	}
+	return (coords.z * m_brickPoolDim + coords.y) * m_brickPoolDim + coords.x;
+}
+
+glm::vec4 CpuOctreeBuilder::loadBrick(BrickPoolData pool, const glm::ivec3 & coords) const
+{
+	int voxel = brickVoxelIndex(coords);
+	return voxel >= 0 ? unpackUnorm(m_brickPool[pool][voxel]) : glm::vec4(0.0f);
+}
+
+void CpuOctreeBuilder::getLevelRange(int level, uint32_t & begin, uint32_t & end) const
+{
+	// getThreadNode in _threadNodeUtil.shader for the level's command of writeLevelCommandsVert.shader:
+	// the children of the tiles the level above handed out, at most the range of the level.
+	begin = m_levelAddress[level];
+	uint32_t levelNodes = m_levelAddress[level + 1] - begin;
+	end = begin + (level == 0 ? 1U : std::min(8U * m_nextFreeTile[level - 1], levelNodes));
+}
+
+int CpuOctreeBuilder::traverseSimple(glm::vec3 posTex, int maxLevel, glm::vec3 & nodeCenterPos, int & foundOnLevel) const
+{
+	// traverseOctree_simple in flagNodeVert.shader
+	glm::vec3 nodePosTex(0.0f);
+	glm::vec3 nodePosMaxTex(1.0f);
+	uint32_t nodeAddress = 0;
+	float sideLength = 0.5f;
+	foundOnLevel = maxLevel;
+
+	for (int iLevel = 0; iLevel < maxLevel; ++iLevel) {
+		uint32_t nodeNext = loadNode(NODE_POOL_NEXT, nodeAddress);
+		uint32_t childStartAddress = nodeNext & NODE_MASK_VALUE;
+		if ((nodeNext & NODE_MASK_BRICK) == 0U || childStartAddress == 0U) {
+			foundOnLevel = iLevel;
+			break;
+		}
+		glm::uvec3 offVec = toUint(2.0f * posTex);
+		uint32_t off = offVec.x + 2U * offVec.y + 4U * offVec.z;
+
+		nodeAddress = childStartAddress + off;
+		nodePosTex += childOffset(off) * sideLength;
+		nodePosMaxTex = nodePosTex + glm::vec3(sideLength);
+
+		sideLength = sideLength / 2.0f;
+		posTex = 2.0f * posTex - glm::vec3(offVec);
+	}
+
+	nodeCenterPos = 0.5f * (nodePosTex + nodePosMaxTex);
+	return (int)nodeAddress;
+}
+
+int CpuOctreeBuilder::traverseToLevel(glm::vec3 posTex, unsigned int & foundOnLevel, unsigned int maxLevel) const
+{
+	// traverseToLevel in _octreeTraverse.shader
+	uint32_t nodeAddress = 0;
+	for (foundOnLevel = 0; foundOnLevel < maxLevel; ++foundOnLevel) {
+		uint32_t nodeNext = loadNode(NODE_POOL_NEXT, nodeAddress);
+		uint32_t childStartAddress = nodeNext & NODE_MASK_VALUE;
+		if ((nodeNext & NODE_MASK_BRICK) == 0U || foundOnLevel == maxLevel - 1) {
+			break;
+		}
+		glm::uvec3 offVec = toUint(2.0f * posTex);
+		uint32_t off = offVec.x + 2U * offVec.y + 4U * offVec.z;
+		nodeAddress = childStartAddress + off;
+		posTex = 2.0f * posTex - glm::vec3(offVec);
+	}
+	return (int)nodeAddress;
+}
+
+int CpuOctreeBuilder::traversePosOut(glm::vec3 & posTex) const
+{
+	// traverseOctree_posOut in _octreeTraverse.shader
+	uint32_t nodeAddress = 0;
+	for (int iLevel = 0; iLevel < m_numLevels; ++iLevel) {
+		uint32_t nodeNext = loadNode(NODE_POOL_NEXT, nodeAddress);
+		uint32_t childStartAddress = nodeNext & NODE_MASK_VALUE;
+		if (childStartAddress == 0U) {
+			break;
+		}
+		glm::uvec3 offVec = toUint(2.0f * posTex);
+		uint32_t off = offVec.x + 2U * offVec.y + 4U * offVec.z;
+		nodeAddress = childStartAddress + off;
+		posTex = 2.0f * posTex - glm::vec3(offVec);
+	}
+	return (int)nodeAddress;
+}
+
+// ----------------------
+// Validation.
+// ----------------------
+CpuOctreeBuilder::Comparison CpuOctreeBuilder::compare(
+	const std::vector<uint32_t> gpuNodePool[NODE_POOL_NUM_TEXTURES],
+	const std::vector<uint32_t> gpuBrickPool[BRICK_POOL_NUM_TEXTURES],
+	unsigned int gpuFragmentCount, int tolerance) const
+{
+	Comparison result;
+	result.fragmentCountMatches = gpuFragmentCount == m_fragmentList.size();
+
+	auto loadGpuNode = [&](int data, uint32_t address) {
+		return address < gpuNodePool[data].size() ? gpuNodePool[data][address] : 0U;
+	};
+
+	// Walk both trees level by level and pair up the nodes at the same position.
+	std::unordered_map<uint32_t, uint32_t> cpuToGpu;
+	std::vector<std::pair<uint32_t, uint32_t>> current, next;
+	current.push_back(std::make_pair(0U, 0U));
+	cpuToGpu[0] = 0;
+	for (int level = 0; level < m_numLevels && !current.empty(); ++level) {
+		next.clear();
+		for (auto & pair : current) {
+			++result.comparedNodes;
+			uint32_t cpuNext = loadNode(NODE_POOL_NEXT, pair.first);
+			uint32_t gpuNext = loadGpuNode(NODE_POOL_NEXT, pair.second);
+			bool cpuHasChildren = (cpuNext & NODE_MASK_VALUE) != 0;
+			bool gpuHasChildren = (gpuNext & NODE_MASK_VALUE) != 0;
+			if ((cpuNext & ~NODE_MASK_VALUE) != (gpuNext & ~NODE_MASK_VALUE) || cpuHasChildren != gpuHasChildren) {
+				++result.structureMismatches;
+				continue;
+			}
+
+			if ((cpuNext & NODE_MASK_BRICK) != 0) {
+				glm::ivec3 cpuBrick = glm::ivec3(uintXYZ10ToVec3(loadNode(NODE_POOL_COLOR, pair.first)));
+				glm::ivec3 gpuBrick = glm::ivec3(uintXYZ10ToVec3(loadGpuNode(NODE_POOL_COLOR, pair.second)));
+				for (int pool = 0; pool < BRICK_POOL_NUM_TEXTURES; ++pool) {
+					for (int i = 0; i < 27; ++i) {
+						glm::ivec3 offset(i % 3, (i / 3) % 3, i / 9);
+						int cpuVoxel = brickVoxelIndex(cpuBrick + offset);
+						int gpuVoxel = brickVoxelIndex(gpuBrick + offset);
+						if (cpuVoxel < 0 || gpuVoxel < 0 || (size_t)gpuVoxel >= gpuBrickPool[pool].size()) continue;
+						glm::ivec4 a = glm::ivec4(convRGBA8ToVec4(m_brickPool[pool][cpuVoxel]));
+						glm::ivec4 b = glm::ivec4(convRGBA8ToVec4(gpuBrickPool[pool][gpuVoxel]));
+						glm::ivec4 diff = glm::abs(a - b);
+						int maxDiff = std::max(std::max(diff.x, diff.y), std::max(diff.z, diff.w));
+						result.maxBrickError = std::max(result.maxBrickError, maxDiff);
+						if (maxDiff > tolerance) {
+							++result.brickVoxelMismatches[pool];
+						}
+					}
+				}
+			}
+
+			if (cpuHasChildren) {
+				uint32_t cpuChild = cpuNext & NODE_MASK_VALUE;
+				uint32_t gpuChild = gpuNext & NODE_MASK_VALUE;
+				for (uint32_t i = 0; i < 8; ++i) {
+					next.push_back(std::make_pair(cpuChild + i, gpuChild + i));
+					cpuToGpu[cpuChild + i] = gpuChild + i;
+				}
+			}
+		}
+		current.swap(next);
+	}
+
+	// Neighbour pointers must point to the matching node.
+	const NodePoolData neighbourPools[6] = {
+		NODE_POOL_NEIGH_X, NODE_POOL_NEIGH_X_NEG, NODE_POOL_NEIGH_Y,
+		NODE_POOL_NEIGH_Y_NEG, NODE_POOL_NEIGH_Z, NODE_POOL_NEIGH_Z_NEG };
+	for (auto & pair : cpuToGpu) {
+		for (auto neighbourPool : neighbourPools) {
+			uint32_t cpuNeighbour = loadNode(neighbourPool, pair.first);
+			uint32_t gpuNeighbour = loadGpuNode(neighbourPool, pair.second);
+			uint32_t expected = 0;
+			if (cpuNeighbour != 0) {
+				auto it = cpuToGpu.find(cpuNeighbour);
+				expected = it != cpuToGpu.end() ? it->second : NODE_MASK_VALUE;
+			}
+			if (expected != gpuNeighbour) {
+				++result.neighbourMismatches;
+			}
+		}
+	}
+	return result;
+}
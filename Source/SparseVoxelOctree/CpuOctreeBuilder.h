@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm.hpp>
+
+class MeshRenderer;
+class ThreadPool;
+
+/// <summary> Builds the sparse voxel octree on the CPU. Runs the same passes as Graphics::sparseVoxelize
+/// (voxelize, flagNode, allocateNode, findNeighbours, allocateBrick, writeLeafNode, spreadLeafBrick,
+/// borderTransfer and the mipmap passes) and produces node and brick pools with the layout and packing
+/// of the GPU textures, so it can bake octrees without a GL context and serve as a reference for the shaders. </summary>
+class CpuOctreeBuilder {
+public:
+	// Same order as Graphics::NodePoolData.
+	enum NodePoolData {
+		NODE_POOL_NEXT,
+		NODE_POOL_COLOR,
+		NODE_POOL_NEIGH_X,
+		NODE_POOL_NEIGH_X_NEG,
+		NODE_POOL_NEIGH_Y,
+		NODE_POOL_NEIGH_Y_NEG,
+		NODE_POOL_NEIGH_Z,
+		NODE_POOL_NEIGH_Z_NEG,
+		NODE_POOL_NUM_TEXTURES
+	};
+
+	// The brick pools written by sparseVoxelize.
+	enum BrickPoolData {
+		BRICK_POOL_COLOR,
+		BRICK_POOL_IRRADIANCE,
+		BRICK_POOL_NORMAL,
+		BRICK_POOL_NUM_TEXTURES
+	};
+
+	/// <summary> A world space triangle. Normals are already transformed, the color is the material's diffuse color. </summary>
+	struct Triangle {
+		glm::vec3 position[3];
+		glm::vec3 normal[3];
+		glm::vec3 diffuseColor;
+	};
+
+	/// <summary> Result of comparing this octree with a GPU read back. </summary>
+	struct Comparison {
+		size_t comparedNodes = 0;
+		size_t structureMismatches = 0; // different flags or child pointer presence
+		size_t neighbourMismatches = 0;
+		size_t brickVoxelMismatches[BRICK_POOL_NUM_TEXTURES] = { 0, 0, 0 };
+		int maxBrickError = 0; // largest per channel difference in 1/255 steps
+		bool fragmentCountMatches = true; // both fragment lists hold the same number of voxels
+	};
+
+	/// <summary> levelTileCapacity holds the tiles each level can hand out, 13 entries as Graphics::m_levelTileCapacity.
+	/// The level ranges of the node pool follow from them as in Graphics::resizeNodePool. Without it the levels are dense. </summary>
+	CpuOctreeBuilder(int nodePoolDim = 256, int brickPoolDim = 70 * 3, const uint32_t * levelTileCapacity = nullptr, ThreadPool * threadPool = nullptr);
+
+	/// <summary> Removes all triangles. </summary>
+	void clearGeometry();
+
+	/// <summary> Adds the triangles of all enabled renderers, exactly as Graphics::renderQueue would draw them. </summary>
+	void addRenderers(const std::vector<MeshRenderer *> & renderers);
+
+	void addTriangle(const Triangle & triangle) { m_triangles.push_back(triangle); }
+
+	/// <summary> Builds the octree. voxelGridTransformI maps world space to the [0,1] voxel texture space. </summary>
+	void build(const glm::mat4 & voxelGridTransformI);
+
+	/// <summary> Compares against GPU pools: the node pool textures and the RGBA8 brick pool textures
+	/// (x fastest, one uint per voxel). Nodes are matched by walking both trees, because the GPU allocation
+	/// order is not deterministic. Brick values may differ by tolerance steps of 1/255. </summary>
+	Comparison compare(const std::vector<uint32_t> gpuNodePool[NODE_POOL_NUM_TEXTURES],
+		const std::vector<uint32_t> gpuBrickPool[BRICK_POOL_NUM_TEXTURES],
+		unsigned int gpuFragmentCount, int tolerance = 1) const;
+
+	// ----------------
+	// Results.
+	// ----------------
+	/// <summary> Node pool words, same packing as the nodePool_* texture buffers. Nodes past the end are zero. </summary>
+	const std::vector<uint32_t> & getNodePool(NodePoolData data) const { return m_nodePool[data]; }
+	/// <summary> Brick pool voxels as packed RGBA8 (red in the lowest byte), brickPoolDim^3 entries, x fastest. </summary>
+	const std::vector<uint32_t> & getBrickPool(BrickPoolData data) const { return m_brickPool[data]; }
+	/// <summary> Voxel fragment list, one XYZ16 packed position per voxel (Z in the high word), in first claim order. </summary>
+	const std::vector<uint64_t> & getFragmentList() const { return m_fragmentList; }
+	unsigned int getLevelAddress(int level) const { return m_levelAddress[level]; }
+	unsigned int getLevelTileCapacity(int level) const { return m_levelTileCapacity[level]; }
+	/// <summary> Tiles the level handed out to its children, past its capacity if it ran out. </summary>
+	unsigned int getLevelTiles(int level) const { return m_nextFreeTile[level]; }
+	unsigned int getNumTiles() const;
+	int getMaxNodes() const { return m_maxNodes; }
+	unsigned int getNumBricks() const { return m_nextFreeBrick; }
+	int getNumLevels() const { return m_numLevels; }
+	int getNodePoolDim() const { return m_nodePoolDim; }
+	int getBrickPoolDim() const { return m_brickPoolDim; }
+
+private:
+	struct Fragment {
+		uint64_t position; // XYZ16
+		glm::vec4 color;
+		glm::vec4 normal;
+	};
+
+	// A deferred write, applied in thread order after a parallel pass.
+	struct Write {
+		uint32_t address;
+		uint32_t value;
+		int data; // NodePoolData or BrickPoolData the write goes to
+	};
+
+	// ----------------
+	// Passes, named after the Graphics functions they replace.
+	// ----------------
+	void clearPools();
+	void voxelizeScene(const glm::mat4 & voxelGridTransformI);
+	void flagNode(int level);
+	void allocateNode(int level);
+	void findNeighbours(int level);
+	void allocateBrick();
+	void writeLeafNode();
+	void spreadLeafBrick(BrickPoolData pool);
+	void borderTransfer(int level, BrickPoolData pool);
+	void mipmap(int level, BrickPoolData pool, const glm::vec4 & emptyColor);
+
+	// ----------------
+	// Helpers.
+	// ----------------
+	void rasterizeTriangle(const Triangle & triangle, const glm::mat4 & voxelGridTransformI, std::vector<Fragment> & fragments) const;
+	uint32_t loadNode(NodePoolData data, uint32_t address) const;
+	void storeNode(NodePoolData data, uint32_t address, uint32_t value);
+	void applyWrites(NodePoolData data, const std::vector<std::vector<Write>> & writes);
+	void applyWrites(BrickPoolData pool, const std::vector<std::vector<Write>> & writes);
+	int brickVoxelIndex(const glm::ivec3 & coords) const;
+	glm::vec4 loadBrick(BrickPoolData pool, const glm::ivec3 & coords) const;
+	void getLevelRange(int level, uint32_t & begin, uint32_t & end) const;
+	int traverseSimple(glm::vec3 posTex, int maxLevel, glm::vec3 & nodeCenterPos, int & foundOnLevel) const;
+	int traverseToLevel(glm::vec3 posTex, unsigned int & foundOnLevel, unsigned int maxLevel) const;
+	int traversePosOut(glm::vec3 & posTex) const;
+	template<typename Body> void parallelFor(size_t count, size_t grainSize, const Body & body);
+
+	ThreadPool * m_threadPool;
+	std::vector<Triangle> m_triangles;
+
+	int m_nodePoolDim;
+	int m_numLevels;
+	int m_maxNodes;
+	int m_brickPoolDim;
+
+	std::vector<uint32_t> m_nodePool[NODE_POOL_NUM_TEXTURES];
+	std::vector<uint32_t> m_levelAddress;
+	std::vector<uint32_t> m_levelTileCapacity;
+	std::vector<uint32_t> m_brickPool[BRICK_POOL_NUM_TEXTURES];
+	std::vector<uint64_t> m_fragmentList;
+	std::vector<uint32_t> m_voxelColor;  // averaged color of each listed voxel, RGBA8 as voxelFragTex_color
+	std::vector<uint32_t> m_voxelNormal; // averaged normal of each listed voxel, RGBA8 as voxelFragTex_normal
+	std::vector<uint32_t> m_nextFreeTile; // tiles handed out for the children of each level
+	uint32_t m_nextFreeBrick;
+};
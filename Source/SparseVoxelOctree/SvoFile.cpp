@@ -0,0 +1,189 @@
+#include "SvoFile.h"
+
+// Stdlib.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Internal.
+#include "../Graphic/Renderer/MeshRenderer.h"
+#include "../Shape/Mesh.h"
+
+namespace {
+	const uint64_t CHUNK_ALIGNMENT = 4096;
+
+	uint64_t alignChunk(uint64_t offset) {
+		return (offset + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+	}
+
+	bool writeAt(FILE * file, uint64_t offset, const void * data, size_t size) {
+		// Large files need 64 bit offsets
+#ifdef _WIN32
+		if (_fseeki64(file, (long long)offset, SEEK_SET) != 0) return false;
+#else
+		if (fseeko(file, (off_t)offset, SEEK_SET) != 0) return false;
+#endif
+		return fwrite(data, 1, size, file) == size;
+	}
+
+	// FNV-1a
+	void hashBytes(uint64_t & hash, const void * data, size_t size) {
+		const unsigned char * bytes = (const unsigned char *)data;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+}
+
+uint64_t SvoFile::hashScene(const std::vector<MeshRenderer *> & renderers)
+{
+	// Same inputs as CpuOctreeBuilder::addRenderers
+	uint64_t hash = 14695981039346656037ULL;
+	for (auto * renderer : renderers) {
+		if (!renderer->enabled) continue;
+		renderer->transform.updateTransformMatrix();
+		hashBytes(hash, &renderer->transform.getTransformMatrix()[0][0], sizeof(glm::mat4));
+		if (renderer->materialSetting != nullptr) {
+			hashBytes(hash, &renderer->materialSetting->diffuseColor[0], sizeof(glm::vec3));
+		}
+
+		const Mesh & mesh = *renderer->mesh;
+		for (const VertexData & vertex : mesh.vertexData) {
+			hashBytes(hash, &vertex.position[0], sizeof(glm::vec3));
+			hashBytes(hash, &vertex.normal[0], sizeof(glm::vec3));
+		}
+		if (!mesh.indices.empty()) {
+			hashBytes(hash, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+		}
+	}
+	return hash;
+}
+
+bool SvoFile::write(const std::string & path, uint64_t sceneHash, const Info & info, const Levels & levels,
+	const uint32_t * const nodePool[CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES],
+	const uint32_t * const brickPools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES])
+{
+	const uint64_t nodeFieldSize = (uint64_t)info.maxNodes * sizeof(uint32_t);
+	const uint64_t brickPoolSize = (uint64_t)info.brickPoolDim * info.brickPoolDim * info.brickPoolDim * sizeof(uint32_t);
+
+	Header header;
+	memcpy(header.magic, "SVOF", 4);
+	header.version = VERSION;
+	header.numChunks = 4;
+	header.reserved = 0;
+	header.sceneHash = sceneHash;
+
+	Chunk chunks[4];
+	chunks[0] = { CHUNK_INFO, 0, alignChunk(sizeof(Header) + sizeof(chunks)), sizeof(Info) };
+	chunks[1] = { CHUNK_LEVELS, 0, chunks[0].offset + chunks[0].size, sizeof(Levels) };
+	chunks[2] = { CHUNK_NODE_POOL, 0, alignChunk(chunks[1].offset + chunks[1].size), nodeFieldSize * CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES };
+	chunks[3] = { CHUNK_BRICK_POOLS, 0, alignChunk(chunks[2].offset + chunks[2].size), brickPoolSize * CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES };
+
+	FILE * file = fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	bool ok = writeAt(file, 0, &header, sizeof(header))
+		&& writeAt(file, sizeof(header), chunks, sizeof(chunks))
+		&& writeAt(file, chunks[0].offset, &info, sizeof(info))
+		&& writeAt(file, chunks[1].offset, &levels, sizeof(levels));
+	for (int i = 0; ok && i < CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES; i++) {
+		ok = writeAt(file, chunks[2].offset + i * nodeFieldSize, nodePool[i], (size_t)nodeFieldSize);
+	}
+	for (int i = 0; ok && i < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; i++) {
+		ok = writeAt(file, chunks[3].offset + i * brickPoolSize, brickPools[i], (size_t)brickPoolSize);
+	}
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
+
+bool SvoFile::write(const std::string & path, uint64_t sceneHash, const CpuOctreeBuilder & builder)
+{
+	Info info;
+	info.nodePoolDim = builder.getNodePoolDim();
+	info.numLevels = builder.getNumLevels();
+	info.maxNodes = builder.getMaxNodes();
+	info.brickPoolDim = builder.getBrickPoolDim();
+	const uint32_t brickPoolBricks = (info.brickPoolDim / 3) * (info.brickPoolDim / 3) * (info.brickPoolDim / 3);
+	info.numBricks = std::min(builder.getNumBricks(), brickPoolBricks);
+	Levels levels;
+	for (int i = 0; i < MAX_LEVELS; i++) {
+		info.levelTileCapacity[i] = builder.getLevelTileCapacity(i);
+		levels.levelAddress[i] = builder.getLevelAddress(i);
+		levels.levelTiles[i] = builder.getLevelTiles(i);
+	}
+
+	// The builder stores the node pool up to the last written node, the file holds maxNodes words per field
+	std::vector<uint32_t> nodePool[CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES];
+	const uint32_t * nodeFields[CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES];
+	for (int i = 0; i < CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES; i++) {
+		nodePool[i] = builder.getNodePool((CpuOctreeBuilder::NodePoolData)i);
+		nodePool[i].resize(info.maxNodes, 0U);
+		nodeFields[i] = nodePool[i].data();
+	}
+	const uint32_t * brickData[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES];
+	for (int i = 0; i < CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES; i++) {
+		brickData[i] = builder.getBrickPool((CpuOctreeBuilder::BrickPoolData)i).data();
+	}
+	return write(path, sceneHash, info, levels, nodeFields, brickData);
+}
+
+bool SvoFile::open(const std::string & path)
+{
+	m_nodePool = nullptr;
+	m_brickPools = nullptr;
+	if (!m_mappedFile.open(path)) {
+		std::cout << "SVO file " << path << " cannot be opened." << std::endl;
+		return false;
+	}
+
+	const unsigned char * data = m_mappedFile.getData();
+	const size_t size = m_mappedFile.getSize();
+	Header header;
+	if (size < sizeof(Header)) {
+		std::cout << "SVO file " << path << " is truncated." << std::endl;
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "SVOF", 4) != 0 || header.version != VERSION) {
+		std::cout << "SVO file " << path << " is not an SVO file of version " << VERSION << "." << std::endl;
+		return false;
+	}
+	if (size < sizeof(Header) + (size_t)header.numChunks * sizeof(Chunk)) {
+		std::cout << "SVO file " << path << " is truncated." << std::endl;
+		return false;
+	}
+
+	const Chunk * chunkTable = (const Chunk *)(data + sizeof(Header));
+	const Chunk * chunks[NUM_CHUNK_IDS] = {};
+	for (uint32_t i = 0; i < header.numChunks; i++) {
+		if (chunkTable[i].offset > size || chunkTable[i].size > size - chunkTable[i].offset) {
+			std::cout << "SVO file " << path << " is truncated." << std::endl;
+			return false;
+		}
+		if (chunkTable[i].id < NUM_CHUNK_IDS) {
+			chunks[chunkTable[i].id] = &chunkTable[i];
+		}
+	}
+	if (!chunks[CHUNK_INFO] || chunks[CHUNK_INFO]->size != sizeof(Info) || !chunks[CHUNK_LEVELS] || chunks[CHUNK_LEVELS]->size != sizeof(Levels)
+		|| !chunks[CHUNK_NODE_POOL] || !chunks[CHUNK_BRICK_POOLS]) {
+		std::cout << "SVO file " << path << " misses chunks." << std::endl;
+		return false;
+	}
+
+	m_sceneHash = header.sceneHash;
+	memcpy(&m_info, data + chunks[CHUNK_INFO]->offset, sizeof(Info));
+	memcpy(&m_levels, data + chunks[CHUNK_LEVELS]->offset, sizeof(Levels));
+	const uint64_t nodePoolSize = (uint64_t)m_info.maxNodes * sizeof(uint32_t) * CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES;
+	const uint64_t brickPoolsSize = (uint64_t)m_info.brickPoolDim * m_info.brickPoolDim * m_info.brickPoolDim * sizeof(uint32_t) * CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES;
+	if (chunks[CHUNK_NODE_POOL]->size != nodePoolSize || chunks[CHUNK_BRICK_POOLS]->size != brickPoolsSize
+		|| m_info.numLevels == 0 || (int)m_info.numLevels >= MAX_LEVELS) {
+		std::cout << "SVO file " << path << " has inconsistent chunk sizes." << std::endl;
+		return false;
+	}
+	m_nodePool = (const uint32_t *)(data + chunks[CHUNK_NODE_POOL]->offset);
+	m_brickPools = (const uint32_t *)(data + chunks[CHUNK_BRICK_POOLS]->offset);
+	return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "CpuOctreeBuilder.h"
+#include "../Utility/MappedFile.h"
+
+class MeshRenderer;
+
+/// <summary> A baked sparse voxel octree in a chunked binary file: the node pool, the level ranges and the
+/// brick pools, in the layout of the GPU buffers (see CpuOctreeBuilder::getNodePool and getBrickPool).
+/// The file is read through a memory mapping, so the chunks can be uploaded or streamed without copies.
+/// Chunks are aligned to 4 KB; unknown chunks are skipped, so chunks can be added without a new version.
+/// The header keeps a hash of the scene the octree was baked from (see hashScene). </summary>
+class SvoFile {
+public:
+	static const uint32_t VERSION = 2;
+	static const int MAX_LEVELS = 13; // Graphics MAX_NODE_POOL_LEVELS
+
+	enum ChunkId {
+		CHUNK_INFO = 1,
+		CHUNK_NODE_POOL = 2,   // NODE_POOL_NUM_TEXTURES fields of maxNodes words each
+		CHUNK_BRICK_POOLS = 3, // BRICK_POOL_NUM_TEXTURES RGBA8 pools of brickPoolDim^3 voxels each, x fastest
+		CHUNK_LEVELS = 4,      // Levels
+		NUM_CHUNK_IDS
+	};
+
+	struct Info {
+		uint32_t nodePoolDim;   // voxels along one edge
+		uint32_t numLevels;
+		uint32_t maxNodes;      // nodes of all level ranges
+		uint32_t brickPoolDim;  // brick pool voxels along one edge
+		uint32_t numBricks;     // bricks handed out, brick 0 included
+		uint32_t levelTileCapacity[MAX_LEVELS];
+	};
+
+	struct Levels {
+		uint32_t levelAddress[MAX_LEVELS]; // first node of each level
+		uint32_t levelTiles[MAX_LEVELS];   // tiles each level handed out to its children
+	};
+
+	/// <summary> Hash of what the voxelization of the enabled renderers depends on: meshes, transforms and diffuse colors. </summary>
+	static uint64_t hashScene(const std::vector<MeshRenderer *> & renderers);
+
+	/// <summary> Writes a file. nodePool holds the fields in CpuOctreeBuilder::NodePoolData order,
+	/// brickPools the pools in CpuOctreeBuilder::BrickPoolData order. Returns false on a write error. </summary>
+	static bool write(const std::string & path, uint64_t sceneHash, const Info & info, const Levels & levels,
+		const uint32_t * const nodePool[CpuOctreeBuilder::NODE_POOL_NUM_TEXTURES],
+		const uint32_t * const brickPools[CpuOctreeBuilder::BRICK_POOL_NUM_TEXTURES]);
+
+	/// <summary> Writes the octree of a CPU build, with its tile capacities and level ranges. Returns false on a write error. </summary>
+	static bool write(const std::string & path, uint64_t sceneHash, const CpuOctreeBuilder & builder);
+
+	/// <summary> Maps a file and checks its header and chunk sizes. Prints the reason and returns false
+	/// if it cannot be used. </summary>
+	bool open(const std::string & path);
+
+	uint64_t getSceneHash() const { return m_sceneHash; }
+	const Info & getInfo() const { return m_info; }
+	const Levels & getLevels() const { return m_levels; }
+	/// <summary> maxNodes words of a node pool field. </summary>
+	const uint32_t * getNodePool(CpuOctreeBuilder::NodePoolData data) const { return m_nodePool + (size_t)data * m_info.maxNodes; }
+	/// <summary> brickPoolDim^3 packed RGBA8 voxels of a brick pool. </summary>
+	const uint32_t * getBrickPool(CpuOctreeBuilder::BrickPoolData data) const {
+		return m_brickPools + (size_t)data * m_info.brickPoolDim * m_info.brickPoolDim * m_info.brickPoolDim;
+	}
+
+private:
+	struct Header {
+		char magic[4];      // "SVOF"
+		uint32_t version;
+		uint32_t numChunks;
+		uint32_t reserved;
+		uint64_t sceneHash;
+	};
+
+	struct Chunk {
+		uint32_t id;
+		uint32_t reserved;
+		uint64_t offset;    // from the start of the file
+		uint64_t size;      // bytes
+	};
+
+	MappedFile m_mappedFile;
+	uint64_t m_sceneHash = 0;
+	Info m_info;
+	Levels m_levels;
+	const uint32_t * m_nodePool = nullptr;
+	const uint32_t * m_brickPools = nullptr;
+};
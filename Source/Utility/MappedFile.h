@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/// <summary> A read-only memory mapping of a whole file. The pages are read from disk when they are first
+/// touched, so large files can be opened without reading them. </summary>
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	/// <summary> Maps the file. Returns false if it cannot be opened or is empty. </summary>
+	bool open(const std::string & path);
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+	const unsigned char * getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+private:
+	MappedFile(MappedFile const &) = delete;
+	void operator=(MappedFile const &) = delete;
+
+	const unsigned char * m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void * m_file = nullptr;    // HANDLE
+	void * m_mapping = nullptr; // HANDLE
+#else
+	int m_file = -1;
+#endif
+};
@@ -0,0 +1,157 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+	// Index of the work queue owned by the current thread, -1 for threads outside the pool.
+	thread_local int currentQueueIndex = -1;
+}
+
+ThreadPool::ThreadPool(unsigned int numThreads) : m_numQueuedTasks(0), m_nextQueue(0)
+{
+	if (numThreads == 0) {
+		numThreads = std::max(1U, std::thread::hardware_concurrency());
+	}
+
+	// The calling thread takes part in parallelFor, so it counts as one of the threads.
+	unsigned int numWorkers = numThreads - 1;
+	for (unsigned int i = 0; i <= numWorkers; ++i) {
+		m_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+	for (unsigned int i = 0; i < numWorkers; ++i) {
+		m_threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+	for (auto & thread : m_threads) {
+		thread.join();
+	}
+}
+
+ThreadPool & ThreadPool::getInstance()
+{
+	static ThreadPool instance;
+	return instance;
+}
+
+void ThreadPool::pushTask(unsigned int queueIndex, Task && task)
+{
+	WorkQueue & queue = *m_queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	queue.tasks.push_back(std::move(task));
+	++m_numQueuedTasks;
+}
+
+bool ThreadPool::popTask(unsigned int queueIndex, Task & task)
+{
+	WorkQueue & queue = *m_queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) {
+		return false;
+	}
+	task = std::move(queue.tasks.front());
+	queue.tasks.pop_front();
+	--m_numQueuedTasks;
+	return true;
+}
+
+bool ThreadPool::stealTask(unsigned int queueIndex, Task & task)
+{
+	const unsigned int numQueues = (unsigned int)m_queues.size();
+	for (unsigned int i = 1; i < numQueues; ++i) {
+		WorkQueue & queue = *m_queues[(queueIndex + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			--m_numQueuedTasks;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(unsigned int queueIndex)
+{
+	currentQueueIndex = (int)queueIndex;
+	Task task;
+	for (;;) {
+		if (popTask(queueIndex, task) || stealTask(queueIndex, task)) {
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wakeCondition.wait(lock, [this]() { return m_stop || m_numQueuedTasks > 0; });
+		if (m_stop) {
+			return;
+		}
+	}
+}
+
+void ThreadPool::run(Task task)
+{
+	if (m_threads.empty()) {
+		task();
+		return;
+	}
+	pushTask(m_nextQueue.fetch_add(1) % (unsigned int)m_threads.size(), std::move(task));
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+	}
+	m_wakeCondition.notify_all();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grainSize, const RangeTask & body)
+{
+	if (begin >= end) {
+		return;
+	}
+	grainSize = std::max<size_t>(grainSize, 1);
+	const size_t numChunks = (end - begin + grainSize - 1) / grainSize;
+	if (numChunks == 1 || m_threads.empty()) {
+		body(begin, end);
+		return;
+	}
+
+	// Outside callers share the last queue, workers push to their own one.
+	const unsigned int ownQueue = currentQueueIndex >= 0 ? (unsigned int)currentQueueIndex : (unsigned int)m_queues.size() - 1;
+	std::atomic<size_t> numRemaining(numChunks);
+
+	// Deal the chunks round robin so every worker starts with local work; idle workers steal the rest.
+	const unsigned int numQueues = (unsigned int)m_queues.size();
+	unsigned int queueIndex = m_nextQueue.fetch_add(1) % numQueues;
+	for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+		size_t chunkBegin = begin + chunk * grainSize;
+		size_t chunkEnd = std::min(end, chunkBegin + grainSize);
+		pushTask(queueIndex, [&body, &numRemaining, chunkBegin, chunkEnd]() {
+			body(chunkBegin, chunkEnd);
+			numRemaining.fetch_sub(1);
+		});
+		queueIndex = (queueIndex + 1) % numQueues;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+	}
+	m_wakeCondition.notify_all();
+
+	// Help out until all chunks of this call are done.
+	Task task;
+	while (numRemaining.load() > 0) {
+		if (popTask(ownQueue, task) || stealTask(ownQueue, task)) {
+			task();
+			task = nullptr;
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
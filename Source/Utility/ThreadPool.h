@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+/// <summary> A work-stealing thread pool. Every worker owns a task queue; it pops work from the front
+/// of its own queue and steals from the back of the other queues when it runs dry. </summary>
+class ThreadPool {
+public:
+	using Task = std::function<void()>;
+	using RangeTask = std::function<void(size_t, size_t)>;
+
+	/// <summary> Creates a pool with the given number of workers (0 = one per hardware thread). </summary>
+	ThreadPool(unsigned int numThreads = 0);
+	~ThreadPool();
+
+	/// <summary> Splits [begin, end) into chunks of at most grainSize elements and runs body(chunkBegin, chunkEnd)
+	/// on the pool. Blocks until every chunk has finished; the calling thread helps with the work, so nested
+	/// calls from inside a task are allowed. </summary>
+	void parallelFor(size_t begin, size_t end, size_t grainSize, const RangeTask & body);
+
+	/// <summary> Queues task on the pool and returns without waiting for it. Runs it right away
+	/// if the pool has no workers. </summary>
+	void run(Task task);
+
+	/// <summary> Number of threads that execute tasks, including the calling thread. </summary>
+	unsigned int getNumThreads() const { return (unsigned int)m_threads.size() + 1; }
+
+	/// <summary> A process wide pool used by the CPU side octree tools. </summary>
+	static ThreadPool & getInstance();
+
+private:
+	struct WorkQueue {
+		std::deque<Task> tasks;
+		std::mutex mutex;
+	};
+
+	ThreadPool(ThreadPool const &) = delete;
+	void operator=(ThreadPool const &) = delete;
+
+	void workerLoop(unsigned int queueIndex);
+	bool popTask(unsigned int queueIndex, Task & task);
+	bool stealTask(unsigned int queueIndex, Task & task);
+	void pushTask(unsigned int queueIndex, Task && task);
+
+	std::vector<std::unique_ptr<WorkQueue>> m_queues; // one per worker, the last one is shared by outside callers
+	std::vector<std::thread> m_threads;
+	std::atomic<size_t> m_numQueuedTasks;
+	std::atomic<unsigned int> m_nextQueue;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+	bool m_stop = false;
+};